@@ -42,6 +42,7 @@
  */
 
 #include <cstdint>
+#include <map>
 
 #include "gaussian_process.h"
 #include "math_tools.h"
@@ -61,7 +62,8 @@ GP::GP()
       data_loc_(Eigen::VectorXd()), data_out_(Eigen::VectorXd()), data_var_(Eigen::VectorXd()), gram_matrix_(Eigen::MatrixXd()),
       alpha_(Eigen::VectorXd()), chol_gram_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), log_noise_sd_(-1E20),
       use_explicit_trend_(false), feature_vectors_(Eigen::MatrixXd()), feature_matrix_(Eigen::MatrixXd()),
-      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd())
+      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd()), use_incremental_inference_(false),
+      chol_factor_(Eigen::MatrixXd()), chol_factor_valid_(false)
 {
 }
 
@@ -70,7 +72,8 @@ GP::GP(const covariance_functions::CovFunc& covFunc)
       data_var_(Eigen::VectorXd()), gram_matrix_(Eigen::MatrixXd()), alpha_(Eigen::VectorXd()),
       chol_gram_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), log_noise_sd_(-1E20), use_explicit_trend_(false),
       feature_vectors_(Eigen::MatrixXd()), feature_matrix_(Eigen::MatrixXd()),
-      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd())
+      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd()), use_incremental_inference_(false),
+      chol_factor_(Eigen::MatrixXd()), chol_factor_valid_(false)
 {
 }
 
@@ -79,7 +82,8 @@ GP::GP(const double noise_variance, const covariance_functions::CovFunc& covFunc
       data_var_(Eigen::VectorXd()), gram_matrix_(Eigen::MatrixXd()), alpha_(Eigen::VectorXd()),
       chol_gram_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), log_noise_sd_(std::log(noise_variance)), use_explicit_trend_(false),
       feature_vectors_(Eigen::MatrixXd()), feature_matrix_(Eigen::MatrixXd()),
-      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd())
+      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd()), use_incremental_inference_(false),
+      chol_factor_(Eigen::MatrixXd()), chol_factor_valid_(false)
 {
 }
 
@@ -95,7 +99,9 @@ GP::GP(const GP& that)
       data_loc_(that.data_loc_), data_out_(that.data_out_), data_var_(that.data_var_), gram_matrix_(that.gram_matrix_),
       alpha_(that.alpha_), chol_gram_matrix_(that.chol_gram_matrix_), log_noise_sd_(that.log_noise_sd_),
       use_explicit_trend_(that.use_explicit_trend_), feature_vectors_(that.feature_vectors_),
-      feature_matrix_(that.feature_matrix_), chol_feature_matrix_(that.chol_feature_matrix_), beta_(that.beta_)
+      feature_matrix_(that.feature_matrix_), chol_feature_matrix_(that.chol_feature_matrix_), beta_(that.beta_),
+      use_incremental_inference_(that.use_incremental_inference_), chol_factor_(that.chol_factor_),
+      chol_factor_valid_(that.chol_factor_valid_)
 {
     covFunc_ = that.covFunc_->clone();
     covFuncProj_ = that.covFuncProj_->clone();
@@ -140,6 +146,9 @@ GP& GP::operator=(const GP& that)
         alpha_ = that.alpha_;
         chol_gram_matrix_ = that.chol_gram_matrix_;
         log_noise_sd_ = that.log_noise_sd_;
+        use_incremental_inference_ = that.use_incremental_inference_;
+        chol_factor_ = that.chol_factor_;
+        chol_factor_valid_ = that.chol_factor_valid_;
     }
     return *this;
 }
@@ -169,7 +178,7 @@ Eigen::VectorXd GP::drawSample(const Eigen::VectorXd& locations, const Eigen::Ve
         Eigen::MatrixXd mixed_covariance;
         mixed_covariance = covFunc_->evaluate(locations, data_loc_);
         Eigen::MatrixXd posterior_covariance;
-        posterior_covariance = prior_covariance - mixed_covariance * (chol_gram_matrix_.solve(mixed_covariance.transpose()));
+        posterior_covariance = prior_covariance - mixed_covariance * (solveGram(mixed_covariance.transpose()));
         kernel_matrix =
             posterior_covariance + JITTER * Eigen::MatrixXd::Identity(posterior_covariance.rows(), posterior_covariance.cols());
     }
@@ -202,10 +211,29 @@ void GP::infer()
     }
 
     // compute the Cholesky decomposition of the Gram matrix
-    chol_gram_matrix_ = gram_matrix_.ldlt();
+    chol_factor_valid_ = false;
+    if (use_incremental_inference_)
+    {
+        // the plain Cholesky factor can be updated when the data changes
+        Eigen::LLT<Eigen::MatrixXd> chol_gram_matrix(gram_matrix_);
+        if (chol_gram_matrix.info() == Eigen::Success)
+        {
+            chol_factor_ = chol_gram_matrix.matrixL();
+            chol_factor_valid_ = true;
+        }
+    }
+    if (!chol_factor_valid_)
+    {
+        chol_gram_matrix_ = gram_matrix_.ldlt();
+    }
+
+    updateWeights();
+}
 
+void GP::updateWeights()
+{
     // pre-compute the alpha, which is the solution of the chol to the data
-    alpha_ = chol_gram_matrix_.solve(data_out_);
+    alpha_ = solveGram(data_out_);
 
     if (use_explicit_trend_)
     {
@@ -214,13 +242,180 @@ void GP::infer()
         feature_vectors_.row(0) = Eigen::MatrixXd::Ones(1, data_loc_.rows()); // instead of pow(0)
         feature_vectors_.row(1) = data_loc_.array(); // instead of pow(1)
 
-        feature_matrix_ = feature_vectors_ * chol_gram_matrix_.solve(feature_vectors_.transpose());
+        feature_matrix_ = feature_vectors_ * solveGram(feature_vectors_.transpose());
         chol_feature_matrix_ = feature_matrix_.ldlt();
 
         beta_ = chol_feature_matrix_.solve(feature_vectors_) * alpha_;
     }
 }
 
+Eigen::MatrixXd GP::solveGram(const Eigen::MatrixXd& rhs) const
+{
+    if (use_incremental_inference_ && chol_factor_valid_)
+    {
+        Eigen::MatrixXd tmp = chol_factor_.triangularView<Eigen::Lower>().solve(rhs);
+        return chol_factor_.transpose().triangularView<Eigen::Upper>().solve(tmp);
+    }
+    return chol_gram_matrix_.solve(rhs);
+}
+
+void GP::removeDataPoint(int index)
+{
+    int n = data_loc_.rows();
+    int m = n - index - 1; // number of points behind the removed one
+
+    // the column of the factor below the removed point, see below
+    Eigen::VectorXd v = chol_factor_.block(index + 1, index, m, 1);
+
+    // close the gap in the data, the Gram matrix and the factor
+    if (m > 0)
+    {
+        data_loc_.segment(index, m) = data_loc_.tail(m).eval();
+        data_out_.segment(index, m) = data_out_.tail(m).eval();
+        if (data_var_.rows() > 0)
+        {
+            data_var_.segment(index, m) = data_var_.tail(m).eval();
+        }
+        gram_matrix_.middleRows(index, m) = gram_matrix_.bottomRows(m).eval();
+        gram_matrix_.middleCols(index, m) = gram_matrix_.rightCols(m).eval();
+        chol_factor_.block(index, 0, m, index) = chol_factor_.block(index + 1, 0, m, index).eval();
+        chol_factor_.block(index, index, m, m) = chol_factor_.block(index + 1, index + 1, m, m).eval();
+    }
+    data_loc_.conservativeResize(n - 1);
+    data_out_.conservativeResize(n - 1);
+    if (data_var_.rows() > 0)
+    {
+        data_var_.conservativeResize(n - 1);
+    }
+    gram_matrix_.conservativeResize(n - 1, n - 1);
+    chol_factor_.conservativeResize(n - 1, n - 1);
+
+    // With the factor partitioned around the removed point as [A 0 0; b c 0; D v F],
+    // the factor of the reduced matrix is [A 0; D F'] with F' F'^T = F F^T + v v^T,
+    // which is a rank-one update of the trailing block.
+    for (int i = 0; i < m; ++i)
+    {
+        int j = index + i;
+        int t = m - i - 1;
+        double l = chol_factor_(j, j);
+        double r = std::sqrt(l * l + v(i) * v(i));
+        double c = r / l;
+        double s = v(i) / l;
+        chol_factor_(j, j) = r;
+        if (t > 0)
+        {
+            chol_factor_.block(j + 1, j, t, 1) = (chol_factor_.block(j + 1, j, t, 1) + s * v.segment(i + 1, t)) / c;
+            v.segment(i + 1, t) = c * v.segment(i + 1, t) - s * chol_factor_.block(j + 1, j, t, 1);
+        }
+    }
+}
+
+bool GP::appendDataPoint(double loc, double out, double var)
+{
+    int n = data_loc_.rows();
+
+    Eigen::VectorXd location(1);
+    location << loc;
+
+    // covariances to the points already in the subset, and the new diagonal element
+    Eigen::VectorXd covariance = covFunc_->evaluate(data_loc_, location);
+    double variance = covFunc_->evaluate(location, location)(0, 0);
+    if (data_var_.rows() == 0) // homoscedastic
+    {
+        variance += std::exp(2 * log_noise_sd_) + JITTER;
+    }
+    else // heteroscedastic
+    {
+        variance += var;
+    }
+
+    // the new row of the factor is L^-1 * covariance
+    Eigen::VectorXd row = chol_factor_.triangularView<Eigen::Lower>().solve(covariance);
+    double pivot = variance - row.squaredNorm();
+    if (!(pivot > 0))
+    {
+        return false;
+    }
+
+    data_loc_.conservativeResize(n + 1);
+    data_loc_(n) = loc;
+    data_out_.conservativeResize(n + 1);
+    data_out_(n) = out;
+    if (data_var_.rows() > 0)
+    {
+        data_var_.conservativeResize(n + 1);
+        data_var_(n) = var;
+    }
+
+    gram_matrix_.conservativeResize(n + 1, n + 1);
+    gram_matrix_.block(n, 0, 1, n) = covariance.transpose();
+    gram_matrix_.block(0, n, n, 1) = covariance;
+    gram_matrix_(n, n) = variance;
+
+    chol_factor_.conservativeResize(n + 1, n + 1);
+    chol_factor_.block(n, 0, 1, n) = row.transpose();
+    chol_factor_.block(0, n, n, 1).setZero();
+    chol_factor_(n, n) = std::sqrt(pivot);
+
+    return true;
+}
+
+bool GP::updateSubset(const std::vector<double>& loc, const std::vector<double>& out, const std::vector<double>& var)
+{
+    int n = data_loc_.rows();
+    bool use_var = !var.empty();
+
+    // index the new subset by location
+    std::map<double, int> wanted;
+    for (size_t i = 0; i < loc.size(); ++i)
+    {
+        wanted[loc[i]] = i;
+    }
+    if (wanted.size() != loc.size())
+    {
+        return false; // duplicate locations, cannot match points
+    }
+
+    // points of the current subset that are not in the new one, or whose values changed, are removed
+    std::vector<bool> kept(loc.size(), false);
+    std::vector<int> removed;
+    for (int j = 0; j < n; ++j)
+    {
+        std::map<double, int>::const_iterator it = wanted.find(data_loc_[j]);
+        if (it != wanted.end() && !kept[it->second] && out[it->second] == data_out_[j] &&
+            (!use_var || var[it->second] == data_var_[j]))
+        {
+            kept[it->second] = true;
+        }
+        else
+        {
+            removed.push_back(j);
+        }
+    }
+    size_t added = loc.size() - (n - removed.size());
+
+    // each update is O(n^2), while a new decomposition is O(n^3) plus O(n^2)
+    // covariance evaluations, so only few changes are worth updating
+    if (8 * (removed.size() + added) > static_cast<size_t>(n))
+    {
+        return false;
+    }
+
+    for (std::vector<int>::const_reverse_iterator it = removed.rbegin(); it != removed.rend(); ++it)
+    {
+        removeDataPoint(*it);
+    }
+    for (size_t i = 0; i < loc.size(); ++i)
+    {
+        if (!kept[i] && !appendDataPoint(loc[i], out[i], use_var ? var[i] : 0.0))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void GP::infer(const Eigen::VectorXd& data_loc, const Eigen::VectorXd& data_out,
                const Eigen::VectorXd& data_var /* = EigenVectorXd() */)
 {
@@ -265,6 +460,40 @@ void GP::inferSD(const Eigen::VectorXd& data_loc, const Eigen::VectorXd& data_ou
 
     bool use_var = data_var.rows() > 0; // true means heteroscedastic noise
 
+    if (use_incremental_inference_)
+    {
+        int m = std::min<int>(n, data_loc.rows());
+        std::vector<double> loc_arr(m);
+        std::vector<double> out_arr(m);
+        std::vector<double> var_arr(use_var ? m : 0);
+
+        for (int i = 0; i < m; ++i)
+        {
+            loc_arr[i] = data_loc[index[i]];
+            out_arr[i] = data_out[index[i]];
+            if (use_var)
+            {
+                var_arr[i] = data_var[index[i]];
+            }
+        }
+
+        // try to update the factor for the points that entered and left the subset
+        if (chol_factor_valid_ && use_var == (data_var_.rows() > 0) && updateSubset(loc_arr, out_arr, var_arr))
+        {
+            updateWeights();
+            return;
+        }
+
+        data_loc_ = Eigen::Map<Eigen::VectorXd>(loc_arr.data(), m, 1);
+        data_out_ = Eigen::Map<Eigen::VectorXd>(out_arr.data(), m, 1);
+        if (use_var)
+        {
+            data_var_ = Eigen::Map<Eigen::VectorXd>(var_arr.data(), m, 1);
+        }
+        infer();
+        return;
+    }
+
     if (n < data_loc.rows())
     {
         std::vector<double> loc_arr(n);
@@ -304,6 +533,8 @@ void GP::clearData()
 {
     gram_matrix_ = Eigen::MatrixXd();
     chol_gram_matrix_ = Eigen::LDLT<Eigen::MatrixXd>();
+    chol_factor_ = Eigen::MatrixXd();
+    chol_factor_valid_ = false;
     data_loc_ = Eigen::VectorXd();
     data_out_ = Eigen::VectorXd();
 }
@@ -392,7 +623,7 @@ Eigen::VectorXd GP::predict(const Eigen::MatrixXd& prior_cov, const Eigen::Matri
     Eigen::VectorXd m = mixed_cov * alpha_;
 
     // precompute K^{-1} * mixed_cov
-    Eigen::MatrixXd gamma = chol_gram_matrix_.solve(mixed_cov.transpose());
+    Eigen::MatrixXd gamma = solveGram(mixed_cov.transpose());
 
     Eigen::MatrixXd R;
 
@@ -457,3 +688,22 @@ void GP::disableExplicitTrend()
 {
     use_explicit_trend_ = false;
 }
+
+void GP::enableIncrementalInference()
+{
+    use_incremental_inference_ = true;
+    if (data_loc_.rows() > 0)
+    {
+        infer(); // build the factor
+    }
+}
+
+void GP::disableIncrementalInference()
+{
+    use_incremental_inference_ = false;
+    chol_factor_valid_ = false;
+    if (data_loc_.rows() > 0)
+    {
+        infer(); // build the LDLT decomposition
+    }
+}
@@ -76,6 +76,41 @@ private:
     Eigen::MatrixXd feature_matrix_;
     Eigen::LDLT<Eigen::MatrixXd> chol_feature_matrix_;
     Eigen::VectorXd beta_;
+    bool use_incremental_inference_;
+    Eigen::MatrixXd chol_factor_; // lower Cholesky factor of the Gram matrix (incremental inference)
+    bool chol_factor_valid_;
+
+    /*!
+     * Solves the Gram matrix system for the given right hand side, using
+     * either the LDLT decomposition or the incrementally updated Cholesky
+     * factor.
+     */
+    Eigen::MatrixXd solveGram(const Eigen::MatrixXd& rhs) const;
+
+    /*!
+     * Computes alpha and the explicit trend matrices from the decomposed Gram
+     * matrix.
+     */
+    void updateWeights();
+
+    /*!
+     * Removes the data point at the given index from the Gram matrix and its
+     * Cholesky factor with a rank-one update.
+     */
+    void removeDataPoint(int index);
+
+    /*!
+     * Appends a data point to the Gram matrix and extends its Cholesky factor.
+     * Returns false if the extended matrix is not numerically positive
+     * definite.
+     */
+    bool appendDataPoint(double loc, double out, double var);
+
+    /*!
+     * Brings the selected subset of data up to date by removing and appending
+     * points. Returns false if the Gram matrix has to be decomposed anew.
+     */
+    bool updateSubset(const std::vector<double>& loc, const std::vector<double>& out, const std::vector<double>& var);
 
 public:
     typedef std::pair<Eigen::VectorXd, Eigen::MatrixXd> VectorMatrixPair;
@@ -145,6 +180,20 @@ public:
                  const Eigen::VectorXd& data_var = Eigen::VectorXd(),
                  const double prediction_point = std::numeric_limits<double>::quiet_NaN());
 
+    /*!
+     * Enables incremental inference. inferSD() then keeps the Cholesky factor
+     * of the Gram matrix and updates it with rank-one updates as points enter
+     * and leave the selected subset, instead of building and decomposing the
+     * Gram matrix on every call. Changing the hyperparameters invalidates the
+     * factor.
+     */
+    void enableIncrementalInference();
+
+    /*!
+     * Disables incremental inference.
+     */
+    void disableIncrementalInference();
+
     /*!
      * Sets the GP back to the prior:
      * Removes datapoints, empties the Gram matrix.
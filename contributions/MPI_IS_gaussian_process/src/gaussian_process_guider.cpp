@@ -60,16 +60,22 @@
 
 #define HYSTERESIS 0.1 // for the hybrid mode
 
+#define PERIOD_UPDATE_TOLERANCE 1e-3 // relative period change passed on to the GP in incremental mode
+
 GaussianProcessGuider::GaussianProcessGuider(guide_parameters parameters)
     : start_time_(clock::now()), last_time_(clock::now()), control_signal_(0), prediction_(0), last_prediction_end_(0),
       dither_steps_(0), dithering_active_(false), dither_offset_(0.0), circular_buffer_data_(CIRCULAR_BUFFER_SIZE),
       covariance_function_(), output_covariance_function_(), gp_(covariance_function_), learning_rate_(DEFAULT_LEARNING_RATE),
-      parameters(parameters)
+      parameters(parameters), period_estimate_(0.0), pending_period_length_(0.0)
 {
     circular_buffer_data_.push_front(data_point()); // add first point
     circular_buffer_data_[0].control = 0; // set first control to zero
     gp_.enableExplicitTrend(); // enable the explicit basis function for the linear drift
     gp_.enableOutputProjection(output_covariance_function_); // for prediction
+    if (parameters.incremental_inference_)
+    {
+        gp_.enableIncrementalInference();
+    }
 
     std::vector<double> hyperparameters(NumParameters);
     hyperparameters[SE0KLengthScale] = parameters.SE0KLengthScale_;
@@ -207,8 +213,16 @@ void GaussianProcessGuider::UpdateGP(double prediction_point /*= std::numeric_li
     double period_length = GetGPHyperparameters()[PKPeriodLength];
     if (GetBoolComputePeriod() && get_last_point().timestamp > parameters.min_periods_for_period_estimation_ * period_length)
     {
-        // find periodicity parameter with FFT
-        period_length = EstimatePeriodLength(timestamps, gear_error_detrend);
+        // find periodicity parameter with FFT; the regularized data only changes
+        // when a grid cell is completed, so the estimate is reused until then
+        if (timestamps.size() != period_estimation_time_.size() || timestamps != period_estimation_time_ ||
+            gear_error_detrend != period_estimation_data_)
+        {
+            period_estimate_ = EstimatePeriodLength(timestamps, gear_error_detrend);
+            period_estimation_time_ = timestamps;
+            period_estimation_data_ = gear_error_detrend;
+        }
+        period_length = period_estimate_;
         UpdatePeriodLength(period_length);
 
 #if PRINT_TIMINGS_
@@ -409,6 +423,8 @@ void GaussianProcessGuider::reset()
 {
     circular_buffer_data_.clear();
     gp_.clearData();
+    period_estimation_time_ = Eigen::VectorXd();
+    period_estimation_data_ = Eigen::VectorXd();
 
     // We need to add a first data point because the measurements are always relative to the control.
     // For the first measurement, we therefore need to add a point with zero control.
@@ -471,6 +487,25 @@ bool GaussianProcessGuider::SetBoolComputePeriod(bool active)
     return false;
 }
 
+bool GaussianProcessGuider::GetBoolIncrementalInference() const
+{
+    return parameters.incremental_inference_;
+}
+
+bool GaussianProcessGuider::SetBoolIncrementalInference(bool active)
+{
+    parameters.incremental_inference_ = active;
+    if (active)
+    {
+        gp_.enableIncrementalInference();
+    }
+    else
+    {
+        gp_.disableIncrementalInference();
+    }
+    return false;
+}
+
 std::vector<double> GaussianProcessGuider::GetGPHyperparameters() const
 {
     // since the GP class works in log space, we have to exp() the parameters first.
@@ -502,6 +537,8 @@ bool GaussianProcessGuider::SetGPHyperparameters(std::vector<double> const& hype
     // safeguard all parameters from being too small (log conversion)
     hyperparameters_eig = hyperparameters_eig.array().max(1e-10);
 
+    pending_period_length_ = hyperparameters_eig(PKPeriodLength);
+
     // need to convert to GP parameters
     Eigen::VectorXd hyperparameters_full(NumParameters + 1); // the GP has one more parameter!
     hyperparameters_full << 1.0, hyperparameters_eig;
@@ -676,8 +713,23 @@ void GaussianProcessGuider::UpdatePeriodLength(double period_length)
         period_length = hypers[PKPeriodLength]; // just use the old value instead
     }
 
-    // we just apply a simple learning rate to slow down parameter jumps
-    hypers[PKPeriodLength] = (1 - learning_rate_) * hypers[PKPeriodLength] + learning_rate_ * period_length;
+    if (parameters.incremental_inference_)
+    {
+        // every change of the hyperparameters needs a new decomposition of the
+        // Gram matrix, so the filtered period length is only passed on to the
+        // GP when it has moved noticeably
+        pending_period_length_ = (1 - learning_rate_) * pending_period_length_ + learning_rate_ * period_length;
+        if (std::abs(pending_period_length_ - hypers[PKPeriodLength]) <= PERIOD_UPDATE_TOLERANCE * hypers[PKPeriodLength])
+        {
+            return;
+        }
+        hypers[PKPeriodLength] = pending_period_length_;
+    }
+    else
+    {
+        // we just apply a simple learning rate to slow down parameter jumps
+        hypers[PKPeriodLength] = (1 - learning_rate_) * hypers[PKPeriodLength] + learning_rate_ * period_length;
+    }
 
     SetGPHyperparameters(hypers); // the setter function is needed to convert parameters
 }
@@ -97,6 +97,8 @@ public:
 
         bool compute_period_;
 
+        bool incremental_inference_;
+
         double SE0KLengthScale_;
         double SE0KSignalVariance_;
         double PKLengthScale_;
@@ -108,7 +110,7 @@ public:
         guide_parameters()
             : control_gain_(0.0), min_move_(0.0), prediction_gain_(0.0), min_periods_for_inference_(0.0),
               min_periods_for_period_estimation_(0.0), points_for_approximation_(0), compute_period_(false),
-              SE0KLengthScale_(0.0), SE0KSignalVariance_(0.0), PKLengthScale_(0.0), PKSignalVariance_(0.0),
+              incremental_inference_(false), SE0KLengthScale_(0.0), SE0KSignalVariance_(0.0), PKLengthScale_(0.0), PKSignalVariance_(0.0),
               SE1KLengthScale_(0.0), SE1KSignalVariance_(0.0), PKPeriodLength_(0.0)
         {
         }
@@ -144,6 +146,20 @@ private:
      */
     guide_parameters parameters;
 
+    /**
+     * The data of the last period estimation and its result. The FFT is only
+     * computed again when the regularized data has changed.
+     */
+    Eigen::VectorXd period_estimation_time_;
+    Eigen::VectorXd period_estimation_data_;
+    double period_estimate_;
+
+    /**
+     * In incremental mode, the filtered period length, which is only passed on
+     * to the GP when it has moved noticeably.
+     */
+    double pending_period_length_;
+
     /**
      * Stores the current time and creates a timestamp for the GP.
      */
@@ -201,6 +217,9 @@ public:
     bool GetBoolComputePeriod() const;
     bool SetBoolComputePeriod(bool active);
 
+    bool GetBoolIncrementalInference() const;
+    bool SetBoolIncrementalInference(bool active);
+
     std::vector<double> GetGPHyperparameters() const;
     bool SetGPHyperparameters(const std::vector<double>& hyperparameters);
 
@@ -209,6 +209,62 @@ TEST_F(GPTest, infer_prediction_clear_test)
     EXPECT_NEAR(prediction(1), 0, 1e-6);
 }
 
+// The incremental updates of the Cholesky factor have to give the same
+// predictions as building and decomposing the Gram matrix on every step
+TEST_F(GPTest, inferSD_incremental_matches_full)
+{
+    Eigen::Matrix<double, 6, 1> hyperParams;
+    hyperParams << 10, 1, 1, 1, 100, 1;
+    hyperParams = hyperParams.array().log();
+
+    Eigen::VectorXd periodLength(1);
+    periodLength << std::log(80);
+
+    covariance_functions::PeriodicSquareExponential2 covFunc(hyperParams);
+    covFunc.setExtraParameters(periodLength);
+
+    GP full_gp(covFunc);
+    GP incremental_gp(covFunc);
+    full_gp.enableExplicitTrend();
+    incremental_gp.enableExplicitTrend();
+    incremental_gp.enableIncrementalInference();
+
+    const int N = 200;
+    const int n = 40;
+    Eigen::VectorXd locations(N), outputs(N), variances(N);
+    for (int i = 0; i < N; ++i)
+    {
+        locations(i) = 5.0 * i + 2.5;
+        outputs(i) = 3.0 * std::sin(2 * M_PI * locations(i) / 80.0) + 0.01 * locations(i) + 0.1 * std::cos(1.3 * i);
+        variances(i) = 0.1 + 0.05 * (i % 3);
+    }
+
+    // grow the data set one point at a time, and move the prediction point in between
+    for (int m = 10; m <= N; ++m)
+    {
+        for (int step = 0; step < 3; ++step)
+        {
+            double prediction_point = locations(m - 1) + 1.5 * step;
+
+            full_gp.inferSD(locations.head(m), outputs.head(m), n, variances.head(m), prediction_point);
+            incremental_gp.inferSD(locations.head(m), outputs.head(m), n, variances.head(m), prediction_point);
+
+            Eigen::VectorXd prediction_locations(3);
+            prediction_locations << prediction_point, prediction_point + 5.0, prediction_point + 40.0;
+
+            Eigen::VectorXd full_variances, incremental_variances;
+            Eigen::VectorXd full_prediction = full_gp.predict(prediction_locations, &full_variances);
+            Eigen::VectorXd incremental_prediction = incremental_gp.predict(prediction_locations, &incremental_variances);
+
+            for (int i = 0; i < prediction_locations.size(); ++i)
+            {
+                EXPECT_NEAR(incremental_prediction(i), full_prediction(i), 1e-6);
+                EXPECT_NEAR(incremental_variances(i), full_variances(i), 1e-6);
+            }
+        }
+    }
+}
+
 TEST_F(GPTest, squareDistanceTest)
 {
     Eigen::MatrixXd a(4, 3);
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2026, openphdguiding.org.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Measures the per-step cost of GaussianProcessGuider::UpdateGP versus the
+ * length of the guiding history, once with the full refit on every step and
+ * once with incremental inference.
+ *
+ * Usage: GPInferenceBenchmark [steps]
+ */
+
+#include "gaussian_process_guider.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+static const double TimeStep = 2.0; // seconds between guide steps
+static const double PeriodLength = 480.0; // worm period of the simulated mount
+
+static GaussianProcessGuider::guide_parameters benchmark_parameters(bool incremental)
+{
+    GaussianProcessGuider::guide_parameters parameters;
+    parameters.control_gain_ = 0.6;
+    parameters.min_periods_for_inference_ = 2.0;
+    parameters.min_move_ = 0.2;
+    parameters.SE0KLengthScale_ = 700.0;
+    parameters.SE0KSignalVariance_ = 20.0;
+    parameters.PKLengthScale_ = 10.0;
+    parameters.PKPeriodLength_ = 200.0;
+    parameters.PKSignalVariance_ = 20.0;
+    parameters.SE1KLengthScale_ = 25.0;
+    parameters.SE1KSignalVariance_ = 10.0;
+    parameters.min_periods_for_period_estimation_ = 2.0;
+    parameters.points_for_approximation_ = 100;
+    parameters.prediction_gain_ = 0.5;
+    parameters.compute_period_ = true;
+    parameters.incremental_inference_ = incremental;
+    return parameters;
+}
+
+// Runs history_length guide steps on a simulated periodic error and returns
+// the mean time of UpdateGP over the last timed_steps of them, in milliseconds
+static double time_update(int history_length, int timed_steps, bool incremental)
+{
+    GaussianProcessGuider guider(benchmark_parameters(incremental));
+
+    std::mt19937 generator(42);
+    std::normal_distribution<double> noise(0.0, 0.3);
+
+    double elapsed = 0.0;
+    for (int i = 0; i < history_length; ++i)
+    {
+        double t = i * TimeStep;
+        double measurement = 2.0 * std::sin(2 * M_PI * t / PeriodLength) + 0.5 * std::sin(6 * M_PI * t / PeriodLength) +
+            noise(generator);
+
+        guider.inject_data_point(t, measurement, 20.0, 0.0);
+
+        // the GP is only updated once the history is long enough, and also
+        // during a warm-up before the timed steps, so that incremental
+        // inference starts from a steady state
+        if (i >= history_length - timed_steps - 20)
+        {
+            auto start = std::chrono::steady_clock::now();
+            guider.UpdateGP(t + 0.5 * TimeStep);
+            auto end = std::chrono::steady_clock::now();
+            if (i >= history_length - timed_steps)
+            {
+                elapsed += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+        }
+    }
+
+    return elapsed / timed_steps;
+}
+
+int main(int argc, char **argv)
+{
+    int timed_steps = argc > 1 ? std::atoi(argv[1]) : 100;
+    if (timed_steps <= 0)
+    {
+        return -1;
+    }
+
+    static const int history_lengths[] = { 250, 500, 1000, 2000, 4000, 8000 };
+
+    std::printf("%10s %12s %12s %12s %8s\n", "steps", "history [s]", "full [ms]", "incr. [ms]", "speedup");
+    for (int history_length : history_lengths)
+    {
+        double full = time_update(history_length, timed_steps, false);
+        double incremental = time_update(history_length, timed_steps, true);
+        std::printf("%10d %12.0f %12.3f %12.3f %8.2f\n", history_length, history_length * TimeStep, full, incremental,
+                    full / incremental);
+    }
+
+    return 0;
+}
@@ -41,6 +41,8 @@
 # include "cam_indi.h"
 # include "camera.h"
 # include "config_indi.h"
+# include "fits_blob.h"
+# include "image_kernels.h"
 # include "image_math.h"
 # include "indi_gui.h"
 # include <libindi/baseclient.h>
@@ -48,6 +50,8 @@
 # include <libindi/basedevice.h>
 # include <libindi/indiproperty.h>
 
+# include <chrono>
+
 class CapturedFrame
 {
 public:
@@ -83,6 +87,36 @@ public:
     }
 };
 
+// Time spent turning BLOBs into images, logged every LOG_INTERVAL frames
+struct BlobTiming
+{
+    const char *what;
+    unsigned int frames;
+    unsigned int fallbacks; // frames that needed CFITSIO
+    double sumMs;
+    double maxMs;
+
+    BlobTiming(const char *what_) : what(what_), frames(0), fallbacks(0), sumMs(0.0), maxMs(0.0) { }
+    void Add(double ms, bool fallback = false);
+};
+
+void BlobTiming::Add(double ms, bool fallback)
+{
+    enum
+    {
+        LOG_INTERVAL = 100, // frames
+    };
+
+    sumMs += ms;
+    maxMs = wxMax(maxMs, ms);
+    if (fallback)
+        ++fallbacks;
+
+    if (++frames % LOG_INTERVAL == 0)
+        Debug.Write(wxString::Format("INDI Camera %s timing: frames=%u cfitsio=%u avg=%.2f ms max=%.2f ms\n", what, frames,
+                                     fallbacks, sumMs / frames, maxMs));
+}
+
 class CameraINDI : public GuideCamera, public INDI::BaseClient
 {
 private:
@@ -119,6 +153,9 @@ private:
     wxCondition m_lastFrame_cond;
     CapturedFrame *m_lastFrame;
 
+    BlobTiming m_decodeTiming; // worker thread
+    BlobTiming m_stackTiming; // INDI client thread
+
     usImage *StackImg;
     int StackFrames;
     volatile bool stacking; // TODO: use a wxCondition to signal completion
@@ -151,6 +188,8 @@ private:
     void CameraDialog();
     void CameraSetup();
     bool ReadFITS(CapturedFrame *cf, usImage& img, bool takeSubframe, const wxRect& subframe);
+    bool DecodeFITS(const FitsBlobImage& fits, usImage& img, bool takeSubframe, const wxRect& subframe);
+    bool ReadFITSCfitsio(CapturedFrame *cf, usImage& img, bool takeSubframe, const wxRect& subframe);
     bool StackStream(CapturedFrame *cf);
     void SendBinning();
 
@@ -187,7 +226,9 @@ public:
     bool ST4HasNonGuiMove() override;
 };
 
-CameraINDI::CameraINDI() : sync_cond(sync_lock), m_lastFrame_cond(m_lastFrame_lock), m_gui(nullptr)
+CameraINDI::CameraINDI()
+    : sync_cond(sync_lock), m_lastFrame_cond(m_lastFrame_lock), m_gui(nullptr), m_decodeTiming("decode"),
+      m_stackTiming("stack")
 {
     m_lastFrame = nullptr;
     ClearStatus();
@@ -836,6 +877,60 @@ void CameraINDI::SetCCDdevice()
 }
 
 bool CameraINDI::ReadFITS(CapturedFrame *frame, usImage& img, bool takeSubframe, const wxRect& subframe)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // plain 8 and 16-bit images, the usual case, are decoded straight into the
+    // image rows; anything else goes through CFITSIO
+    FitsBlobImage fits;
+    bool direct = ParseFitsBlob(&fits, frame->m_data, frame->m_size);
+    if (direct && takeSubframe)
+    {
+        direct = FullSize != UNDEFINED_FRAME_SIZE && wxRect(FullSize).Contains(subframe) && fits.width == subframe.width &&
+            fits.height == subframe.height;
+    }
+
+    bool err = direct ? DecodeFITS(fits, img, takeSubframe, subframe) : ReadFITSCfitsio(frame, img, takeSubframe, subframe);
+
+    if (!err)
+    {
+        m_decodeTiming.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                           !direct);
+    }
+
+    return err;
+}
+
+bool CameraINDI::DecodeFITS(const FitsBlobImage& fits, usImage& img, bool takeSubframe, const wxRect& subframe)
+{
+    if (takeSubframe)
+    {
+        // only the subframe is allocated
+        if (img.InitCompact(FullSize, subframe))
+        {
+            pFrame->Alert(_("Memory allocation error"));
+            return true;
+        }
+
+        DecodeFitsBlob(img.ImageData, img.RowStride(), fits, subframe.width, subframe.height, CpuSimdLevel());
+    }
+    else
+    {
+        FullSize.Set(fits.width, fits.height);
+
+        if (img.Init(FullSize))
+        {
+            pFrame->Alert(_("Memory allocation error"));
+            return true;
+        }
+
+        DecodeFitsBlob(img.ImageData, fits.width, fits, fits.width, fits.height, CpuSimdLevel());
+    }
+
+    return false;
+}
+
+bool CameraINDI::ReadFITSCfitsio(CapturedFrame *frame, usImage& img, bool takeSubframe, const wxRect& subframe)
 {
     fitsfile *fptr; // FITS file pointer
     int status = 0; // CFITSIO status value MUST be initialized to zero!
@@ -892,35 +987,44 @@ bool CameraINDI::ReadFITS(CapturedFrame *frame, usImage& img, bool takeSubframe,
             PHD_fits_close_file(fptr);
             return true;
         }
-        if (img.Init(FullSize))
+        if (img.InitCompact(FullSize, subframe))
         {
             pFrame->Alert(_("Memory allocation error"));
             PHD_fits_close_file(fptr);
             return true;
         }
 
-        img.Clear();
-        img.Subframe = subframe;
-
-        unsigned short *rawdata = new unsigned short[xsize * ysize];
-
-        if (fits_read_pix(fptr, TUSHORT, fpixel, xsize * ysize, nullptr, rawdata, nullptr, &status))
+        if (xsize == subframe.width && ysize == subframe.height)
         {
-            pFrame->Alert(_("Error reading data"));
-            PHD_fits_close_file(fptr);
-            delete[] rawdata;
-            return true;
+            // the usual case: the file holds just the subframe
+            if (fits_read_pix(fptr, TUSHORT, fpixel, xsize * ysize, nullptr, img.ImageData, nullptr, &status))
+            {
+                pFrame->Alert(_("Error reading data"));
+                PHD_fits_close_file(fptr);
+                return true;
+            }
         }
-
-        int i = 0;
-        for (int y = 0; y < subframe.height; y++)
+        else
         {
-            unsigned short *dataptr = img.ImageData + (y + subframe.y) * img.Size.GetWidth() + subframe.x;
-            memcpy(dataptr, &rawdata[i], subframe.width * sizeof(unsigned short));
-            i += subframe.width;
-        }
+            unsigned short *rawdata = new unsigned short[xsize * ysize];
 
-        delete[] rawdata;
+            if (fits_read_pix(fptr, TUSHORT, fpixel, xsize * ysize, nullptr, rawdata, nullptr, &status))
+            {
+                pFrame->Alert(_("Error reading data"));
+                PHD_fits_close_file(fptr);
+                delete[] rawdata;
+                return true;
+            }
+
+            int i = 0;
+            for (int y = 0; y < subframe.height; y++)
+            {
+                memcpy(&img.Pixel(subframe.x, subframe.y + y), &rawdata[i], subframe.width * sizeof(unsigned short));
+                i += subframe.width;
+            }
+
+            delete[] rawdata;
+        }
     }
     else
     {
@@ -961,14 +1065,14 @@ bool CameraINDI::StackStream(CapturedFrame *cf)
     // Add new blob to stacked image
     stacking = true;
 
-    unsigned short *outptr = StackImg->ImageData;
-    const unsigned char *inptr = (unsigned char *) cf->m_data;
+    auto start = std::chrono::steady_clock::now();
 
-    for (int i = 0; i < StackImg->NPixels; i++)
-        *outptr++ += (unsigned short) *inptr++;
+    AccumulateBytes(StackImg->ImageData, static_cast<const unsigned char *>(cf->m_data), StackImg->NPixels, CpuSimdLevel());
 
     ++StackFrames;
 
+    m_stackTiming.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
     stacking = false;
 
     return false;
@@ -39,6 +39,7 @@
 
 # include "cam_sxv.h"
 # include "image_math.h"
+# include "frame_pool.h"
 
 # include <wx/choicdlg.h>
 
@@ -58,7 +59,7 @@ class CameraSXV : public GuideCamera
 {
     sxccd_handle_t hCam;
     sxccd_params_t CCDParams;
-    unsigned short *RawData;
+    unsigned short *RawData; // from FramePoolAlloc, so it can be swapped with tmpImg.ImageData
     unsigned int RawDataSize;
     usImage tmpImg;
     unsigned short CameraModel;
@@ -272,7 +273,7 @@ CameraSXV::CameraSXV()
 
 CameraSXV::~CameraSXV()
 {
-    delete[] RawData;
+    FramePoolFree(RawData);
 }
 
 wxByte CameraSXV::BitsPerPixel()
@@ -502,7 +503,7 @@ bool CameraSXV::Connect(const wxString& camId)
 
 bool CameraSXV::Disconnect()
 {
-    delete[] RawData;
+    FramePoolFree(RawData);
     RawData = nullptr;
     RawDataSize = 0;
     Connected = false;
@@ -877,8 +878,8 @@ bool CameraSXV::Capture(int duration, usImage& img, int options, const wxRect& s
 
     if (nPixelsToRead > RawDataSize)
     {
-        delete[] RawData;
-        RawData = new unsigned short[nPixelsToRead];
+        FramePoolFree(RawData);
+        RawData = FramePoolAlloc<unsigned short>(nPixelsToRead);
         if (!RawData)
         {
             RawDataSize = 0;
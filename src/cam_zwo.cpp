@@ -718,12 +718,6 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
         binning_change = true;
     }
 
-    if (img.Init(FullSize))
-    {
-        DisconnectWithAlert(CAPT_FAIL_MEMORY);
-        return true;
-    }
-
     wxRect frame;
     wxPoint subframePos; // position of subframe within frame
 
@@ -732,6 +726,13 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
     if (useSubframe && (subframe.width <= 0 || subframe.height <= 0 || binning_change))
         useSubframe = false;
 
+    // with a subframe only the subframe is allocated
+    if (useSubframe ? img.InitCompact(FullSize, subframe) : img.Init(FullSize))
+    {
+        DisconnectWithAlert(CAPT_FAIL_MEMORY);
+        return true;
+    }
+
     if (useSubframe)
     {
         // ensure transfer size is a multiple of 1024
@@ -915,17 +916,12 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
 
     if (useSubframe)
     {
-        img.Subframe = subframe;
-
-        // Clear out the image
-        img.Clear();
-
         if (m_bpp == 8)
         {
             for (int y = 0; y < subframe.height; y++)
             {
                 const unsigned char *src = buffer + (y + subframePos.y) * frame.width + subframePos.x;
-                unsigned short *dst = img.ImageData + (y + subframe.y) * FullSize.GetWidth() + subframe.x;
+                unsigned short *dst = &img.Pixel(subframe.x, subframe.y + y);
                 for (int x = 0; x < subframe.width; x++)
                     *dst++ = *src++;
             }
@@ -935,9 +931,7 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
             for (int y = 0; y < subframe.height; y++)
             {
                 const unsigned short *src = (unsigned short *) buffer + (y + subframePos.y) * frame.width + subframePos.x;
-                unsigned short *dst = img.ImageData + (y + subframe.y) * FullSize.GetWidth() + subframe.x;
-                for (int x = 0; x < subframe.width; x++)
-                    *dst++ = *src++;
+                memcpy(&img.Pixel(subframe.x, subframe.y + y), src, subframe.width * sizeof(unsigned short));
             }
         }
     }
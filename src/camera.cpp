@@ -228,6 +228,7 @@ GuideCamera::GuideCamera()
     MaxBinning = 1;
     Binning = pConfig->Profile.GetInt("/camera/binning", 1);
     CurrentDarkFrame = nullptr;
+    m_currentDarkExp = 0;
     CurrentDefectMap = nullptr;
 }
 
@@ -834,6 +835,8 @@ void CameraConfigDialogPane::LayoutControls(GuideCamera *pCamera, BrainCtrlIdMap
     wxSizerFlags def_flags = wxSizerFlags(0).Border(wxALL, 10).Expand();
     pTopline->Add(GetSizerCtrl(CtrlMap, AD_szNoiseReduction));
     pTopline->Add(GetSizerCtrl(CtrlMap, AD_szTimeLapse), wxSizerFlags(0).Border(wxLEFT, 110).Expand());
+    pTopline->Add(GetSingleCtrl(CtrlMap, AD_cbPipelinedCapture),
+                  wxSizerFlags(0).Border(wxLEFT, 40).Align(wxALIGN_CENTER_VERTICAL));
     pGenGroup->Add(pTopline, def_flags);
     pGenGroup->Add(GetSizerCtrl(CtrlMap, AD_szVariableExposureDelay), def_flags);
     pGenGroup->Add(GetSizerCtrl(CtrlMap, AD_szAutoExposure), def_flags);
@@ -1348,42 +1351,215 @@ wxString GuideCamera::GetSettingsSummary()
                             CurrentDefectMap ? "defect map in use" : "no defect map", pixelSizeStr);
 }
 
+// Read rows [rowsBegin, rowsEnd) of the dark in the given HDU of the dark library
+// file into img. The library is written with one tile per row, so only the tiles
+// covering the requested rows are decompressed. Returns true on error.
+static bool read_dark_rows(const wxString& fileName, int hdu, usImage *img, int rowsBegin, int rowsEnd)
+{
+    fitsfile *fptr;
+    int status = 0; // CFITSIO status value MUST be initialized to zero!
+
+    if (PHD_fits_open_diskfile(&fptr, fileName, READONLY, &status))
+    {
+        Debug.Write(wxString::Format("dark library: error opening %s, status = %d\n", fileName, status));
+        return true;
+    }
+
+    fits_movabs_hdu(fptr, hdu, nullptr, &status);
+
+    long fpixel[] = { 1, rowsBegin + 1 };
+    long lpixel[] = { img->Size.GetWidth(), rowsEnd };
+    long inc[] = { 1, 1 };
+    if (!status)
+        fits_read_subset(fptr, TUSHORT, fpixel, lpixel, inc, nullptr, &img->Pixel(0, rowsBegin), nullptr, &status);
+
+    PHD_fits_close_file(fptr);
+
+    if (status)
+        Debug.Write(wxString::Format("dark library: error reading hdu %d rows %d-%d, status = %d\n", hdu, rowsBegin,
+                                     rowsEnd - 1, status));
+
+    return status != 0;
+}
+
 void GuideCamera::AddDark(usImage *dark)
 {
     int const expdur = dark->ImgExpDur;
 
-    { // lock scope
-        wxCriticalSectionLocker lck(DarkFrameLock);
+    wxCriticalSectionLocker lck(DarkFrameLock);
+
+    // free the prior dark with this exposure duration
+    DarkFrame& entry = Darks[expdur];
+    if (entry.img && entry.img == CurrentDarkFrame)
+        CurrentDarkFrame = dark;
+    delete entry.img;
 
-        // free the prior dark with this exposure duration
-        ExposureImgMap::iterator pos = Darks.find(expdur);
-        if (pos != Darks.end())
+    entry.img = dark;
+    entry.hdu = 0;
+    entry.rowsBegin = 0;
+    entry.rowsEnd = dark->Size.GetHeight();
+}
+
+// Replace the darks with the given exposures (map exposure => HDU) by the darks
+// in the dark library file. The darks are not read until they are selected.
+void GuideCamera::SetDarkLibrary(const wxString& fileName, const wxSize& size, const std::map<int, int>& hdus)
+{
+    bool reselect = false;
+
+    // reselect before releasing the lock so the camera worker thread never sees
+    // the current dark cleared
+    wxCriticalSectionLocker lck(DarkFrameLock);
+
+    DarkLibFile = fileName;
+    DarkLibSize = size;
+
+    for (auto it = hdus.begin(); it != hdus.end(); ++it)
+    {
+        DarkFrame& entry = Darks[it->first];
+        if (entry.img && entry.img == CurrentDarkFrame)
         {
-            usImage *prior = pos->second;
-            if (prior == CurrentDarkFrame)
-                CurrentDarkFrame = dark;
-            delete prior;
+            CurrentDarkFrame = nullptr;
+            reselect = true;
         }
+        delete entry.img;
 
-    } // lock scope
+        entry.img = nullptr;
+        entry.hdu = it->second;
+        entry.rowsBegin = entry.rowsEnd = 0;
+    }
 
-    Darks[expdur] = dark;
+    if (reselect)
+        SelectDarkLocked(m_currentDarkExp);
 }
 
 void GuideCamera::SelectDark(int exposureDuration)
+{
+    wxCriticalSectionLocker lck(DarkFrameLock);
+    SelectDarkLocked(exposureDuration);
+}
+
+// The caller must hold DarkFrameLock
+void GuideCamera::SelectDarkLocked(int exposureDuration)
 {
     // select the dark frame with the smallest exposure >= the requested exposure.
     // if there are no darks with exposures > the select exposure, select the dark with the greatest exposure
 
-    wxCriticalSectionLocker lck(DarkFrameLock);
-
-    CurrentDarkFrame = 0;
-    for (ExposureImgMap::const_iterator it = Darks.begin(); it != Darks.end(); ++it)
+    ExposureDarkMap::iterator sel = Darks.end();
+    for (ExposureDarkMap::iterator it = Darks.begin(); it != Darks.end(); ++it)
     {
-        CurrentDarkFrame = it->second;
+        sel = it;
         if (it->first >= exposureDuration)
             break;
     }
+
+    // page out the previous dark if it can be read back from the library file
+    if (CurrentDarkFrame && (sel == Darks.end() || sel->first != m_currentDarkExp))
+    {
+        ExposureDarkMap::iterator prev = Darks.find(m_currentDarkExp);
+        if (prev != Darks.end() && prev->second.hdu)
+        {
+            delete prev->second.img;
+            prev->second.img = nullptr;
+        }
+    }
+
+    CurrentDarkFrame = nullptr;
+
+    if (sel == Darks.end())
+        return;
+
+    DarkFrame& dark = sel->second;
+    if (!dark.img)
+    {
+        // no pixels are allocated until rows are paged in
+        std::unique_ptr<usImage> img(new usImage());
+        img->InitCompact(DarkLibSize, wxRect());
+        img->ImgExpDur = sel->first;
+        dark.img = img.release();
+        dark.rowsBegin = dark.rowsEnd = 0;
+    }
+
+    CurrentDarkFrame = dark.img;
+    m_currentDarkExp = sel->first;
+}
+
+// Extend the rows of a paged dark that have been read from the library file to
+// cover [rowsBegin, rowsEnd). Only the rows read so far are held in memory, as a
+// compact image which is reallocated when the range grows. The caller must hold
+// DarkFrameLock. Returns true on error.
+bool GuideCamera::PageInDark(DarkFrame& dark, int rowsBegin, int rowsEnd)
+{
+    // keep the rows read so far contiguous so they can be tracked as a single range
+    bool const empty = dark.rowsBegin == dark.rowsEnd;
+    int const newBegin = empty ? rowsBegin : std::min(rowsBegin, dark.rowsBegin);
+    int const newEnd = empty ? rowsEnd : std::max(rowsEnd, dark.rowsEnd);
+    int const width = dark.img->Size.GetWidth();
+
+    usImage rows;
+    if (rows.InitCompact(dark.img->Size, wxRect(0, newBegin, width, newEnd - newBegin)))
+    {
+        Debug.Write(wxString::Format("dark library: cannot allocate dark frame exposure = %d rows %d-%d\n",
+                                     dark.img->ImgExpDur, newBegin, newEnd - 1));
+        return true;
+    }
+
+    if (empty)
+    {
+        if (read_dark_rows(DarkLibFile, dark.hdu, &rows, newBegin, newEnd))
+            return true;
+    }
+    else
+    {
+        memcpy(&rows.Pixel(0, dark.rowsBegin), &dark.img->Pixel(0, dark.rowsBegin),
+               (size_t) (dark.rowsEnd - dark.rowsBegin) * width * sizeof(unsigned short));
+
+        if (newBegin < dark.rowsBegin && read_dark_rows(DarkLibFile, dark.hdu, &rows, newBegin, dark.rowsBegin))
+            return true;
+        if (newEnd > dark.rowsEnd && read_dark_rows(DarkLibFile, dark.hdu, &rows, dark.rowsEnd, newEnd))
+            return true;
+    }
+
+    dark.img->SwapImageData(rows);
+    dark.img->Subframe = dark.img->IsCompact() ? dark.img->DataRect : wxRect();
+    dark.rowsBegin = newBegin;
+    dark.rowsEnd = newEnd;
+
+    Debug.Write(wxString::Format("dark library: paged in dark frame exposure = %d, rows %d-%d\n", dark.img->ImgExpDur,
+                                 dark.rowsBegin, dark.rowsEnd - 1));
+
+    // full frame dark subtraction uses the dark's median
+    if (dark.rowsBegin == 0 && dark.rowsEnd == dark.img->Size.GetHeight())
+        dark.img->CalcStats();
+
+    return false;
+}
+
+// Copy the complete dark frame for an exposure, reading it from the dark library
+// file if it has not been fully paged in. Returns true on error.
+bool GuideCamera::CopyDark(int exposureDuration, usImage *dark)
+{
+    wxCriticalSectionLocker lck(DarkFrameLock);
+
+    ExposureDarkMap::const_iterator it = Darks.find(exposureDuration);
+    if (it == Darks.end())
+        return true;
+
+    const DarkFrame& src = it->second;
+    if (src.img && src.rowsBegin == 0 && src.rowsEnd == src.img->Size.GetHeight())
+    {
+        if (dark->CopyFrom(*src.img))
+            return true;
+    }
+    else
+    {
+        if (dark->Init(DarkLibSize))
+            return true;
+        if (read_dark_rows(DarkLibFile, src.hdu, dark, 0, DarkLibSize.GetHeight()))
+            return true;
+    }
+
+    dark->ImgExpDur = exposureDuration;
+    return false;
 }
 
 void GuideCamera::GetDarklibProperties(int *pNumDarks, double *pMinExp, double *pMaxExp)
@@ -1434,8 +1610,8 @@ void GuideCamera::ClearDarks()
     wxCriticalSectionLocker lck(DarkFrameLock);
     while (!Darks.empty())
     {
-        ExposureImgMap::iterator it = Darks.begin();
-        delete it->second;
+        ExposureDarkMap::iterator it = Darks.begin();
+        delete it->second.img;
         Darks.erase(it);
     }
     CurrentDarkFrame = nullptr;
@@ -1455,6 +1631,21 @@ void GuideCamera::SubtractDark(usImage& img)
     }
     else if (CurrentDarkFrame)
     {
+        // page in the rows of the dark covering the frame or subframe
+        ExposureDarkMap::iterator it = Darks.find(m_currentDarkExp);
+        if (it != Darks.end() && img.Size == CurrentDarkFrame->Size)
+        {
+            DarkFrame& dark = it->second;
+            int rowsBegin = img.Subframe.IsEmpty() ? 0 : img.Subframe.GetTop();
+            int rowsEnd = img.Subframe.IsEmpty() ? img.Size.GetHeight() : img.Subframe.GetBottom() + 1;
+            if ((rowsBegin < dark.rowsBegin || rowsEnd > dark.rowsEnd) && PageInDark(dark, rowsBegin, rowsEnd))
+            {
+                Debug.Write("dark library: cannot read dark frame, dark subtraction disabled\n");
+                CurrentDarkFrame = nullptr;
+                return;
+            }
+        }
+
         Subtract(img, *CurrentDarkFrame);
     }
 }
@@ -35,7 +35,17 @@
 #ifndef CAMERA_H_INCLUDED
 #define CAMERA_H_INCLUDED
 
-typedef std::map<int, usImage *> ExposureImgMap; // map exposure to image
+// A dark frame of the dark library. Darks read from the dark library file are
+// paged in on demand: the image is only allocated while the dark is selected,
+// and only the rows covering the frames being calibrated are read from the file.
+struct DarkFrame
+{
+    usImage *img; // nullptr until the dark is paged in
+    int hdu; // dark library file HDU holding this dark, or 0 if the dark is only in memory
+    int rowsBegin; // rows [rowsBegin, rowsEnd) of img have been read from the file
+    int rowsEnd;
+};
+typedef std::map<int, DarkFrame> ExposureDarkMap; // map exposure to dark
 class DefectMap;
 
 enum PropDlgType
@@ -110,6 +120,10 @@ class GuideCamera : public wxMessageBoxProxy, public OnboardST4
     friend class CameraConfigDialogCtrlSet;
 
     double m_pixelSize;
+    int m_currentDarkExp; // Darks key of CurrentDarkFrame
+
+    void SelectDarkLocked(int exposureDuration);
+    bool PageInDark(DarkFrame& dark, int rowsBegin, int rowsEnd);
 
 protected:
     bool m_hasGuideOutput;
@@ -140,7 +154,9 @@ public:
 
     wxCriticalSection DarkFrameLock; // dark frames can be accessed in the main thread or the camera worker thread
     usImage *CurrentDarkFrame;
-    ExposureImgMap Darks; // map exposure => dark frame
+    ExposureDarkMap Darks; // map exposure => dark frame
+    wxString DarkLibFile; // file the darks with hdu != 0 are paged in from
+    wxSize DarkLibSize; // frame size of the darks in DarkLibFile
     DefectMap *CurrentDefectMap;
 
     static wxArrayString GuideCameraList();
@@ -194,7 +210,9 @@ public:
 
     virtual wxString GetSettingsSummary();
     void AddDark(usImage *dark);
+    void SetDarkLibrary(const wxString& fileName, const wxSize& size, const std::map<int, int>& hdus);
     void SelectDark(int exposureDuration);
+    bool CopyDark(int exposureDuration, usImage *dark);
     void SetDefectMap(DefectMap *newMap);
     void ClearDefectMap();
     void ClearDarks();
@@ -47,6 +47,10 @@ class circular_buffer
     unsigned int m_size;
     unsigned int m_capacity;
 
+    // positions are always less than twice the capacity, so a compare and
+    // subtract replaces the (much slower) modulo on each element access
+    unsigned int wrap(unsigned int pos) const { return pos < m_capacity ? pos : pos - m_capacity; }
+
 public:
     class iterator
     {
@@ -77,8 +81,8 @@ public:
             assert(&m_cb == &rhs.m_cb);
             return m_pos != rhs.m_pos;
         }
-        T& operator*() const { return m_cb.m_ary[m_pos % m_cb.m_capacity]; }
-        T *operator->() const { return &m_cb.m_ary[m_pos % m_cb.m_capacity]; }
+        T& operator*() const { return m_cb.m_ary[m_cb.wrap(m_pos)]; }
+        T *operator->() const { return &m_cb.m_ary[m_cb.wrap(m_pos)]; }
     };
     friend class circular_buffer<T>::iterator;
     circular_buffer();
@@ -155,7 +159,7 @@ template<typename T>
 T& circular_buffer<T>::operator[](unsigned int n) const
 {
     assert(n < m_size);
-    return m_ary[(m_tail + n) % m_capacity];
+    return m_ary[wrap(m_tail + n)];
 }
 
 #endif
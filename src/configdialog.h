@@ -55,6 +55,7 @@ enum BRAIN_CTRL_IDS
     AD_szLanguage,
     AD_szSoftwareUpdate,
     AD_szLogFileInfo,
+    AD_szGuideLogOptions,
     AD_cbEnableImageLogging,
     AD_szImageLoggingOptions,
     AD_szDither,
@@ -67,6 +68,7 @@ enum BRAIN_CTRL_IDS
     AD_szSaturationOptions,
     AD_szCameraTimeout,
     AD_szTimeLapse,
+    AD_cbPipelinedCapture,
     AD_szPixelSize,
     AD_szGain,
     AD_szDelay,
@@ -0,0 +1,101 @@
+/*
+ *  cpu_features.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "cpu_features.h"
+
+#if defined(PHD_HAVE_SSE2) && defined(_MSC_VER) && !defined(__clang__)
+# include <intrin.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+static SimdLevel DetectSimdLevel()
+{
+    // PHD_SIMD=none or PHD_SIMD=sse2 caps the level, useful for comparing the code paths
+    const char *env = getenv("PHD_SIMD");
+    if (env && strcmp(env, "none") == 0)
+        return SIMD_NONE;
+    bool allowAvx2 = !env || strcmp(env, "sse2") != 0;
+
+#if defined(PHD_HAVE_NEON)
+    (void) allowAvx2;
+    return SIMD_NEON;
+#elif defined(PHD_HAVE_SSE2)
+    bool avx2 = false;
+# if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        // make sure the OS saves the YMM registers on context switch
+        if (osxsave && avx && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+    }
+# else
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2") != 0;
+# endif
+    return avx2 && allowAvx2 ? SIMD_AVX2 : SIMD_SSE2;
+#else
+    (void) allowAvx2;
+    return SIMD_NONE;
+#endif
+}
+
+SimdLevel CpuSimdLevel()
+{
+    static SimdLevel s_level = DetectSimdLevel();
+    return s_level;
+}
+
+const char *SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SIMD_SSE2:
+        return "SSE2";
+    case SIMD_AVX2:
+        return "AVX2";
+    case SIMD_NEON:
+        return "NEON";
+    default:
+        return "none";
+    }
+}
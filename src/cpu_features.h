@@ -0,0 +1,72 @@
+/*
+ *  cpu_features.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CPU_FEATURES_INCLUDED
+#define CPU_FEATURES_INCLUDED
+
+// Compile-time availability of the SIMD instruction sets used by the image
+// processing kernels. SSE2 and NEON are part of the x86-64 and AArch64 base
+// ISAs (32-bit ARM stays on the scalar path); AVX2 code is compiled with a
+// per-function target attribute and only called when the CPU reports support
+// at runtime.
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+# define PHD_HAVE_SSE2 1
+#endif
+
+#if defined(PHD_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+# define PHD_HAVE_AVX2 1
+# if defined(_MSC_VER) && !defined(__clang__)
+#  define PHD_TARGET_AVX2
+# else
+#  define PHD_TARGET_AVX2 __attribute__((target("avx2")))
+# endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+# define PHD_HAVE_NEON 1
+#endif
+
+enum SimdLevel
+{
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_NEON,
+};
+
+// best instruction set supported by both the build and the running CPU
+extern SimdLevel CpuSimdLevel();
+extern const char *SimdLevelName(SimdLevel level);
+
+#endif
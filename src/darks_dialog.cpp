@@ -35,10 +35,13 @@
 
 #include "phd.h"
 #include "darks_dialog.h"
+#include "parallel.h"
 #include <wx/valnum.h>
 
 #include <algorithm>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 static const int DefDarkCount = 5;
 static const int DefDMExpTime = 15;
@@ -495,6 +498,106 @@ struct Histogram
     }
 };
 
+// Accumulates the dark frames for a master dark. Each frame is handed off
+// as soon as it has been downloaded, and is logged and added to the running
+// sum on a background thread while the camera takes the next exposure, so
+// the master dark is ready as soon as the last frame arrives.
+class DarkStacker
+{
+    usImage m_frame; // frame being accumulated
+    std::vector<unsigned int> m_sum;
+    unsigned int m_count;
+    std::thread m_thread;
+
+    void Accumulate();
+
+public:
+    DarkStacker() : m_count(0) { }
+    ~DarkStacker() { Wait(); }
+
+    void Wait()
+    {
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Take the frame's pixel data for accumulation and give frame an
+    // identically-sized buffer to capture the next exposure into
+    void Add(usImage& frame);
+
+    // Replace the pixels of dark with the mean of the accumulated frames
+    void GetMean(usImage& dark);
+};
+
+void DarkStacker::Add(usImage& frame)
+{
+    Wait();
+
+    if (m_frame.Init(frame.Size))
+        throw ERROR_INFO("DarkStacker: memory allocation failure");
+    m_frame.SwapImageData(frame);
+    m_frame.Subframe = frame.Subframe;
+    m_frame.BitsPerPixel = frame.BitsPerPixel;
+
+    if (m_sum.size() != m_frame.NPixels)
+    {
+        m_sum.assign(m_frame.NPixels, 0);
+        m_count = 0;
+    }
+
+    m_thread = std::thread(&DarkStacker::Accumulate, this);
+}
+
+void DarkStacker::Accumulate()
+{
+    m_frame.CalcStats();
+
+    Debug.Write(wxString::Format("dark frame stats: bpp %u min %u max %u med %u filtmin %u filtmax %u\n",
+                                 m_frame.BitsPerPixel, m_frame.MinADU, m_frame.MaxADU, m_frame.MedianADU, m_frame.FiltMin,
+                                 m_frame.FiltMax));
+
+    Histogram h(m_frame);
+    h.Dump();
+
+    int const W = m_frame.Size.GetWidth();
+    int const H = m_frame.Size.GetHeight();
+    int const BAND_ROWS = 64;
+    const unsigned short *const src = m_frame.ImageData;
+    unsigned int *const sum = &m_sum[0];
+
+    ParallelFor((H + BAND_ROWS - 1) / BAND_ROWS, [=](int band) {
+        size_t const start = (size_t) band * BAND_ROWS * W;
+        size_t const end = std::min((size_t) (band + 1) * BAND_ROWS, (size_t) H) * W;
+        for (size_t i = start; i < end; i++)
+            sum[i] += src[i];
+    });
+
+    ++m_count;
+}
+
+void DarkStacker::GetMean(usImage& dark)
+{
+    Wait();
+
+    if (!m_count || dark.NPixels != m_sum.size())
+        return;
+
+    unsigned int const count = m_count;
+    const unsigned int *const sum = &m_sum[0];
+    unsigned short *const dst = dark.ImageData;
+    unsigned int const npix = dark.NPixels;
+    unsigned int const BAND = 1 << 16;
+
+    ParallelFor((npix + BAND - 1) / BAND, [=](int band) {
+        unsigned int const start = band * BAND;
+        unsigned int const end = std::min(start + BAND, npix);
+        for (unsigned int i = start; i < end; i++)
+            dst[i] = (unsigned short) (sum[i] / count);
+    });
+
+    dark.StatsValid = false;
+}
+
 bool DarksDialog::CreateMasterDarkFrame(usImage& darkFrame, int expTime, int frameCount)
 {
     bool err = false;
@@ -503,63 +606,48 @@ bool DarksDialog::CreateMasterDarkFrame(usImage& darkFrame, int expTime, int fra
     darkFrame.ImgExpDur = expTime;
     darkFrame.ImgStackCnt = frameCount;
 
-    unsigned int *avgimg = 0;
+    DarkStacker stacker;
 
-    for (int j = 1; j <= frameCount; j++)
+    try
     {
-        wxYield();
-        if (m_cancelling)
-            break;
-        ShowStatus(wxString::Format(_("Taking dark frame %d/%d"), j, frameCount), true);
-
-        Debug.Write(wxString::Format("Capture dark frame %d/%d exp=%d\n", j, frameCount, expTime));
-        err = GuideCamera::Capture(pCamera, expTime, darkFrame, CAPTURE_DARK);
-        if (err)
+        for (int j = 1; j <= frameCount; j++)
         {
-            ShowStatus(wxString::Format(_("%.1f s dark FAILED"), (double) expTime / 1000.0), true);
-            pCamera->ShutterClosed = false;
-            break;
-        }
-
-        m_pProgress->SetValue(m_pProgress->GetValue() + expTime);
-        wxYield();
-
-        darkFrame.CalcStats();
+            wxYield();
+            if (m_cancelling)
+                break;
+            ShowStatus(wxString::Format(_("Taking dark frame %d/%d"), j, frameCount), true);
 
-        Debug.Write(wxString::Format("dark frame stats: bpp %u min %u max %u med %u filtmin %u filtmax %u\n",
-                                     darkFrame.BitsPerPixel, darkFrame.MinADU, darkFrame.MaxADU, darkFrame.MedianADU,
-                                     darkFrame.FiltMin, darkFrame.FiltMax));
+            Debug.Write(wxString::Format("Capture dark frame %d/%d exp=%d\n", j, frameCount, expTime));
+            err = GuideCamera::Capture(pCamera, expTime, darkFrame, CAPTURE_DARK);
+            if (err)
+            {
+                ShowStatus(wxString::Format(_("%.1f s dark FAILED"), (double) expTime / 1000.0), true);
+                pCamera->ShutterClosed = false;
+                break;
+            }
 
-        Histogram h(darkFrame);
-        h.Dump();
-        wxYield();
+            m_pProgress->SetValue(m_pProgress->GetValue() + expTime);
+            wxYield();
 
-        if (!avgimg)
-        {
-            avgimg = new unsigned int[darkFrame.NPixels];
-            memset(avgimg, 0, darkFrame.NPixels * sizeof(*avgimg));
+            stacker.Add(darkFrame);
         }
-
-        unsigned int *iptr = avgimg;
-        const unsigned short *usptr = darkFrame.ImageData;
-        for (unsigned int i = 0; i < darkFrame.NPixels; i++)
-            *iptr++ += *usptr++;
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        err = true;
     }
 
     if (!m_cancelling && !err)
     {
+        stacker.GetMean(darkFrame);
+        darkFrame.CalcStats();
         ShowStatus(_("Dark frames complete"), true);
-        const unsigned int *iptr = avgimg;
-        unsigned short *usptr = darkFrame.ImageData;
-        for (unsigned int i = 0; i < darkFrame.NPixels; i++)
-            *usptr++ = (unsigned short) (*iptr++ / frameCount);
     }
 
     m_pProgress->SetValue(m_pProgress->GetValue() + expTime);
     wxYield();
 
-    delete[] avgimg;
-
     return err;
 }
 
@@ -37,17 +37,335 @@
 
 #include <wx/dir.h>
 
-#define ALWAYS_FLUSH_DEBUGLOG
+#include <chrono>
+#include <ctime>
+
+#if defined(__WINDOWS__)
+# include <io.h>
+#else
+# include <signal.h>
+# include <unistd.h>
+#endif
+
 const int RetentionPeriod = 30;
 
-DebugLog::DebugLog() : m_enabled(false), m_lastWriteTime(wxDateTime::UNow()) { }
+enum
+{
+    RING_SLOTS = 16384, // 2 MB
+    WRITER_INTERVAL_MS = 100, // longest time a line waits before it is written
+};
+
+// Lines logged from a crashing thread, and lines still in the ring when the
+// process crashes, are written out by the crash handler before the process
+// terminates. The handlers that were installed before ours (a crash reporter,
+// a debugger hook) are run afterwards.
+#if defined(__WINDOWS__)
+
+static LPTOP_LEVEL_EXCEPTION_FILTER s_prevExceptionFilter;
+
+static LONG WINAPI CrashExceptionFilter(EXCEPTION_POINTERS *info)
+{
+    Debug.CrashFlush();
+    return s_prevExceptionFilter ? s_prevExceptionFilter(info) : EXCEPTION_CONTINUE_SEARCH;
+}
+
+void DebugLog::InstallCrashHandler()
+{
+    static bool s_installed;
+    if (s_installed)
+        return;
+    s_installed = true;
+
+    s_prevExceptionFilter = SetUnhandledExceptionFilter(CrashExceptionFilter);
+}
+
+#else
+
+static const int s_crashSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+static struct sigaction s_prevActions[WXSIZEOF(s_crashSignals)];
+
+static void CrashSignalHandler(int sig, siginfo_t *info, void *uctx)
+{
+    Debug.CrashFlush();
+
+    // put back the previous handler and pass the signal on to it
+    struct sigaction prev;
+    memset(&prev, 0, sizeof(prev));
+    prev.sa_handler = SIG_DFL;
+    for (size_t i = 0; i < WXSIZEOF(s_crashSignals); i++)
+    {
+        if (s_crashSignals[i] == sig)
+            prev = s_prevActions[i];
+    }
+    sigaction(sig, &prev, nullptr);
+
+    if (prev.sa_flags & SA_SIGINFO)
+        prev.sa_sigaction(sig, info, uctx);
+    else if (prev.sa_handler == SIG_DFL)
+        raise(sig); // delivered with the default action when this handler returns
+    else if (prev.sa_handler != SIG_IGN)
+        prev.sa_handler(sig);
+}
+
+void DebugLog::InstallCrashHandler()
+{
+    static bool s_installed;
+    if (s_installed)
+        return;
+    s_installed = true;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = CrashSignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_SIGINFO;
+
+    for (size_t i = 0; i < WXSIZEOF(s_crashSignals); i++)
+        sigaction(s_crashSignals[i], &sa, &s_prevActions[i]);
+}
+
+#endif
+
+DebugLog::DebugLog()
+    : m_enabled(false), m_ring(RING_SLOTS), m_writerRunning(false), m_draining(false), m_stopWriter(false),
+      m_flushRequested(false), m_lastWriteTime(0), m_tmSecond(-1), m_reportedOverflows(0), m_crashFd(-1)
+{
+}
 
 DebugLog::~DebugLog()
 {
+    StopWriter();
+    WritePending();
     wxFFile::Flush();
     wxFFile::Close();
 }
 
+void DebugLog::StartWriter()
+{
+    std::lock_guard<std::mutex> lck(m_writerLock);
+    if (m_writer.joinable())
+        return;
+
+    m_stopWriter = false;
+    m_writer = std::thread(&DebugLog::WriterLoop, this);
+    m_writerRunning = true;
+}
+
+void DebugLog::StopWriter()
+{
+    {
+        std::lock_guard<std::mutex> lck(m_writerLock);
+        if (!m_writer.joinable())
+            return;
+        m_stopWriter = true;
+    }
+    m_wakeWriter.notify_one();
+    m_writer.join();
+    m_writerRunning = false;
+}
+
+void DebugLog::WriterLoop()
+{
+    std::unique_lock<std::mutex> lck(m_writerLock);
+
+    while (true)
+    {
+        m_wakeWriter.wait_for(lck, std::chrono::milliseconds(WRITER_INTERVAL_MS),
+                              [this] { return m_stopWriter || m_flushRequested; });
+        bool const stop = m_stopWriter;
+        m_flushRequested = false;
+
+        lck.unlock();
+        WritePending();
+        lck.lock();
+
+        m_written.notify_all();
+
+        if (stop)
+            break;
+    }
+}
+
+void DebugLog::WriteRecord(FILE *fp, const LogRing::Record& rec)
+{
+    // lines from different threads can be stamped slightly out of order
+    int64_t delta = m_lastWriteTime ? wxMax(rec.time - m_lastWriteTime, (int64_t) 0) : 0;
+    m_lastWriteTime = rec.time;
+
+    int64_t const second = rec.time / 1000000;
+    if (second != m_tmSecond)
+    {
+        time_t t = (time_t) second;
+#if defined(__WINDOWS__)
+        localtime_s(&m_tm, &t);
+#else
+        localtime_r(&t, &m_tm);
+#endif
+        m_tmSecond = second;
+    }
+
+    char prefix[96];
+    int n = snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d %02lld.%03lld %llu ", m_tm.tm_hour, m_tm.tm_min,
+                     m_tm.tm_sec, (int) (rec.time / 1000 % 1000), (long long) (delta / 1000000),
+                     (long long) (delta / 1000 % 1000), (unsigned long long) rec.thread);
+
+    if (fp)
+    {
+        fwrite(prefix, 1, n, fp);
+        fwrite(rec.text, 1, rec.len, fp);
+    }
+
+#if defined(__WINDOWS__) && defined(_DEBUG)
+    OutputDebugStringA((std::string(prefix, n) + std::string(rec.text, rec.len)).c_str());
+#endif
+}
+
+void DebugLog::WritePending()
+{
+    wxCriticalSectionLocker lock(m_criticalSection);
+
+    while (m_draining.exchange(true))
+        std::this_thread::yield(); // the crash handler is writing
+
+    FILE *fp = IsOpened() ? wxFFile::fp() : nullptr;
+
+    unsigned int count = m_ring.Drain([this, fp](const LogRing::Record& rec) { WriteRecord(fp, rec); });
+
+    uint64_t const overflows = m_ring.Overflows();
+    if (overflows != m_reportedOverflows)
+    {
+        char msg[96];
+        int n = snprintf(msg, sizeof(msg), "DebugLog: %llu lines dropped, log buffer full\n",
+                         (unsigned long long) (overflows - m_reportedOverflows));
+        m_reportedOverflows = overflows;
+
+        LogRing::Record rec;
+        rec.time = m_lastWriteTime;
+        rec.thread = 0;
+        rec.text = msg;
+        rec.len = n;
+        WriteRecord(fp, rec);
+        ++count;
+    }
+
+    if (fp && count)
+        fflush(fp);
+
+    m_draining = false;
+}
+
+// The crash handler may only call async-signal-safe functions: the heap,
+// stdio or the time zone data may be what is broken. These helpers format
+// with plain digit arithmetic and write with write(2).
+
+static char *put_digits(char *p, uint64_t val, int width)
+{
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char) ('0' + val % 10);
+        val /= 10;
+    } while (val && n < (int) sizeof(digits));
+    while (n < width--)
+        *p++ = '0';
+    while (n)
+        *p++ = digits[--n];
+    return p;
+}
+
+static void write_all(int fd, const char *buf, size_t len)
+{
+    while (len)
+    {
+#if defined(__WINDOWS__)
+        int n = _write(fd, buf, (unsigned int) len);
+#else
+        ssize_t n = write(fd, buf, len);
+#endif
+        if (n <= 0)
+            return;
+        buf += n;
+        len -= n;
+    }
+}
+
+static void sleep_1ms()
+{
+#if defined(__WINDOWS__)
+    ::Sleep(1);
+#else
+    struct timespec ts = { 0, 1000000 };
+    nanosleep(&ts, nullptr);
+#endif
+}
+
+// Same format as WriteRecord. The local time of day is derived from the last
+// time the writer converted, so no time zone lookup is needed.
+void DebugLog::CrashWriteRecord(void *ctx, const LogRing::Record& rec)
+{
+    DebugLog *log = static_cast<DebugLog *>(ctx);
+
+    int64_t delta = log->m_lastWriteTime ? wxMax(rec.time - log->m_lastWriteTime, (int64_t) 0) : 0;
+    log->m_lastWriteTime = rec.time;
+
+    int64_t const second = rec.time / 1000000;
+    int64_t tod = second;
+    if (log->m_tmSecond >= 0)
+        tod = log->m_tm.tm_hour * 3600 + log->m_tm.tm_min * 60 + log->m_tm.tm_sec + (second - log->m_tmSecond);
+    tod %= 86400;
+    if (tod < 0)
+        tod += 86400;
+
+    char prefix[96];
+    char *p = prefix;
+    p = put_digits(p, tod / 3600, 2);
+    *p++ = ':';
+    p = put_digits(p, tod / 60 % 60, 2);
+    *p++ = ':';
+    p = put_digits(p, tod % 60, 2);
+    *p++ = '.';
+    p = put_digits(p, rec.time / 1000 % 1000, 3);
+    *p++ = ' ';
+    p = put_digits(p, delta / 1000000, 2);
+    *p++ = '.';
+    p = put_digits(p, delta / 1000 % 1000, 3);
+    *p++ = ' ';
+    p = put_digits(p, rec.thread, 1);
+    *p++ = ' ';
+
+    write_all(log->m_crashFd, prefix, p - prefix);
+    write_all(log->m_crashFd, rec.text, rec.len);
+}
+
+void DebugLog::CrashFlush()
+{
+    // The writer thread may be in the middle of a batch; give it a moment to
+    // finish. If the crash is on the writer thread itself, do nothing more.
+    bool expected = false;
+    for (int i = 0; !m_draining.compare_exchange_strong(expected, true); i++)
+    {
+        if (i == 200)
+            return;
+        expected = false;
+        sleep_1ms();
+    }
+
+    // No locks are taken here: the crashing thread may hold them. The writer
+    // flushes stdio after each batch, so writing to the descriptor directly
+    // keeps the lines in order.
+    FILE *fp = IsOpened() ? wxFFile::fp() : nullptr;
+    if (fp)
+    {
+#if defined(__WINDOWS__)
+        m_crashFd = _fileno(fp);
+#else
+        m_crashFd = fileno(fp);
+#endif
+        m_ring.Drain(CrashWriteRecord, this);
+    }
+}
+
 static bool ParseLogTimestamp(wxDateTime *p, const wxString& s)
 {
     wxDateTime dt;
@@ -99,27 +417,35 @@ void DebugLog::InitDebugLog(bool enable, bool forceOpen)
 {
     const wxDateTime& logFileTime = wxGetApp().GetLogFileTime();
 
-    wxCriticalSectionLocker lock(m_criticalSection);
+    // lines logged so far belong in the current file
+    Flush();
 
-    if (m_enabled)
     {
-        wxFFile::Flush();
-        wxFFile::Close();
+        wxCriticalSectionLocker lock(m_criticalSection);
 
-        m_enabled = false;
-    }
+        if (m_enabled)
+        {
+            wxFFile::Flush();
+            wxFFile::Close();
 
-    if (enable && (m_path.IsEmpty() || forceOpen))
-    {
-        m_path = GetLogDir() + PATHSEPSTR + logFileTime.Format(_T("PHD2_DebugLog_%Y-%m-%d_%H%M%S.txt"));
+            m_enabled = false;
+        }
 
-        if (!wxFFile::Open(m_path, "a"))
+        if (enable && (m_path.IsEmpty() || forceOpen))
         {
-            wxMessageBox(wxString::Format(_("unable to open file %s"), m_path));
+            m_path = GetLogDir() + PATHSEPSTR + logFileTime.Format(_T("PHD2_DebugLog_%Y-%m-%d_%H%M%S.txt"));
+
+            if (!wxFFile::Open(m_path, "a"))
+            {
+                wxMessageBox(wxString::Format(_("unable to open file %s"), m_path));
+            }
         }
+
+        m_enabled = enable;
     }
 
-    m_enabled = enable;
+    if (enable)
+        StartWriter();
 }
 
 bool DebugLog::ChangeDirLog(const wxString& newdir)
@@ -163,39 +489,76 @@ wxString DebugLog::AddBytes(const wxString& str, const unsigned char *pBytes, un
     return Write(Line + "\n");
 }
 
+// Wait until every line logged before the call has been written to the file
 bool DebugLog::Flush()
 {
-    bool ret = true;
+    if (!m_enabled)
+        return true;
 
-    if (m_enabled)
+    uint64_t const target = m_ring.Produced();
+
+    if (!m_writerRunning)
     {
-        wxCriticalSectionLocker lock(m_criticalSection);
+        WritePending();
+        return true;
+    }
 
-        ret = wxFFile::Flush();
+    std::unique_lock<std::mutex> lck(m_writerLock);
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+    while (m_ring.Consumed() < target && !m_stopWriter)
+    {
+        m_flushRequested = true;
+        m_wakeWriter.notify_one();
+        if (m_written.wait_until(lck, deadline) == std::cv_status::timeout)
+            return false;
+    }
+
+    return true;
+}
+
+// Copy an ASCII string to buf; returns false if the string has any other
+// characters or does not fit, so the caller can fall back to a conversion
+static bool CopyAscii(char *buf, size_t size, const wxString& str, size_t *len)
+{
+    if (str.length() > size)
+        return false;
+
+    char *p = buf;
+    for (wxString::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+        wxUint32 c = (*it).GetValue();
+        if (c >= 0x80)
+            return false;
+        *p++ = (char) c;
     }
 
-    return ret;
+    *len = p - buf;
+    return true;
 }
 
 wxString DebugLog::Write(const wxString& str)
 {
     if (m_enabled)
     {
-        wxCriticalSectionLocker lock(m_criticalSection);
-
-        wxDateTime now = wxDateTime::UNow();
-        wxTimeSpan deltaTime = now - m_lastWriteTime;
-        m_lastWriteTime = now;
-        wxString outputLine = wxString::Format("%s %s %lu %s", now.Format("%H:%M:%S.%l"), deltaTime.Format("%S.%l"),
-                                               (unsigned long) wxThread::GetCurrentId(), str);
+        int64_t const now =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        uint64_t const thread = (uint64_t) wxThread::GetCurrentId();
+
+        char buf[512];
+        size_t len;
+        if (CopyAscii(buf, sizeof(buf), str, &len))
+            m_ring.Put(now, thread, buf, len);
+        else
+        {
+            wxScopedCharBuffer utf8 = str.utf8_str();
+            m_ring.Put(now, thread, utf8.data(), utf8.length());
+        }
 
-        wxFFile::Write(outputLine);
-#if defined(ALWAYS_FLUSH_DEBUGLOG)
-        wxFFile::Flush();
-#endif
-#if defined(__WINDOWS__) && defined(_DEBUG)
-        OutputDebugString(outputLine.c_str());
-#endif
+        if (!m_writerRunning)
+            WritePending();
+        else if (m_ring.Produced() - m_ring.Consumed() > RING_SLOTS / 4)
+            m_wakeWriter.notify_one(); // don't wait for the timer when logging is heavy
     }
 
     return str;
@@ -37,14 +37,48 @@
 #define DEBUGLOG_INCLUDED
 
 #include "logger.h"
+#include "log_ring.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+// Write() does not touch the file: it copies the line into a lock-free ring
+// buffer and returns. A background thread formats the timestamps and writes
+// the lines in batches, so a slow disk cannot stall the calling thread. If
+// the ring fills up, lines are dropped and the number dropped is logged.
 class DebugLog : public wxFFile, public Logger
 {
     bool m_enabled;
-    wxCriticalSection m_criticalSection;
-    wxDateTime m_lastWriteTime;
+    wxCriticalSection m_criticalSection; // protects the file
     wxString m_path;
 
+    LogRing m_ring;
+    std::atomic<bool> m_writerRunning;
+    std::atomic<bool> m_draining; // the ring is being written out
+    std::thread m_writer;
+    std::mutex m_writerLock; // protects the fields below
+    std::condition_variable m_wakeWriter;
+    std::condition_variable m_written;
+    bool m_stopWriter;
+    bool m_flushRequested;
+
+    // used by the thread that writes the file
+    int64_t m_lastWriteTime; // microseconds
+    int64_t m_tmSecond;
+    struct tm m_tm; // local time for m_tmSecond
+    uint64_t m_reportedOverflows;
+    int m_crashFd; // file descriptor written by CrashFlush
+
+    void StartWriter();
+    void StopWriter();
+    void WriterLoop();
+    void WritePending();
+    void WriteRecord(FILE *fp, const LogRing::Record& rec);
+    static void CrashWriteRecord(void *ctx, const LogRing::Record& rec);
+
 public:
     DebugLog();
     ~DebugLog();
@@ -58,6 +92,9 @@ public:
     wxString AddBytes(const wxString& str, const unsigned char *bytes, unsigned count);
     wxString Write(const wxString& str);
     bool Flush();
+    void CrashFlush(); // best-effort write of pending lines when the process is crashing
+    // flush the log on a crash, then run the crash handlers that were already installed; called once at startup
+    static void InstallCrashHandler();
 
     bool ChangeDirLog(const wxString& newdir) override;
     void RemoveOldFiles();
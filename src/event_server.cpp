@@ -36,7 +36,11 @@
 
 #include <wx/sstream.h>
 #include <wx/sckstrm.h>
+#include <algorithm>
+#include <deque>
+#include <memory>
 #include <sstream>
+#include <stddef.h>
 #include <string.h>
 
 EventServer EvtServer;
@@ -53,6 +57,160 @@ enum
     MSG_PROTOCOL_VERSION = 1,
 };
 
+// Outbound messages that a client's socket cannot take immediately are queued
+// and written as the socket drains. Events that the next frame supersedes
+// (GuideStep, LoopingExposures, StarLost, Settling) are dropped for a client
+// with more than s_slowClientBytes queued. No other message is ever dropped:
+// a client whose queue would grow past MAX_CLIENT_BACKLOG is disconnected, so
+// that it sees an error rather than waiting for a response that never comes.
+// Messages are queued or dropped whole, so a slow client never sees a partial
+// message.
+enum
+{
+    DEFAULT_SLOW_CLIENT_KB = 256,
+    MAX_CLIENT_BACKLOG = 8 * 1024 * 1024,
+};
+
+static size_t s_slowClientBytes = DEFAULT_SLOW_CLIENT_KB * 1024;
+
+// Notification event types. Clients receive all of them unless they choose a
+// subset with set_event_subscription.
+enum EventType
+{
+    EVT_VERSION,
+    EVT_LOCK_POSITION_SET,
+    EVT_CALIBRATING,
+    EVT_CALIBRATION_COMPLETE,
+    EVT_STAR_SELECTED,
+    EVT_START_GUIDING,
+    EVT_PAUSED,
+    EVT_START_CALIBRATION,
+    EVT_APP_STATE,
+    EVT_CALIBRATION_FAILED,
+    EVT_CALIBRATION_DATA_FLIPPED,
+    EVT_LOCK_POSITION_SHIFT_LIMIT_REACHED,
+    EVT_LOOPING_EXPOSURES,
+    EVT_LOOPING_EXPOSURES_STOPPED,
+    EVT_SETTLE_BEGIN,
+    EVT_SETTLING,
+    EVT_SETTLE_DONE,
+    EVT_STAR_LOST,
+    EVT_GUIDING_STOPPED,
+    EVT_RESUMED,
+    EVT_GUIDE_STEP,
+    EVT_GUIDING_DITHERED,
+    EVT_LOCK_POSITION_LOST,
+    EVT_ALERT,
+    EVT_GUIDE_PARAM_CHANGE,
+    EVT_CONFIGURATION_CHANGE,
+
+    NUM_EVENT_TYPES
+};
+
+static const char *const s_eventNames[] = {
+    "Version",
+    "LockPositionSet",
+    "Calibrating",
+    "CalibrationComplete",
+    "StarSelected",
+    "StartGuiding",
+    "Paused",
+    "StartCalibration",
+    "AppState",
+    "CalibrationFailed",
+    "CalibrationDataFlipped",
+    "LockPositionShiftLimitReached",
+    "LoopingExposures",
+    "LoopingExposuresStopped",
+    "SettleBegin",
+    "Settling",
+    "SettleDone",
+    "StarLost",
+    "GuidingStopped",
+    "Resumed",
+    "GuideStep",
+    "GuidingDithered",
+    "LockPositionLost",
+    "Alert",
+    "GuideParamChange",
+    "ConfigurationChange",
+};
+
+static_assert(WXSIZEOF(s_eventNames) == NUM_EVENT_TYPES, "event name table out of sync");
+
+static const unsigned int ALL_EVENTS = (1u << NUM_EVENT_TYPES) - 1;
+
+static int event_type(const char *name)
+{
+    for (int i = 0; i < NUM_EVENT_TYPES; i++)
+        if (strcmp(name, s_eventNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+// events that the next frame supersedes, see s_slowClientBytes
+static bool droppable_event(EventType evt)
+{
+    return evt == EVT_GUIDE_STEP || evt == EVT_LOOPING_EXPOSURES || evt == EVT_STAR_LOST || evt == EVT_SETTLING;
+}
+
+enum SendPolicy
+{
+    SEND_NORMAL, // dropped only when the backlog reaches MAX_CLIENT_BACKLOG
+    SEND_DROPPABLE, // dropped when the client has more than s_slowClientBytes queued
+    SEND_FRAME, // dropped while the client's previous frame is still queued
+};
+
+// Binary frame stream. After start_frame_stream a client receives each new
+// guide frame on the same connection, between the JSON lines, as this header
+// followed by payloadSize bytes of unsigned 16-bit pixels (height rows of
+// width pixels). All header fields and pixels are little-endian, with the
+// header packed as laid out below (80 bytes, no padding). The magic cannot
+// start a JSON line. Readers should skip headerSize bytes rather than sizeof
+// the header, so that fields can be added.
+struct FrameStreamHeader
+{
+    char magic[4]; // "PHDF"
+    uint32_t headerSize;
+    uint32_t payloadSize;
+    uint32_t frameNumber;
+    uint16_t x; // origin of the pixel data in full-frame coordinates
+    uint16_t y;
+    uint16_t width; // of the pixel data, after binning
+    uint16_t height;
+    uint16_t binning; // each pixel is the mean of binning x binning camera pixels
+    uint16_t flags; // FRAME_SUBFRAME: the camera read out only the subframe
+    uint16_t fullWidth;
+    uint16_t fullHeight;
+    uint16_t subX; // camera subframe, when FRAME_SUBFRAME is set
+    uint16_t subY;
+    uint16_t subWidth;
+    uint16_t subHeight;
+    uint32_t exposureMs;
+    uint32_t reserved;
+    double exposureStart; // seconds since the epoch
+    double sent; // seconds since the epoch
+    float starX; // primary star, full-frame coordinates, -1 if none
+    float starY;
+    float lockX; // lock position, -1 if none
+    float lockY;
+};
+
+static_assert(sizeof(FrameStreamHeader) == 80 && offsetof(FrameStreamHeader, exposureStart) == 48 &&
+                  offsetof(FrameStreamHeader, starX) == 64,
+              "frame stream header layout changed");
+
+// frame_message fills in the header and copies the pixels in host byte order
+#if wxBYTE_ORDER != wxLITTLE_ENDIAN
+# error "the frame stream is little-endian: frame_message needs byte swapping on big-endian hosts"
+#endif
+
+enum
+{
+    FRAME_SUBFRAME = 1,
+    FRAME_STREAM_MAX_BINNING = 16,
+};
+
 static const wxString literal_null("null");
 static const wxString literal_true("true");
 static const wxString literal_false("false");
@@ -371,20 +529,140 @@ static Ev ev_settle_done(const wxString& errorMsg, int settleFrames, int dropped
     return ev;
 }
 
-struct ClientReadBuf
+// Receive buffer for a client's requests. Requests are parsed in place: a
+// complete line is NUL-terminated where it lies and consumed by advancing
+// m_start. Handling a request can run the event loop and read more input for
+// the same client, so while a request is being handled (m_busy) the buffer is
+// never compacted, and when it has to grow the old block is kept until the
+// outermost request completes.
+class ClientReadBuf
 {
+    char *m_buf;
+    size_t m_size;
+    size_t m_start; // first unconsumed byte
+    size_t m_end; // end of received data
+    size_t m_scanned; // bytes before this contain no newline
+    std::vector<char *> m_retired;
+
+    ClientReadBuf(const ClientReadBuf&);
+    ClientReadBuf& operator=(const ClientReadBuf&);
+
+public:
     enum
     {
-        SIZE = 1024
+        INITIAL_SIZE = 4096,
+        MAX_REQUEST = 16 * 1024 * 1024,
     };
-    char m_buf[SIZE];
-    char *dest;
-
-    ClientReadBuf() { reset(); }
-    char *buf() { return &m_buf[0]; }
-    size_t len() const { return dest - &m_buf[0]; }
-    size_t avail() const { return &m_buf[SIZE] - dest; }
-    void reset() { dest = &m_buf[0]; }
+
+    int m_busy;
+
+    ClientReadBuf() : m_buf((char *) malloc(INITIAL_SIZE)), m_size(INITIAL_SIZE), m_start(0), m_end(0), m_scanned(0), m_busy(0)
+    {
+    }
+    ~ClientReadBuf()
+    {
+        free(m_buf);
+        ReleaseRetired();
+    }
+
+    char *dest() { return m_buf + m_end; }
+    size_t avail() const { return m_size - m_end; }
+    void Received(size_t n) { m_end += n; }
+
+    // make room to receive more data; false if the pending request is too big
+    bool Reserve(size_t want)
+    {
+        if (m_size - m_end >= want)
+            return true;
+
+        size_t pending = m_end - m_start;
+        if (pending >= MAX_REQUEST)
+            return false;
+
+        if (!m_busy && m_start > 0 && m_size - pending >= want)
+        {
+            memmove(m_buf, m_buf + m_start, pending);
+            Rebase(m_buf);
+            return true;
+        }
+
+        size_t size = m_size;
+        while (size - pending < want)
+            size *= 2;
+
+        char *buf = (char *) malloc(size);
+        if (!buf)
+            return false;
+        memcpy(buf, m_buf + m_start, pending);
+        if (m_busy)
+            m_retired.push_back(m_buf); // the request being handled still points into it
+        else
+            free(m_buf);
+        m_size = size;
+        Rebase(buf);
+        return true;
+    }
+
+    // the next complete line, NUL-terminated in place, or null
+    char *NextLine()
+    {
+        char *nl = static_cast<char *>(memchr(m_buf + m_scanned, '\n', m_end - m_scanned));
+        if (!nl)
+        {
+            m_scanned = m_end;
+            return nullptr;
+        }
+        *nl = 0;
+        char *line = m_buf + m_start;
+        m_start = m_scanned = nl + 1 - m_buf;
+        return line;
+    }
+
+    // discard unconsumed input
+    void Discard() { m_start = m_scanned = m_end; }
+
+    // called when no request is being handled
+    void Idle()
+    {
+        ReleaseRetired();
+        if (m_start == m_end)
+        {
+            m_start = m_end = m_scanned = 0;
+            if (m_size > INITIAL_SIZE * 16)
+            {
+                free(m_buf);
+                m_buf = (char *) malloc(INITIAL_SIZE);
+                m_size = INITIAL_SIZE;
+            }
+        }
+    }
+
+private:
+    void Rebase(char *buf)
+    {
+        size_t pending = m_end - m_start;
+        m_scanned -= m_start;
+        m_buf = buf;
+        m_start = 0;
+        m_end = pending;
+    }
+    void ReleaseRetired()
+    {
+        for (size_t i = 0; i < m_retired.size(); i++)
+            free(m_retired[i]);
+        m_retired.clear();
+    }
+};
+
+struct ClientStats
+{
+    unsigned long msgs; // messages queued
+    unsigned long long bytes;
+    unsigned long deferred; // messages not fully written on the first attempt
+    unsigned long dropped;
+    size_t maxBacklog;
+
+    ClientStats() : msgs(0), bytes(0), deferred(0), dropped(0), maxBacklog(0) { }
 };
 
 struct ClientData
@@ -392,9 +670,44 @@ struct ClientData
     wxSocketClient *cli;
     int refcnt;
     ClientReadBuf rdbuf;
+    // one parser for each level of nested request handling, kept so that
+    // their allocators are reused from one request to the next
+    std::vector<std::unique_ptr<JsonParser>> parsers;
     wxMutex wrlock;
 
-    ClientData(wxSocketClient *cli_) : cli(cli_), refcnt(1) { }
+    // outbound messages the socket has not taken yet; the first one has
+    // outofs bytes written already
+    std::deque<wxCharBuffer> outq;
+    size_t outofs;
+    size_t outbytes;
+    bool dropping;
+    unsigned long dropsSinceReport;
+    bool closing; // the backlog overflowed and the client is being disconnected
+    ClientStats stats;
+
+    // subscribed event types, one bit per EventType, and for rate-limited
+    // types the minimum interval between events and when the next may be sent
+    unsigned int subscribed;
+    int minInterval[NUM_EVENT_TYPES]; // milliseconds, 0 = no limit
+    wxLongLong_t nextDue[NUM_EVENT_TYPES];
+
+    // frame stream: requested region (empty = whole frame) and binning, and
+    // the stream position just past the last queued frame
+    bool streaming;
+    wxRect streamRoi;
+    int streamBinning;
+    unsigned long long frameEnd;
+    unsigned long framesSent;
+    unsigned long framesSkipped;
+
+    ClientData(wxSocketClient *cli_)
+        : cli(cli_), refcnt(1), outofs(0), outbytes(0), dropping(false), dropsSinceReport(0), closing(false),
+          subscribed(ALL_EVENTS),
+          streaming(false), streamBinning(1), frameEnd(0), framesSent(0), framesSkipped(0)
+    {
+        std::fill(minInterval, minInterval + NUM_EVENT_TYPES, 0);
+        std::fill(nextDue, nextDue + NUM_EVENT_TYPES, 0);
+    }
     void AddRef() { ++refcnt; }
     void RemoveRef()
     {
@@ -414,9 +727,9 @@ struct ClientDataGuard
     ClientData *operator->() const { return cd; }
 };
 
-inline static wxMutex *client_wrlock(wxSocketClient *cli)
+inline static ClientData *client_data(wxSocketClient *cli)
 {
-    return &((ClientData *) cli->GetClientData())->wrlock;
+    return (ClientData *) cli->GetClientData();
 }
 
 static wxString SockErrStr(wxSocketError e)
@@ -448,16 +761,123 @@ static wxString SockErrStr(wxSocketError e)
     }
 }
 
-static void send_buf(wxSocketClient *client, const wxCharBuffer& buf)
+// Write queued output until the socket would block. Called with wrlock held.
+static void flush_output(ClientData *cd)
+{
+    wxSocketClient *cli = cd->cli;
+
+    while (!cd->outq.empty())
+    {
+        const wxCharBuffer& buf = cd->outq.front();
+        size_t len = buf.length() - cd->outofs;
+
+        cli->Write(buf.data() + cd->outofs, len);
+        size_t n = cli->LastWriteCount();
+        cd->outofs += n;
+        cd->outbytes -= n;
+
+        if (n < len)
+        {
+            if (cli->Error() && cli->LastError() != wxSOCKET_WOULDBLOCK)
+            {
+                // the connection is going away; the lost event will follow
+                Debug.Write(wxString::Format("evsrv: cli %p write error %s, discarding %u bytes\n", cli,
+                                             SockErrStr(cli->LastError()), (unsigned int) cd->outbytes));
+                cd->outq.clear();
+                cd->outofs = 0;
+                cd->outbytes = 0;
+            }
+            // otherwise the remainder is written on the next wxSOCKET_OUTPUT event
+            break;
+        }
+
+        cd->outq.pop_front();
+        cd->outofs = 0;
+    }
+
+    if (cd->dropping && cd->outbytes <= s_slowClientBytes / 2)
+    {
+        Debug.Write(wxString::Format("evsrv: cli %p caught up, %lu events dropped\n", cli, cd->dropsSinceReport));
+        cd->dropping = false;
+        cd->dropsSinceReport = 0;
+    }
+}
+
+static void send_buf(wxSocketClient *client, const wxCharBuffer& buf, SendPolicy policy = SEND_NORMAL)
 {
-    wxMutexLocker lock(*client_wrlock(client));
-    client->Write(buf.data(), buf.length());
-    if (client->LastWriteCount() != buf.length())
+    ClientData *cd = client_data(client);
+    wxMutexLocker lock(cd->wrlock);
+
+    size_t len = buf.length();
+
+    if (cd->closing)
+        return;
+
+    if (policy == SEND_FRAME)
+    {
+        // a frame may be larger than the backlog limit, but a client never
+        // has more than one queued; skip frames until the last one is written
+        if (cd->stats.bytes - cd->outbytes < cd->frameEnd)
+        {
+            ++cd->framesSkipped;
+            return;
+        }
+    }
+    else if (cd->outbytes + len > MAX_CLIENT_BACKLOG)
+    {
+        // dropping a response or a state change would leave the client
+        // waiting or out of sync; disconnect it instead, from the event loop
+        // since the caller may be iterating over the clients
+        Debug.Write(wxString::Format("evsrv: cli %p backlog limit reached, %u bytes queued, disconnecting\n", client,
+                                     (unsigned int) cd->outbytes));
+        cd->closing = true;
+        cd->outq.clear();
+        cd->outofs = 0;
+        cd->outbytes = 0;
+        cd->AddRef(); // released by DisconnectClient
+        EvtServer.CallAfter(&EventServer::DisconnectClient, client);
+        return;
+    }
+    else if (policy == SEND_DROPPABLE && s_slowClientBytes && cd->outbytes >= s_slowClientBytes)
+    {
+        if (!cd->dropping)
+        {
+            Debug.Write(wxString::Format("evsrv: cli %p slow, %u bytes queued, dropping events\n", client,
+                                         (unsigned int) cd->outbytes));
+            cd->dropping = true;
+        }
+        ++cd->stats.dropped;
+        ++cd->dropsSinceReport;
+        return;
+    }
+
+    // the buffer is reference counted, so every client shares one copy of a notification
+    cd->outq.push_back(buf);
+    cd->outbytes += len;
+    ++cd->stats.msgs;
+    cd->stats.bytes += len;
+
+    if (policy == SEND_FRAME)
     {
-        Debug.Write(wxString::Format("evsrv: cli %p short write %u/%u %s\n", client, client->LastWriteCount(),
-                                     (unsigned int) buf.length(),
-                                     SockErrStr(client->Error() ? client->LastError() : wxSOCKET_NOERROR)));
+        cd->frameEnd = cd->stats.bytes;
+        ++cd->framesSent;
     }
+
+    flush_output(cd);
+
+    if (cd->outbytes > 0)
+    {
+        ++cd->stats.deferred;
+        if (cd->outbytes > cd->stats.maxBacklog)
+            cd->stats.maxBacklog = cd->outbytes;
+    }
+}
+
+static void handle_cli_output(wxSocketClient *cli)
+{
+    ClientData *cd = client_data(cli);
+    wxMutexLocker lock(cd->wrlock);
+    flush_output(cd);
 }
 
 static void do_notify1(wxSocketClient *client, const JAry& ary)
@@ -470,30 +890,69 @@ static void do_notify1(wxSocketClient *client, const JObj& j)
     send_buf(client, (JObj(j).str() + "\r\n").ToUTF8());
 }
 
-static void do_notify(const EventServer::CliSockSet& cli, const JObj& jj)
+inline static bool client_wants(const ClientData *cd, EventType evt, wxLongLong_t now)
 {
-    wxCharBuffer buf = (JObj(jj).str() + "\r\n").ToUTF8();
+    return (cd->subscribed & (1u << evt)) != 0 && now >= cd->nextDue[evt];
+}
+
+// Notify* methods check this before building an event so that events no
+// client subscribes to, or that are rate limited for every client, cost nothing
+static bool any_client_wants(const EventServer::CliSockSet& cli, EventType evt)
+{
+    if (cli.empty())
+        return false;
+
+    wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
 
     for (EventServer::CliSockSet::const_iterator it = cli.begin(); it != cli.end(); ++it)
     {
-        send_buf(*it, buf);
+        if (client_wants(client_data(*it), evt, now))
+            return true;
     }
+
+    return false;
 }
 
-inline static void simple_notify(const EventServer::CliSockSet& cli, const wxString& ev)
+static void do_notify(const EventServer::CliSockSet& cli, EventType evt, const JObj& jj)
 {
-    if (!cli.empty())
-        do_notify(cli, Ev(ev));
+    wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+    wxCharBuffer buf;
+    bool formatted = false;
+
+    for (EventServer::CliSockSet::const_iterator it = cli.begin(); it != cli.end(); ++it)
+    {
+        ClientData *cd = client_data(*it);
+        if (!client_wants(cd, evt, now))
+            continue;
+
+        // allow 1/8 of the interval for jitter so that events arriving at
+        // the limit rate are not skipped alternately
+        if (cd->minInterval[evt])
+            cd->nextDue[evt] = now + cd->minInterval[evt] - cd->minInterval[evt] / 8;
+
+        if (!formatted)
+        {
+            buf = (JObj(jj).str() + "\r\n").ToUTF8();
+            formatted = true;
+        }
+
+        send_buf(*it, buf, droppable_event(evt) ? SEND_DROPPABLE : SEND_NORMAL);
+    }
 }
 
-inline static void simple_notify_ev(const EventServer::CliSockSet& cli, const Ev& ev)
+inline static void simple_notify(const EventServer::CliSockSet& cli, EventType evt)
 {
-    if (!cli.empty())
-        do_notify(cli, ev);
+    if (any_client_wants(cli, evt))
+        do_notify(cli, evt, Ev(s_eventNames[evt]));
 }
 
-#define SIMPLE_NOTIFY(s) simple_notify(m_eventServerClients, s)
-#define SIMPLE_NOTIFY_EV(ev) simple_notify_ev(m_eventServerClients, ev)
+#define SIMPLE_NOTIFY(evt) simple_notify(m_eventServerClients, evt)
+#define SIMPLE_NOTIFY_EV(evt, ev)                                                                                              \
+    do                                                                                                                         \
+    {                                                                                                                          \
+        if (any_client_wants(m_eventServerClients, evt))                                                                       \
+            do_notify(m_eventServerClients, evt, ev);                                                                          \
+    } while (0)
 
 static void send_catchup_events(wxSocketClient *cli)
 {
@@ -538,6 +997,18 @@ static void send_catchup_events(wxSocketClient *cli)
 static void destroy_client(wxSocketClient *cli)
 {
     ClientData *buf = (ClientData *) cli->GetClientData();
+
+    const ClientStats& st = buf->stats;
+    Debug.Write(wxString::Format("evsrv: cli %p sent %lu msgs %llu bytes, deferred %lu, dropped %lu, max backlog %u bytes, "
+                                 "%u bytes unsent\n",
+                                 cli, st.msgs, st.bytes, st.deferred, st.dropped, (unsigned int) st.maxBacklog,
+                                 (unsigned int) buf->outbytes));
+    if (buf->framesSent || buf->framesSkipped)
+    {
+        Debug.Write(wxString::Format("evsrv: cli %p frame stream sent %lu frames, skipped %lu\n", cli, buf->framesSent,
+                                     buf->framesSkipped));
+    }
+
     buf->RemoveRef();
 }
 
@@ -1489,15 +1960,12 @@ static void get_star_image(JObj& response, const json_value *params)
     int const sx = (int) rint(star.X);
     int const sy = (int) rint(star.Y);
     wxRect rect(sx - halfw, sy - halfw, fullw, fullw);
-    if (img->Subframe.IsEmpty())
-        rect.Intersect(wxRect(img->Size));
-    else
-        rect.Intersect(img->Subframe);
+    rect.Intersect(img->ValidRect());
 
     B64Encode enc;
     for (int y = rect.GetTop(); y <= rect.GetBottom(); y++)
     {
-        const unsigned short *p = img->ImageData + y * img->Size.GetWidth() + rect.GetLeft();
+        const unsigned short *p = &img->Pixel(rect.GetLeft(), y);
         enc.append(p, rect.GetWidth() * sizeof(unsigned short));
     }
 
@@ -2198,6 +2666,135 @@ static void export_config_settings(JObj& response, const json_value *params)
     response << jrpc_result(rslt);
 }
 
+static void subscription_result(JObj& response, const ClientData *cd)
+{
+    JAry events;
+    JObj rates;
+    for (int i = 0; i < NUM_EVENT_TYPES; i++)
+    {
+        if (!(cd->subscribed & (1u << i)))
+            continue;
+        events << ('"' + wxString(s_eventNames[i]) + '"');
+        if (cd->minInterval[i])
+            rates << NV(s_eventNames[i], 1000.0 / cd->minInterval[i], 3);
+    }
+
+    JObj rslt;
+    rslt << NV("events", events) << NV("max_rate", rates);
+    response << jrpc_result(rslt);
+}
+
+static void get_event_subscription(JObj& response, const json_value *params, wxSocketClient *cli)
+{
+    subscription_result(response, client_data(cli));
+}
+
+// params: events - array of event names to receive, all events if omitted;
+// max_rate - object mapping event names to the maximum number of events per
+// second, no limit if omitted. Replaces the client's previous subscription.
+// Responses to requests and the events sent on connection are not affected.
+static void set_event_subscription(JObj& response, const json_value *params, wxSocketClient *cli)
+{
+    Params p("events", "max_rate", params);
+
+    unsigned int subscribed = ALL_EVENTS;
+    const json_value *events = p.param("events");
+    if (events && events->type != JSON_NULL)
+    {
+        if (events->type != JSON_ARRAY)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected events array");
+            return;
+        }
+        subscribed = 0;
+        json_for_each(ev, events)
+        {
+            int evt = ev->type == JSON_STRING ? event_type(ev->string_value) : -1;
+            if (evt < 0)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, wxString::Format("unknown event %s", json_format(ev)));
+                return;
+            }
+            subscribed |= 1u << evt;
+        }
+    }
+
+    int minInterval[NUM_EVENT_TYPES] = { 0 };
+    const json_value *rates = p.param("max_rate");
+    if (rates && rates->type != JSON_NULL)
+    {
+        if (rates->type != JSON_OBJECT)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected max_rate object");
+            return;
+        }
+        json_for_each(r, rates)
+        {
+            int evt = event_type(r->name);
+            double rate;
+            if (evt < 0 || !float_param(r, &rate) || rate < 0.0)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, wxString::Format("invalid max_rate for %s", r->name));
+                return;
+            }
+            minInterval[evt] = rate > 0.0 ? (int) ceil(1000.0 / wxMax(rate, 0.001)) : 0;
+        }
+    }
+
+    ClientData *cd = client_data(cli);
+    cd->subscribed = subscribed;
+    std::copy(minInterval, minInterval + NUM_EVENT_TYPES, cd->minInterval);
+    std::fill(cd->nextDue, cd->nextDue + NUM_EVENT_TYPES, 0);
+
+    Debug.Write(wxString::Format("evsrv: cli %p subscription %s\n", cli, json_format(params)));
+
+    subscription_result(response, cd);
+}
+
+// params: binning - 1 (default) to 16; roi - [x,y,width,height] in
+// full-frame coordinates, the whole frame if omitted. Calling again changes
+// the parameters of a running stream.
+static void start_frame_stream(JObj& response, const json_value *params, wxSocketClient *cli)
+{
+    Params p("binning", "roi", params);
+
+    int binning = 1;
+    const json_value *jb = p.param("binning");
+    if (jb)
+    {
+        if (jb->type != JSON_INT || jb->int_value < 1 || jb->int_value > FRAME_STREAM_MAX_BINNING)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "invalid binning param");
+            return;
+        }
+        binning = jb->int_value;
+    }
+
+    wxRect roi;
+    const json_value *jr = p.param("roi");
+    if (jr && (!parse_rect(&roi, jr) || roi.width <= 0 || roi.height <= 0))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "invalid roi param");
+        return;
+    }
+
+    ClientData *cd = client_data(cli);
+    cd->streaming = true;
+    cd->streamBinning = binning;
+    cd->streamRoi = roi;
+
+    Debug.Write(wxString::Format("evsrv: cli %p start frame stream binning %d roi %d,%d,%d,%d\n", cli, binning, roi.x, roi.y,
+                                 roi.width, roi.height));
+
+    response << jrpc_result(0);
+}
+
+static void stop_frame_stream(JObj& response, const json_value *params, wxSocketClient *cli)
+{
+    client_data(cli)->streaming = false;
+    response << jrpc_result(0);
+}
+
 struct JRpcCall
 {
     wxSocketClient *cli;
@@ -2460,6 +3057,35 @@ static bool handle_request(JRpcCall& call)
                     { "get_variable_delay_settings", &get_variable_delay_settings },
                     { "set_variable_delay_settings", &set_variable_delay_settings } };
 
+    // methods that act on the calling client's connection
+    static struct
+    {
+        const char *name;
+        void (*fn)(JObj& response, const json_value *params, wxSocketClient *cli);
+    } client_methods[] = {
+        { "get_event_subscription", &get_event_subscription },
+        { "set_event_subscription", &set_event_subscription },
+        { "start_frame_stream", &start_frame_stream },
+        { "stop_frame_stream", &stop_frame_stream },
+    };
+
+    for (unsigned int i = 0; i < WXSIZEOF(client_methods); i++)
+    {
+        if (strcmp(call.method->string_value, client_methods[i].name) == 0)
+        {
+            (*client_methods[i].fn)(call.response, params, call.cli);
+            if (id)
+            {
+                call.response << jrpc_id(id);
+                return true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+
     for (unsigned int i = 0; i < WXSIZEOF(methods); i++)
     {
         if (strcmp(call.method->string_value, methods[i].name) == 0)
@@ -2488,13 +3114,8 @@ static bool handle_request(JRpcCall& call)
     }
 }
 
-static void handle_cli_input_complete(wxSocketClient *cli, char *input)
+static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonParser& parser)
 {
-    // a dedicated JsonParser instance is used for each line of input since
-    // handle_request can recurse if the request causes the event loop to run and we
-    // don't want the parser to be reused.
-    JsonParser parser;
-
     if (!parser.Parse(input))
     {
         JRpcCall call(cli, nullptr);
@@ -2557,7 +3178,7 @@ static void handle_cli_input(wxSocketClient *cli)
 
     while (sis.CanRead())
     {
-        if (rdbuf->avail() == 0)
+        if (!rdbuf->Reserve(1024))
         {
             drain_input(sis);
 
@@ -2565,33 +3186,29 @@ static void handle_cli_input(wxSocketClient *cli)
             response << jrpc_error(JSONRPC_INTERNAL_ERROR, "too big") << jrpc_id(0);
             do_notify1(cli, response);
 
-            rdbuf->reset();
+            rdbuf->Discard();
             break;
         }
-        size_t n = sis.Read(rdbuf->dest, rdbuf->avail()).LastRead();
+        size_t n = sis.Read(rdbuf->dest(), rdbuf->avail()).LastRead();
         if (n == 0)
             break;
 
-        rdbuf->dest += n;
+        rdbuf->Received(n);
 
-        char *end;
-        while ((end = static_cast<char *>(memchr(rdbuf->buf(), '\n', rdbuf->len()))) != nullptr)
+        char *line;
+        while ((line = rdbuf->NextLine()) != nullptr)
         {
-            // Move the newline-terminated chunk from the read buffer to a temporary
-            // buffer on the stack, and consume the chunk from the read buffer before
-            // processing the line. This leaves the read buffer in the correct state to
-            // be used again if this function is caller reentrantly.
-            char line[ClientReadBuf::SIZE];
-            size_t len1 = end - rdbuf->buf();
-            memcpy(line, rdbuf->buf(), len1);
-            line[len1] = 0;
-
-            char *next = end + 1;
-            size_t len2 = rdbuf->dest - next;
-            memmove(rdbuf->buf(), next, len2);
-            rdbuf->dest = rdbuf->buf() + len2;
-
-            handle_cli_input_complete(cli, line);
+            // The line is consumed from the read buffer before it is handled, so the
+            // buffer is in the correct state to be used again if this function is
+            // called reentrantly. The nested call gets its own parser.
+            size_t depth = rdbuf->m_busy++;
+            if (clidata->parsers.size() <= depth)
+                clidata->parsers.emplace_back(new JsonParser());
+
+            handle_cli_input_complete(cli, line, *clidata->parsers[depth]);
+
+            if (--rdbuf->m_busy == 0)
+                rdbuf->Idle();
         }
     }
 }
@@ -2627,6 +3244,8 @@ bool EventServer::EventServerStart(unsigned int instanceId)
 
     m_configEventDebouncer = new wxTimer();
 
+    s_slowClientBytes = wxMax(0, pConfig->Global.GetInt("/EventServer/SlowClientQueueKB", DEFAULT_SLOW_CLIENT_KB)) * 1024;
+
     Debug.Write(wxString::Format("event server started, listening on port %u\n", port));
 
     return false;
@@ -2667,7 +3286,7 @@ void EventServer::OnEventServerEvent(wxSocketEvent& event)
     Debug.Write(wxString::Format("evsrv: cli %p connect\n", client));
 
     client->SetEventHandler(*this, EVENT_SERVER_CLIENT_ID);
-    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG);
+    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG);
     client->SetFlags(wxSOCKET_NOWAIT);
     client->Notify(true);
     client->SetClientData(new ClientData(client));
@@ -2677,6 +3296,17 @@ void EventServer::OnEventServerEvent(wxSocketEvent& event)
     m_eventServerClients.insert(client);
 }
 
+void EventServer::DisconnectClient(wxSocketClient *cli)
+{
+    ClientData *cd = client_data(cli);
+
+    // the client may already have gone away on its own
+    if (m_eventServerClients.erase(cli) == 1)
+        destroy_client(cli);
+
+    cd->RemoveRef();
+}
+
 void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
 {
     wxSocketClient *cli = static_cast<wxSocketClient *>(event.GetSocket());
@@ -2695,6 +3325,10 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
     {
         handle_cli_input(cli);
     }
+    else if (event.GetSocketEvent() == wxSOCKET_OUTPUT)
+    {
+        handle_cli_output(cli);
+    }
     else
     {
         Debug.Write(wxString::Format("unexpected client socket event %d\n", event.GetSocketEvent()));
@@ -2703,12 +3337,12 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
 
 void EventServer::NotifyStartCalibration(const Mount *mount)
 {
-    SIMPLE_NOTIFY_EV(ev_start_calibration(mount));
+    SIMPLE_NOTIFY_EV(EVT_START_CALIBRATION, ev_start_calibration(mount));
 }
 
 void EventServer::NotifyCalibrationStep(const CalibrationStepInfo& info)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_CALIBRATING))
         return;
 
     Ev ev("Calibrating");
@@ -2719,42 +3353,42 @@ void EventServer::NotifyCalibrationStep(const CalibrationStepInfo& info)
     if (!info.msg.empty())
         ev << NV("State", info.msg);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_CALIBRATING, ev);
 }
 
 void EventServer::NotifyCalibrationFailed(const Mount *mount, const wxString& msg)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_CALIBRATION_FAILED))
         return;
 
     Ev ev("CalibrationFailed");
     ev << NVMount(mount) << NV("Reason", msg);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_CALIBRATION_FAILED, ev);
 }
 
 void EventServer::NotifyCalibrationComplete(const Mount *mount)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_CALIBRATION_COMPLETE))
         return;
 
-    do_notify(m_eventServerClients, ev_calibration_complete(mount));
+    do_notify(m_eventServerClients, EVT_CALIBRATION_COMPLETE, ev_calibration_complete(mount));
 }
 
 void EventServer::NotifyCalibrationDataFlipped(const Mount *mount)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_CALIBRATION_DATA_FLIPPED))
         return;
 
     Ev ev("CalibrationDataFlipped");
     ev << NVMount(mount);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_CALIBRATION_DATA_FLIPPED, ev);
 }
 
 void EventServer::NotifyLooping(unsigned int exposure, const Star *star, const FrameDroppedInfo *info)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_LOOPING_EXPOSURES))
         return;
 
     Ev ev("LoopingExposures");
@@ -2794,22 +3428,153 @@ void EventServer::NotifyLooping(unsigned int exposure, const Star *star, const F
     if (!status.IsEmpty())
         ev << NV("Status", status);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_LOOPING_EXPOSURES, ev);
+}
+
+// The part of the frame a streaming client receives: the valid data (the
+// subframe, if there is one) within the client's region of interest
+static wxRect stream_rect(const usImage *img, const ClientData *cd)
+{
+    wxRect r = img->Subframe.IsEmpty() ? wxRect(img->Size) : img->Subframe;
+    if (!cd->streamRoi.IsEmpty())
+        r.Intersect(cd->streamRoi);
+    return r;
+}
+
+// Header and pixels for one frame message, copied and binned straight from
+// the image in a single pass. The image is recycled for the next exposure, so
+// this copy is the only one; the message is shared by every client that
+// requested the same region and binning.
+static wxCharBuffer frame_message(const usImage *img, const wxRect& r, int binning, const PHD_Point& star,
+                                  const PHD_Point& lock)
+{
+    int w = r.width > 0 ? r.width / binning : 0;
+    int h = r.height > 0 ? r.height / binning : 0;
+    size_t payload = (size_t) w * h * sizeof(unsigned short);
+
+    wxCharBuffer buf(sizeof(FrameStreamHeader) + payload);
+
+    FrameStreamHeader *hdr = reinterpret_cast<FrameStreamHeader *>(buf.data());
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, "PHDF", 4);
+    hdr->headerSize = sizeof(FrameStreamHeader);
+    hdr->payloadSize = payload;
+    hdr->frameNumber = img->FrameNum;
+    hdr->x = r.x;
+    hdr->y = r.y;
+    hdr->width = w;
+    hdr->height = h;
+    hdr->binning = binning;
+    hdr->fullWidth = img->Size.x;
+    hdr->fullHeight = img->Size.y;
+    if (!img->Subframe.IsEmpty())
+    {
+        hdr->flags |= FRAME_SUBFRAME;
+        hdr->subX = img->Subframe.x;
+        hdr->subY = img->Subframe.y;
+        hdr->subWidth = img->Subframe.width;
+        hdr->subHeight = img->Subframe.height;
+    }
+    hdr->exposureMs = img->ImgExpDur;
+    if (img->ImgStartTime.IsValid())
+        hdr->exposureStart = img->ImgStartTime.GetValue().ToDouble() / 1000.0;
+    hdr->sent = ::wxGetUTCTimeMillis().ToDouble() / 1000.0;
+    hdr->starX = star.IsValid() ? star.X : -1.f;
+    hdr->starY = star.IsValid() ? star.Y : -1.f;
+    hdr->lockX = lock.IsValid() ? lock.X : -1.f;
+    hdr->lockY = lock.IsValid() ? lock.Y : -1.f;
+
+    unsigned short *dst = reinterpret_cast<unsigned short *>(buf.data() + sizeof(FrameStreamHeader));
+
+    if (binning == 1)
+    {
+        for (int y = 0; y < h; y++)
+            memcpy(dst + (size_t) y * w, &img->Pixel(r.x, r.y + y), w * sizeof(unsigned short));
+    }
+    else
+    {
+        const unsigned int n = binning * binning;
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                unsigned int sum = 0;
+                for (int j = 0; j < binning; j++)
+                {
+                    const unsigned short *src = &img->Pixel(r.x + x * binning, r.y + y * binning + j);
+                    for (int i = 0; i < binning; i++)
+                        sum += src[i];
+                }
+                *dst++ = (unsigned short) (sum / n);
+            }
+        }
+    }
+
+    return buf;
+}
+
+void EventServer::NotifyFrame(const usImage *img, const PHD_Point& star, const PHD_Point& lock)
+{
+    if (m_eventServerClients.empty() || !img->ImageData)
+        return;
+
+    struct Built
+    {
+        wxRect r;
+        int binning;
+        wxCharBuffer buf;
+    };
+    std::vector<Built> built;
+
+    for (CliSockSet::const_iterator it = m_eventServerClients.begin(); it != m_eventServerClients.end(); ++it)
+    {
+        ClientData *cd = client_data(*it);
+        if (!cd->streaming)
+            continue;
+
+        {
+            // skip the frame without building it if the client is still
+            // receiving the previous one
+            wxMutexLocker guard(cd->wrlock);
+            if (cd->stats.bytes - cd->outbytes < cd->frameEnd)
+            {
+                ++cd->framesSkipped;
+                continue;
+            }
+        }
+
+        wxRect r = stream_rect(img, cd);
+
+        size_t i;
+        for (i = 0; i < built.size(); i++)
+            if (built[i].r == r && built[i].binning == cd->streamBinning)
+                break;
+        if (i == built.size())
+        {
+            Built b;
+            b.r = r;
+            b.binning = cd->streamBinning;
+            b.buf = frame_message(img, r, cd->streamBinning, star, lock);
+            built.push_back(b);
+        }
+
+        send_buf(*it, built[i].buf, SEND_FRAME);
+    }
 }
 
 void EventServer::NotifyLoopingStopped()
 {
-    SIMPLE_NOTIFY("LoopingExposuresStopped");
+    SIMPLE_NOTIFY(EVT_LOOPING_EXPOSURES_STOPPED);
 }
 
 void EventServer::NotifyStarSelected(const PHD_Point& pt)
 {
-    SIMPLE_NOTIFY_EV(ev_star_selected(pt));
+    SIMPLE_NOTIFY_EV(EVT_STAR_SELECTED, ev_star_selected(pt));
 }
 
 void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_STAR_LOST))
         return;
 
     Ev ev("StarLost");
@@ -2823,32 +3588,32 @@ void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
     if (!info.status.IsEmpty())
         ev << NV("Status", info.status);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_STAR_LOST, ev);
 }
 
 void EventServer::NotifyGuidingStarted()
 {
-    SIMPLE_NOTIFY_EV(ev_start_guiding());
+    SIMPLE_NOTIFY_EV(EVT_START_GUIDING, ev_start_guiding());
 }
 
 void EventServer::NotifyGuidingStopped()
 {
-    SIMPLE_NOTIFY("GuidingStopped");
+    SIMPLE_NOTIFY(EVT_GUIDING_STOPPED);
 }
 
 void EventServer::NotifyPaused()
 {
-    SIMPLE_NOTIFY_EV(ev_paused());
+    SIMPLE_NOTIFY_EV(EVT_PAUSED, ev_paused());
 }
 
 void EventServer::NotifyResumed()
 {
-    SIMPLE_NOTIFY("Resumed");
+    SIMPLE_NOTIFY(EVT_RESUMED);
 }
 
 void EventServer::NotifyGuideStep(const GuideStepInfo& step)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_GUIDE_STEP))
         return;
 
     Ev ev("GuideStep");
@@ -2887,78 +3652,78 @@ void EventServer::NotifyGuideStep(const GuideStepInfo& step)
     if (step.decLimited)
         ev << NV("DecLimited", true);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_GUIDE_STEP, ev);
 }
 
 void EventServer::NotifyGuidingDithered(double dx, double dy)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_GUIDING_DITHERED))
         return;
 
     Ev ev("GuidingDithered");
     ev << NV("dx", dx, 3) << NV("dy", dy, 3);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_GUIDING_DITHERED, ev);
 }
 
 void EventServer::NotifySetLockPosition(const PHD_Point& xy)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_LOCK_POSITION_SET))
         return;
 
-    do_notify(m_eventServerClients, ev_set_lock_position(xy));
+    do_notify(m_eventServerClients, EVT_LOCK_POSITION_SET, ev_set_lock_position(xy));
 }
 
 void EventServer::NotifyLockPositionLost()
 {
-    SIMPLE_NOTIFY("LockPositionLost");
+    SIMPLE_NOTIFY(EVT_LOCK_POSITION_LOST);
 }
 
 void EventServer::NotifyLockShiftLimitReached()
 {
-    SIMPLE_NOTIFY("LockPositionShiftLimitReached");
+    SIMPLE_NOTIFY(EVT_LOCK_POSITION_SHIFT_LIMIT_REACHED);
 }
 
 void EventServer::NotifyAppState()
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_APP_STATE))
         return;
 
-    do_notify(m_eventServerClients, ev_app_state());
+    do_notify(m_eventServerClients, EVT_APP_STATE, ev_app_state());
 }
 
 void EventServer::NotifySettleBegin()
 {
-    SIMPLE_NOTIFY("SettleBegin");
+    SIMPLE_NOTIFY(EVT_SETTLE_BEGIN);
 }
 
 void EventServer::NotifySettling(double distance, double time, double settleTime, bool starLocked)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_SETTLING))
         return;
 
     Ev ev(ev_settling(distance, time, settleTime, starLocked));
 
     Debug.Write(wxString::Format("evsrv: %s\n", ev.str()));
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_SETTLING, ev);
 }
 
 void EventServer::NotifySettleDone(const wxString& errorMsg, int settleFrames, int droppedFrames)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_SETTLE_DONE))
         return;
 
     Ev ev(ev_settle_done(errorMsg, settleFrames, droppedFrames));
 
     Debug.Write(wxString::Format("evsrv: %s\n", ev.str()));
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_SETTLE_DONE, ev);
 }
 
 void EventServer::NotifyAlert(const wxString& msg, int type)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, EVT_ALERT))
         return;
 
     Ev ev("Alert");
@@ -2984,20 +3749,20 @@ void EventServer::NotifyAlert(const wxString& msg, int type)
     }
     ev << NV("Type", s);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_ALERT, ev);
 }
 
 template<typename T>
 static void NotifyGuidingParam(const EventServer::CliSockSet& clients, const wxString& name, T val)
 {
-    if (clients.empty())
+    if (!any_client_wants(clients, EVT_GUIDE_PARAM_CHANGE))
         return;
 
     Ev ev("GuideParamChange");
     ev << NV("Name", name);
     ev << NV("Value", val);
 
-    do_notify(clients, ev);
+    do_notify(clients, EVT_GUIDE_PARAM_CHANGE, ev);
 }
 
 void EventServer::NotifyGuidingParam(const wxString& name, double val)
@@ -3025,7 +3790,10 @@ void EventServer::NotifyConfigurationChange()
     if (m_configEventDebouncer == nullptr || m_configEventDebouncer->IsRunning())
         return;
 
+    if (!any_client_wants(m_eventServerClients, EVT_CONFIGURATION_CHANGE))
+        return;
+
     Ev ev("ConfigurationChange");
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, EVT_CONFIGURATION_CHANGE, ev);
     m_configEventDebouncer->StartOnce(0);
 }
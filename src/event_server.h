@@ -61,6 +61,7 @@ public:
     void NotifyCalibrationComplete(const Mount *mount);
     void NotifyCalibrationDataFlipped(const Mount *mount);
     void NotifyLooping(unsigned int exposure, const Star *star, const FrameDroppedInfo *info);
+    void NotifyFrame(const usImage *img, const PHD_Point& star, const PHD_Point& lock);
     void NotifyLoopingStopped();
     void NotifyStarSelected(const PHD_Point& pos);
     void NotifyStarLost(const FrameDroppedInfo& info);
@@ -88,6 +89,12 @@ private:
     void OnEventServerEvent(wxSocketEvent& evt);
     void OnEventServerClientEvent(wxSocketEvent& evt);
 
+public:
+    // drop a client whose output backlog overflowed; queued by send_buf
+    void DisconnectClient(wxSocketClient *cli);
+
+private:
+
     wxDECLARE_EVENT_TABLE();
 };
 
@@ -0,0 +1,174 @@
+/*
+ *  fits_blob.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "fits_blob.h"
+#include "image_kernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    FITS_BLOCK = 2880,
+    FITS_CARD = 80,
+};
+
+// value of a header card as a number; false if the card has no numeric value
+static bool CardNumber(const char *card, double *val)
+{
+    if (card[8] != '=' || card[9] != ' ')
+        return false;
+
+    char buf[FITS_CARD - 10 + 1];
+    memcpy(buf, card + 10, FITS_CARD - 10);
+    buf[FITS_CARD - 10] = 0;
+
+    char *end;
+    *val = strtod(buf, &end);
+    if (end == buf)
+        return false;
+    while (*end == ' ')
+        ++end;
+    return *end == 0 || *end == '/';
+}
+
+static bool CardIs(const char *card, const char *keyword)
+{
+    size_t len = strlen(keyword);
+    if (memcmp(card, keyword, len) != 0)
+        return false;
+    for (size_t i = len; i < 8; i++)
+        if (card[i] != ' ')
+            return false;
+    return true;
+}
+
+bool ParseFitsBlob(FitsBlobImage *img, const void *blob, size_t size)
+{
+    const char *p = static_cast<const char *>(blob);
+
+    if (size < FITS_BLOCK || !CardIs(p, "SIMPLE"))
+        return false;
+
+    if (p[8] != '=' || p[29] != 'T')
+        return false;
+
+    int bitpix = 0, naxis = -1;
+    double naxis1 = 0, naxis2 = 0;
+    double bzero = 0.0, bscale = 1.0;
+    size_t hdrlen = 0;
+
+    for (size_t pos = FITS_CARD; pos + FITS_CARD <= size; pos += FITS_CARD)
+    {
+        const char *card = p + pos;
+        double val;
+
+        if (CardIs(card, "END"))
+        {
+            hdrlen = (pos + FITS_CARD + FITS_BLOCK - 1) / FITS_BLOCK * FITS_BLOCK;
+            break;
+        }
+        else if (CardIs(card, "BITPIX"))
+        {
+            if (!CardNumber(card, &val))
+                return false;
+            bitpix = (int) val;
+        }
+        else if (CardIs(card, "NAXIS"))
+        {
+            if (!CardNumber(card, &val))
+                return false;
+            naxis = (int) val;
+        }
+        else if (CardIs(card, "NAXIS1"))
+        {
+            if (!CardNumber(card, &naxis1))
+                return false;
+        }
+        else if (CardIs(card, "NAXIS2"))
+        {
+            if (!CardNumber(card, &naxis2))
+                return false;
+        }
+        else if (CardIs(card, "BZERO"))
+        {
+            if (!CardNumber(card, &bzero))
+                return false;
+        }
+        else if (CardIs(card, "BSCALE"))
+        {
+            if (!CardNumber(card, &bscale))
+                return false;
+        }
+    }
+
+    if (!hdrlen || naxis != 2 || naxis1 < 1 || naxis2 < 1 || naxis1 > 65535 || naxis2 > 65535 || bscale != 1.0)
+        return false;
+
+    unsigned short flip;
+    if (bitpix == 8 && bzero == 0.0)
+        flip = 0;
+    else if (bitpix == 16 && bzero == 32768.0)
+        flip = 0x8000;
+    else
+        return false;
+
+    size_t const datalen = (size_t) naxis1 * (size_t) naxis2 * (size_t) (bitpix / 8);
+    size_t const padded = (datalen + FITS_BLOCK - 1) / FITS_BLOCK * FITS_BLOCK;
+
+    // the data must be complete, and anything after it would be an extension
+    if (size < hdrlen + datalen || size > hdrlen + padded)
+        return false;
+
+    img->bitpix = bitpix;
+    img->width = (int) naxis1;
+    img->height = (int) naxis2;
+    img->flip = flip;
+    img->data = reinterpret_cast<const unsigned char *>(p) + hdrlen;
+
+    return true;
+}
+
+void DecodeFitsBlob(unsigned short *dst, int dstRowsize, const FitsBlobImage& img, int width, int height, SimdLevel simd)
+{
+    size_t const srcRowBytes = (size_t) img.width * (img.bitpix / 8);
+    const unsigned char *src = img.data;
+
+    for (int y = 0; y < height; y++, dst += dstRowsize, src += srcRowBytes)
+    {
+        if (img.bitpix == 16)
+            ConvertBigEndian16(dst, src, width, img.flip, simd);
+        else
+            WidenBytes(dst, src, width, simd);
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ *  fits_blob.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FITS_BLOB_INCLUDED
+#define FITS_BLOB_INCLUDED
+
+#include "cpu_features.h"
+
+#include <stddef.h>
+
+// Direct decoding of the FITS images that INDI camera drivers send as BLOBs.
+// Only plain single-HDU 2D images with 8-bit data or 16-bit data stored with
+// BZERO = 32768 are handled -- what the drivers send in practice. Anything
+// else is left to CFITSIO.
+
+struct FitsBlobImage
+{
+    int bitpix; // 8 or 16
+    int width; // NAXIS1
+    int height; // NAXIS2
+    unsigned short flip; // 0x8000 for 16-bit data with BZERO = 32768
+    const unsigned char *data; // first pixel
+};
+
+// Parse the primary header of a FITS file held in memory. Returns false if
+// the file is not one this parser handles: other BITPIX, BZERO or BSCALE
+// values, more than two axes, extensions, or truncated data.
+extern bool ParseFitsBlob(FitsBlobImage *img, const void *blob, size_t size);
+
+// Convert the top-left width x height pixels of the image to 16-bit values,
+// writing each row to dst + y * dstRowsize.
+extern void DecodeFitsBlob(unsigned short *dst, int dstRowsize, const FitsBlobImage& img, int width, int height,
+                           SimdLevel simd);
+
+#endif
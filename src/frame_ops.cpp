@@ -0,0 +1,601 @@
+/*
+ *  frame_ops.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "frame_ops.h"
+#include "frame_pool.h"
+#include "image_kernels.h"
+#include "median_kernels.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+inline static void swap(unsigned short& a, unsigned short& b)
+{
+    unsigned short const t = a;
+    a = b;
+    b = t;
+}
+
+inline static unsigned short median8(const unsigned short l[8])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
+    unsigned short x;
+
+    x = l[5];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[6];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[7];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+
+    if (l2 > l0)
+        swap(l2, l0);
+    if (l2 > l1)
+        swap(l2, l1);
+
+    if (l3 > l0)
+        swap(l3, l0);
+    if (l3 > l1)
+        swap(l3, l1);
+
+    if (l4 > l0)
+        swap(l4, l0);
+    if (l4 > l1)
+        swap(l4, l1);
+
+    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline static unsigned short median6(const unsigned short l[6])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
+    unsigned short x;
+
+    x = l[4];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    x = l[5];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+
+    if (l2 > l0)
+        swap(l2, l0);
+    if (l2 > l1)
+        swap(l2, l1);
+
+    if (l3 > l0)
+        swap(l3, l0);
+    if (l3 > l1)
+        swap(l3, l1);
+
+    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline static unsigned short median5(const unsigned short l[5])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    unsigned short x;
+    x = l[3];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    x = l[4];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+
+    if (l1 > l0)
+        l0 = l1;
+    if (l2 > l0)
+        l0 = l2;
+
+    return l0;
+}
+
+inline static unsigned short median4(const unsigned short l[4])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    unsigned short x;
+    x = l[3];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+
+    if (l2 > l0)
+        swap(l2, l0);
+    if (l2 > l1)
+        swap(l2, l1);
+
+    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline static unsigned short median3(const unsigned short l[3])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    if (l2 < l0)
+        swap(l2, l0);
+    if (l2 < l1)
+        swap(l2, l1);
+    if (l1 > l0)
+        l0 = l1;
+    return l0;
+}
+
+void Median3FilterRow(unsigned short *dst, const unsigned short *src, int rowsize, const FrameRect& rect, int y)
+{
+    int const W = rowsize;
+    int const RX = rect.x;
+    int const RY = rect.y;
+    int const RW = rect.width;
+    int const RH = rect.height;
+
+    unsigned short a[9];
+    unsigned short *d = dst;
+
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+
+    if (y == 0 || y == RH - 1)
+    {
+        // top or bottom row: two rows of neighbors
+        int const y0 = y == 0 ? 0 : RH - 2;
+        int const y1 = y0 + 1;
+
+        // corner
+        a[0] = src[IX(0, y0)];
+        a[1] = src[IX(1, y0)];
+        a[2] = src[IX(0, y1)];
+        a[3] = src[IX(1, y1)];
+        *d++ = median4(a);
+
+        // middle pixels
+        for (int x = 1; x <= RW - 2; x++)
+        {
+            a[0] = src[IX(x - 1, y0)];
+            a[1] = src[IX(x, y0)];
+            a[2] = src[IX(x + 1, y0)];
+            a[3] = src[IX(x - 1, y1)];
+            a[4] = src[IX(x, y1)];
+            a[5] = src[IX(x + 1, y1)];
+            *d++ = median6(a);
+        }
+
+        // corner
+        a[0] = src[IX(RW - 2, y0)];
+        a[1] = src[IX(RW - 1, y0)];
+        a[2] = src[IX(RW - 2, y1)];
+        a[3] = src[IX(RW - 1, y1)];
+        *d = median4(a);
+
+        return;
+    }
+
+    // leftmost pixel
+    a[0] = src[IX(0, y - 1)];
+    a[1] = src[IX(1, y - 1)];
+    a[2] = src[IX(0, y)];
+    a[3] = src[IX(1, y)];
+    a[4] = src[IX(0, y + 1)];
+    a[5] = src[IX(1, y + 1)];
+    *d = median6(a);
+
+    // interior pixels
+    Median3Interior(dst, &src[IX(0, y - 1)], &src[IX(0, y)], &src[IX(0, y + 1)], RW, CpuSimdLevel());
+    d = dst + RW - 1;
+
+    // rightmost pixel
+    a[0] = src[IX(RW - 2, y - 1)];
+    a[1] = src[IX(RW - 1, y - 1)];
+    a[2] = src[IX(RW - 2, y)];
+    a[3] = src[IX(RW - 1, y)];
+    a[4] = src[IX(RW - 2, y + 1)];
+    a[5] = src[IX(RW - 1, y + 1)];
+    *d = median6(a);
+
+#undef IX
+}
+
+// Scratch space for CalcFrameStats: a histogram and a filtered-row buffer for
+// each band of rows. The histograms are returned to all-zero after each use,
+// so only the range of values actually seen has to be cleared.
+struct StatsScratch
+{
+    std::mutex lock;
+    std::vector<unsigned int> histo;
+    std::vector<unsigned short> filtered;
+};
+
+static StatsScratch& GetStatsScratch()
+{
+    static StatsScratch s_scratch;
+    return s_scratch;
+}
+
+struct BandStats
+{
+    unsigned short minADU, maxADU;
+    unsigned short filtMin, filtMax;
+};
+
+void CalcFrameStats(FrameStats *stats, const ConstFrameView& img)
+{
+    // Min, max and median come from a histogram of the frame or subframe;
+    // FiltMin and FiltMax are the extremes of the 3x3 median filtered image.
+    // Everything is computed in one pass over the rows: each row is added to
+    // the histogram and then median filtered together with its neighbors
+    // into a one-row buffer, so no image-sized temporaries are needed.
+
+    FrameRect const rect = img.ValidRect();
+    FrameRect const drect = { rect.x - img.dataRect.x, rect.y - img.dataRect.y, rect.width, rect.height };
+    int const RW = rect.width;
+    int const RH = rect.height;
+
+    enum
+    {
+        HISTO_SIZE = 65536,
+        MIN_BAND_PIXELS = 256 * 1024,
+        MAX_BANDS = 64,
+    };
+
+    BandStats bands[MAX_BANDS];
+    int nbands = std::min((int) ParallelThreadCount(), RW * RH / MIN_BAND_PIXELS);
+    nbands = std::max(1, std::min(nbands, std::min(RH, (int) MAX_BANDS)));
+
+    StatsScratch& scratch = GetStatsScratch();
+    std::lock_guard<std::mutex> lock(scratch.lock);
+
+    if (scratch.histo.size() < (size_t) nbands * HISTO_SIZE)
+        scratch.histo.resize((size_t) nbands * HISTO_SIZE); // zero-filled
+    if (scratch.filtered.size() < (size_t) nbands * RW)
+        scratch.filtered.resize((size_t) nbands * RW);
+
+    // the median filter needs at least 2x2 pixels
+    bool const filter = RW >= 2 && RH >= 2;
+
+    ParallelFor(nbands, [&](int band) {
+        int const y0 = band * RH / nbands;
+        int const y1 = (band + 1) * RH / nbands;
+        unsigned int *const histo = &scratch.histo[(size_t) band * HISTO_SIZE];
+        unsigned short *const filt = &scratch.filtered[(size_t) band * RW];
+
+        unsigned short lo = 65535, hi = 0, flo = 65535, fhi = 0;
+
+        for (int y = y0; y < y1; y++)
+        {
+            const unsigned short *const row = &img.Pixel(rect.x, rect.y + y);
+            for (int x = 0; x < RW; x++)
+            {
+                unsigned short const v = row[x];
+                ++histo[v];
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+            }
+
+            if (filter)
+            {
+                Median3FilterRow(filt, img.data, img.RowStride(), drect, y);
+                for (int x = 0; x < RW; x++)
+                {
+                    flo = std::min(flo, filt[x]);
+                    fhi = std::max(fhi, filt[x]);
+                }
+            }
+        }
+
+        if (!filter)
+        {
+            flo = lo;
+            fhi = hi;
+        }
+
+        BandStats& bs = bands[band];
+        bs.minADU = lo;
+        bs.maxADU = hi;
+        bs.filtMin = flo;
+        bs.filtMax = fhi;
+    });
+
+    stats->minADU = 65535;
+    stats->maxADU = 0;
+    stats->filtMin = 65535;
+    stats->filtMax = 0;
+
+    for (int band = 0; band < nbands; band++)
+    {
+        stats->minADU = std::min(stats->minADU, bands[band].minADU);
+        stats->maxADU = std::max(stats->maxADU, bands[band].maxADU);
+        stats->filtMin = std::min(stats->filtMin, bands[band].filtMin);
+        stats->filtMax = std::max(stats->filtMax, bands[band].filtMax);
+    }
+
+    // median: walk the combined histogram
+    int pixelLeft = RW * RH / 2;
+    stats->medianADU = stats->maxADU;
+    for (int i = stats->minADU; i < stats->maxADU; i++)
+    {
+        unsigned int cnt = 0;
+        for (int band = 0; band < nbands; band++)
+            cnt += scratch.histo[(size_t) band * HISTO_SIZE + i];
+        if ((int) cnt > pixelLeft)
+        {
+            stats->medianADU = i;
+            break;
+        }
+        pixelLeft -= cnt;
+    }
+
+    // leave the histograms zeroed for the next call
+    for (int band = 0; band < nbands; band++)
+    {
+        unsigned int *histo = &scratch.histo[(size_t) band * HISTO_SIZE];
+        std::fill(histo + bands[band].minADU, histo + bands[band].maxADU + 1, 0);
+    }
+}
+
+// Dark subtraction algorithm:
+//     Pedestal = max(median(dark_frame) - median(light_frame), 0) - handles overall gain/gradient differences
+//     Dark_corrected(i) = min(max(light(i) + pedestal - dark(i), 0), 65335)
+void SubtractDarkFrame(const FrameView& light, unsigned short lightMedian, const ConstFrameView& dark,
+                       unsigned short darkMedian, unsigned short *pedestal)
+{
+    FrameRect const rect = light.ValidRect();
+
+    if (!light.subframe.IsEmpty())
+    {
+        // compute the dark's median ADU within the subframe region
+        unsigned int pixcnt = rect.width * rect.height;
+        FramePoolBuffer<unsigned short> buf(pixcnt);
+        unsigned short *tmp = buf.get();
+        const unsigned short *src = &dark.Pixel(rect.x, rect.y);
+        unsigned short *dst = tmp;
+        for (int y = 0; y < rect.height; y++)
+        {
+            memcpy(dst, src, rect.width * sizeof(unsigned short));
+            src += dark.RowStride();
+            dst += rect.width;
+        }
+        std::nth_element(tmp, tmp + pixcnt / 2, tmp + pixcnt);
+        darkMedian = tmp[pixcnt / 2];
+    }
+
+    if (darkMedian > lightMedian)
+    {
+        // dark was brighter than light
+        *pedestal = darkMedian - lightMedian; // Needed for saturation detection in find-star
+    }
+
+    SubtractDarkRect(&light.Pixel(rect.x, rect.y), light.RowStride(), &dark.Pixel(rect.x, rect.y), dark.RowStride(),
+                     rect.width, rect.height, *pedestal);
+}
+
+// neighbors of a defect for each DefectIndex stencil, following the edge and
+// corner cases of the original per-defect code
+static const struct
+{
+    int count;
+    signed char dx[8];
+    signed char dy[8];
+} s_stencils[DefectIndex::STENCIL_COUNT] = {
+    { 8, { -1, 0, 1, -1, 1, -1, 0, 1 }, { -1, -1, -1, 0, 0, 1, 1, 1 } }, // interior
+    { 5, { 0, 0, 1, 1, 1 }, { -1, 1, -1, 0, 1 } }, // left edge
+    { 5, { 0, 0, -1, -1, -1 }, { -1, 1, -1, 0, 1 } }, // right edge
+    { 5, { -1, -1, 0, 1, 1 }, { 0, 1, 1, 0, 1 } }, // first row
+    { 5, { -1, -1, 0, 1, 1 }, { 0, -1, -1, 0, -1 } }, // last row
+    { 3, { 1, 0, 1 }, { 0, 1, 1 } }, // first row, left corner
+    { 3, { 1, 0, 1 }, { 0, -1, -1 } }, // last row, left corner
+    { 3, { -1, 0, -1 }, { 0, -1, -1 } }, // last row, right corner
+    { 3, { -1, 0, -1 }, { 0, 1, 1 } }, // first row, right corner
+};
+
+// neighbor offsets of each stencil for images with the given row stride
+static void StencilOffsets(DefectIndex::Stencil *stencils, int rowsize)
+{
+    for (int i = 0; i < DefectIndex::STENCIL_COUNT; i++)
+    {
+        DefectIndex::Stencil& st = stencils[i];
+        st.count = s_stencils[i].count;
+        for (int j = 0; j < st.count; j++)
+            st.offset[j] = s_stencils[i].dy[j] * rowsize + s_stencils[i].dx[j];
+    }
+}
+
+static int StencilFor(int x, int y, int xsize, int ysize)
+{
+    bool const left = x == 0, right = x == xsize - 1;
+    bool const top = y == 0, bottom = y == ysize - 1;
+
+    if (!left && !right && !top && !bottom)
+        return 0;
+    if (!top && !bottom)
+        return left ? 1 : 2;
+    if (!left && !right)
+        return top ? 3 : 4;
+    if (left)
+        return top ? 5 : 6;
+    return bottom ? 7 : 8;
+}
+
+void BuildDefectIndex(DefectIndex *index, int width, int height, const DefectPoint *pts, size_t count)
+{
+    index->frameWidth = width;
+    index->frameHeight = height;
+    index->entries.clear();
+    index->rowStart.assign(height + 1, 0);
+
+    StencilOffsets(index->stencils, width);
+
+    // a frame needs two rows and columns for every defect to have neighbors
+    if (width < 2 || height < 2)
+        return;
+
+    // sort the defects inside the frame by position, dropping duplicates
+    std::vector<DefectPoint> sorted;
+    sorted.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (pts[i].x >= 0 && pts[i].x < width && pts[i].y >= 0 && pts[i].y < height)
+            sorted.push_back(pts[i]);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const DefectPoint& a, const DefectPoint& b) { return a.y < b.y || (a.y == b.y && a.x < b.x); });
+    sorted.erase(std::unique(sorted.begin(), sorted.end(),
+                             [](const DefectPoint& a, const DefectPoint& b) { return a.x == b.x && a.y == b.y; }),
+                 sorted.end());
+
+    index->entries.resize(sorted.size());
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        index->entries[i].x = sorted[i].x;
+        index->entries[i].stencil = StencilFor(sorted[i].x, sorted[i].y, width, height);
+        ++index->rowStart[sorted[i].y + 1];
+    }
+    for (int y = 0; y < height; y++)
+        index->rowStart[y + 1] += index->rowStart[y];
+}
+
+
+void RemoveFrameDefects(const FrameView& light, const DefectIndex& index)
+{
+    if (index.entries.empty())
+        return;
+
+    // only the defects inside the subframe are visited
+    FrameRect const valid = light.ValidRect();
+    int const left = std::max(valid.x, 0);
+    int const top = std::max(valid.y, 0);
+    int const right = std::min(valid.Right(), light.width - 1);
+    int const bottom = std::min(valid.Bottom(), light.height - 1);
+
+    // a compact image has no pixels outside its subframe, so there the
+    // neighbors of a defect are chosen by its position in the subframe
+    bool const compact = light.IsCompact();
+    const FrameRect& data = light.dataRect;
+    DefectIndex::Stencil compactStencils[DefectIndex::STENCIL_COUNT];
+    if (compact)
+    {
+        if (data.width < 2 || data.height < 2)
+            return;
+        StencilOffsets(compactStencils, light.RowStride());
+    }
+
+    // Step over each defect and replace the light value
+    // with the median of the surrounding pixels
+    for (int y = top; y <= bottom; y++)
+    {
+        const DefectIndex::Entry *first = &index.entries[0] + index.rowStart[y];
+        const DefectIndex::Entry *const last = &index.entries[0] + index.rowStart[y + 1];
+        if (first == last)
+            continue;
+
+        if (left > 0)
+            first = std::lower_bound(first, last, left, [](const DefectIndex::Entry& e, int x) { return e.x < x; });
+
+        for (; first != last && first->x <= right; ++first)
+        {
+            unsigned short *const p = &light.Pixel(first->x, y);
+            const DefectIndex::Stencil& st = compact ?
+                compactStencils[StencilFor(first->x - data.x, y - data.y, data.width, data.height)] :
+                index.stencils[first->stencil];
+
+            unsigned short array[8];
+            for (int i = 0; i < st.count; i++)
+                array[i] = p[st.offset[i]];
+
+            *p = st.count == 8 ? median8(array) : st.count == 5 ? median5(array) : median3(array);
+        }
+    }
+}
+
+void FullFrameRow(unsigned short *dst, const ConstFrameView& img, int y)
+{
+    const FrameRect& data = img.dataRect;
+
+    if (y < data.y || y > data.Bottom())
+    {
+        memset(dst, 0, img.width * sizeof(unsigned short));
+        return;
+    }
+
+    memset(dst, 0, data.x * sizeof(unsigned short));
+    memcpy(dst + data.x, &img.Pixel(data.x, y), data.width * sizeof(unsigned short));
+    memset(dst + data.x + data.width, 0, (img.width - data.x - data.width) * sizeof(unsigned short));
+}
@@ -0,0 +1,123 @@
+/*
+ *  frame_ops.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FRAME_OPS_INCLUDED
+#define FRAME_OPS_INCLUDED
+
+#include "frame_view.h"
+
+#include <cstddef>
+#include <vector>
+
+// Whole-frame operations behind usImage::CalcStats, Subtract, RemoveDefects
+// and the full-frame layout of usImage::Expand and usImage::Save, without
+// wxWidgets. All of them take compact and full-size images alike.
+
+// One row of the 3x3 median filtered rectangle rect of the image data src
+// (data coordinates, rows rowsize pixels apart): dst[x] for x = 0 ..
+// rect.width - 1 is the median of the neighbors of pixel (rect.x + x, rect.y
+// + y) that lie inside rect. rect must be at least 2x2.
+extern void Median3FilterRow(unsigned short *dst, const unsigned short *src, int rowsize, const FrameRect& rect, int y);
+
+struct FrameStats
+{
+    unsigned short minADU;
+    unsigned short maxADU;
+    unsigned short medianADU;
+    unsigned short filtMin; // extremes of the 3x3 median filtered valid rect
+    unsigned short filtMax;
+};
+
+// Statistics of the valid rect of img
+extern void CalcFrameStats(FrameStats *stats, const ConstFrameView& img);
+
+// Subtract dark from the valid rect of light, which must be the same image
+// size. lightMedian is the median of the valid rect of light and darkMedian
+// the median of the whole dark; when light has a subframe the dark's median
+// over the subframe is used instead. *pedestal is raised to the amount the
+// dark is brighter than the light, and added back to every pixel.
+extern void SubtractDarkFrame(const FrameView& light, unsigned short lightMedian, const ConstFrameView& dark,
+                              unsigned short darkMedian, unsigned short *pedestal);
+
+// The defects of a DefectMap sorted by row, with the neighbors used to
+// replace each one, for applying the map to frames of one size
+struct DefectIndex
+{
+    enum
+    {
+        STENCIL_COUNT = 9,
+    };
+
+    struct Entry
+    {
+        int x;
+        int stencil;
+    };
+
+    struct Stencil
+    {
+        int count; // 8 (interior), 5 (edge) or 3 (corner)
+        int offset[8]; // of the neighbors, relative to the defect
+    };
+
+    int frameWidth;
+    int frameHeight;
+    size_t defectCount; // size of the DefectMap the index was built from
+    std::vector<Entry> entries; // sorted by row, then x
+    std::vector<unsigned int> rowStart; // row y is entries [rowStart[y], rowStart[y + 1])
+    Stencil stencils[STENCIL_COUNT];
+
+    DefectIndex() : frameWidth(0), frameHeight(0), defectCount(0) { }
+};
+
+struct DefectPoint
+{
+    int x;
+    int y;
+};
+
+// Index the count defects at pts for frames of width x height. Defects
+// outside the frame and duplicates are dropped. defectCount is left to the
+// caller.
+extern void BuildDefectIndex(DefectIndex *index, int width, int height, const DefectPoint *pts, size_t count);
+
+// Replace each defect inside the valid rect of light by the median of its
+// neighbors. index must have been built for the image size of light. The
+// neighbors of a defect in a compact image are chosen by its position in the
+// subframe, as the image has no pixels outside it.
+extern void RemoveFrameDefects(const FrameView& light, const DefectIndex& index);
+
+// Row y of img as a full-width row, zero outside dataRect
+extern void FullFrameRow(unsigned short *dst, const ConstFrameView& img, int y);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ *  frame_pool.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "frame_pool.h"
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+// Each buffer is preceded by a header recording its bucket, so the size does
+// not have to be passed back to FramePoolFree. The header size keeps the
+// buffer as aligned as the underlying allocation.
+struct BufHeader
+{
+    size_t bucket; // 0 for buffers that bypass the pool
+};
+
+enum
+{
+    HEADER_BYTES = 64,
+    MAX_IDLE_PER_BUCKET = 16, // enough for a per-thread scratch buffer on most machines
+};
+
+static const size_t MAX_IDLE_BYTES = 512 * 1024 * 1024;
+
+static_assert(sizeof(BufHeader) <= HEADER_BYTES, "header too large");
+
+// round up to a multiple of 1/8 of the largest power of two not above bytes
+inline size_t BucketSize(size_t bytes)
+{
+    size_t step = 1;
+    while ((step << 4) <= bytes)
+        step <<= 1;
+    return (bytes + step - 1) & ~(step - 1);
+}
+
+inline void *Payload(BufHeader *hdr)
+{
+    return reinterpret_cast<char *>(hdr) + HEADER_BYTES;
+}
+
+inline BufHeader *Header(void *buf)
+{
+    return reinterpret_cast<BufHeader *>(static_cast<char *>(buf) - HEADER_BYTES);
+}
+
+class Pool
+{
+    std::mutex m_lock; // protects the fields below
+    std::map<size_t, std::vector<BufHeader *>> m_idle;
+    FramePoolStats m_stats;
+
+public:
+    Pool() : m_stats() { }
+
+    void *Alloc(size_t bytes)
+    {
+        if (bytes < FRAME_POOL_MIN_BYTES)
+        {
+            BufHeader *hdr = static_cast<BufHeader *>(std::malloc(HEADER_BYTES + bytes));
+            if (!hdr)
+                return nullptr;
+            hdr->bucket = 0;
+            return Payload(hdr);
+        }
+
+        size_t const bucket = BucketSize(bytes);
+
+        {
+            std::lock_guard<std::mutex> lck(m_lock);
+            auto it = m_idle.find(bucket);
+            if (it != m_idle.end() && !it->second.empty())
+            {
+                BufHeader *hdr = it->second.back();
+                it->second.pop_back();
+                m_stats.bytesIdle -= bucket;
+                ++m_stats.hits;
+                return Payload(hdr);
+            }
+            ++m_stats.misses;
+        }
+
+        BufHeader *hdr = static_cast<BufHeader *>(std::malloc(HEADER_BYTES + bucket));
+        if (!hdr)
+            return nullptr;
+        hdr->bucket = bucket;
+
+        std::lock_guard<std::mutex> lck(m_lock);
+        m_stats.bytesResident += bucket;
+        return Payload(hdr);
+    }
+
+    void Free(void *buf)
+    {
+        if (!buf)
+            return;
+
+        BufHeader *hdr = Header(buf);
+        size_t const bucket = hdr->bucket;
+
+        if (bucket)
+        {
+            std::lock_guard<std::mutex> lck(m_lock);
+            std::vector<BufHeader *>& idle = m_idle[bucket];
+            if (idle.size() < MAX_IDLE_PER_BUCKET && m_stats.bytesIdle + bucket <= MAX_IDLE_BYTES)
+            {
+                idle.push_back(hdr);
+                m_stats.bytesIdle += bucket;
+                return;
+            }
+            m_stats.bytesResident -= bucket;
+        }
+
+        std::free(hdr);
+    }
+
+    FramePoolStats Stats()
+    {
+        std::lock_guard<std::mutex> lck(m_lock);
+        return m_stats;
+    }
+
+    void Trim()
+    {
+        std::map<size_t, std::vector<BufHeader *>> idle;
+        {
+            std::lock_guard<std::mutex> lck(m_lock);
+            idle.swap(m_idle);
+            m_stats.bytesResident -= m_stats.bytesIdle;
+            m_stats.bytesIdle = 0;
+        }
+        for (auto& bucket : idle)
+            for (BufHeader *hdr : bucket.second)
+                std::free(hdr);
+    }
+};
+
+// never destroyed: buffers may be released by static objects during exit
+Pool& ThePool()
+{
+    static Pool *s_pool = new Pool();
+    return *s_pool;
+}
+
+} // namespace
+
+void *FramePoolAlloc(size_t bytes)
+{
+    return ThePool().Alloc(bytes);
+}
+
+void FramePoolFree(void *buf)
+{
+    ThePool().Free(buf);
+}
+
+FramePoolStats FramePoolGetStats()
+{
+    return ThePool().Stats();
+}
+
+void FramePoolTrim()
+{
+    ThePool().Trim();
+}
@@ -0,0 +1,94 @@
+/*
+ *  frame_pool.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FRAME_POOL_INCLUDED
+#define FRAME_POOL_INCLUDED
+
+#include <cstddef>
+
+// A thread-safe pool of frame-sized buffers, shared by usImage, FloatImg and
+// the image math temporaries. Requests are rounded up to a size bucket (eight
+// buckets per power of two, so at most 12.5% is wasted) and a released buffer
+// is kept for the next request in its bucket. Looping at a fixed frame size,
+// or alternating between a full frame and a subframe, therefore stops
+// allocating once the pool has warmed up. Requests smaller than
+// FRAME_POOL_MIN_BYTES are passed through to the heap.
+
+enum
+{
+    FRAME_POOL_MIN_BYTES = 64 * 1024,
+};
+
+struct FramePoolStats
+{
+    unsigned long long hits; // requests served from an idle buffer
+    unsigned long long misses; // requests that allocated a new buffer
+    size_t bytesResident; // pooled buffers, in use or idle
+    size_t bytesIdle; // pooled buffers waiting for reuse
+};
+
+// Returns a buffer of at least bytes bytes, or nullptr if the allocation
+// fails. The contents are undefined.
+extern void *FramePoolAlloc(size_t bytes);
+
+// Returns a buffer obtained from FramePoolAlloc to the pool; null is ignored
+extern void FramePoolFree(void *buf);
+
+template<typename T>
+T *FramePoolAlloc(size_t count)
+{
+    return static_cast<T *>(FramePoolAlloc(count * sizeof(T)));
+}
+
+// Owns a pool buffer of count elements for the lifetime of a scope
+template<typename T>
+class FramePoolBuffer
+{
+    T *m_buf;
+
+    FramePoolBuffer(const FramePoolBuffer&) = delete;
+    FramePoolBuffer& operator=(const FramePoolBuffer&) = delete;
+
+public:
+    explicit FramePoolBuffer(size_t count) : m_buf(FramePoolAlloc<T>(count)) { }
+    ~FramePoolBuffer() { FramePoolFree(m_buf); }
+    T *get() const { return m_buf; }
+    T& operator[](size_t i) const { return m_buf[i]; }
+};
+
+extern FramePoolStats FramePoolGetStats();
+
+// Release all idle buffers to the heap
+extern void FramePoolTrim();
+
+#endif
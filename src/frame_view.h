@@ -0,0 +1,110 @@
+/*
+ *  frame_view.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FRAME_VIEW_INCLUDED
+#define FRAME_VIEW_INCLUDED
+
+#include <cstdarg>
+#include <cstdio>
+
+// How the phd2core frame routines see a usImage, without wxWidgets. The image
+// is width x height pixels; the part of it held in memory is dataRect, stored
+// row by row from data with a stride of dataRect.width. For a compact image
+// dataRect is the subframe, otherwise it is the whole image. Coordinates
+// passed to the routines are image coordinates.
+
+struct FrameRect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+
+    bool IsEmpty() const { return width <= 0 || height <= 0; }
+    int Right() const { return x + width - 1; }
+    int Bottom() const { return y + height - 1; }
+};
+
+template<typename T>
+struct FrameViewT
+{
+    T *data;
+    int width;
+    int height;
+    FrameRect dataRect;
+    FrameRect subframe; // where the valid data is, or empty for the whole image
+
+    int RowStride() const { return dataRect.width; }
+    bool IsCompact() const { return dataRect.width != width || dataRect.height != height; }
+    FrameRect ValidRect() const { return subframe.IsEmpty() ? FrameRect{ 0, 0, width, height } : subframe; }
+    // x and y must be within dataRect
+    T& Pixel(int x, int y) const { return data[(y - dataRect.y) * dataRect.width + x - dataRect.x]; }
+    // a view of mutable pixels can be passed where read-only pixels are expected
+    template<typename U>
+    operator FrameViewT<const U>() const
+    {
+        FrameViewT<const U> v = { data, width, height, dataRect, subframe };
+        return v;
+    }
+};
+
+typedef FrameViewT<unsigned short> FrameView;
+typedef FrameViewT<const unsigned short> ConstFrameView;
+
+// Debug log sink for the core routines; msg is a complete line ending in a
+// newline. A null fn discards the messages.
+struct CoreLog
+{
+    void (*fn)(void *ctx, const char *msg);
+    void *ctx;
+
+    void Write(const char *fmt, ...) const
+#if defined(__GNUC__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+};
+
+inline void CoreLog::Write(const char *fmt, ...) const
+{
+    if (!fn)
+        return;
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    fn(ctx, buf);
+}
+
+#endif
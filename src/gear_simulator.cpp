@@ -786,9 +786,7 @@ static void rand_normal(double r[2])
 
 inline static unsigned short *pixel_addr(usImage& img, int x, int y)
 {
-    if (x < 0 || x >= img.Size.x)
-        return 0;
-    if (y < 0 || y >= img.Size.y)
+    if (!img.DataRect.Contains(x, y))
         return 0;
     return &img.Pixel(x, y);
 }
@@ -986,7 +984,7 @@ static void render_clouds(usImage& img, const wxRect& subframe, int exptime, int
 {
     unsigned short cloud_amt;
     unsigned short *p0 = &img.Pixel(subframe.GetLeft(), subframe.GetTop());
-    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.Size.GetWidth())
+    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.RowStride())
     {
         unsigned short *const end = p0 + subframe.GetWidth();
         for (unsigned short *p = p0; p < end; p++)
@@ -1410,7 +1408,7 @@ bool CameraSimulator::Capture(int duration, usImage& img, int options, const wxR
 static void fill_noise(usImage& img, const wxRect& subframe, int exptime, int gain, int offset)
 {
     unsigned short *p0 = &img.Pixel(subframe.GetLeft(), subframe.GetTop());
-    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.Size.GetWidth())
+    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.RowStride())
     {
         unsigned short *const end = p0 + subframe.GetWidth();
         for (unsigned short *p = p0; p < end; p++)
@@ -1465,22 +1463,17 @@ bool CameraSimulator::Capture(int duration, usImage& img, int options, const wxR
     int const gain = 30;
     int const offset = 100;
 
-    if (img.Init(FullSize))
+    // with a subframe only the subframe is allocated and rendered
+    if (usingSubframe ? img.InitCompact(FullSize, subframe) : img.Init(FullSize))
     {
         pFrame->Alert(_("Memory allocation error"));
         return true;
     }
 
-    if (usingSubframe)
-        img.Clear();
-
     fill_noise(img, subframe, exptime, gain, offset);
 
     sim.FillImage(img, subframe, exptime, gain, offset);
 
-    if (usingSubframe)
-        img.Subframe = subframe;
-
     if (options & CAPTURE_SUBTRACT_DARK)
         SubtractDark(img);
 
@@ -830,6 +830,9 @@ static void reset_trend_accums(TrendLineAccum accums[4])
 void GraphLogClientWindow::ResetData()
 {
     m_history.clear();
+    m_buckets.clear();
+    m_bucketSize = 0;
+    m_seq = 0;
     reset_trend_accums(m_trendLineAccum);
     m_noDitherDec.ClearAll();
     m_noDitherRA.ClearAll();
@@ -1037,6 +1040,121 @@ static double peak_dec(const circular_buffer<S_HISTORY>& history, unsigned int n
     return peak;
 }
 
+static void series_init(GraphBucketSeries *s, double val)
+{
+    s->first = s->last = s->lo = s->hi = val;
+    s->loPos = s->hiPos = 0;
+}
+
+static void series_add(GraphBucketSeries *s, double val, unsigned int pos)
+{
+    s->last = val;
+    if (val < s->lo)
+    {
+        s->lo = val;
+        s->loPos = pos;
+    }
+    else if (val > s->hi)
+    {
+        s->hi = val;
+        s->hiPos = pos;
+    }
+}
+
+static int signed_ra_dur(const S_HISTORY& h)
+{
+    // West corrections => Up on graph
+    return h.raDir == WEST ? -h.raDur : h.raDur;
+}
+
+static int signed_dec_dur(const S_HISTORY& h)
+{
+    // North Corrections => Up on graph
+    return h.decDir == SOUTH ? h.decDur : -h.decDur;
+}
+
+static void bucket_init(GraphBucket *b, unsigned int seq, const S_HISTORY& h)
+{
+    b->seq = seq;
+    b->count = 1;
+    series_init(&b->series[GraphBucket::RA], h.ra);
+    series_init(&b->series[GraphBucket::DEC], h.dec);
+    series_init(&b->series[GraphBucket::DX], h.dx);
+    series_init(&b->series[GraphBucket::DY], h.dy);
+    series_init(&b->series[GraphBucket::STAR_MASS], h.starMass);
+    series_init(&b->series[GraphBucket::STAR_SNR], h.starSNR);
+    b->raDurLo = b->raDurHi = signed_ra_dur(h);
+    b->decDurLo = b->decDurHi = signed_dec_dur(h);
+}
+
+static void bucket_add(GraphBucket *b, const S_HISTORY& h)
+{
+    unsigned int pos = b->count++;
+    series_add(&b->series[GraphBucket::RA], h.ra, pos);
+    series_add(&b->series[GraphBucket::DEC], h.dec, pos);
+    series_add(&b->series[GraphBucket::DX], h.dx, pos);
+    series_add(&b->series[GraphBucket::DY], h.dy, pos);
+    series_add(&b->series[GraphBucket::STAR_MASS], h.starMass, pos);
+    series_add(&b->series[GraphBucket::STAR_SNR], h.starSNR, pos);
+    int d = signed_ra_dur(h);
+    b->raDurLo = wxMin(b->raDurLo, d);
+    b->raDurHi = wxMax(b->raDurHi, d);
+    d = signed_dec_dur(h);
+    b->decDurLo = wxMin(b->decDurLo, d);
+    b->decDurHi = wxMax(b->decDurHi, d);
+}
+
+// add the history entry with sequence number seq after the last bucket
+void GraphLogClientWindow::AddToBuckets(const S_HISTORY& h, unsigned int seq)
+{
+    if (m_buckets.empty() || seq / m_bucketSize != m_buckets.back().seq / m_bucketSize)
+    {
+        m_buckets.push_back(GraphBucket());
+        bucket_init(&m_buckets.back(), seq, h);
+    }
+    else
+        bucket_add(&m_buckets.back(), h);
+}
+
+// drop the entries that have scrolled off the graph from the oldest buckets
+void GraphLogClientWindow::ClipBuckets()
+{
+    unsigned int plot_length = GetItemCount();
+    unsigned int start_seq = m_seq - plot_length;
+
+    while (!m_buckets.empty() && m_buckets.front().seq + m_buckets.front().count <= start_seq)
+        m_buckets.pop_front();
+
+    if (!m_buckets.empty() && m_buckets.front().seq < start_seq)
+    {
+        // rebuild the partly visible bucket from its remaining entries
+        GraphBucket& b = m_buckets.front();
+        unsigned int end_seq = b.seq + b.count;
+        unsigned int i = m_history.size() - plot_length;
+        bucket_init(&b, start_seq, m_history[i]);
+        for (unsigned int seq = start_seq + 1; seq < end_seq; seq++)
+            bucket_add(&b, m_history[++i]);
+    }
+}
+
+// rebuild the buckets if the number of entries per pixel column has changed
+void GraphLogClientWindow::UpdateBuckets(int width)
+{
+    unsigned int bucketSize = width > 0 ? m_length / width : m_length;
+    if (bucketSize < 1)
+        bucketSize = 1;
+    if (bucketSize == m_bucketSize)
+        return;
+
+    m_bucketSize = bucketSize;
+    m_buckets.clear();
+
+    unsigned int plot_length = GetItemCount();
+    unsigned int start_item = m_history.size() - plot_length;
+    for (unsigned int i = start_item, seq = m_seq - plot_length; i < m_history.size(); i++, seq++)
+        AddToBuckets(m_history[i], seq);
+}
+
 void GraphLogClientWindow::AppendData(const GuideStepInfo& step)
 {
     unsigned int trend_items = GetItemCount();
@@ -1068,6 +1186,13 @@ void GraphLogClientWindow::AppendData(const GuideStepInfo& step)
     S_HISTORY cur(step);
     m_history.push_front(cur);
 
+    unsigned int seq = m_seq++;
+    if (m_bucketSize)
+    {
+        AddToBuckets(cur, seq);
+        ClipBuckets();
+    }
+
     if (m_ditherStarted)
         m_ditherStarted = false;
     else if (!PhdController::IsSettling())
@@ -1108,6 +1233,8 @@ void GraphLogClientWindow::AppendData(const DitherInfo& info)
 
 void GraphLogClientWindow::RecalculateTrendLines()
 {
+    m_bucketSize = 0; // rebuild the buckets at the next repaint
+
     reset_trend_accums(m_trendLineAccum);
     unsigned int trend_items = GetItemCount();
     const int begin = m_history.size() - trend_items;
@@ -1201,44 +1328,90 @@ static wxString rms_label(double rms, double sampling)
         return wxString::Format("%4.2f", rms);
 }
 
-static int GetMaxDuration(const circular_buffer<S_HISTORY>& history, int start_item)
+static int GetMaxDuration(const std::deque<GraphBucket>& buckets)
 {
     int maxdur = 1; // always return at least 1 to protect against divide-by-zero
-    for (unsigned int i = start_item; i < history.size(); i++)
+    for (std::deque<GraphBucket>::const_iterator it = buckets.begin(); it != buckets.end(); ++it)
     {
-        const S_HISTORY& h = history[i];
-        int d = abs(h.raDur);
+        int d = wxMax(-it->raDurLo, it->raDurHi);
         if (d > maxdur)
             maxdur = d;
-        d = abs(h.decDur);
+        d = wxMax(-it->decDurLo, it->decDurHi);
         if (d > maxdur)
             maxdur = d;
     }
     return maxdur;
 }
 
-static double GetMaxStarMass(const circular_buffer<S_HISTORY>& history, int start_item)
+static double GetMaxValue(const std::deque<GraphBucket>& buckets, int series)
 {
-    double maxMass = 0.0;
-    for (unsigned int i = start_item; i < history.size(); i++)
+    double maxVal = 0.0;
+    for (std::deque<GraphBucket>::const_iterator it = buckets.begin(); it != buckets.end(); ++it)
     {
-        const S_HISTORY& h = history[i];
-        if (h.starMass > maxMass)
-            maxMass = h.starMass;
+        if (it->series[series].hi > maxVal)
+            maxVal = it->series[series].hi;
     }
-    return maxMass;
+    return maxVal;
 }
 
-static double GetMaxStarSNR(const circular_buffer<S_HISTORY>& history, int start_item)
+// draw a correction bar from the x axis to dur
+static void DrawCorrection(wxDC& dc, const ScaleAndTranslate& sctr, double x, double dur, int xoffset)
 {
-    double maxSNR = 0.0;
-    for (unsigned int i = start_item; i < history.size(); i++)
+    wxPoint pt(sctr.pt(x, dur));
+    pt.x += xoffset;
+    if (dur < 0)
+        dc.DrawRectangle(pt, wxSize(4, sctr.m_yorig - pt.y));
+    else
+        dc.DrawRectangle(wxPoint(pt.x, sctr.m_yorig), wxSize(4, pt.y - sctr.m_yorig));
+}
+
+// Fill pts with a line through the first, minimum, maximum and last entry of
+// each bucket in time order. Returns the number of points, which never
+// exceeds the number of history entries in the buckets.
+static unsigned int GetBucketLine(wxPoint *pts, const std::deque<GraphBucket>& buckets, int series, double sign,
+                                  const ScaleAndTranslate& sctr)
+{
+    unsigned int n = 0;
+    const unsigned int start_seq = buckets.front().seq;
+    for (std::deque<GraphBucket>::const_iterator it = buckets.begin(); it != buckets.end(); ++it)
+    {
+        const GraphBucketSeries& s = it->series[series];
+        const double x = it->seq - start_seq;
+        const unsigned int last = it->count - 1;
+
+        unsigned int pos1 = s.loPos, pos2 = s.hiPos;
+        double val1 = s.lo, val2 = s.hi;
+        if (pos2 < pos1)
+        {
+            std::swap(pos1, pos2);
+            std::swap(val1, val2);
+        }
+
+        pts[n++] = sctr.pt(x, sign * s.first);
+        if (pos1 != 0 && pos1 != last)
+            pts[n++] = sctr.pt(x + pos1, sign * val1);
+        if (pos2 != 0 && pos2 != last)
+            pts[n++] = sctr.pt(x + pos2, sign * val2);
+        if (last != 0)
+            pts[n++] = sctr.pt(x + last, sign * s.last);
+    }
+    return n;
+}
+
+// index of the first history entry at or after begin that is later than t,
+// or history.size() if there is none
+static unsigned int GetFirstAfter(const circular_buffer<S_HISTORY>& history, unsigned int begin, wxLongLong_t t)
+{
+    unsigned int end = history.size();
+    while (begin < end)
     {
-        const S_HISTORY& h = history[i];
-        if (h.starSNR > maxSNR)
-            maxSNR = h.starSNR;
+        unsigned int mid = begin + (end - begin) / 2;
+        if (history[mid].timestamp > t)
+            end = mid;
+        else
+            begin = mid + 1;
     }
-    return maxSNR;
+    return begin;
 }
 
 enum
@@ -1352,6 +1525,8 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
         unsigned int plot_length = GetItemCount();
         unsigned int start_item = m_history.size() - plot_length;
 
+        UpdateBuckets(size.x);
+
         if (m_showCorrections)
         {
             double ymagc;
@@ -1361,7 +1536,7 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
             }
             else
             {
-                int maxDur = GetMaxDuration(m_history, start_item);
+                int maxDur = GetMaxDuration(m_buckets);
                 ymagc = (size.y - 10) * 0.5 / (double) maxDur;
             }
             ScaleAndTranslate sctr(xorig, yorig, xmag, ymagc);
@@ -1369,82 +1544,58 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
             dc.SetBrush(*wxTRANSPARENT_BRUSH);
             dc.SetPen(wxPen(m_raOrDxColor.ChangeLightness(60)));
 
-            double const xRate = pMount ? pMount->xRate() : 1.0;
+            // the longest correction each way in each bucket
+            const unsigned int start_seq = m_buckets.front().seq;
 
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-            {
-                const S_HISTORY& h = m_history[i];
+            double const xRate = m_correctionsToScale && pMount ? pMount->xRate() : 1.0;
 
-                if (h.raDur != 0)
-                {
-                    // West corrections => Up on graph
-                    double raDur = h.raDir == WEST ? -h.raDur : h.raDur;
-                    if (m_correctionsToScale)
-                        raDur *= xRate;
-                    wxPoint pt(sctr.pt(j, raDur));
-                    if (raDur < 0)
-                        dc.DrawRectangle(pt, wxSize(4, yorig - pt.y));
-                    else
-                        dc.DrawRectangle(wxPoint(pt.x, yorig), wxSize(4, pt.y - yorig));
-                }
+            for (std::deque<GraphBucket>::const_iterator it = m_buckets.begin(); it != m_buckets.end(); ++it)
+            {
+                double j = it->seq - start_seq;
+                if (it->raDurLo < 0)
+                    DrawCorrection(dc, sctr, j, it->raDurLo * xRate, 0);
+                if (it->raDurHi > 0)
+                    DrawCorrection(dc, sctr, j, it->raDurHi * xRate, 0);
             }
 
             dc.SetPen(wxPen(m_decOrDyColor.ChangeLightness(60)));
 
-            double const yRate = pMount ? pMount->yRate() : 1.0;
+            double const yRate = m_correctionsToScale && pMount ? pMount->yRate() : 1.0;
 
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
+            for (std::deque<GraphBucket>::const_iterator it = m_buckets.begin(); it != m_buckets.end(); ++it)
             {
-                const S_HISTORY& h = m_history[i];
-
-                if (h.decDur != 0)
-                {
-                    // North Corrections => Up on graph
-                    double decDur = h.decDir == SOUTH ? h.decDur : -h.decDur;
-                    if (m_correctionsToScale)
-                        decDur *= yRate;
-                    wxPoint pt(sctr.pt(j, decDur));
-                    pt.x += 5;
-                    if (decDur < 0)
-                        dc.DrawRectangle(pt, wxSize(4, yorig - pt.y));
-                    else
-                        dc.DrawRectangle(wxPoint(pt.x, yorig), wxSize(4, pt.y - yorig));
-                }
+                double j = it->seq - start_seq;
+                if (it->decDurLo < 0)
+                    DrawCorrection(dc, sctr, j, it->decDurLo * yRate, 5);
+                if (it->decDurHi > 0)
+                    DrawCorrection(dc, sctr, j, it->decDurHi * yRate, 5);
             }
         }
 
         if (m_showStarMass)
         {
-            double maxMass = GetMaxStarMass(m_history, start_item);
+            double maxMass = GetMaxValue(m_buckets, GraphBucket::STAR_MASS);
 
             const double ymag = (size.y - 10) * 0.5 / maxMass;
             ScaleAndTranslate sctr(xorig, yorig, xmag, -ymag);
 
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-            {
-                const S_HISTORY& h = m_history[i];
-                m_line1[j] = sctr.pt(j, h.starMass);
-            }
+            unsigned int n = GetBucketLine(m_line1, m_buckets, GraphBucket::STAR_MASS, 1.0, sctr);
 
             dc.SetPen(*wxYELLOW_PEN);
-            dc.DrawLines(plot_length, m_line1);
+            dc.DrawLines(n, m_line1);
         }
 
         if (m_showStarSNR)
         {
-            double maxSNR = GetMaxStarSNR(m_history, start_item);
+            double maxSNR = GetMaxValue(m_buckets, GraphBucket::STAR_SNR);
 
             const double ymag = (size.y - 10) * 0.5 / maxSNR;
             ScaleAndTranslate sctr(xorig, yorig, xmag, -ymag);
 
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-            {
-                const S_HISTORY& h = m_history[i];
-                m_line1[j] = sctr.pt(j, h.starSNR);
-            }
+            unsigned int n = GetBucketLine(m_line1, m_buckets, GraphBucket::STAR_SNR, 1.0, sctr);
 
             dc.SetPen(*wxWHITE_PEN);
-            dc.DrawLines(plot_length, m_line1);
+            dc.DrawLines(n, m_line1);
         }
 
         std::deque<DitherInfo>::const_iterator it = m_dithers.begin();
@@ -1454,38 +1605,38 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
                 ++it;
         }
 
-        for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
+        // label each dither at the first entry following it, at most one label per entry
+        for (unsigned int i = start_item; it != m_dithers.end(); ++it, ++i)
         {
-            const S_HISTORY& h = m_history[i];
+            i = GetFirstAfter(m_history, i, it->timestamp);
+            if (i >= m_history.size())
+                break;
 
-            if (it != m_dithers.end() && it->timestamp < h.timestamp)
-            {
-                wxPoint pt(sctr.pt((double) j - 0.5, 0.0));
-                pt.y = topEdge + 6;
-                dc.DrawText(_("Dither"), pt);
-                ++it;
-            }
+            wxPoint pt(sctr.pt((double) (i - start_item) - 0.5, 0.0));
+            pt.y = topEdge + 6;
+            dc.DrawText(_("Dither"), pt);
+        }
 
-            switch (m_mode)
-            {
-            case MODE_RADEC:
-                m_line1[j] = sctr.pt(j, h.ra);
-                m_line2[j] = sctr.pt(j, -h.dec); // North corrections Up, North offsets down
-                break;
-            case MODE_DXDY:
-                m_line1[j] = sctr.pt(j, h.dx);
-                m_line2[j] = sctr.pt(j, h.dy);
-                break;
-            }
+        unsigned int n1 = 0, n2 = 0;
+        switch (m_mode)
+        {
+        case MODE_RADEC:
+            n1 = GetBucketLine(m_line1, m_buckets, GraphBucket::RA, 1.0, sctr);
+            n2 = GetBucketLine(m_line2, m_buckets, GraphBucket::DEC, -1.0, sctr); // North corrections Up, North offsets down
+            break;
+        case MODE_DXDY:
+            n1 = GetBucketLine(m_line1, m_buckets, GraphBucket::DX, 1.0, sctr);
+            n2 = GetBucketLine(m_line2, m_buckets, GraphBucket::DY, 1.0, sctr);
+            break;
         }
 
         wxPen raOrDxPen(m_raOrDxColor, 2);
         dc.SetPen(raOrDxPen);
-        dc.DrawLines(plot_length, m_line1);
+        dc.DrawLines(n1, m_line1);
 
         wxPen decOrDyPen(m_decOrDyColor, 2);
         dc.SetPen(decOrDyPen);
-        dc.DrawLines(plot_length, m_line2);
+        dc.DrawLines(n2, m_line2);
 
         // draw trend lines
         double polarAlignCircleRadius = 0.0;
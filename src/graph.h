@@ -86,6 +86,42 @@ struct DitherInfo
     double dDec;
 };
 
+// first, last, minimum and maximum value of one plotted quantity over a
+// GraphBucket
+struct GraphBucketSeries
+{
+    double first;
+    double last;
+    double lo;
+    double hi;
+    unsigned int loPos; // offset of the minimum within the bucket
+    unsigned int hiPos; // offset of the maximum within the bucket
+};
+
+// A run of consecutive history entries that fall within a single pixel column
+// of the graph. Drawing the first, minimum, maximum and last entry of each
+// bucket looks the same as drawing every entry, so the cost of a repaint
+// depends on the width of the window rather than the length of the history.
+struct GraphBucket
+{
+    enum
+    {
+        RA,
+        DEC,
+        DX,
+        DY,
+        STAR_MASS,
+        STAR_SNR,
+        NR_SERIES
+    };
+
+    unsigned int seq; // sequence number of the first entry
+    unsigned int count;
+    GraphBucketSeries series[NR_SERIES];
+    int raDurLo, raDurHi; // signed RA correction durations, West < 0
+    int decDurLo, decDurHi; // signed Dec correction durations, North < 0
+};
+
 struct SummaryStats
 {
     S_HISTORY cur;
@@ -133,6 +169,10 @@ private:
     wxPoint *m_line1;
     wxPoint *m_line2;
 
+    std::deque<GraphBucket> m_buckets; // decimated history, covering exactly the plotted items
+    unsigned int m_bucketSize; // history entries per bucket, 0 when m_buckets must be rebuilt
+    unsigned int m_seq; // sequence number of the next history entry
+
     TrendLineAccum m_trendLineAccum[4]; // dx, dy, ra, dec
     int m_raSameSides; // accumulator for RA osc index
     SummaryStats m_stats;
@@ -171,6 +211,9 @@ public:
 private:
     void RecalculateTrendLines();
     void UpdateStats(unsigned int nr, const S_HISTORY *cur);
+    void AddToBuckets(const S_HISTORY& h, unsigned int seq);
+    void ClipBuckets();
+    void UpdateBuckets(int width);
 
     void OnPaint(wxPaintEvent& evt);
     void OnLeftBtnDown(wxMouseEvent& evt);
@@ -72,6 +72,7 @@ static const double DefaultNoresetMaxPctPeriod =
     40.; // max percent of worm period elapsed to skip resetting the model when guiding is stopped and resumed
 
 static const bool DefaultComputePeriod = true;
+static const bool DefaultIncrementalInference = true; // update the GP factorization instead of refitting every step
 
 static void MakeBold(wxControl *ctrl)
 {
@@ -456,11 +457,14 @@ GuideAlgorithmGaussianProcess::GuideAlgorithmGaussianProcess(Mount *pMount, Guid
     parameters.prediction_gain_ = DefaultPredictionGain;
     parameters.compute_period_ = DefaultComputePeriod;
 
+    wxString configPath = GetConfigPath();
+
+    parameters.incremental_inference_ =
+        pConfig->Profile.GetBoolean(configPath + "/gp_incremental_inference", DefaultIncrementalInference);
+
     // create instance of the worker
     GPG = new GaussianProcessGuider(parameters);
 
-    wxString configPath = GetConfigPath();
-
     double control_gain = pConfig->Profile.GetDouble(configPath + "/gp_control_gain", DefaultControlGain);
     SetControlGain(control_gain);
 
@@ -0,0 +1,311 @@
+/*
+ *  guidelog_binary.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "guidelog_binary.h"
+
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+
+static const char MAGIC[8] = { 'P', 'H', 'D', '2', 'G', 'L', 'B', 0 };
+static const uint32_t VERSION = 1;
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t recordSize;
+    uint32_t columnCount;
+};
+
+static_assert(sizeof(GuideLogRecord) == 128, "guide log record layout changed");
+static_assert(sizeof(GuideLogColumn) == 32, "guide log column layout changed");
+
+#define COLUMN(name, field, type)                                                                                              \
+    {                                                                                                                          \
+        name, (uint16_t) offsetof(GuideLogRecord, field), type, (uint8_t) sizeof(GuideLogRecord::field), 0                     \
+    }
+
+static const GuideLogColumn s_columns[] = {
+    COLUMN("Frame", frame, GLC_I32),
+    COLUMN("Kind", kind, GLC_U8),
+    COLUMN("RADirection", raDir, GLC_CHAR),
+    COLUMN("DECDirection", decDir, GLC_CHAR),
+    COLUMN("Time", time, GLC_F64),
+    COLUMN("dx", dx, GLC_F64),
+    COLUMN("dy", dy, GLC_F64),
+    COLUMN("RARawDistance", raRaw, GLC_F64),
+    COLUMN("DECRawDistance", decRaw, GLC_F64),
+    COLUMN("RAGuideDistance", raGuide, GLC_F64),
+    COLUMN("DECGuideDistance", decGuide, GLC_F64),
+    COLUMN("StarMass", starMass, GLC_F64),
+    COLUMN("SNR", snr, GLC_F64),
+    COLUMN("RADuration", raDuration, GLC_I32),
+    COLUMN("DECDuration", decDuration, GLC_I32),
+    COLUMN("XStep", xStep, GLC_I32),
+    COLUMN("YStep", yStep, GLC_I32),
+    COLUMN("ErrorCode", errorCode, GLC_I32),
+    COLUMN("Status", status, GLC_STR),
+};
+
+#undef COLUMN
+
+static const size_t NUM_COLUMNS = sizeof(s_columns) / sizeof(s_columns[0]);
+
+void GuideLogRecord::Clear()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+void GuideLogRecord::SetStatus(const char *s)
+{
+    size_t len = strlen(s);
+    if (len >= sizeof(status))
+    {
+        len = sizeof(status) - 1;
+        // do not split a UTF-8 sequence
+        while (len > 0 && (s[len] & 0xC0) == 0x80)
+            --len;
+    }
+    memcpy(status, s, len);
+    memset(status + len, 0, sizeof(status) - len);
+}
+
+void GuideLogFormatRow(std::string *out, const GuideLogRecord& rec, const char *status)
+{
+    char buf[256];
+    int n;
+
+    if (rec.kind == GLR_DROP)
+    {
+        n = snprintf(buf, sizeof(buf), "%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"", rec.frame, rec.time, rec.starMass, rec.snr,
+                     rec.errorCode);
+        out->append(buf, n);
+        if (status)
+            out->append(status);
+        else
+            out->append(rec.status, strnlen(rec.status, sizeof(rec.status)));
+        out->append("\"\n");
+        return;
+    }
+
+    n = snprintf(buf, sizeof(buf), "%d,%.3f,\"%s\",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,", rec.frame, rec.time,
+                 rec.kind == GLR_AO ? "AO" : "Mount", rec.dx, rec.dy, rec.raRaw, rec.decRaw, rec.raGuide, rec.decGuide);
+    out->append(buf, n);
+
+    if (rec.kind == GLR_AO)
+        n = snprintf(buf, sizeof(buf), ",,,,%d,%d,", rec.xStep, rec.yStep);
+    else
+    {
+        char ra[2] = { rec.raDir, 0 };
+        char dec[2] = { rec.decDir, 0 };
+        n = snprintf(buf, sizeof(buf), "%d,%s,%d,%s,,,", rec.raDuration, ra, rec.decDuration, dec);
+    }
+    out->append(buf, n);
+
+    n = snprintf(buf, sizeof(buf), "%.f,%.2f,%d\n", rec.starMass, rec.snr, rec.errorCode);
+    out->append(buf, n);
+}
+
+bool GuideLogBinaryWriteHeader(FILE *fp)
+{
+    FileHeader hdr;
+    memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+    hdr.version = VERSION;
+    hdr.byteOrder = BYTE_ORDER_MARK;
+    hdr.recordSize = sizeof(GuideLogRecord);
+    hdr.columnCount = NUM_COLUMNS;
+
+    return fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && fwrite(s_columns, sizeof(s_columns), 1, fp) == 1;
+}
+
+bool GuideLogBinaryWriteRecord(FILE *fp, const GuideLogRecord& rec)
+{
+    return fwrite(&rec, sizeof(rec), 1, fp) == 1;
+}
+
+GuideLogBinaryReader::GuideLogBinaryReader() : m_fp(nullptr), m_recordSize(0) { }
+
+bool GuideLogBinaryReader::Open(FILE *fp, std::string *error)
+{
+    m_fp = nullptr;
+
+    FileHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        *error = "not a binary guide log";
+        return false;
+    }
+    if (hdr.byteOrder != BYTE_ORDER_MARK)
+    {
+        *error = "guide log was written with a different byte order";
+        return false;
+    }
+    if (hdr.columnCount == 0 || hdr.columnCount > 1024 || hdr.recordSize == 0 || hdr.recordSize > 65536)
+    {
+        *error = "corrupt guide log header";
+        return false;
+    }
+
+    m_columns.resize(hdr.columnCount);
+    if (fread(&m_columns[0], sizeof(GuideLogColumn), hdr.columnCount, fp) != hdr.columnCount)
+    {
+        *error = "truncated guide log header";
+        return false;
+    }
+
+    // match the file's columns to ours by name and type; columns this reader
+    // does not know are skipped and columns the file lacks read as zero
+    m_map.assign(NUM_COLUMNS, -1);
+    for (size_t i = 0; i < NUM_COLUMNS; i++)
+    {
+        const GuideLogColumn& want = s_columns[i];
+        for (size_t j = 0; j < m_columns.size(); j++)
+        {
+            const GuideLogColumn& have = m_columns[j];
+            if (strncmp(have.name, want.name, sizeof(have.name)) != 0 || have.type != want.type)
+                continue;
+            if (have.type == GLC_STR ? have.size == 0 : have.size != want.size)
+                continue;
+            if ((uint32_t) have.offset + have.size > hdr.recordSize)
+                continue;
+            m_map[i] = (int) j;
+            break;
+        }
+    }
+
+    m_recordSize = hdr.recordSize;
+    m_buf.resize(m_recordSize);
+    m_fp = fp;
+    return true;
+}
+
+bool GuideLogBinaryReader::Next(GuideLogRecord *rec)
+{
+    if (!m_fp || fread(&m_buf[0], m_recordSize, 1, m_fp) != 1)
+        return false;
+
+    rec->Clear();
+    char *dst = reinterpret_cast<char *>(rec);
+
+    for (size_t i = 0; i < NUM_COLUMNS; i++)
+    {
+        if (m_map[i] < 0)
+            continue;
+        const GuideLogColumn& have = m_columns[m_map[i]];
+        const GuideLogColumn& want = s_columns[i];
+        size_t size = have.size < want.size ? have.size : want.size;
+        memcpy(dst + want.offset, &m_buf[have.offset], size);
+    }
+
+    rec->status[sizeof(rec->status) - 1] = 0;
+    return true;
+}
+
+static void FormatTimestamp(std::string *out, const char *what, double t)
+{
+    time_t secs = (time_t) t;
+    struct tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &secs);
+#else
+    localtime_r(&secs, &tm);
+#endif
+    char buf[64];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    *out += what;
+    *out += buf;
+    *out += "\n";
+}
+
+static const char *COLUMN_HEADING = "Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,"
+                                    "RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode\n";
+
+bool GuideLogBinaryToText(FILE *in, FILE *out, std::string *error)
+{
+    GuideLogBinaryReader reader;
+    if (!reader.Open(in, error))
+        return false;
+
+    GuideLogRecord rec;
+    std::string line;
+    bool headed = false;
+
+    while (reader.Next(&rec))
+    {
+        line.clear();
+
+        switch (rec.kind)
+        {
+        case GLR_GUIDING_BEGIN:
+            line += "\n";
+            FormatTimestamp(&line, "Guiding Begins at ", rec.time);
+            line += COLUMN_HEADING;
+            headed = true;
+            break;
+        case GLR_GUIDING_END:
+            FormatTimestamp(&line, "Guiding Ends at ", rec.time);
+            headed = false;
+            break;
+        case GLR_MOUNT:
+        case GLR_AO:
+        case GLR_DROP:
+            // logging may have been enabled part way through guiding
+            if (!headed)
+            {
+                line += COLUMN_HEADING;
+                headed = true;
+            }
+            GuideLogFormatRow(&line, rec);
+            break;
+        default:
+            continue;
+        }
+
+        if (fwrite(line.data(), 1, line.size(), out) != line.size())
+        {
+            *error = "write error";
+            return false;
+        }
+    }
+
+    if (ferror(in))
+    {
+        *error = "read error";
+        return false;
+    }
+
+    return true;
+}
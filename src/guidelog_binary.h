@@ -0,0 +1,135 @@
+/*
+ *  guidelog_binary.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDELOG_BINARY_INCLUDED
+#define GUIDELOG_BINARY_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Binary companion to the text guide log. The file starts with a header
+// giving the record size and a table of columns (name, type, offset), followed
+// by fixed-size records, one per guide step, dropped frame or guiding start/end.
+// Readers locate fields through the column table, so columns can be added
+// without breaking older readers. Values are stored in the writer's native
+// byte order, which the header records.
+
+enum GuideLogRecordKind
+{
+    GLR_MOUNT = 0,
+    GLR_AO = 1,
+    GLR_DROP = 2,
+    GLR_GUIDING_BEGIN = 3, // time = seconds since the epoch
+    GLR_GUIDING_END = 4,   // time = seconds since the epoch
+};
+
+enum GuideLogColumnType
+{
+    GLC_I32 = 1,
+    GLC_F64 = 2,
+    GLC_U8 = 3,
+    GLC_CHAR = 4,
+    GLC_STR = 5, // NUL-padded string
+};
+
+struct GuideLogRecord
+{
+    int32_t frame;
+    uint8_t kind; // GuideLogRecordKind
+    char raDir; // direction character, 0 when no RA pulse
+    char decDir;
+    uint8_t reserved;
+    double time;
+    double dx;
+    double dy;
+    double raRaw;
+    double decRaw;
+    double raGuide;
+    double decGuide;
+    double starMass;
+    double snr;
+    int32_t raDuration;
+    int32_t decDuration;
+    int32_t xStep;
+    int32_t yStep;
+    int32_t errorCode;
+    char status[28]; // dropped frame status, truncated
+
+    void Clear();
+    void SetStatus(const char *s);
+};
+
+struct GuideLogColumn
+{
+    char name[24];
+    uint16_t offset;
+    uint8_t type; // GuideLogColumnType
+    uint8_t size;
+    uint32_t reserved;
+};
+
+// Append the text guide log row for a GLR_MOUNT, GLR_AO or GLR_DROP record to
+// *out. status, if given, replaces rec.status, which may have been truncated.
+extern void GuideLogFormatRow(std::string *out, const GuideLogRecord& rec, const char *status = nullptr);
+
+// Write the file header; call once on an empty file
+extern bool GuideLogBinaryWriteHeader(FILE *fp);
+extern bool GuideLogBinaryWriteRecord(FILE *fp, const GuideLogRecord& rec);
+
+class GuideLogBinaryReader
+{
+    FILE *m_fp;
+    uint32_t m_recordSize;
+    std::vector<GuideLogColumn> m_columns;
+    std::vector<int> m_map; // reader column index for each GuideLogRecord column, -1 if absent
+    std::vector<char> m_buf;
+
+public:
+    GuideLogBinaryReader();
+
+    // Read and check the header; on failure *error says why
+    bool Open(FILE *fp, std::string *error);
+    // Read the next record; returns false at end of file or on a short record
+    bool Next(GuideLogRecord *rec);
+
+    const std::vector<GuideLogColumn>& Columns() const { return m_columns; }
+};
+
+// Convert a binary guide log to the guide step rows of the text guide log,
+// with "Guiding Begins/Ends" lines and the column heading for each guiding
+// session. Settings summaries are only in the text log.
+extern bool GuideLogBinaryToText(FILE *in, FILE *out, std::string *error);
+
+#endif
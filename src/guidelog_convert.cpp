@@ -0,0 +1,86 @@
+/*
+ *  guidelog_convert.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Command line converter from the binary guide log to the text format:
+//   phd2_guidelog_convert PHD2_GuideLog_<date>.bin [output.txt]
+// Output goes to stdout when no output file is given.
+
+#include "guidelog_binary.h"
+
+#include <cstdio>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "usage: %s binary-guide-log [text-output]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (argc == 3)
+    {
+        out = fopen(argv[2], "w");
+        if (!out)
+        {
+            perror(argv[2]);
+            fclose(in);
+            return 1;
+        }
+    }
+
+    std::string error;
+    bool ok = GuideLogBinaryToText(in, out, &error);
+
+    fclose(in);
+    if (out != stdout && fclose(out) != 0)
+    {
+        ok = false;
+        error = "error closing output";
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -182,6 +182,7 @@ Guider::Guider(wxWindow *parent, int xSize, int ySize)
     m_measurementMode = false;
     m_searchRegion = 0;
     m_pCurrentImage = new usImage(); // so we always have one
+    m_frameMoveDispatched = false;
 
     SetOverlayMode(DefaultOverlayMode);
 
@@ -265,6 +266,8 @@ PauseType Guider::SetPaused(PauseType pause)
 
     if (pause != prev)
     {
+        // no guide correction on the worker thread until the next frame is processed
+        m_measurementStage.Withdraw();
         Refresh();
         Update();
     }
@@ -333,6 +336,8 @@ void Guider::GetOverlaySlitCoords(wxPoint *center, wxSize *size, int *angle)
 
 void Guider::EnableMeasurementMode(bool enable)
 {
+    m_measurementStage.Withdraw();
+
     if (enable)
     {
         if (m_state == STATE_GUIDING)
@@ -449,15 +454,35 @@ bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
         GUIDER_STATE state = GetState();
         GetSize(&XWinSize, &YWinSize);
 
+        int imageWidth;
+        int imageHeight;
+
         if (m_pCurrentImage->ImageData)
         {
+            imageWidth = m_pCurrentImage->Size.GetWidth();
+            imageHeight = m_pCurrentImage->Size.GetHeight();
+
+            // When the image is at least twice the size of the window, render
+            // it at a reduced resolution rather than expanding the full frame
+            // and scaling it down below
+            int downsample = 1;
+            if (XWinSize > 0 && YWinSize > 0)
+            {
+                double scale = wxMax(imageWidth / (double) XWinSize, imageHeight / (double) YWinSize);
+                if (scale >= 2.0)
+                    downsample = (int) scale;
+            }
+
+            m_pCurrentImage->EnsureStats();
             int blevel = m_pCurrentImage->FiltMin;
             int wlevel = m_pCurrentImage->FiltMax;
-            m_pCurrentImage->CopyToImage(&m_displayedImage, blevel, wlevel, pFrame->Stretch_gamma);
+            m_pCurrentImage->CopyToImage(&m_displayedImage, blevel, wlevel, pFrame->Stretch_gamma, downsample);
+        }
+        else
+        {
+            imageWidth = m_displayedImage->GetWidth();
+            imageHeight = m_displayedImage->GetHeight();
         }
-
-        int imageWidth = m_displayedImage->GetWidth();
-        int imageHeight = m_displayedImage->GetHeight();
 
         // scale the image if necessary
 
@@ -491,7 +516,7 @@ bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
 
                 m_scaleFactor = newScaleFactor;
 
-                if (imageWidth != newWidth || imageHeight != newHeight)
+                if (m_displayedImage->GetWidth() != newWidth || m_displayedImage->GetHeight() != newHeight)
                 {
                     //                    Debug.Write(wxString::Format("Resizing image to %d,%d\n", newWidth, newHeight));
 
@@ -739,10 +764,20 @@ void Guider::UpdateImageDisplay(usImage *pImage)
         pImage = m_pCurrentImage;
     }
 
-    Debug.Write(
-        wxString::Format("UpdateImageDisplay: Size=(%d,%d) min=%u, max=%u, med=%u, FiltMin=%u, FiltMax=%u, Gamma=%.3f\n",
-                         pImage->Size.x, pImage->Size.y, pImage->MinADU, pImage->MaxADU, pImage->MedianADU, pImage->FiltMin,
-                         pImage->FiltMax, pFrame->Stretch_gamma));
+    // the stats are only used to stretch the displayed image; skip them when
+    // the image will not be painted
+    if (IsShownOnScreen())
+        pImage->EnsureStats();
+
+    if (pImage->StatsValid)
+    {
+        Debug.Write(wxString::Format(
+            "UpdateImageDisplay: Size=(%d,%d) min=%u, max=%u, med=%u, FiltMin=%u, FiltMax=%u, Gamma=%.3f\n", pImage->Size.x,
+            pImage->Size.y, pImage->MinADU, pImage->MaxADU, pImage->MedianADU, pImage->FiltMin, pImage->FiltMax,
+            pFrame->Stretch_gamma));
+    }
+    else
+        Debug.Write(wxString::Format("UpdateImageDisplay: Size=(%d,%d) not shown\n", pImage->Size.x, pImage->Size.y));
 
     Refresh();
     Update();
@@ -795,6 +830,7 @@ bool Guider::SetLockPosition(const PHD_Point& position)
 
         if (!m_lockPosition.IsValid() || position.X != m_lockPosition.X || position.Y != m_lockPosition.Y)
         {
+            m_measurementStage.Withdraw();
             EvtServer.NotifySetLockPosition(position);
             if (m_state == STATE_GUIDING)
             {
@@ -937,6 +973,8 @@ void Guider::SetState(GUIDER_STATE newState)
     {
         Debug.Write(wxString::Format("Changing from state %s to %s\n", StateStr(m_state), StateStr(newState)));
 
+        m_measurementStage.Withdraw();
+
         if (newState == STATE_STOP)
         {
             // we are going to stop looping exposures.  We should put
@@ -1131,12 +1169,12 @@ inline static double CurrentError(time_t starFoundTimestamp, double avgDist)
     return avgDist;
 }
 
-double Guider::CurrentError(bool raOnly)
+double Guider::CurrentError(bool raOnly) const
 {
     return ::CurrentError(m_starFoundTimestamp, raOnly ? m_avgDistanceRA : m_avgDistance);
 }
 
-double Guider::CurrentErrorSmoothed(bool raOnly)
+double Guider::CurrentErrorSmoothed(bool raOnly) const
 {
     return ::CurrentError(m_starFoundTimestamp, raOnly ? m_avgDistanceLongRA : m_avgDistanceLong);
 }
@@ -1232,6 +1270,7 @@ void Guider::DisplayImage(usImage *img)
     // switch in the new image
     usImage *prev = m_pCurrentImage;
     m_pCurrentImage = img;
+    m_frameMeasurement.reset();
 
     ImageLogger::SaveImage(prev);
 
@@ -1261,10 +1300,29 @@ inline static bool IsLoopingState(GUIDER_STATE state)
 
 /*************  A new image is ready ************************/
 
-void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
+// The measurement of the current frame taken on the worker thread, provided
+// it was made with the plan the guider would use now: the same settings and
+// the same star tracking state
+const StarMeasurement *Guider::FrameMeasurement() const
+{
+    if (!m_frameMeasurement)
+        return nullptr;
+
+    StarSearchPlan plan;
+    if (!GetSearchPlan(&plan) || plan != m_frameMeasurement->plan)
+    {
+        Debug.Write("FrameMeasurement: search plan changed, measuring on the GUI thread\n");
+        return nullptr;
+    }
+
+    return m_frameMeasurement.get();
+}
+
+void Guider::UpdateGuideState(usImage *pImage, bool bStopping, const StarMeasurementPtr& measurement)
 {
     wxString statusMessage;
     bool someException = false;
+    const bool newImage = pImage != nullptr;
 
     try
     {
@@ -1276,6 +1334,8 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
             usImage *pPrevImage = m_pCurrentImage;
             m_pCurrentImage = pImage;
+            m_frameMeasurement = measurement;
+            m_frameMoveDispatched = measurement && measurement->move.mount;
 
             ImageLogger::SaveImage(pPrevImage);
         }
@@ -1294,7 +1354,8 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             throw THROW_INFO("Stopped Guiding");
         }
 
-        assert(!pMount || !pMount->IsBusy());
+        // the guide correction the worker thread made for this frame may still be in progress
+        assert(!pMount || !pMount->IsBusy() || m_frameMoveDispatched);
 
         // shift lock position
         if (LockPosShiftEnabled() && IsGuiding())
@@ -1348,8 +1409,11 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
                 pFrame->pGraphLog->AppendData(info);
 
                 // allow guide algorithms to attempt dead reckoning
-                static GuiderOffset ZERO_OFS;
-                pFrame->SchedulePrimaryMove(pMount, ZERO_OFS, MOVEOPTS_DEDUCED_MOVE);
+                if (!m_frameMoveDispatched)
+                {
+                    static GuiderOffset ZERO_OFS;
+                    pFrame->SchedulePrimaryMove(pMount, ZERO_OFS, MOVEOPTS_DEDUCED_MOVE);
+                }
 
                 wxColor prevColor = GetBackgroundColour();
                 SetBackgroundColour(wxColour(64, 0, 0));
@@ -1384,7 +1448,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
         if (IsPaused())
         {
-            if (m_state == STATE_GUIDING)
+            if (m_state == STATE_GUIDING && !m_frameMoveDispatched)
             {
                 // allow guide algorithms to attempt dead reckoning
                 static GuiderOffset ZERO_OFS;
@@ -1485,7 +1549,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             CheckCalibrationAutoLoad();
             break;
         case STATE_GUIDING:
-            if (m_ditherRecenterRemaining.IsValid())
+            if (m_ditherRecenterRemaining.IsValid() && !m_frameMoveDispatched)
             {
                 // fast recenter after dither taking large steps and bypassing
                 // guide algorithms
@@ -1519,9 +1583,10 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             }
             else
             {
-                // ordinary guide step
+                // ordinary guide step, unless the worker thread made it already
                 s_deflectionLogger.Log(CurrentPosition());
-                pFrame->SchedulePrimaryMove(pMount, ofs, MOVEOPTS_GUIDE_STEP);
+                if (!m_frameMoveDispatched)
+                    pFrame->SchedulePrimaryMove(pMount, ofs, MOVEOPTS_GUIDE_STEP);
             }
             break;
 
@@ -1536,6 +1601,18 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
         someException = true;
     }
 
+    // tell the worker thread how to measure the next frame, and let it make the
+    // guide correction for the frame while guiding normally
+    StarSearchPlan plan;
+    if (GetSearchPlan(&plan))
+    {
+        bool workerGuideStep = m_state == STATE_GUIDING && !IsPaused() && !m_ditherRecenterRemaining.IsValid() &&
+            !m_measurementMode && !LockPosShiftEnabled() && m_lockPosition.IsValid() && pMount && pMount->IsCalibrated();
+        m_measurementStage.Publish(plan, workerGuideStep ? pMount : nullptr);
+    }
+    else
+        m_measurementStage.Withdraw();
+
     // during calibration, the mount is responsible for updating the status message
     if (someException && m_state != STATE_CALIBRATING_PRIMARY && m_state != STATE_CALIBRATING_SECONDARY)
     {
@@ -1550,6 +1627,9 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
     pFrame->UpdateButtonsStatus();
 
+    if (newImage)
+        EvtServer.NotifyFrame(pImage, PrimaryStar(), LockPosition());
+
     UpdateImageDisplay(pImage);
 
     Debug.AddLine("UpdateGuideState exits: " + statusMessage);
@@ -1590,6 +1670,7 @@ void Guider::EnableLockPosShift(bool enable)
     {
         Debug.Write(wxString::Format("EnableLockPosShift: enable = %d\n", enable));
         m_lockPosShift.shiftEnabled = enable;
+        m_measurementStage.Withdraw();
         if (enable)
         {
             m_lockPosition.BeginShift();
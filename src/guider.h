@@ -157,6 +157,9 @@ class Guider : public wxWindow
     bool m_avgDistanceNeedReset;
     GUIDER_STATE m_state;
     usImage *m_pCurrentImage;
+    StarMeasurementPtr m_frameMeasurement; // stars in m_pCurrentImage measured on the worker thread
+    bool m_frameMoveDispatched; // the worker thread made the guide correction for m_pCurrentImage
+    StarMeasurementStage m_measurementStage;
     bool m_scaleImage;
     bool m_lockPosIsSticky;
     bool m_ignoreLostStarLooping;
@@ -204,6 +207,7 @@ protected:
     bool PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC);
     void SetState(GUIDER_STATE newState);
     void UpdateCurrentDistance(double distance, double distanceRA);
+    const StarMeasurement *FrameMeasurement() const;
 
     void ToggleBookmark(const wxRealPoint& pt);
 
@@ -246,15 +250,17 @@ public:
 
     void StartGuiding();
     void StopGuiding();
-    void UpdateGuideState(usImage *pImage, bool bStopping = false);
+    void UpdateGuideState(usImage *pImage, bool bStopping = false,
+                          const StarMeasurementPtr& measurement = StarMeasurementPtr());
+    StarMeasurementStage& MeasurementStage();
     void DisplayImage(usImage *img);
 
     bool SetScaleImage(bool newScaleValue);
     bool GetScaleImage() const;
 
     int GetSearchRegion() const;
-    double CurrentError(bool raOnly);
-    double CurrentErrorSmoothed(bool raOnly);
+    double CurrentError(bool raOnly) const;
+    double CurrentErrorSmoothed(bool raOnly) const;
     unsigned int CurrentErrorFrameCount() const { return m_avgDistanceCnt; }
 
     bool GetBookmarksShown() const;
@@ -297,6 +303,7 @@ public:
 
 private:
     virtual bool UpdateCurrentPosition(const usImage *pImage, GuiderOffset *ofs, FrameDroppedInfo *errorInfo) = 0;
+    virtual bool GetSearchPlan(StarSearchPlan *plan) const = 0;
     virtual bool SetCurrentPosition(const usImage *pImage, const PHD_Point& position) = 0;
 
 public:
@@ -399,6 +406,11 @@ inline usImage *Guider::CurrentImage() const
     return m_pCurrentImage;
 }
 
+inline StarMeasurementStage& Guider::MeasurementStage()
+{
+    return m_measurementStage;
+}
+
 inline wxImage *Guider::DisplayedImage() const
 {
     return m_displayedImage;
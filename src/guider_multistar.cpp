@@ -49,136 +49,6 @@
 # define wxPENSTYLE_DOT wxDOT
 #endif
 
-class MassChecker
-{
-    enum
-    {
-        DefaultTimeWindowMs = 22500
-    };
-
-    struct Entry
-    {
-        wxLongLong_t time;
-        double mass;
-    };
-
-    std::deque<Entry> m_data;
-    double m_highMass; // high-water mark
-    double m_lowMass; // low-water mark
-    unsigned long m_timeWindow;
-    double *m_tmp;
-    size_t m_tmpSize;
-    int m_exposure;
-    bool m_isAutoExposure;
-
-public:
-    MassChecker() : m_highMass(0.), m_lowMass(9e99), m_tmp(0), m_tmpSize(0), m_exposure(0), m_isAutoExposure(false)
-    {
-        SetTimeWindow(DefaultTimeWindowMs);
-    }
-
-    ~MassChecker() { delete[] m_tmp; }
-
-    void SetTimeWindow(unsigned int milliseconds)
-    {
-        // an abrupt change in mass will affect the median after approx m_timeWindow/2
-        m_timeWindow = milliseconds * 2;
-    }
-
-    void SetExposure(int exposure, bool isAutoExp)
-    {
-        if (isAutoExp != m_isAutoExposure)
-        {
-            m_isAutoExposure = isAutoExp;
-            m_exposure = exposure;
-            Reset();
-        }
-        else if (exposure != m_exposure)
-        {
-            m_exposure = exposure;
-            if (!m_isAutoExposure)
-            {
-                Reset();
-            }
-        }
-    }
-
-    double AdjustedMass(double mass) const { return m_isAutoExposure ? mass / (double) m_exposure : mass; }
-
-    void AppendData(double mass)
-    {
-        wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
-        wxLongLong_t oldest = now - m_timeWindow;
-
-        while (m_data.size() > 0 && m_data.front().time < oldest)
-            m_data.pop_front();
-
-        Entry entry;
-        entry.time = now;
-        entry.mass = AdjustedMass(mass);
-        m_data.push_back(entry);
-    }
-
-    bool CheckMass(double mass, double threshold, double limits[4])
-    {
-        if (m_data.size() < 5)
-            return false;
-
-        if (m_tmpSize < m_data.size())
-        {
-            delete[] m_tmp;
-            m_tmpSize = m_data.size() + 10;
-            m_tmp = new double[m_tmpSize];
-        }
-
-        std::deque<Entry>::const_iterator it = m_data.begin();
-        std::deque<Entry>::const_iterator end = m_data.end();
-        double *p = &m_tmp[0];
-        for (; it != end; ++it)
-            *p++ = it->mass;
-
-        size_t mid = m_data.size() / 2;
-        std::nth_element(&m_tmp[0], &m_tmp[mid], &m_tmp[m_data.size()]);
-        double med = m_tmp[mid];
-
-        if (med > m_highMass)
-            m_highMass = med;
-        if (med < m_lowMass)
-            m_lowMass = med;
-
-        // let the low water mark drift to follow the median so that it moves back up after a
-        // period of intermittent clouds has brought it down
-        m_lowMass += .05 * (med - m_lowMass);
-
-        limits[0] = m_lowMass * (1. - threshold);
-        limits[1] = med;
-        limits[2] = m_highMass * (1. + threshold);
-        // when mass is depressed by sky conditions, we still want to trigger a rejection when
-        // there is a large spike in mass, even if it is still below the high water mark-based
-        // threhold
-        limits[3] = med * (1. + 2.0 * threshold);
-
-        double adjmass = AdjustedMass(mass);
-        bool reject = adjmass < limits[0] || adjmass > limits[2] || adjmass > limits[3];
-
-        if (reject && m_isAutoExposure)
-        {
-            // convert back to mass-like numbers for logging by caller
-            for (int i = 0; i < 4; i++)
-                limits[i] *= (double) m_exposure;
-        }
-
-        return reject;
-    }
-
-    void Reset()
-    {
-        m_data.clear();
-        m_highMass = 0.;
-        m_lowMass = 9e99;
-    }
-};
-
 static const double DefaultMassChangeThreshold = 0.5;
 
 enum
@@ -596,111 +466,6 @@ void GuiderMultiStar::InvalidateCurrentPosition(bool fullReset)
     }
 }
 
-struct DistanceChecker
-{
-    enum State
-    {
-        ST_GUIDING,
-        ST_WAITING,
-        ST_RECOVERING,
-    };
-    State m_state;
-    wxLongLong_t m_expires;
-    double m_forceTolerance;
-
-    enum
-    {
-        WAIT_INTERVAL_MS = 5000
-    };
-
-    DistanceChecker() : m_state(ST_GUIDING) { }
-
-    void Activate()
-    {
-        if (m_state == ST_GUIDING)
-        {
-            Debug.Write("DistanceChecker: activated\n");
-            m_state = ST_WAITING;
-            m_expires = ::wxGetUTCTimeMillis().GetValue() + WAIT_INTERVAL_MS;
-            m_forceTolerance = 2.0;
-        }
-    }
-
-    static bool _CheckDistance(double distance, bool raOnly, double tolerance)
-    {
-        enum
-        {
-            MIN_FRAMES_FOR_STATS = 10
-        };
-        Guider *guider = pFrame->pGuider;
-        if (!guider->IsGuiding() || guider->IsPaused() || PhdController::IsSettling() ||
-            guider->CurrentErrorFrameCount() < MIN_FRAMES_FOR_STATS)
-        {
-            return true;
-        }
-        double avgDist = guider->CurrentErrorSmoothed(raOnly);
-        double threshold = tolerance * avgDist;
-        if (distance > threshold)
-        {
-            Debug.Write(wxString::Format("DistanceChecker: reject for large offset (%.2f > %.2f) avgDist = %.2f count = %u\n",
-                                         distance, threshold, avgDist, guider->CurrentErrorFrameCount()));
-            return false;
-        }
-        return true;
-    }
-
-    bool CheckDistance(double distance, bool raOnly, double tolerance)
-    {
-        if (m_forceTolerance != 0.)
-            tolerance = m_forceTolerance;
-
-        bool small_offset = _CheckDistance(distance, raOnly, tolerance);
-
-        switch (m_state)
-        {
-        default:
-        case ST_GUIDING:
-            if (small_offset)
-                return true;
-
-            Debug.Write("DistanceChecker: activated\n");
-            m_state = ST_WAITING;
-            m_expires = ::wxGetUTCTimeMillis().GetValue() + WAIT_INTERVAL_MS;
-            return false;
-
-        case ST_WAITING:
-        {
-            if (small_offset)
-            {
-                Debug.Write("DistanceChecker: deactivated\n");
-                m_state = ST_GUIDING;
-                m_forceTolerance = 0.;
-                return true;
-            }
-            // large distance
-            wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
-            if (now < m_expires)
-            {
-                // reject frame
-                return false;
-            }
-            // timed-out
-            Debug.Write("DistanceChecker: begin recovering\n");
-            m_state = ST_RECOVERING;
-            // fall through
-        }
-
-        case ST_RECOVERING:
-            if (small_offset)
-            {
-                Debug.Write("DistanceChecker: deactivated\n");
-                m_state = ST_GUIDING;
-            }
-            return true;
-        }
-    }
-};
-
 wxString GuiderMultiStar::GetStarCount() const
 {
     // no weird displays if stars are being removed from list
@@ -708,216 +473,6 @@ wxString GuiderMultiStar::GetStarCount() const
                             static_cast<unsigned int>(m_guideStars.size()));
 }
 
-// Private method to build compact logging string for how secondary stars were used
-static void AppendStarUse(wxString& secondaryInfo, int starNum, double dX, double dY, double weight, const wxString& flag)
-{
-    secondaryInfo += wxString::Format("[#%d %0.2f,%0.2f,%0.2f,%s] ", starNum, dX, dY, weight, flag);
-}
-
-// Use secondary stars to refine Offset value if appropriate.  Return of true means offset has been adjusted
-bool GuiderMultiStar::RefineOffset(const usImage *pImage, GuiderOffset *pOffset)
-{
-    double primaryDistance;
-    double secondaryDistance;
-    double primarySigma = 0;
-    bool averaged = false;
-    int validStars = 0;
-    GuiderOffset origOffset = *pOffset;
-    m_starsUsed = 1;
-    bool erasures = false;
-    bool refined = false;
-
-    // Primary star is in position 0 of the list
-    try
-    {
-        if (IsGuiding() && m_guideStars.size() > 1 && pMount->GetGuidingEnabled() && !PhdController::IsSettling())
-        {
-            double sumWeights = 1;
-            double sumX = origOffset.cameraOfs.X;
-            double sumY = origOffset.cameraOfs.Y;
-            primaryDistance = hypot(sumX, sumY);
-
-            m_primaryDistStats->AddValue(primaryDistance);
-
-#define Iter_Inx(p) (p - m_guideStars.begin())
-
-            if (m_primaryDistStats->GetCount() > 5)
-            {
-                primarySigma = m_primaryDistStats->GetSigma();
-                if (!m_stabilizing && primaryDistance > m_stabilitySigmaX * primarySigma)
-                {
-                    m_stabilizing = true;
-                    Debug.Write("MultiStar: large primary error, entering stabilization period\n");
-                }
-                else if (m_stabilizing)
-                {
-                    if (primaryDistance <= 2 * primarySigma)
-                    {
-                        m_stabilizing = false;
-                        Debug.Write("MultiStar: exiting stabilization period\n");
-                        if (m_lockPositionMoved)
-                        {
-                            m_lockPositionMoved = false;
-                            Debug.Write("MultiStar: updating star positions after lock position change\n");
-                            for (auto pGS = m_guideStars.begin() + 1; pGS != m_guideStars.end();)
-                            {
-                                PHD_Point expectedLoc = m_primaryStar + pGS->offsetFromPrimary;
-                                bool found;
-                                if (IsValidSecondaryStarPosition(expectedLoc))
-                                    found = pGS->Find(pImage, m_searchRegion, expectedLoc.X, expectedLoc.Y,
-                                                      pFrame->GetStarFindMode(), GetMinStarHFD(), GetMaxStarHFD(),
-                                                      pCamera->GetSaturationADU(), Star::FIND_LOGGING_VERBOSE);
-                                else
-                                    found = pGS->Find(pImage, m_searchRegion, pGS->X, pGS->Y, pFrame->GetStarFindMode(),
-                                                      GetMinStarHFD(), GetMaxStarHFD(), pCamera->GetSaturationADU(),
-                                                      Star::FIND_LOGGING_VERBOSE);
-                                if (found)
-                                {
-                                    pGS->referencePoint.X = pGS->X;
-                                    pGS->referencePoint.Y = pGS->Y;
-                                    pGS->wasLost = false;
-                                    ++pGS;
-                                }
-                                else
-                                {
-                                    // Don't need to update reference point, lost star will continue to use the
-                                    // offsetFromPrimary location for possible recovery
-                                    pGS->wasLost = true;
-                                    ++pGS;
-                                }
-                            }
-                            return false; // All the secondary stars reference points reflect current positions
-                        }
-                    }
-                }
-            }
-            else
-                m_stabilizing = true; // get some data for primary star movement
-
-            if (!m_stabilizing && m_guideStars.size() > 1 && (sumX != 0 || sumY != 0))
-            {
-                wxString secondaryInfo = "MultiStar: ";
-                for (auto pGS = m_guideStars.begin() + 1; pGS != m_guideStars.end();)
-                {
-                    if (m_starsUsed >= m_maxStars || m_guideStars.size() == 1)
-                        break;
-                    bool found = false;
-                    if (pGS->wasLost)
-                    {
-                        // Look for it based on its original offset from the primary star
-                        PHD_Point expectedLoc = m_primaryStar + pGS->offsetFromPrimary;
-                        found = pGS->Find(pImage, m_searchRegion, expectedLoc.X, expectedLoc.Y, pFrame->GetStarFindMode(),
-                                          GetMinStarHFD(), GetMaxStarHFD(), pCamera->GetSaturationADU(),
-                                          Star::FIND_LOGGING_MINIMAL);
-                    }
-                    else
-                        // Look for it where we last found it
-                        found = pGS->Find(pImage, m_searchRegion, pGS->X, pGS->Y, pFrame->GetStarFindMode(), GetMinStarHFD(),
-                                          GetMaxStarHFD(), pCamera->GetSaturationADU(), Star::FIND_LOGGING_MINIMAL);
-                    if (found)
-                    {
-                        double dX = pGS->X - pGS->referencePoint.X;
-                        double dY = pGS->Y - pGS->referencePoint.Y;
-
-                        pGS->wasLost = false;
-                        m_starsUsed++;
-
-                        if (dX != 0. || dY != 0.)
-                        {
-                            // Handle zero-counting - suspect results of exactly zero movement
-                            if (dX == 0. || dY == 0.)
-                                ++pGS->zeroCount;
-                            else if (pGS->zeroCount > 0)
-                                --pGS->zeroCount;
-
-                            if (pGS->zeroCount == 5)
-                            {
-                                AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "DZ");
-                                pGS = m_guideStars.erase(pGS);
-                                erasures = true;
-                                continue;
-                            }
-
-                            // Handle suspicious excursions - counted as "misses"
-                            secondaryDistance = hypot(dX, dY);
-                            if (secondaryDistance > 2.5 * primarySigma)
-                            {
-                                if (++pGS->missCount > 10)
-                                {
-                                    // Reset the reference point to wherever it is now
-                                    pGS->referencePoint.X = pGS->X;
-                                    pGS->referencePoint.Y = pGS->Y;
-                                    pGS->missCount = 0;
-                                    AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0, "R");
-                                }
-                                else
-                                    AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0,
-                                                  "M" + std::to_string(pGS->missCount));
-                                ++pGS;
-                                continue;
-                            }
-                            else if (pGS->missCount > 0)
-                            {
-                                --pGS->missCount;
-                            }
-
-                            // At this point we have usable data from the secondary star
-                            double wt = (pGS->SNR / m_primaryStar.SNR);
-                            sumX += wt * dX;
-                            sumY += wt * dY;
-                            sumWeights += wt;
-                            averaged = true;
-                            validStars++;
-
-                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, wt, "U");
-                        }
-                        else // exactly zero on both axes, probably a hot pixel, drop it
-                        {
-                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "DZ");
-                            pGS = m_guideStars.erase(pGS);
-                            erasures = true;
-                        }
-                    }
-                    else
-                    {
-                        // star not found in its search region
-                        AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "L");
-                        pGS->wasLost = true;
-                    }
-                    if (!erasures)
-                        ++pGS;
-                    else
-                        erasures = false;
-                } // End of looping through secondary stars
-                Debug.Write(secondaryInfo + "\n");
-
-                if (averaged)
-                {
-                    sumX = sumX / sumWeights;
-                    sumY = sumY / sumWeights;
-                    if (hypot(sumX, sumY) < primaryDistance) // Apply average only if its smaller than single-star delta
-                    {
-                        pOffset->cameraOfs.X = sumX;
-                        pOffset->cameraOfs.Y = sumY;
-                        refined = true;
-                    }
-                    Debug.Write(wxString::Format("%s, %d included, MultiStar: {%0.2f, %0.2f}, one-star: {%0.2f, %0.2f}\n",
-                                                 (refined ? "refined" : "single-star"), validStars, sumX, sumY,
-                                                 origOffset.cameraOfs.X, origOffset.cameraOfs.Y));
-                }
-            }
-        }
-    }
-    catch (const wxString& msg)
-    {
-        Debug.Write(wxString::Format("MultiStar fault: exception at %d, %s, reverting to single-star mode\n", __LINE__, msg));
-        m_multiStarMode = false;
-    }
-
-    return refined;
-#undef Iter_Inx
-}
-
 static DistanceChecker s_distanceChecker;
 
 bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, GuiderOffset *ofs, FrameDroppedInfo *errorInfo)
@@ -938,74 +493,49 @@ bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, GuiderOffset
 
     try
     {
-        Star newStar(m_primaryStar);
+        // use the measurement made on the worker thread if it is still valid,
+        // otherwise measure the frame here the same way
+        std::unique_ptr<StarMeasurement> localMeasurement;
+        const StarMeasurement *measured = FrameMeasurement();
+        if (!measured)
+        {
+            StarSearchPlan plan;
+            if (!GetSearchPlan(&plan))
+                throw ERROR_INFO("UpdateCurrentPosition(): no search plan");
+            localMeasurement.reset(MeasureFrame(pImage, plan));
+            measured = localMeasurement.get();
+        }
+
+        RestoreTrackingState(measured->state);
+
+        const Star& newStar = measured->star;
 
-        if (!newStar.Find(pImage, m_searchRegion, pFrame->GetStarFindMode(), GetMinStarHFD(), GetMaxStarHFD(),
-                          pCamera->GetSaturationADU(), Star::FIND_LOGGING_VERBOSE))
+        switch (measured->result)
         {
+        case StarMeasurement::STAR_LOST:
             errorInfo->starError = newStar.GetError();
             errorInfo->starMass = 0.0;
             errorInfo->starSNR = 0.0;
             errorInfo->starHFD = 0.0;
             errorInfo->status = StarStatusStr(newStar);
-            m_primaryStar.SetError(newStar.GetError());
 
-            s_distanceChecker.Activate();
             ImageLogger::LogImage(pImage, *errorInfo);
 
             throw ERROR_INFO("UpdateCurrentPosition():newStar not found");
-        }
-
-        // check to see if it seems like the star we just found was the
-        // same as the original star by comparing the mass
-        if (m_massChangeThresholdEnabled)
-        {
-            int exposure;
-            bool isAutoExp;
-            pFrame->GetExposureInfo(&exposure, &isAutoExp);
-            m_massChecker->SetExposure(exposure, isAutoExp);
-            double limits[4];
-            if (m_massChecker->CheckMass(newStar.Mass, m_massChangeThreshold, limits))
-            {
-                m_primaryStar.SetError(Star::STAR_MASSCHANGE);
-                errorInfo->starError = Star::STAR_MASSCHANGE;
-                errorInfo->starMass = newStar.Mass;
-                errorInfo->starSNR = newStar.SNR;
-                errorInfo->starHFD = newStar.HFD;
-                errorInfo->status = StarStatusStr(m_primaryStar);
-                pFrame->StatusMsg(wxString::Format(_("Mass: %.f vs %.f"), newStar.Mass, limits[1]));
-
-                Debug.Write(wxString::Format(
-                    "UpdateCurrentPosition: star mass new=%.1f exp=%.1f thresh=%.0f%% limits=(%.1f, %.1f, %.1f)\n",
-                    newStar.Mass, limits[1], m_massChangeThreshold * 100., limits[0], limits[2], limits[3]));
 
-                m_massChecker->AppendData(newStar.Mass);
-
-                s_distanceChecker.Activate();
-                ImageLogger::LogImage(pImage, *errorInfo);
-
-                throw THROW_INFO("massChangeThreshold error");
-            }
-        }
+        case StarMeasurement::STAR_MASS_CHANGED:
+            errorInfo->starError = Star::STAR_MASSCHANGE;
+            errorInfo->starMass = newStar.Mass;
+            errorInfo->starSNR = newStar.SNR;
+            errorInfo->starHFD = newStar.HFD;
+            errorInfo->status = StarStatusStr(m_primaryStar);
+            pFrame->StatusMsg(wxString::Format(_("Mass: %.f vs %.f"), newStar.Mass, measured->massLimits[1]));
 
-        const PHD_Point& lockPos = LockPosition();
-        double distance;
-        bool raOnly = MyFrame::GuidingRAOnly();
-        if (lockPos.IsValid())
-        {
-            if (raOnly)
-                distance = fabs(newStar.X - lockPos.X);
-            else
-                distance = newStar.Distance(lockPos);
-        }
-        else
-            distance = 0.;
+            ImageLogger::LogImage(pImage, *errorInfo);
 
-        double tolerance = m_tolerateJumpsEnabled ? m_tolerateJumpsThreshold : 9e99;
+            throw THROW_INFO("massChangeThreshold error");
 
-        if (!s_distanceChecker.CheckDistance(distance, raOnly, tolerance))
-        {
-            m_primaryStar.SetError(Star::STAR_ERROR);
+        case StarMeasurement::STAR_JUMPED:
             errorInfo->starError = Star::STAR_ERROR;
             errorInfo->starMass = newStar.Mass;
             errorInfo->starSNR = newStar.SNR;
@@ -1016,24 +546,20 @@ bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, GuiderOffset
             ImageLogger::LogImage(pImage, *errorInfo);
 
             throw THROW_INFO("CheckDistance error");
-        }
 
-        ImageLogger::LogImage(pImage, distance);
+        case StarMeasurement::STAR_FOUND:
+            break;
+        }
 
-        // update the star position, mass, etc.
-        m_primaryStar = newStar;
-        m_massChecker->AppendData(newStar.Mass);
+        ImageLogger::LogImage(pImage, measured->distance);
 
+        const PHD_Point& lockPos = LockPosition();
         if (lockPos.IsValid())
         {
-            ofs->cameraOfs = m_primaryStar - lockPos;
-            if (m_multiStarMode && m_guideStars.size() > 1)
-            {
-                if (RefineOffset(pImage, ofs))
-                    distance = hypot(ofs->cameraOfs.X, ofs->cameraOfs.Y); // Distance is reported to server clients
-            }
-            else
-                m_starsUsed = 1;
+            ofs->cameraOfs = measured->offset;
+            double distance = measured->distance;
+            if (measured->refined)
+                distance = hypot(ofs->cameraOfs.X, ofs->cameraOfs.Y); // Distance is reported to server clients
 
             if (pMount && pMount->IsCalibrated())
                 pMount->TransformCameraCoordinatesToMountCoordinates(ofs->cameraOfs, ofs->mountOfs, true);
@@ -1057,6 +583,68 @@ bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, GuiderOffset
     return bError;
 }
 
+// What MeasureFrame needs to measure the next frame: the settings and the star tracking state
+bool GuiderMultiStar::GetSearchPlan(StarSearchPlan *plan) const
+{
+    if (!m_primaryStar.IsValid() && m_primaryStar.X == 0.0 && m_primaryStar.Y == 0.0)
+        return false; // no star selected
+
+    if (!pCamera)
+        return false;
+
+    plan->searchRegion = m_searchRegion;
+    plan->findMode = pFrame->GetStarFindMode();
+    plan->minHFD = GetMinStarHFD();
+    plan->maxHFD = GetMaxStarHFD();
+    plan->saturation = pCamera->GetSaturationADU();
+    plan->maxStars = m_maxStars;
+    plan->stabilitySigmaX = m_stabilitySigmaX;
+
+    plan->massChangeThresholdEnabled = m_massChangeThresholdEnabled;
+    plan->massChangeThreshold = m_massChangeThreshold;
+    pFrame->GetExposureInfo(&plan->exposure, &plan->autoExposure);
+    plan->jumpTolerance = m_tolerateJumpsEnabled ? m_tolerateJumpsThreshold : 9e99;
+    plan->raOnly = MyFrame::GuidingRAOnly();
+    plan->avgDistance = CurrentErrorSmoothed(plan->raOnly);
+    plan->avgDistanceCount = CurrentErrorFrameCount();
+
+    plan->lockPosition = LockPosition();
+    plan->guiding = IsGuiding();
+    plan->paused = IsPaused();
+    plan->settling = PhdController::IsSettling();
+    plan->guidingEnabled = pMount && pMount->GetGuidingEnabled();
+
+    SaveTrackingState(&plan->state);
+
+    return true;
+}
+
+void GuiderMultiStar::SaveTrackingState(StarTrackingState *state) const
+{
+    state->primary = m_primaryStar;
+    state->guideStars = m_guideStars;
+    state->primaryDistStats = *m_primaryDistStats;
+    state->massChecker = *m_massChecker;
+    state->distanceChecker = s_distanceChecker;
+    state->multiStarMode = m_multiStarMode;
+    state->stabilizing = m_stabilizing;
+    state->lockPositionMoved = m_lockPositionMoved;
+    state->starsUsed = m_starsUsed;
+}
+
+void GuiderMultiStar::RestoreTrackingState(const StarTrackingState& state)
+{
+    m_primaryStar = state.primary;
+    m_guideStars = state.guideStars;
+    *m_primaryDistStats = state.primaryDistStats;
+    *m_massChecker = state.massChecker;
+    s_distanceChecker = state.distanceChecker;
+    m_multiStarMode = state.multiStarMode;
+    m_stabilizing = state.stabilizing;
+    m_lockPositionMoved = state.lockPositionMoved;
+    m_starsUsed = state.starsUsed;
+}
+
 bool GuiderMultiStar::SetLockPosition(const PHD_Point& position)
 {
     if (!Guider::SetLockPosition(position))
@@ -1088,9 +676,7 @@ bool GuiderMultiStar::IsValidSecondaryStarPosition(const PHD_Point& pt)
     const usImage *pImage = CurrentImage();
     if (!pImage)
         return false;
-    // As above, tightly coupled to Star::Find but with somewhat relaxed constraints. Find handles cases where search region is
-    // only partly within image
-    return pt.X >= 5 && pt.X + 5 < pImage->Size.GetX() && pt.Y >= 5 && pt.Y + 5 < pImage->Size.GetY();
+    return ::IsValidSecondaryStarPosition(pt, pImage->Size);
 }
 
 void GuiderMultiStar::OnLClick(wxMouseEvent& mevent)
@@ -1288,13 +874,13 @@ void GuiderMultiStar::SaveStarFITS()
         start_x = pImage->Size.GetWidth() - 60;
     if ((start_y + 60) > pImage->Size.GetHeight())
         start_y = pImage->Size.GetHeight() - 60;
-    int x, y, width;
-    width = pImage->Size.GetWidth();
+    int x, y;
+    const wxRect valid = pImage->ValidRect(); // zero outside the subframe
     unsigned short *usptr = tmpimg.ImageData;
     for (y = 0; y < 60; y++)
     {
         for (x = 0; x < 60; x++, usptr++)
-            *usptr = *(pImage->ImageData + (y + start_y) * width + (x + start_x));
+            *usptr = valid.Contains(x + start_x, y + start_y) ? pImage->Pixel(x + start_x, y + start_y) : 0;
     }
 
     imgLogDirectory = Debug.GetLogDir() + PATHSEPSTR + "PHD2_Stars";
@@ -44,7 +44,6 @@
 #ifndef GUIDER_MULTISTAR_H_INCLUDED
 #define GUIDER_MULTISTAR_H_INCLUDED
 
-class MassChecker;
 class GuiderMultiStar;
 class GuiderConfigDialogCtrlSet;
 
@@ -112,7 +111,6 @@ public:
     bool SetMassChangeThreshold(double starMassChangeThreshold);
     bool SetTolerateJumps(bool enable, double threshold);
     bool SetSearchRegion(int searchRegion);
-    bool RefineOffset(const usImage *pImage, GuiderOffset *pOffset);
 
     friend class GuiderMultiStarConfigDialogPane;
     friend class GuiderMultiStarConfigDialogCtrlSet;
@@ -147,6 +145,9 @@ private:
     bool IsValidSecondaryStarPosition(const PHD_Point& pt) final;
     void InvalidateCurrentPosition(bool fullReset = false) final;
     bool UpdateCurrentPosition(const usImage *pImage, GuiderOffset *ofs, FrameDroppedInfo *errorInfo) final;
+    bool GetSearchPlan(StarSearchPlan *plan) const final;
+    void SaveTrackingState(StarTrackingState *state) const;
+    void RestoreTrackingState(const StarTrackingState& state);
     bool SetCurrentPosition(const usImage *pImage, const PHD_Point& position) final;
 
     void OnLClick(wxMouseEvent& evt);
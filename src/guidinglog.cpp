@@ -34,6 +34,7 @@
  */
 
 #include "phd.h"
+#include "guidelog_binary.h"
 
 #include <wx/wfstream.h>
 #include <wx/txtstrm.h>
@@ -41,10 +42,19 @@
 #define GUIDELOG_VERSION _T("2.5")
 
 const int RetentionPeriod = 60;
+const int DefaultFlushInterval = 5; // seconds
+const int DefaultFlushLines = 100;
 
-GuidingLog::GuidingLog() : m_enabled(false), m_keepFile(false), m_isGuiding(false) { }
+GuidingLog::GuidingLog()
+    : m_enabled(false), m_keepFile(false), m_isGuiding(false), m_flushInterval(DefaultFlushInterval),
+      m_flushLines(DefaultFlushLines), m_unflushedLines(0), m_lastFlush(0), m_flushTimer(nullptr), m_binaryLog(false)
+{
+}
 
-GuidingLog::~GuidingLog() { }
+GuidingLog::~GuidingLog()
+{
+    delete m_flushTimer;
+}
 
 static wxString PierSideStr(PierSide p)
 {
@@ -299,6 +309,9 @@ void GuidingLog::EnableLogging()
         if (pFrame && pFrame->pGuider->IsGuiding())
             GuidingHeader(m_file);
 
+        if (m_binaryLog)
+            OpenBinaryLog();
+
         Flush();
     }
     catch (const wxString& Msg)
@@ -309,6 +322,10 @@ void GuidingLog::EnableLogging()
 
 void GuidingLog::EnableLogging(bool enable)
 {
+    m_flushInterval = wxMax(0, pConfig->Global.GetInt("/GuideLog/FlushInterval", DefaultFlushInterval));
+    m_flushLines = wxMax(1, pConfig->Global.GetInt("/GuideLog/FlushLines", DefaultFlushLines));
+    m_binaryLog = pConfig->Global.GetBoolean("/GuideLog/Binary", false);
+
     if (enable)
         EnableLogging();
     else
@@ -359,6 +376,110 @@ bool GuidingLog::ChangeDirLog(const wxString& newdir)
 void GuidingLog::RemoveOldFiles()
 {
     Logger::RemoveMatchingFiles("PHD2_GuideLog*.txt", RetentionPeriod);
+    Logger::RemoveMatchingFiles("PHD2_GuideLog*.bin", RetentionPeriod);
+}
+
+void GuidingLog::SetFlushInterval(int seconds)
+{
+    m_flushInterval = wxMax(0, seconds);
+    pConfig->Global.SetInt("/GuideLog/FlushInterval", m_flushInterval);
+    Flush();
+}
+
+void GuidingLog::SetBinaryLog(bool enable)
+{
+    m_binaryLog = enable;
+    pConfig->Global.SetBoolean("/GuideLog/Binary", m_binaryLog);
+
+    if (!m_binaryLog)
+        CloseBinaryLog(m_keepFile);
+    else if (m_enabled)
+        OpenBinaryLog();
+}
+
+// The binary log sits next to the text log and has the same name with a .bin
+// extension; it holds only the guide step rows, the text log is still written
+void GuidingLog::OpenBinaryLog()
+{
+    if (m_binFile.IsOpened() || !m_file.IsOpened())
+        return;
+
+    try
+    {
+        wxFileName fn(m_fileName);
+        fn.SetExt("bin");
+        m_binFileName = fn.GetFullPath();
+
+        if (!m_binFile.Open(m_binFileName, "ab"))
+        {
+            throw ERROR_INFO("unable to open binary guide log");
+        }
+        if (m_binFile.Length() == 0 && !GuideLogBinaryWriteHeader(m_binFile.fp()))
+        {
+            m_binFile.Close();
+            throw ERROR_INFO("unable to write binary guide log header");
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+    }
+}
+
+void GuidingLog::CloseBinaryLog(bool keep)
+{
+    if (!m_binFile.IsOpened())
+        return;
+
+    m_binFile.Close();
+
+    if (!keep)
+        wxRemove(m_binFileName);
+}
+
+struct GuideLogFlushTimer : public wxTimer
+{
+    GuidingLog *m_log;
+    GuideLogFlushTimer(GuidingLog *log) : m_log(log) { }
+    void Notify() override { m_log->FlushIfDue(); }
+};
+
+// Guide steps and dropped frames arrive every exposure, so rather than flush
+// each line, flush when the oldest unflushed line is m_flushInterval seconds
+// old or m_flushLines lines are pending. An interval of 0 flushes every line.
+// A timer covers the case where the steps stop (star lost, guiding paused or
+// stopped) before the next line would have triggered the flush.
+void GuidingLog::DeferredFlush()
+{
+    ++m_unflushedLines;
+
+    if (m_flushInterval > 0 && m_unflushedLines < (unsigned int) m_flushLines)
+    {
+        wxLongLong_t wait = m_lastFlush + m_flushInterval * 1000LL - ::wxGetUTCTimeMillis().GetValue();
+        if (wait > 0)
+        {
+            if (!m_flushTimer)
+                m_flushTimer = new GuideLogFlushTimer(this);
+            if (!m_flushTimer->IsRunning())
+                m_flushTimer->StartOnce((int) wait);
+            return;
+        }
+    }
+
+    Flush();
+}
+
+void GuidingLog::FlushIfDue()
+{
+    if (!m_enabled || m_unflushedLines == 0)
+        return;
+
+    // there may have been a flush since the timer was started
+    wxLongLong_t wait = m_lastFlush + m_flushInterval * 1000LL - ::wxGetUTCTimeMillis().GetValue();
+    if (m_flushInterval > 0 && wait > 0)
+        m_flushTimer->StartOnce((int) wait);
+    else
+        Flush();
 }
 
 bool GuidingLog::Flush()
@@ -368,6 +489,9 @@ bool GuidingLog::Flush()
 
     bool error = false;
 
+    m_unflushedLines = 0;
+    m_lastFlush = ::wxGetUTCTimeMillis().GetValue();
+
     try
     {
         assert(m_file.IsOpened());
@@ -376,6 +500,11 @@ bool GuidingLog::Flush()
         {
             throw ERROR_INFO("unable to flush file");
         }
+
+        if (m_binFile.IsOpened() && !m_binFile.Flush())
+        {
+            throw ERROR_INFO("unable to flush binary guide log");
+        }
     }
     catch (const wxString& Msg)
     {
@@ -403,6 +532,11 @@ void GuidingLog::CloseGuideLog()
         m_file.Close();
     }
 
+    CloseBinaryLog(m_keepFile);
+
+    delete m_flushTimer;
+    m_flushTimer = nullptr;
+
     m_enabled = false;
 
     if (!m_keepFile) // Delete the file if nothing useful was logged
@@ -531,6 +665,15 @@ void GuidingLog::GuidingStarted()
     // add common guiding header
     GuidingHeader(m_file);
 
+    if (m_binFile.IsOpened())
+    {
+        GuideLogRecord rec;
+        rec.Clear();
+        rec.kind = GLR_GUIDING_BEGIN;
+        rec.time = (double) pFrame->m_guidingStarted.GetTicks();
+        GuideLogBinaryWriteRecord(m_binFile.fp(), rec);
+    }
+
     Flush();
 
     m_keepFile = true;
@@ -548,7 +691,18 @@ void GuidingLog::GuidingStopped()
     ++m_summary.guide_cnt;
     m_summary.guide_dur += pFrame->TimeSinceGuidingStarted();
 
-    m_file.Write("Guiding Ends at " + wxDateTime::Now().Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    wxDateTime now = wxDateTime::Now();
+    m_file.Write("Guiding Ends at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+
+    if (m_binFile.IsOpened())
+    {
+        GuideLogRecord rec;
+        rec.Clear();
+        rec.kind = GLR_GUIDING_END;
+        rec.time = (double) now.GetTicks();
+        GuideLogBinaryWriteRecord(m_binFile.fp(), rec);
+    }
+
     Flush();
 }
 
@@ -559,27 +713,45 @@ void GuidingLog::GuideStep(const GuideStepInfo& step)
 
     assert(m_file.IsOpened());
 
-    m_file.Write(wxString::Format("%d,%.3f,\"%s\",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,", step.frameNumber, step.time,
-                                  step.mount->IsStepGuider() ? "AO" : "Mount", step.cameraOffset.X, step.cameraOffset.Y,
-                                  step.mountOffset.X, step.mountOffset.Y, step.guideDistanceRA, step.guideDistanceDec));
+    GuideLogRecord rec;
+    rec.Clear();
+    rec.frame = step.frameNumber;
+    rec.time = step.time;
+    rec.dx = step.cameraOffset.X;
+    rec.dy = step.cameraOffset.Y;
+    rec.raRaw = step.mountOffset.X;
+    rec.decRaw = step.mountOffset.Y;
+    rec.raGuide = step.guideDistanceRA;
+    rec.decGuide = step.guideDistanceDec;
+    rec.starMass = step.starMass;
+    rec.snr = step.starSNR;
+    rec.errorCode = step.starError;
 
     if (step.mount->IsStepGuider())
     {
-        int xSteps = step.directionRA == LEFT ? -step.durationRA : step.durationRA;
-        int ySteps = step.directionDec == DOWN ? -step.durationDec : step.durationDec;
-        m_file.Write(wxString::Format(",,,,%d,%d,", xSteps, ySteps));
+        rec.kind = GLR_AO;
+        rec.xStep = step.directionRA == LEFT ? -step.durationRA : step.durationRA;
+        rec.yStep = step.directionDec == DOWN ? -step.durationDec : step.durationDec;
     }
     else
     {
-        m_file.Write(wxString::Format(
-            "%d,%s,%d,%s,,,", step.durationRA,
-            step.durationRA > 0 ? step.mount->DirectionChar((GUIDE_DIRECTION) step.directionRA) : "", step.durationDec,
-            step.durationDec > 0 ? step.mount->DirectionChar((GUIDE_DIRECTION) step.directionDec) : ""));
+        rec.kind = GLR_MOUNT;
+        rec.raDuration = step.durationRA;
+        rec.decDuration = step.durationDec;
+        if (step.durationRA > 0)
+            rec.raDir = step.mount->DirectionChar((GUIDE_DIRECTION) step.directionRA)[0];
+        if (step.durationDec > 0)
+            rec.decDir = step.mount->DirectionChar((GUIDE_DIRECTION) step.directionDec)[0];
     }
 
-    m_file.Write(wxString::Format("%.f,%.2f,%d\n", step.starMass, step.starSNR, step.starError));
+    m_line.clear();
+    GuideLogFormatRow(&m_line, rec);
+    m_file.Write(m_line.data(), m_line.size());
 
-    Flush();
+    if (m_binFile.IsOpened())
+        GuideLogBinaryWriteRecord(m_binFile.fp(), rec);
+
+    DeferredFlush();
 }
 
 void GuidingLog::FrameDropped(const FrameDroppedInfo& info)
@@ -589,10 +761,26 @@ void GuidingLog::FrameDropped(const FrameDroppedInfo& info)
 
     assert(m_file.IsOpened());
 
-    m_file.Write(wxString::Format("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"%s\"\n", info.frameNumber, info.time,
-                                  info.starMass, info.starSNR, info.starError, info.status));
+    GuideLogRecord rec;
+    rec.Clear();
+    rec.kind = GLR_DROP;
+    rec.frame = info.frameNumber;
+    rec.time = info.time;
+    rec.starMass = info.starMass;
+    rec.snr = info.starSNR;
+    rec.errorCode = info.starError;
 
-    Flush();
+    wxScopedCharBuffer status = info.status.utf8_str();
+    rec.SetStatus(status.data());
+
+    m_line.clear();
+    GuideLogFormatRow(&m_line, rec, status.data());
+    m_file.Write(m_line.data(), m_line.size());
+
+    if (m_binFile.IsOpened())
+        GuideLogBinaryWriteRecord(m_binFile.fp(), rec);
+
+    DeferredFlush();
 }
 
 void GuidingLog::CalibrationFrameDropped(const FrameDroppedInfo& info)
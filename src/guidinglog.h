@@ -40,6 +40,7 @@
 
 class Mount;
 class Guider;
+class wxTimer;
 struct LockPosShiftParams;
 
 struct CalibrationStepInfo
@@ -127,8 +128,28 @@ class GuidingLog : public Logger
     bool m_isGuiding;
     GuideLogSummaryInfo m_summary;
 
+    // guide steps and dropped frames are flushed after m_flushInterval
+    // seconds or m_flushLines lines, whichever comes first; everything else
+    // is flushed immediately
+    int m_flushInterval;
+    int m_flushLines;
+    unsigned int m_unflushedLines;
+    wxLongLong_t m_lastFlush;
+    wxTimer *m_flushTimer; // flushes pending lines when no further lines arrive
+
+    bool m_binaryLog;
+    wxFFile m_binFile;
+    wxString m_binFileName;
+    std::string m_line;
+
     void EnableLogging();
     void DisableLogging();
+    void OpenBinaryLog();
+    void CloseBinaryLog(bool keep);
+    void DeferredFlush();
+    void FlushIfDue();
+
+    friend struct GuideLogFlushTimer;
 
 public:
     GuidingLog();
@@ -139,6 +160,11 @@ public:
     bool Flush();
     void CloseGuideLog();
 
+    int GetFlushInterval() const;
+    void SetFlushInterval(int seconds);
+    bool GetBinaryLog() const;
+    void SetBinaryLog(bool enable);
+
     wxFFile& File();
 
     void StartCalibration(const Mount *pCalibrationMount);
@@ -183,6 +209,16 @@ inline wxFFile& GuidingLog::File()
     return m_file;
 }
 
+inline int GuidingLog::GetFlushInterval() const
+{
+    return m_flushInterval;
+}
+
+inline bool GuidingLog::GetBinaryLog() const
+{
+    return m_binaryLog;
+}
+
 extern GuidingLog GuideLog;
 
 #endif
@@ -0,0 +1,290 @@
+/*
+ *  image_kernels.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "image_kernels.h"
+
+#if defined(PHD_HAVE_SSE2)
+# include <emmintrin.h>
+#endif
+#if defined(PHD_HAVE_AVX2)
+# include <immintrin.h>
+#endif
+#if defined(PHD_HAVE_NEON)
+# include <arm_neon.h>
+#endif
+
+void SubtractDarkRect(unsigned short *light, int lightRowsize, const unsigned short *dark, int darkRowsize, int width,
+                      int height, unsigned short pedestal)
+{
+    unsigned short *pl0 = light;
+    const unsigned short *pd0 = dark;
+
+    for (int r = 0; r < height; r++, pl0 += lightRowsize, pd0 += darkRowsize)
+    {
+        unsigned short *const endl = pl0 + width;
+        unsigned short *pl;
+        const unsigned short *pd;
+        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+        {
+            int newval = (int) *pl + pedestal - (int) *pd;
+            if (newval < 0)
+                newval = 0; // hot pixel in dark frame isn't present in light frame
+            else if (newval > 65535)
+                newval = 65535;
+            *pl = (unsigned short) newval;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// pixel format conversion
+// ----------------------------------------------------------------------------
+
+static void ConvertBigEndian16Scalar(unsigned short *dst, const unsigned char *src, unsigned int count, unsigned short flip)
+{
+    for (unsigned int i = 0; i < count; i++)
+        dst[i] = (unsigned short) ((src[2 * i] << 8) | src[2 * i + 1]) ^ flip;
+}
+
+static void WidenBytesScalar(unsigned short *dst, const unsigned char *src, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        dst[i] = src[i];
+}
+
+static void AccumulateBytesScalar(unsigned short *acc, const unsigned char *src, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        acc[i] += (unsigned short) src[i];
+}
+
+#if defined(PHD_HAVE_SSE2)
+
+static void ConvertBigEndian16_SSE2(unsigned short *dst, const unsigned char *src, unsigned int count, unsigned short flip)
+{
+    __m128i const vflip = _mm_set1_epi16((short) flip);
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + 2 * i));
+        v = _mm_xor_si128(_mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)), vflip);
+        _mm_storeu_si128((__m128i *) (dst + i), v);
+    }
+    ConvertBigEndian16Scalar(dst + i, src + 2 * i, count - i, flip);
+}
+
+static void WidenBytes_SSE2(unsigned short *dst, const unsigned char *src, unsigned int count)
+{
+    __m128i const z = _mm_setzero_si128();
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_unpacklo_epi8(v, z));
+        _mm_storeu_si128((__m128i *) (dst + i + 8), _mm_unpackhi_epi8(v, z));
+    }
+    WidenBytesScalar(dst + i, src + i, count - i);
+}
+
+static void AccumulateBytes_SSE2(unsigned short *acc, const unsigned char *src, unsigned int count)
+{
+    __m128i const z = _mm_setzero_si128();
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i a0 = _mm_loadu_si128((const __m128i *) (acc + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i *) (acc + i + 8));
+        _mm_storeu_si128((__m128i *) (acc + i), _mm_add_epi16(a0, _mm_unpacklo_epi8(v, z)));
+        _mm_storeu_si128((__m128i *) (acc + i + 8), _mm_add_epi16(a1, _mm_unpackhi_epi8(v, z)));
+    }
+    AccumulateBytesScalar(acc + i, src + i, count - i);
+}
+
+#endif // PHD_HAVE_SSE2
+
+#if defined(PHD_HAVE_AVX2)
+
+PHD_TARGET_AVX2 static void ConvertBigEndian16_AVX2(unsigned short *dst, const unsigned char *src, unsigned int count,
+                                                    unsigned short flip)
+{
+    __m256i const vflip = _mm256_set1_epi16((short) flip);
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + 2 * i));
+        v = _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)), vflip);
+        _mm256_storeu_si256((__m256i *) (dst + i), v);
+    }
+    ConvertBigEndian16Scalar(dst + i, src + 2 * i, count - i, flip);
+}
+
+PHD_TARGET_AVX2 static void WidenBytes_AVX2(unsigned short *dst, const unsigned char *src, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_cvtepu8_epi16(v));
+    }
+    WidenBytesScalar(dst + i, src + i, count - i);
+}
+
+PHD_TARGET_AVX2 static void AccumulateBytes_AVX2(unsigned short *acc, const unsigned char *src, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+        __m256i a = _mm256_loadu_si256((const __m256i *) (acc + i));
+        _mm256_storeu_si256((__m256i *) (acc + i), _mm256_add_epi16(a, v));
+    }
+    AccumulateBytesScalar(acc + i, src + i, count - i);
+}
+
+#endif // PHD_HAVE_AVX2
+
+#if defined(PHD_HAVE_NEON)
+
+static void ConvertBigEndian16_NEON(unsigned short *dst, const unsigned char *src, unsigned int count, unsigned short flip)
+{
+    uint16x8_t const vflip = vdupq_n_u16(flip);
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t v = vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(src + 2 * i)));
+        vst1q_u16(dst + i, veorq_u16(v, vflip));
+    }
+    ConvertBigEndian16Scalar(dst + i, src + 2 * i, count - i, flip);
+}
+
+static void WidenBytes_NEON(unsigned short *dst, const unsigned char *src, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(dst + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i + 8, vmovl_u8(vget_high_u8(v)));
+    }
+    WidenBytesScalar(dst + i, src + i, count - i);
+}
+
+static void AccumulateBytes_NEON(unsigned short *acc, const unsigned char *src, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v)));
+        vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v)));
+    }
+    AccumulateBytesScalar(acc + i, src + i, count - i);
+}
+
+#endif // PHD_HAVE_NEON
+
+void ConvertBigEndian16(unsigned short *dst, const unsigned char *src, unsigned int count, unsigned short flip, SimdLevel simd)
+{
+    switch (simd)
+    {
+#if defined(PHD_HAVE_AVX2)
+    case SIMD_AVX2:
+        ConvertBigEndian16_AVX2(dst, src, count, flip);
+        break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+    case SIMD_SSE2:
+        ConvertBigEndian16_SSE2(dst, src, count, flip);
+        break;
+#endif
+#if defined(PHD_HAVE_NEON)
+    case SIMD_NEON:
+        ConvertBigEndian16_NEON(dst, src, count, flip);
+        break;
+#endif
+    default:
+        ConvertBigEndian16Scalar(dst, src, count, flip);
+        break;
+    }
+}
+
+void WidenBytes(unsigned short *dst, const unsigned char *src, unsigned int count, SimdLevel simd)
+{
+    switch (simd)
+    {
+#if defined(PHD_HAVE_AVX2)
+    case SIMD_AVX2:
+        WidenBytes_AVX2(dst, src, count);
+        break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+    case SIMD_SSE2:
+        WidenBytes_SSE2(dst, src, count);
+        break;
+#endif
+#if defined(PHD_HAVE_NEON)
+    case SIMD_NEON:
+        WidenBytes_NEON(dst, src, count);
+        break;
+#endif
+    default:
+        WidenBytesScalar(dst, src, count);
+        break;
+    }
+}
+
+void AccumulateBytes(unsigned short *acc, const unsigned char *src, unsigned int count, SimdLevel simd)
+{
+    switch (simd)
+    {
+#if defined(PHD_HAVE_AVX2)
+    case SIMD_AVX2:
+        AccumulateBytes_AVX2(acc, src, count);
+        break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+    case SIMD_SSE2:
+        AccumulateBytes_SSE2(acc, src, count);
+        break;
+#endif
+#if defined(PHD_HAVE_NEON)
+    case SIMD_NEON:
+        AccumulateBytes_NEON(acc, src, count);
+        break;
+#endif
+    default:
+        AccumulateBytesScalar(acc, src, count);
+        break;
+    }
+}
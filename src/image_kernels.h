@@ -0,0 +1,58 @@
+/*
+ *  image_kernels.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef IMAGE_KERNELS_INCLUDED
+#define IMAGE_KERNELS_INCLUDED
+
+#include "cpu_features.h"
+
+// Per-pixel kernels used by the image math routines. Rectangles are given by
+// a pointer to their first pixel and the row stride of the image they are in.
+
+// light = clamp(light + pedestal - dark, 0, 65535) over a width x height
+// rectangle; the light and dark images may have different strides
+extern void SubtractDarkRect(unsigned short *light, int lightRowsize, const unsigned short *dark, int darkRowsize, int width,
+                             int height, unsigned short pedestal);
+
+// dst[i] = the big-endian 16-bit value at src + 2 * i, xor flip. A flip of
+// 0x8000 converts FITS signed 16-bit data with BZERO = 32768 to unsigned.
+extern void ConvertBigEndian16(unsigned short *dst, const unsigned char *src, unsigned int count, unsigned short flip,
+                               SimdLevel simd);
+
+// dst[i] = src[i]
+extern void WidenBytes(unsigned short *dst, const unsigned char *src, unsigned int count, SimdLevel simd);
+
+// acc[i] += src[i], modulo 65536
+extern void AccumulateBytes(unsigned short *acc, const unsigned char *src, unsigned int count, SimdLevel simd);
+
+#endif
@@ -34,12 +34,16 @@
 
 #include "phd.h"
 #include "image_math.h"
+#include "frame_pool.h"
+#include "median_kernels.h"
+#include "parallel.h"
 
 #include <wx/wfstream.h>
 #include <wx/txtstrm.h>
 #include <wx/tokenzr.h>
 
 #include <algorithm>
+#include <vector>
 
 int dbl_sort_func(double *first, double *second)
 {
@@ -80,28 +84,22 @@ bool QuickLRecon(usImage& img)
 {
     // Does a simple debayer of luminance data only -- sliding 2x2 window
     usImage tmp;
-    if (tmp.Init(img.Size))
+    if (tmp.InitLike(img))
     {
         pFrame->Alert(_("Memory allocation error"));
         return true;
     }
 
-    int const W = img.Size.GetWidth();
-    int RX, RY, RW, RH;
-    if (img.Subframe.IsEmpty())
-    {
-        RX = RY = 0;
-        RW = img.Size.GetWidth();
-        RH = img.Size.GetHeight();
-    }
-    else
-    {
-        RX = img.Subframe.GetX();
-        RY = img.Subframe.GetY();
-        RW = img.Subframe.GetWidth();
-        RH = img.Subframe.GetHeight();
+    // the valid pixels, in the coordinates of the image data
+    wxRect const rect = img.ToData(img.ValidRect());
+    if (rect.GetSize() != img.DataRect.GetSize())
         tmp.Clear();
-    }
+
+    int const W = img.RowStride();
+    int const RX = rect.GetX();
+    int const RY = rect.GetY();
+    int const RW = rect.GetWidth();
+    int const RH = rect.GetHeight();
 
 #define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
 
@@ -151,457 +149,64 @@ bool Median3(usImage& img)
 {
     usImage tmp;
 
-    if (tmp.Init(img.Size))
+    if (tmp.InitLike(img))
     {
         Debug.Write("Median3: ERROR: memory allocation failure!\n");
         return true;
     }
 
-    if (img.Subframe.IsEmpty())
-    {
-        Median3(tmp.ImageData, img.ImageData, img.Size, wxRect(img.Size));
-    }
-    else
-    {
+    wxRect const rect = img.ToData(img.ValidRect());
+    if (rect.GetSize() != img.DataRect.GetSize())
         tmp.Clear();
-        Median3(tmp.ImageData, img.ImageData, img.Size, img.Subframe);
-    }
+
+    Median3(tmp.ImageData, img.ImageData, img.DataRect.GetSize(), rect);
 
     img.SwapImageData(tmp);
 
     return false;
 }
 
-inline static void swap(unsigned short& a, unsigned short& b)
-{
-    unsigned short const t = a;
-    a = b;
-    b = t;
-}
-
-inline static unsigned short median9(const unsigned short l[9])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
-    unsigned short x;
-    x = l[5];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[6];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[7];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[8];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-
-    if (l1 > l0)
-        l0 = l1;
-    if (l2 > l0)
-        l0 = l2;
-    if (l3 > l0)
-        l0 = l3;
-    if (l4 > l0)
-        l0 = l4;
-
-    return l0;
-}
-
-inline static unsigned short median8(const unsigned short l[8])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
-    unsigned short x;
-
-    x = l[5];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[6];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[7];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-
-    if (l2 > l0)
-        swap(l2, l0);
-    if (l2 > l1)
-        swap(l2, l1);
-
-    if (l3 > l0)
-        swap(l3, l0);
-    if (l3 > l1)
-        swap(l3, l1);
-
-    if (l4 > l0)
-        swap(l4, l0);
-    if (l4 > l1)
-        swap(l4, l1);
-
-    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
-inline static unsigned short median6(const unsigned short l[6])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
-    unsigned short x;
-
-    x = l[4];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    x = l[5];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-
-    if (l2 > l0)
-        swap(l2, l0);
-    if (l2 > l1)
-        swap(l2, l1);
-
-    if (l3 > l0)
-        swap(l3, l0);
-    if (l3 > l1)
-        swap(l3, l1);
-
-    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
-inline static unsigned short median5(const unsigned short l[5])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
-    unsigned short x;
-    x = l[3];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    x = l[4];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-
-    if (l1 > l0)
-        l0 = l1;
-    if (l2 > l0)
-        l0 = l2;
-
-    return l0;
-}
-
-inline static unsigned short median4(const unsigned short l[4])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
-    unsigned short x;
-    x = l[3];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-
-    if (l2 > l0)
-        swap(l2, l0);
-    if (l2 > l1)
-        swap(l2, l1);
-
-    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
-inline static unsigned short median3(const unsigned short l[3])
+void Median3Row(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect, int y)
 {
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
-    if (l2 < l0)
-        swap(l2, l0);
-    if (l2 < l1)
-        swap(l2, l1);
-    if (l1 > l0)
-        l0 = l1;
-    return l0;
+    Median3FilterRow(dst, src, size.GetWidth(), ToFrameRect(rect), y);
 }
 
 void Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
 {
     int const W = size.GetWidth();
-    int const RX = rect.GetX();
-    int const RY = rect.GetY();
-    int const RW = rect.GetWidth();
     int const RH = rect.GetHeight();
 
-    unsigned short a[9];
-    unsigned short *d;
+    // split the rows into bands for the worker threads; a band is the unit
+    // of work so keep it large enough to amortize the scheduling
+    int const BAND_ROWS = 32;
+    int const nbands = (RH + BAND_ROWS - 1) / BAND_ROWS;
 
-#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
-
-    // top row
-    d = &dst[IX(0, 0)];
-
-    // top-left corner
-    a[0] = src[IX(0, 0)];
-    a[1] = src[IX(1, 0)];
-    a[2] = src[IX(0, 1)];
-    a[3] = src[IX(1, 1)];
-    *d++ = median4(a);
-
-    // top row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
-    {
-        a[0] = src[IX(x - 1, 0)];
-        a[1] = src[IX(x, 0)];
-        a[2] = src[IX(x + 1, 0)];
-        a[3] = src[IX(x - 1, 1)];
-        a[4] = src[IX(x, 1)];
-        a[5] = src[IX(x + 1, 1)];
-        *d++ = median6(a);
-    }
-
-    // top-right corner
-    a[0] = src[IX(RW - 2, 0)];
-    a[1] = src[IX(RW - 1, 0)];
-    a[2] = src[IX(RW - 2, 1)];
-    a[3] = src[IX(RW - 1, 1)];
-    *d = median4(a);
-
-    for (int y = 1; y <= RH - 2; y++)
-    {
-        d = &dst[IX(0, y)];
-
-        // leftmost pixel
-        a[0] = src[IX(0, y - 1)];
-        a[1] = src[IX(1, y - 1)];
-        a[2] = src[IX(0, y)];
-        a[3] = src[IX(1, y)];
-        a[4] = src[IX(0, y + 1)];
-        a[5] = src[IX(1, y + 1)];
-        *d++ = median6(a);
-
-        for (int x = 1; x <= RW - 2; x++)
-        {
-            a[0] = src[IX(x - 1, y - 1)];
-            a[1] = src[IX(x, y - 1)];
-            a[2] = src[IX(x + 1, y - 1)];
-            a[3] = src[IX(x - 1, y)];
-            a[4] = src[IX(x, y)];
-            a[5] = src[IX(x + 1, y)];
-            a[6] = src[IX(x - 1, y + 1)];
-            a[7] = src[IX(x, y + 1)];
-            a[8] = src[IX(x + 1, y + 1)];
-            *d++ = median9(a);
-        }
-
-        // rightmost pixel
-        a[0] = src[IX(RW - 2, y - 1)];
-        a[1] = src[IX(RW - 1, y - 1)];
-        a[2] = src[IX(RW - 2, y)];
-        a[3] = src[IX(RW - 1, y)];
-        a[4] = src[IX(RW - 2, y + 1)];
-        a[5] = src[IX(RW - 1, y + 1)];
-        *d++ = median6(a);
-    }
-
-    // bottom row
-    d = &dst[IX(0, RH - 1)];
-
-    // bottom-left corner
-    a[0] = src[IX(0, RH - 2)];
-    a[1] = src[IX(1, RH - 2)];
-    a[2] = src[IX(0, RH - 1)];
-    a[3] = src[IX(1, RH - 1)];
-    *d++ = median4(a);
-
-    // bottom row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
-    {
-        a[0] = src[IX(x - 1, RH - 2)];
-        a[1] = src[IX(x, RH - 2)];
-        a[2] = src[IX(x + 1, RH - 2)];
-        a[3] = src[IX(x - 1, RH - 1)];
-        a[4] = src[IX(x, RH - 1)];
-        a[5] = src[IX(x + 1, RH - 1)];
-        *d++ = median6(a);
-    }
-
-    // bottom-right corner
-    a[0] = src[IX(RW - 2, RH - 2)];
-    a[1] = src[IX(RW - 1, RH - 2)];
-    a[2] = src[IX(RW - 2, RH - 1)];
-    a[3] = src[IX(RW - 1, RH - 1)];
-    *d = median4(a);
-
-#undef IX
+    ParallelFor(nbands, [&](int band) {
+        int const y0 = band * BAND_ROWS;
+        int const y1 = std::min(y0 + BAND_ROWS, RH);
+        for (int y = y0; y < y1; y++)
+            Median3Row(&dst[(rect.GetY() + y) * W + rect.GetX()], src, size, rect, y);
+    });
 }
 
-static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
+const DefectIndex& DefectMap::GetIndex(const wxSize& frameSize) const
 {
-    unsigned short array[8];
-    int const xsize = img.Size.GetWidth();
-    int const ysize = img.Size.GetHeight();
-
-    if (x > 0 && y > 0 && x < xsize - 1 && y < ysize - 1)
+    // rebuild when the frame size changes or defects have been added
+    if (m_index.frameWidth == frameSize.GetWidth() && m_index.frameHeight == frameSize.GetHeight() &&
+        m_index.defectCount == size())
     {
-        array[0] = img.ImageData[(x - 1) + (y - 1) * xsize];
-        array[1] = img.ImageData[(x) + (y - 1) * xsize];
-        array[2] = img.ImageData[(x + 1) + (y - 1) * xsize];
-        array[3] = img.ImageData[(x - 1) + (y) *xsize];
-        array[4] = img.ImageData[(x + 1) + (y) *xsize];
-        array[5] = img.ImageData[(x - 1) + (y + 1) * xsize];
-        array[6] = img.ImageData[(x) + (y + 1) * xsize];
-        array[7] = img.ImageData[(x + 1) + (y + 1) * xsize];
-        return median8(array);
+        return m_index;
     }
 
-    if (x == 0 && y > 0 && y < ysize - 1)
-    {
-        // On left edge
-        array[0] = img.ImageData[(x) + (y - 1) * xsize];
-        array[1] = img.ImageData[(x) + (y + 1) * xsize];
-        array[2] = img.ImageData[(x + 1) + (y - 1) * xsize];
-        array[3] = img.ImageData[(x + 1) + (y) *xsize];
-        array[4] = img.ImageData[(x + 1) + (y + 1) * xsize];
-        return median5(array);
-    }
-
-    if (x == xsize - 1 && y > 0 && y < ysize - 1)
-    {
-        // On right edge
-        array[0] = img.ImageData[(x) + (y - 1) * xsize];
-        array[1] = img.ImageData[(x) + (y + 1) * xsize];
-        array[2] = img.ImageData[(x - 1) + (y - 1) * xsize];
-        array[3] = img.ImageData[(x - 1) + (y) *xsize];
-        array[4] = img.ImageData[(x - 1) + (y + 1) * xsize];
-        return median5(array);
-    }
-
-    if (y == 0 && x > 0 && x < xsize - 1)
-    {
-        // On bottom edge
-        array[0] = img.ImageData[(x - 1) + (y) *xsize];
-        array[1] = img.ImageData[(x - 1) + (y + 1) * xsize];
-        array[2] = img.ImageData[(x) + (y + 1) * xsize];
-        array[3] = img.ImageData[(x + 1) + (y) *xsize];
-        array[4] = img.ImageData[(x + 1) + (y + 1) * xsize];
-        return median5(array);
-    }
-
-    if (y == ysize - 1 && x > 0 && x < xsize - 1)
-    {
-        // On top edge
-        array[0] = img.ImageData[(x - 1) + (y) *xsize];
-        array[1] = img.ImageData[(x - 1) + (y - 1) * xsize];
-        array[2] = img.ImageData[(x) + (y - 1) * xsize];
-        array[3] = img.ImageData[(x + 1) + (y) *xsize];
-        array[4] = img.ImageData[(x + 1) + (y - 1) * xsize];
-        return median5(array);
-    }
+    std::vector<DefectPoint> pts;
+    pts.reserve(size());
+    for (const_iterator it = begin(); it != end(); ++it)
+        pts.push_back(DefectPoint{ it->x, it->y });
 
-    if (x == 0 && y == 0)
-    {
-        // At lower left corner
-        array[0] = img.ImageData[(x + 1) + (y) *xsize];
-        array[1] = img.ImageData[(x) + (y + 1) * xsize];
-        array[2] = img.ImageData[(x + 1) + (y + 1) * xsize];
-    }
-    else if (x == 0 && y == ysize - 1)
-    {
-        // At upper left corner
-        array[0] = img.ImageData[(x + 1) + (y) *xsize];
-        array[1] = img.ImageData[(x) + (y - 1) * xsize];
-        array[2] = img.ImageData[(x + 1) + (y - 1) * xsize];
-    }
-    else if (x == xsize - 1 && y == ysize - 1)
-    {
-        // At upper right corner
-        array[0] = img.ImageData[(x - 1) + (y) *xsize];
-        array[1] = img.ImageData[(x) + (y - 1) * xsize];
-        array[2] = img.ImageData[(x - 1) + (y - 1) * xsize];
-    }
-    else if (x == xsize - 1 && y == 0)
-    {
-        // At lower right corner
-        array[0] = img.ImageData[(x - 1) + (y) *xsize];
-        array[1] = img.ImageData[(x) + (y + 1) * xsize];
-        array[2] = img.ImageData[(x - 1) + (y + 1) * xsize];
-    }
-    else
-    {
-        // unreachable
-        return 0;
-    }
+    BuildDefectIndex(&m_index, frameSize.GetWidth(), frameSize.GetHeight(), pts.data(), pts.size());
+    m_index.defectCount = size();
 
-    return median3(array);
+    return m_index;
 }
 
 bool SquarePixels(usImage& img, float xsize, float ysize)
@@ -613,6 +218,13 @@ bool SquarePixels(usImage& img, float xsize, float ysize)
     if (xsize <= ysize)
         return false;
 
+    // the whole frame is stretched
+    if (img.Expand())
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
     // Move the existing data to a temp image
     usImage tempimg;
     if (tempimg.Init(img.Size))
@@ -646,9 +258,6 @@ bool SquarePixels(usImage& img, float xsize, float ysize)
     return false;
 }
 
-// Dark subtraction algorithm:
-//     Pedestal = max(median(dark_frame) - median(light_frame), 0) - handles overall gain/gradient differences
-//     Dark_corrected(i) = min(max(light(i) + pedestal - dark(i), 0), 65335)
 bool Subtract(usImage& light, const usImage& dark)
 {
     if (!light.ImageData || !dark.ImageData)
@@ -656,212 +265,86 @@ bool Subtract(usImage& light, const usImage& dark)
     if (light.Size != dark.Size)
         return true;
 
-    unsigned int left, top, width, height;
-    unsigned short median_light, median_dark;
-    median_light = light.MedianADU; // median of frame or subframe
-
-    if (!light.Subframe.IsEmpty())
-    {
-        left = light.Subframe.GetLeft();
-        width = light.Subframe.GetWidth();
-        top = light.Subframe.GetTop();
-        height = light.Subframe.GetHeight();
-
-        // compute the dark's median ADU within the subframe region
-        unsigned int pixcnt = width * height;
-        unsigned short *tmp = new unsigned short[pixcnt];
-        const unsigned short *src = dark.ImageData + left + top * light.Size.GetWidth();
-        unsigned short *dst = tmp;
-        for (int y = 0; y < height; y++)
-        {
-            memcpy(dst, src, width * sizeof(unsigned short));
-            src += light.Size.GetWidth();
-            dst += width;
-        }
-        std::nth_element(tmp, tmp + pixcnt / 2, tmp + pixcnt);
-        median_dark = tmp[pixcnt / 2];
-        delete[] tmp;
-    }
-    else
-    {
-        left = top = 0;
-        width = light.Size.GetWidth();
-        height = light.Size.GetHeight();
-        median_dark = dark.MedianADU; // use the pre-computed full frame median ADU
-    }
-
-    if (median_dark > median_light)
-    {
-        // dark was brighter than light
-        light.Pedestal = median_dark - median_light; // Needed for saturation detection in find-star
-    }
-
-    unsigned short *pl0 = &light.Pixel(left, top);
-    const unsigned short *pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height; r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
-    {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
-        {
-            int newval = (int) *pl + light.Pedestal - (int) *pd;
-            if (newval < 0)
-                newval = 0; // hot pixel in dark frame isn't present in light frame
-            else if (newval > 65535)
-                newval = 65535;
-            *pl = (unsigned short) newval;
-        }
-    }
+    SubtractDarkFrame(light.View(), light.MedianADU, dark.View(), dark.MedianADU, &light.Pedestal);
 
     return false;
 }
 
-inline static unsigned short histo_median(unsigned short histo1[256], unsigned short histo2[65536], int n)
-{
-    n /= 2;
-    unsigned int i;
-    for (i = 0; i < 256; i++)
-    {
-        if (histo1[i] > n)
-            break;
-        n -= histo1[i];
-    }
-    for (i <<= 8; i < 65536; i++)
-    {
-        if (histo2[i] > n)
-            break;
-        n -= histo2[i];
-    }
-    return i;
-}
-
 static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
 {
     dst.Init(src.Size);
-    unsigned short *d = &dst.ImageData[0];
-
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
-
-    for (int y = 0; y < height; y++)
-    {
-        int top = std::max(0, y - halfWidth);
-        int bot = std::min(y + halfWidth, height - 1);
-        int left = 0;
-        int right = halfWidth;
-
-        // TODO: we initialize the histogram at the start of each row, but we could make this faster
-        // if we scan left to right, move down, scan right to left, move down so we never need to
-        // reinitialize the histogram
-
-        // initialize 2-level histogram
-        unsigned short histo1[256];
-        unsigned short histo2[65536];
-        memset(&histo1[0], 0, sizeof(histo1));
-        memset(&histo2[0], 0, sizeof(histo2));
-
-        for (int j = top; j <= bot; j++)
-        {
-            const unsigned short *p = &src.Pixel(left, j);
-            for (int i = left; i <= right; i++, p++)
-            {
-                ++histo1[*p >> 8];
-                ++histo2[*p];
-            }
-        }
-        unsigned int n = (right - left + 1) * (bot - top + 1);
-
-        // read off first value for this row
-        *d++ = histo_median(histo1, histo2, n);
-
-        // loop across remaining columns for this row
-        for (int i = 1; i < width; i++)
-        {
-            left = std::max(0, i - halfWidth);
-            right = std::min(i + halfWidth, width - 1);
-
-            // remove leftmost column
-            if (left > 0)
-            {
-                const unsigned short *p = &src.Pixel(left - 1, top);
-                for (int j = top; j <= bot; j++, p += width)
-                {
-                    --histo1[*p >> 8];
-                    --histo2[*p];
-                }
-                n -= (bot - top + 1);
-            }
-
-            // add new column on right
-            if (i + halfWidth <= width - 1)
-            {
-                const unsigned short *p = &src.Pixel(right, top);
-                for (int j = top; j <= bot; j++, p += width)
-                {
-                    ++histo1[*p >> 8];
-                    ++histo2[*p];
-                }
-                n += (bot - top + 1);
-            }
-
-            *d++ = histo_median(histo1, histo2, n);
-        }
-    }
+    MedianFilter(dst.ImageData, src.ImageData, src.Size.GetWidth(), src.Size.GetHeight(), halfWidth);
 }
 
-struct ImageStatsWork
-{
-    ImageStats stats;
-    usImage temp;
-};
-
-static void GetImageStats(ImageStatsWork& w, const usImage& img, const wxRect& win)
+// Mean, standard deviation, median and MAD of the pixels in win. The order
+// statistics are read from a histogram of the pixel values rather than by
+// partially sorting a copy of the frame.
+static void GetImageStats(ImageStats& stats, const usImage& img, const wxRect& win)
 {
-    w.temp.Init(img.Size);
-
-    // Determine the mean and standard deviation
-    double a = 0.0;
-    double q = 0.0;
-    double k = 1.0;
-    double km1 = 0.0;
+    FramePoolBuffer<unsigned int> histo(65536);
+    memset(histo.get(), 0, 65536 * sizeof(unsigned int));
+    unsigned int lo = 65535, hi = 0;
 
     const unsigned short *p0 = &img.Pixel(win.GetLeft(), win.GetTop());
-    unsigned short *dst = &w.temp.ImageData[0];
     for (int y = 0; y < win.GetHeight(); y++)
     {
         const unsigned short *end = p0 + win.GetWidth();
         for (const unsigned short *p = p0; p < end; p++)
         {
-            *dst++ = *p;
-            double const x = (double) *p;
-            double const a0 = a;
-            a += (x - a) / k;
-            q += (x - a0) * (x - a);
-            km1 = k;
-            k += 1.0;
+            ++histo[*p];
+            lo = std::min(lo, (unsigned int) *p);
+            hi = std::max(hi, (unsigned int) *p);
         }
-        p0 += img.Size.GetWidth();
+        p0 += img.RowStride();
     }
 
-    w.stats.mean = a;
-    w.stats.stdev = sqrt(q / km1);
+    unsigned int const winPixels = win.GetWidth() * win.GetHeight();
 
-    int winPixels = win.GetWidth() * win.GetHeight();
-    unsigned short *tmp = &w.temp.ImageData[0];
-    std::nth_element(tmp, tmp + winPixels / 2, tmp + winPixels);
+    // Determine the mean and standard deviation
+    double sum = 0.0;
+    for (unsigned int v = lo; v <= hi; v++)
+        sum += (double) v * histo[v];
+    stats.mean = sum / winPixels;
 
-    w.stats.median = tmp[winPixels / 2];
+    double q = 0.0;
+    for (unsigned int v = lo; v <= hi; v++)
+    {
+        double const d = (double) v - stats.mean;
+        q += d * d * histo[v];
+    }
+    stats.stdev = sqrt(q / winPixels);
 
-    // replace each pixel with the absolute deviation from the median
-    unsigned short *p = tmp;
-    for (int i = 0; i < winPixels; i++)
+    // median: the value of rank winPixels / 2
+    unsigned int const rank = winPixels / 2;
+    unsigned int cnt = 0;
+    unsigned int med = lo;
+    for (; med < hi; med++)
     {
-        unsigned short ad = (unsigned short) std::abs((int) *p - (int) w.stats.median);
-        *p++ = ad;
+        cnt += histo[med];
+        if (cnt > rank)
+            break;
     }
-    std::nth_element(tmp, tmp + winPixels / 2, tmp + winPixels);
-    w.stats.mad = tmp[winPixels / 2];
+    stats.median = med;
+
+    // MAD: walk outwards from the median, counting the pixels at each
+    // absolute deviation
+    cnt = 0;
+    unsigned int dev = 0;
+    for (;; dev++)
+    {
+        if (dev == 0)
+            cnt += histo[med];
+        else
+        {
+            if (med + dev <= hi)
+                cnt += histo[med + dev];
+            if (dev <= med - lo)
+                cnt += histo[med - dev];
+        }
+        if (cnt > rank)
+            break;
+    }
+    stats.mad = dev;
 }
 
 void DefectMapDarks::BuildFilteredDark()
@@ -925,7 +408,7 @@ typedef std::set<BadPx> BadPxSet;
 struct DefectMapBuilderImpl
 {
     DefectMapDarks *darks;
-    ImageStatsWork w;
+    ImageStats stats;
     wxArrayString mapInfo;
     int aggrCold;
     int aggrHot;
@@ -959,10 +442,10 @@ void DefectMapBuilder::Init(DefectMapDarks& darks)
 
     Debug.AddLine("DefectMapBuilder: Init");
 
-    ::GetImageStats(m_impl->w, darks.masterDark,
+    ::GetImageStats(m_impl->stats, darks.masterDark,
                     wxRect(0, 0, darks.masterDark.Size.GetWidth(), darks.masterDark.Size.GetHeight()));
 
-    const ImageStats& stats = m_impl->w.stats;
+    const ImageStats& stats = m_impl->stats;
 
     Debug.Write(wxString::Format("DefectMapBuilder: Dark N = %u Mean = %.f Median = %d Standard Deviation = %.f MAD=%d\n",
                                  darks.masterDark.NPixels, stats.mean, stats.median, stats.stdev, stats.mad));
@@ -1002,7 +485,7 @@ void DefectMapBuilder::Init(DefectMapDarks& darks)
 
 const ImageStats& DefectMapBuilder::GetImageStats() const
 {
-    return m_impl->w.stats;
+    return m_impl->stats;
 }
 
 void DefectMapBuilder::SetAggressiveness(int aggrCold, int aggrHot)
@@ -1020,8 +503,8 @@ static void FindThresh(DefectMapBuilderImpl *impl)
     double multCold = AggrToSigma(impl->aggrCold);
     double multHot = AggrToSigma(impl->aggrHot);
 
-    int coldThresh = (int) (multCold * impl->w.stats.stdev);
-    int hotThresh = (int) (multHot * impl->w.stats.stdev);
+    int coldThresh = (int) (multCold * impl->stats.stdev);
+    int hotThresh = (int) (multHot * impl->stats.stdev);
 
     Debug.Write(wxString::Format("DefectMap: find thresholds aggr:(%d,%d) sigma:(%.1f,%.1f) px:(%+d,%+d)\n", impl->aggrCold,
                                  impl->aggrHot, multCold, multHot, -coldThresh, hotThresh));
@@ -1072,7 +555,7 @@ void DefectMapBuilder::BuildDefectMap(DefectMap& defectMap, bool verbose) const
 
     double multCold = AggrToSigma(m_impl->aggrCold);
     double multHot = AggrToSigma(m_impl->aggrHot);
-    const ImageStats& stats = m_impl->w.stats;
+    const ImageStats& stats = m_impl->stats;
 
     info.Clear();
     info.push_back(wxString::Format("Generated: %s", wxDateTime::UNow().FormatISOCombined(' ')));
@@ -1119,35 +602,7 @@ bool RemoveDefects(usImage& light, const DefectMap& defectMap)
     if (!light.ImageData)
         return true;
 
-    if (!light.Subframe.IsEmpty())
-    {
-        // Step over each defect and replace the light value
-        // with the median of the surrounding pixels
-        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
-        {
-            const wxPoint& pt = *it;
-            // Check to see if we are within the subframe before correcting the defect
-            if (light.Subframe.Contains(pt))
-            {
-                light.Pixel(pt.x, pt.y) = MedianBorderingPixels(light, pt.x, pt.y);
-            }
-        }
-    }
-    else
-    {
-        // Step over each defect and replace the light value
-        // with the median of the surrounding pixels
-        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
-        {
-            int const x = it->x;
-            int const y = it->y;
-
-            if (x >= 0 && x < light.Size.GetWidth() && y >= 0 && y < light.Size.GetHeight())
-            {
-                light.Pixel(x, y) = MedianBorderingPixels(light, x, y);
-            }
-        }
-    }
+    RemoveFrameDefects(light.View(), defectMap.GetIndex(light.Size));
 
     return false;
 }
@@ -36,9 +36,12 @@
 #ifndef IMAGE_MATH_INCLUDED
 #define IMAGE_MATH_INCLUDED
 
+#include "frame_ops.h"
+
 class DefectMap : public std::vector<wxPoint>
 {
     int m_profileId;
+    mutable DefectIndex m_index;
     DefectMap(int profileId);
 
 public:
@@ -51,10 +54,12 @@ public:
     void Save(const wxArrayString& mapInfo) const;
     bool FindDefect(const wxPoint& pt) const;
     void AddDefect(const wxPoint& pt);
+    const DefectIndex& GetIndex(const wxSize& frameSize) const;
 };
 
 extern bool QuickLRecon(usImage& img);
 extern void Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect);
+extern void Median3Row(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect, int y);
 extern bool Median3(usImage& img);
 extern bool SquarePixels(usImage& img, float xsize, float ysize);
 extern int dbl_sort_func(double *first, double *second);
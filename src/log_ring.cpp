@@ -0,0 +1,186 @@
+/*
+ *  log_ring.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "log_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+static size_t RoundUpPow2(unsigned int count)
+{
+    size_t n = 4;
+    while (n < count)
+        n <<= 1;
+    return n;
+}
+
+LogRing::LogRing(unsigned int slotCount)
+    : m_slots(RoundUpPow2(slotCount)), m_head(0), m_tail(0), m_overflows(0), m_truncations(0)
+{
+    size_t const n = m_slots.size();
+    for (size_t i = 0; i < n; i++)
+        m_slots[i].seq.store(i, std::memory_order_relaxed);
+
+    m_mask = n - 1;
+    m_maxText = (n / 4) * sizeof(Slot::data) - sizeof(Header);
+    m_buf.resize(m_maxText);
+}
+
+bool LogRing::Put(int64_t time, uint64_t thread, const char *text, size_t len)
+{
+    if (len > m_maxText)
+    {
+        len = m_maxText;
+        m_truncations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t const slotData = sizeof(Slot::data);
+    uint64_t const nslots = (sizeof(Header) + len + slotData - 1) / slotData;
+
+    // reserve nslots consecutive positions. The consumer releases slots in
+    // order, so if the last of them is free, they all are.
+    uint64_t pos = m_head.load(std::memory_order_relaxed);
+    while (true)
+    {
+        uint64_t const last = pos + nslots - 1;
+        uint64_t const seq = m_slots[last & m_mask].seq.load(std::memory_order_acquire);
+        int64_t const diff = (int64_t) (seq - last);
+
+        if (diff == 0)
+        {
+            if (m_head.compare_exchange_weak(pos, pos + nslots, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            m_overflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+            pos = m_head.load(std::memory_order_relaxed);
+    }
+
+    Header hdr;
+    hdr.len = (uint32_t) len;
+    hdr.slots = (uint32_t) nslots;
+    hdr.time = time;
+    hdr.thread = thread;
+
+    // copy the header then the text into the data areas of the slots
+    const char *src = reinterpret_cast<const char *>(&hdr);
+    size_t srcLeft = sizeof(hdr);
+    bool inHeader = true;
+    for (uint64_t i = 0; i < nslots; i++)
+    {
+        char *dst = m_slots[(pos + i) & m_mask].data;
+        size_t room = slotData;
+        while (room)
+        {
+            size_t n = std::min(room, srcLeft);
+            memcpy(dst, src, n);
+            dst += n;
+            room -= n;
+            src += n;
+            srcLeft -= n;
+            if (srcLeft == 0)
+            {
+                if (!inHeader)
+                    break;
+                inHeader = false;
+                src = text;
+                srcLeft = len;
+                if (srcLeft == 0)
+                    break;
+            }
+        }
+    }
+
+    // publish the first slot last, so the consumer sees a complete record
+    for (uint64_t i = nslots; i-- > 0;)
+        m_slots[(pos + i) & m_mask].seq.store(pos + i + 1, std::memory_order_release);
+
+    return true;
+}
+
+static void CallRecordFunction(void *ctx, const LogRing::Record& rec)
+{
+    (*static_cast<const std::function<void(const LogRing::Record&)> *>(ctx))(rec);
+}
+
+unsigned int LogRing::Drain(const std::function<void(const Record&)>& fn)
+{
+    return Drain(CallRecordFunction, const_cast<std::function<void(const Record&)> *>(&fn));
+}
+
+unsigned int LogRing::Drain(RecordFn fn, void *ctx)
+{
+    size_t const slotData = sizeof(Slot::data);
+    uint64_t const n = m_slots.size();
+    uint64_t pos = m_tail.load(std::memory_order_relaxed);
+    unsigned int count = 0;
+
+    while (true)
+    {
+        Slot& first = m_slots[pos & m_mask];
+        if (first.seq.load(std::memory_order_acquire) != pos + 1)
+            break; // not yet published
+
+        Header hdr;
+        memcpy(&hdr, first.data, sizeof(hdr));
+
+        size_t copied = std::min((size_t) hdr.len, slotData - sizeof(hdr));
+        memcpy(&m_buf[0], first.data + sizeof(hdr), copied);
+        for (uint64_t i = 1; i < hdr.slots; i++)
+        {
+            size_t chunk = std::min((size_t) hdr.len - copied, slotData);
+            memcpy(&m_buf[copied], m_slots[(pos + i) & m_mask].data, chunk);
+            copied += chunk;
+        }
+
+        Record rec;
+        rec.time = hdr.time;
+        rec.thread = hdr.thread;
+        rec.text = m_buf.data();
+        rec.len = hdr.len;
+        fn(ctx, rec);
+
+        for (uint64_t i = 0; i < hdr.slots; i++)
+            m_slots[(pos + i) & m_mask].seq.store(pos + i + n, std::memory_order_release);
+
+        pos += hdr.slots;
+        m_tail.store(pos, std::memory_order_release);
+        ++count;
+    }
+
+    return count;
+}
@@ -0,0 +1,120 @@
+/*
+ *  log_ring.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOG_RING_INCLUDED
+#define LOG_RING_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Bounded multi-producer, single-consumer queue of log records. The ring is
+// an array of fixed-size slots, each with a sequence number (after Vyukov's
+// bounded queue); a record takes as many consecutive slots as its text needs.
+// Producers reserve slots with a compare-and-swap on the head position and
+// never block: when the ring is full the record is dropped and counted.
+// Records longer than a quarter of the ring are truncated.
+class LogRing
+{
+public:
+    struct Record
+    {
+        int64_t time; // caller-defined timestamp
+        uint64_t thread;
+        const char *text;
+        size_t len;
+    };
+
+private:
+    enum
+    {
+        SLOT_BYTES = 128,
+    };
+
+    struct Slot
+    {
+        std::atomic<uint64_t> seq;
+        char data[SLOT_BYTES - sizeof(std::atomic<uint64_t>)];
+    };
+
+    struct Header
+    {
+        uint32_t len;
+        uint32_t slots;
+        int64_t time;
+        uint64_t thread;
+    };
+
+    std::vector<Slot> m_slots;
+    uint64_t m_mask;
+    size_t m_maxText;
+    std::atomic<uint64_t> m_head; // next slot to reserve
+    std::atomic<uint64_t> m_tail; // next slot to consume
+    std::atomic<uint64_t> m_overflows;
+    std::atomic<uint64_t> m_truncations;
+    std::vector<char> m_buf; // consumer's copy of the current record, MaxText() bytes
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+public:
+    // slotCount is rounded up to a power of two
+    explicit LogRing(unsigned int slotCount);
+
+    // Append a record; returns false if it was dropped because the ring is full
+    bool Put(int64_t time, uint64_t thread, const char *text, size_t len);
+
+    // Consumer side: pass each complete record, in order, to fn and release
+    // its slots. Returns the number of records consumed. Must not be called
+    // concurrently with itself.
+    unsigned int Drain(const std::function<void(const Record&)>& fn);
+
+    // Same as above, but without a std::function, and it does not allocate, so
+    // it is safe to call from a signal handler
+    typedef void (*RecordFn)(void *ctx, const Record& rec);
+    unsigned int Drain(RecordFn fn, void *ctx);
+
+    // Positions in slots; every record put before Produced() was read has
+    // been consumed once Consumed() reaches that value
+    uint64_t Produced() const { return m_head.load(std::memory_order_acquire); }
+    uint64_t Consumed() const { return m_tail.load(std::memory_order_acquire); }
+
+    uint64_t Overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+    uint64_t Truncations() const { return m_truncations.load(std::memory_order_relaxed); }
+    size_t MaxText() const { return m_maxText; }
+    size_t Capacity() const { return m_slots.size() * SLOT_BYTES; }
+};
+
+#endif
@@ -417,6 +417,10 @@ static void ReallyFlush(const wxFFile& ffile)
 
 static void FlushLogs()
 {
+    // both logs hold back recent lines; write them out first
+    Debug.Flush();
+    GuideLog.Flush();
+
     ReallyFlush(Debug);
     ReallyFlush(GuideLog.File());
 }
@@ -0,0 +1,486 @@
+/*
+ *  median_kernels.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "median_kernels.h"
+#include "parallel.h"
+
+#if defined(PHD_HAVE_SSE2)
+# include <emmintrin.h>
+#endif
+#if defined(PHD_HAVE_AVX2)
+# include <immintrin.h>
+#endif
+#if defined(PHD_HAVE_NEON)
+# include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+// outputs per chunk; the sorted columns of a chunk stay in L1
+enum
+{
+    MEDIAN_CHUNK = 256,
+    MEDIAN_COLS = MEDIAN_CHUNK + 2,
+};
+
+inline static unsigned short Med3(unsigned short a, unsigned short b, unsigned short c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// sort the columns xs - 1 .. xe + 1 into lo <= mid <= hi
+static void SortColumnsScalar(unsigned short *lo, unsigned short *mid, unsigned short *hi, const unsigned short *a,
+                              const unsigned short *b, const unsigned short *c, int xs, int xe)
+{
+    for (int x = xs - 1, i = 0; x <= xe + 1; x++, i++)
+    {
+        unsigned short const l = std::min(a[x], b[x]);
+        unsigned short const h = std::max(a[x], b[x]);
+        lo[i] = std::min(l, c[x]);
+        unsigned short const m = std::max(l, c[x]);
+        mid[i] = std::min(m, h);
+        hi[i] = std::max(m, h);
+    }
+}
+
+static void Median3Scalar(unsigned short *dst, const unsigned short *a, const unsigned short *b, const unsigned short *c,
+                          int xs, int xe)
+{
+    unsigned short lo[MEDIAN_COLS], mid[MEDIAN_COLS], hi[MEDIAN_COLS];
+
+    SortColumnsScalar(lo, mid, hi, a, b, c, xs, xe);
+
+    for (int x = xs, i = 0; x <= xe; x++, i++)
+    {
+        unsigned short const mx = std::max(std::max(lo[i], lo[i + 1]), lo[i + 2]);
+        unsigned short const md = Med3(mid[i], mid[i + 1], mid[i + 2]);
+        unsigned short const mn = std::min(std::min(hi[i], hi[i + 1]), hi[i + 2]);
+        dst[x] = Med3(mx, md, mn);
+    }
+}
+
+// The vector versions need at least one full vector of outputs. The last
+// vector of a chunk is aligned to the end of the chunk and may overlap the
+// previous one; that just recomputes a few values.
+
+#if defined(PHD_HAVE_SSE2)
+
+// SSE2 has only signed 16-bit min/max; the values are biased by 0x8000 to map
+// the unsigned order onto the signed order.
+
+inline static __m128i Med3_SSE2(__m128i a, __m128i b, __m128i c)
+{
+    return _mm_max_epi16(_mm_min_epi16(a, b), _mm_min_epi16(_mm_max_epi16(a, b), c));
+}
+
+static void Median3_SSE2(unsigned short *dst, const unsigned short *a, const unsigned short *b, const unsigned short *c,
+                         int xs, int xe)
+{
+    unsigned short lo[MEDIAN_COLS], mid[MEDIAN_COLS], hi[MEDIAN_COLS];
+    __m128i const bias = _mm_set1_epi16((short) 0x8000);
+
+    int const ncols = xe - xs + 3;
+    for (int i = 0;; i += 8)
+    {
+        if (i + 8 > ncols)
+            i = ncols - 8;
+        int const x = xs - 1 + i;
+        __m128i va = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (a + x)), bias);
+        __m128i vb = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (b + x)), bias);
+        __m128i vc = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (c + x)), bias);
+        __m128i l = _mm_min_epi16(va, vb);
+        __m128i h = _mm_max_epi16(va, vb);
+        __m128i m = _mm_max_epi16(l, vc);
+        _mm_storeu_si128((__m128i *) (lo + i), _mm_min_epi16(l, vc));
+        _mm_storeu_si128((__m128i *) (mid + i), _mm_min_epi16(m, h));
+        _mm_storeu_si128((__m128i *) (hi + i), _mm_max_epi16(m, h));
+        if (i + 8 >= ncols)
+            break;
+    }
+
+    int const n = xe - xs + 1;
+    for (int i = 0;; i += 8)
+    {
+        if (i + 8 > n)
+            i = n - 8;
+        __m128i mx = _mm_max_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *) (lo + i)),
+                                                 _mm_loadu_si128((const __m128i *) (lo + i + 1))),
+                                   _mm_loadu_si128((const __m128i *) (lo + i + 2)));
+        __m128i md = Med3_SSE2(_mm_loadu_si128((const __m128i *) (mid + i)), _mm_loadu_si128((const __m128i *) (mid + i + 1)),
+                               _mm_loadu_si128((const __m128i *) (mid + i + 2)));
+        __m128i mn = _mm_min_epi16(_mm_min_epi16(_mm_loadu_si128((const __m128i *) (hi + i)),
+                                                 _mm_loadu_si128((const __m128i *) (hi + i + 1))),
+                                   _mm_loadu_si128((const __m128i *) (hi + i + 2)));
+        _mm_storeu_si128((__m128i *) (dst + xs + i), _mm_xor_si128(Med3_SSE2(mx, md, mn), bias));
+        if (i + 8 >= n)
+            break;
+    }
+}
+
+#endif // PHD_HAVE_SSE2
+
+#if defined(PHD_HAVE_AVX2)
+
+PHD_TARGET_AVX2 inline static __m256i Med3_AVX2(__m256i a, __m256i b, __m256i c)
+{
+    return _mm256_max_epu16(_mm256_min_epu16(a, b), _mm256_min_epu16(_mm256_max_epu16(a, b), c));
+}
+
+PHD_TARGET_AVX2 static void Median3_AVX2(unsigned short *dst, const unsigned short *a, const unsigned short *b,
+                                         const unsigned short *c, int xs, int xe)
+{
+    unsigned short lo[MEDIAN_COLS], mid[MEDIAN_COLS], hi[MEDIAN_COLS];
+
+    int const ncols = xe - xs + 3;
+    for (int i = 0;; i += 16)
+    {
+        if (i + 16 > ncols)
+            i = ncols - 16;
+        int const x = xs - 1 + i;
+        __m256i va = _mm256_loadu_si256((const __m256i *) (a + x));
+        __m256i vb = _mm256_loadu_si256((const __m256i *) (b + x));
+        __m256i vc = _mm256_loadu_si256((const __m256i *) (c + x));
+        __m256i l = _mm256_min_epu16(va, vb);
+        __m256i h = _mm256_max_epu16(va, vb);
+        __m256i m = _mm256_max_epu16(l, vc);
+        _mm256_storeu_si256((__m256i *) (lo + i), _mm256_min_epu16(l, vc));
+        _mm256_storeu_si256((__m256i *) (mid + i), _mm256_min_epu16(m, h));
+        _mm256_storeu_si256((__m256i *) (hi + i), _mm256_max_epu16(m, h));
+        if (i + 16 >= ncols)
+            break;
+    }
+
+    int const n = xe - xs + 1;
+    for (int i = 0;; i += 16)
+    {
+        if (i + 16 > n)
+            i = n - 16;
+        __m256i mx = _mm256_max_epu16(_mm256_max_epu16(_mm256_loadu_si256((const __m256i *) (lo + i)),
+                                                       _mm256_loadu_si256((const __m256i *) (lo + i + 1))),
+                                      _mm256_loadu_si256((const __m256i *) (lo + i + 2)));
+        __m256i md =
+            Med3_AVX2(_mm256_loadu_si256((const __m256i *) (mid + i)), _mm256_loadu_si256((const __m256i *) (mid + i + 1)),
+                      _mm256_loadu_si256((const __m256i *) (mid + i + 2)));
+        __m256i mn = _mm256_min_epu16(_mm256_min_epu16(_mm256_loadu_si256((const __m256i *) (hi + i)),
+                                                       _mm256_loadu_si256((const __m256i *) (hi + i + 1))),
+                                      _mm256_loadu_si256((const __m256i *) (hi + i + 2)));
+        _mm256_storeu_si256((__m256i *) (dst + xs + i), Med3_AVX2(mx, md, mn));
+        if (i + 16 >= n)
+            break;
+    }
+}
+
+#endif // PHD_HAVE_AVX2
+
+#if defined(PHD_HAVE_NEON)
+
+inline static uint16x8_t Med3_NEON(uint16x8_t a, uint16x8_t b, uint16x8_t c)
+{
+    return vmaxq_u16(vminq_u16(a, b), vminq_u16(vmaxq_u16(a, b), c));
+}
+
+static void Median3_NEON(unsigned short *dst, const unsigned short *a, const unsigned short *b, const unsigned short *c,
+                         int xs, int xe)
+{
+    unsigned short lo[MEDIAN_COLS], mid[MEDIAN_COLS], hi[MEDIAN_COLS];
+
+    int const ncols = xe - xs + 3;
+    for (int i = 0;; i += 8)
+    {
+        if (i + 8 > ncols)
+            i = ncols - 8;
+        int const x = xs - 1 + i;
+        uint16x8_t va = vld1q_u16(a + x);
+        uint16x8_t vb = vld1q_u16(b + x);
+        uint16x8_t vc = vld1q_u16(c + x);
+        uint16x8_t l = vminq_u16(va, vb);
+        uint16x8_t h = vmaxq_u16(va, vb);
+        uint16x8_t m = vmaxq_u16(l, vc);
+        vst1q_u16(lo + i, vminq_u16(l, vc));
+        vst1q_u16(mid + i, vminq_u16(m, h));
+        vst1q_u16(hi + i, vmaxq_u16(m, h));
+        if (i + 8 >= ncols)
+            break;
+    }
+
+    int const n = xe - xs + 1;
+    for (int i = 0;; i += 8)
+    {
+        if (i + 8 > n)
+            i = n - 8;
+        uint16x8_t mx = vmaxq_u16(vmaxq_u16(vld1q_u16(lo + i), vld1q_u16(lo + i + 1)), vld1q_u16(lo + i + 2));
+        uint16x8_t md = Med3_NEON(vld1q_u16(mid + i), vld1q_u16(mid + i + 1), vld1q_u16(mid + i + 2));
+        uint16x8_t mn = vminq_u16(vminq_u16(vld1q_u16(hi + i), vld1q_u16(hi + i + 1)), vld1q_u16(hi + i + 2));
+        vst1q_u16(dst + xs + i, Med3_NEON(mx, md, mn));
+        if (i + 8 >= n)
+            break;
+    }
+}
+
+#endif // PHD_HAVE_NEON
+
+void Median3Interior(unsigned short *dst, const unsigned short *above, const unsigned short *center,
+                     const unsigned short *below, int width, SimdLevel simd)
+{
+    for (int xs = 1; xs <= width - 2; xs += MEDIAN_CHUNK)
+    {
+        int const xe = std::min(xs + MEDIAN_CHUNK - 1, width - 2);
+        int const n = xe - xs + 1;
+
+        switch (simd)
+        {
+#if defined(PHD_HAVE_AVX2)
+        case SIMD_AVX2:
+            if (n >= 16)
+            {
+                Median3_AVX2(dst, above, center, below, xs, xe);
+                continue;
+            }
+            break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+        case SIMD_SSE2:
+            if (n >= 8)
+            {
+                Median3_SSE2(dst, above, center, below, xs, xe);
+                continue;
+            }
+            break;
+#endif
+#if defined(PHD_HAVE_NEON)
+        case SIMD_NEON:
+            if (n >= 8)
+            {
+                Median3_NEON(dst, above, center, below, xs, xe);
+                continue;
+            }
+            break;
+#endif
+        default:
+            break;
+        }
+
+        Median3Scalar(dst, above, center, below, xs, xe);
+    }
+}
+
+// Running two-level histogram of the pixels in the filter window. The
+// median is tracked incrementally: med is the current median and lt the
+// number of pixels below it, so after a window move the median is found by
+// walking from the previous value instead of scanning the histogram.
+//
+// The pixels of a dark frame fall into very few coarse bins, so consecutive
+// updates of a single coarse histogram would wait on each other's stores.
+// The coarse counts are therefore spread over COARSE_LANES copies, each
+// updated by every fourth pixel; a count is the (modular) sum of the lanes,
+// so a pixel may be removed through a different lane than it was added.
+struct SlidingHistogram
+{
+    enum
+    {
+        COARSE_LANES = 4
+    };
+
+    std::vector<unsigned int> coarse; // counts of v >> 8, per lane
+    std::vector<unsigned short> fine; // counts of v
+    unsigned int n;
+    unsigned int med;
+    unsigned int lt;
+
+    SlidingHistogram() : coarse(COARSE_LANES * 256), fine(65536), n(0), med(0), lt(0) { }
+
+    void Add(unsigned short v, int lane)
+    {
+        ++coarse[lane * 256 + (v >> 8)];
+        ++fine[v];
+        lt += v < med; // branchless: v < med is unpredictable
+    }
+
+    void Remove(unsigned short v, int lane)
+    {
+        --coarse[lane * 256 + (v >> 8)];
+        --fine[v];
+        lt -= v < med;
+    }
+
+    unsigned int Coarse(unsigned int bin) const
+    {
+        unsigned int cnt = 0;
+        for (int lane = 0; lane < COARSE_LANES; lane++)
+            cnt += coarse[lane * 256 + bin];
+        return cnt;
+    }
+
+    // smallest value m such that more than n / 2 pixels are <= m
+    unsigned short Median()
+    {
+        unsigned int const k = n / 2;
+
+        while (lt > k)
+        {
+            // step down, a whole coarse bin at a time when it is clear the
+            // median lies below it
+            if ((med & 255) == 0 && lt - Coarse((med >> 8) - 1) > k)
+            {
+                med -= 256;
+                lt -= Coarse(med >> 8);
+                continue;
+            }
+            --med;
+            lt -= fine[med];
+        }
+
+        for (;;)
+        {
+            if ((med & 255) == 0 && lt + Coarse(med >> 8) <= k)
+            {
+                lt += Coarse(med >> 8);
+                med += 256;
+                continue;
+            }
+            if (lt + fine[med] > k)
+                break;
+            lt += fine[med];
+            ++med;
+        }
+
+        return (unsigned short) med;
+    }
+};
+
+// add (sign > 0) or remove the pixels of rows y0 .. y1 in column x
+inline static void UpdateColumn(SlidingHistogram& h, const unsigned short *src, int width, int x, int y0, int y1, int sign)
+{
+    const unsigned short *p = src + (size_t) y0 * width + x;
+    if (sign > 0)
+    {
+        for (int y = y0; y <= y1; y++, p += width)
+            h.Add(*p, y & (SlidingHistogram::COARSE_LANES - 1));
+        h.n += y1 - y0 + 1;
+    }
+    else
+    {
+        for (int y = y0; y <= y1; y++, p += width)
+            h.Remove(*p, y & (SlidingHistogram::COARSE_LANES - 1));
+        h.n -= y1 - y0 + 1;
+    }
+}
+
+// add (sign > 0) or remove the pixels of columns x0 .. x1 in row y
+inline static void UpdateRow(SlidingHistogram& h, const unsigned short *src, int width, int y, int x0, int x1, int sign)
+{
+    const unsigned short *p = src + (size_t) y * width;
+    if (sign > 0)
+    {
+        for (int x = x0; x <= x1; x++)
+            h.Add(p[x], x & (SlidingHistogram::COARSE_LANES - 1));
+        h.n += x1 - x0 + 1;
+    }
+    else
+    {
+        for (int x = x0; x <= x1; x++)
+            h.Remove(p[x], x & (SlidingHistogram::COARSE_LANES - 1));
+        h.n -= x1 - x0 + 1;
+    }
+}
+
+// filter rows y0 .. y1 - 1, scanning them in alternating directions so the
+// histogram only has to be built once per stripe
+static void MedianFilterStripe(unsigned short *dst, const unsigned short *src, int width, int height, int halfWidth, int y0,
+                               int y1)
+{
+    SlidingHistogram h;
+
+    int x = 0;
+    int top = std::max(0, y0 - halfWidth);
+    int bot = std::min(y0 + halfWidth, height - 1);
+    for (int j = top; j <= bot; j++)
+        UpdateRow(h, src, width, j, 0, std::min(halfWidth, width - 1), +1);
+
+    for (int y = y0; y < y1; y++)
+    {
+        unsigned short *d = dst + (size_t) y * width;
+        bool const leftToRight = ((y - y0) & 1) == 0;
+
+        d[x] = h.Median();
+
+        for (int i = 1; i < width; i++)
+        {
+            if (leftToRight)
+            {
+                if (x - halfWidth >= 0)
+                    UpdateColumn(h, src, width, x - halfWidth, top, bot, -1);
+                if (x + 1 + halfWidth <= width - 1)
+                    UpdateColumn(h, src, width, x + 1 + halfWidth, top, bot, +1);
+                ++x;
+            }
+            else
+            {
+                if (x + halfWidth <= width - 1)
+                    UpdateColumn(h, src, width, x + halfWidth, top, bot, -1);
+                if (x - 1 - halfWidth >= 0)
+                    UpdateColumn(h, src, width, x - 1 - halfWidth, top, bot, +1);
+                --x;
+            }
+            d[x] = h.Median();
+        }
+
+        // move the window down one row
+        if (y + 1 < y1)
+        {
+            int const left = std::max(0, x - halfWidth);
+            int const right = std::min(x + halfWidth, width - 1);
+            if (y - halfWidth >= 0)
+                UpdateRow(h, src, width, y - halfWidth, left, right, -1);
+            if (y + 1 + halfWidth <= height - 1)
+                UpdateRow(h, src, width, y + 1 + halfWidth, left, right, +1);
+            top = std::max(0, y + 1 - halfWidth);
+            bot = std::min(y + 1 + halfWidth, height - 1);
+        }
+    }
+}
+
+void MedianFilter(unsigned short *dst, const unsigned short *src, int width, int height, int halfWidth)
+{
+    // stripes are the unit of work for the thread pool; each one pays for
+    // building its histogram from scratch, so keep them reasonably tall
+    int const STRIPE_ROWS = 64;
+    int const nstripes = (height + STRIPE_ROWS - 1) / STRIPE_ROWS;
+
+    ParallelFor(nstripes, [&](int stripe) {
+        int const y0 = stripe * STRIPE_ROWS;
+        int const y1 = std::min(y0 + STRIPE_ROWS, height);
+        MedianFilterStripe(dst, src, width, height, halfWidth, y0, y1);
+    });
+}
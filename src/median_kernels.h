@@ -0,0 +1,59 @@
+/*
+ *  median_kernels.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef MEDIAN_KERNELS_INCLUDED
+#define MEDIAN_KERNELS_INCLUDED
+
+#include "cpu_features.h"
+
+// 3x3 median of the interior of a row: dst[x] = median of the 3x3
+// neighborhood of center[x] for x = 1 .. width - 2, where above and below are
+// the adjacent rows. dst[0] and dst[width - 1] are not written. dst must not
+// overlap the source rows.
+//
+// Each column is sorted once and shared by the three outputs that use it;
+// the median of the 9 values is then med3(max of the column minimums, med3
+// of the column medians, min of the column maximums). The SIMD versions
+// process 8 (SSE2, NEON) or 16 (AVX2) pixels at a time with branchless
+// min/max.
+extern void Median3Interior(unsigned short *dst, const unsigned short *above, const unsigned short *center,
+                            const unsigned short *below, int width, SimdLevel simd);
+
+// Median filter with a (2 * halfWidth + 1) square window, clipped at the image
+// edges. Where the clipped window holds an even number of pixels the upper of
+// the two middle values is used. Each pixel's median is maintained with a
+// running histogram that slides across the rows in a serpentine scan;
+// horizontal stripes of rows are filtered in parallel.
+extern void MedianFilter(unsigned short *dst, const unsigned short *src, int width, int height, int halfWidth);
+
+#endif
@@ -961,6 +961,16 @@ void Mount::LogGuideStepInfo()
     if (m_lastStep.frameNumber < 0)
         return;
 
+    // the move may have been made before the frame was processed, so take the
+    // frame details now
+    m_lastStep.frameNumber = pFrame->m_frameCounter;
+    const Star& star = pFrame->pGuider->PrimaryStar();
+    m_lastStep.starMass = star.Mass;
+    m_lastStep.starSNR = star.SNR;
+    m_lastStep.starHFD = star.HFD;
+    m_lastStep.avgDist = pFrame->CurrentGuideError();
+    m_lastStep.starError = star.GetError();
+
     pFrame->UpdateStatusBarGuiderInfo(m_lastStep);
     GuideLog.GuideStep(m_lastStep);
     EvtServer.NotifyGuideStep(m_lastStep);
@@ -1049,14 +1059,15 @@ Mount::MOVE_RESULT Mount::MoveOffset(GuiderOffset *ofs, unsigned int moveOptions
             result = MoveAxis(yDirection, requestedYAmount, moveOptions, &yMoveResult);
         }
 
-        // Record the info about the guide step. The info will be picked up back in the main UI thread.
-        // We don't want to do anything with the info here in the worker thread since UI operations are
-        // not allowed outside the main UI thread.
+        // Record the info about the guide step. The info will be picked up back in the main UI thread,
+        // which adds the frame number and the star details (see LogGuideStepInfo). We don't want to do
+        // anything with the info here in the worker thread since UI operations are not allowed outside
+        // the main UI thread.
 
         GuideStepInfo& info = m_lastStep;
 
         info.moveOptions = moveOptions;
-        info.frameNumber = pFrame->m_frameCounter;
+        info.frameNumber = 0; // valid until logged
         info.time = pFrame->TimeSinceGuidingStarted();
         info.cameraOffset = ofs->cameraOfs;
         info.mountOffset = ofs->mountOfs;
@@ -1069,12 +1080,6 @@ Mount::MOVE_RESULT Mount::MoveOffset(GuiderOffset *ofs, unsigned int moveOptions
         info.raLimited = xMoveResult.limited;
         info.decLimited = yMoveResult.limited;
         info.aoPos = GetAoPos();
-        const Star& star = pFrame->pGuider->PrimaryStar();
-        info.starMass = star.Mass;
-        info.starSNR = star.SNR;
-        info.starHFD = star.HFD;
-        info.avgDist = pFrame->CurrentGuideError();
-        info.starError = star.GetError();
     }
     catch (const wxString& errMsg)
     {
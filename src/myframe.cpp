@@ -39,6 +39,7 @@
 #include "aui_controls.h"
 #include "comet_tool.h"
 #include "config_indi.h"
+#include "frame_pool.h"
 #include "guiding_assistant.h"
 #include "phdupdate.h"
 #include "pierflip_tool.h"
@@ -364,6 +365,7 @@ MyFrame::MyFrame()
     m_continueCapturing = false;
     CaptureActive = false;
     m_exposurePending = false;
+    m_pipelinedCapture = false;
 
     m_singleExposure.enabled = false;
     m_singleExposure.duration = 0;
@@ -907,6 +909,7 @@ void MyFrame::LoadProfileSettings()
     }
     SetExposureDuration(exposureDuration);
     m_beepForLostStar = pConfig->Profile.GetBoolean("/BeepForLostStar", true);
+    m_pipelinedCapture = pConfig->Profile.GetBoolean("/frame/pipelinedCapture", false);
 
     int val = pConfig->Profile.GetInt("/Gamma", GAMMA_DEFAULT);
     if (val < GAMMA_MIN)
@@ -1718,6 +1721,69 @@ void MyFrame::ScheduleExposure()
         m_pPrimaryWorkerThread->EnqueueWorkerThreadExposeRequest(img, exposureDuration, exposureOptions, subframe);
 }
 
+// With pipelined capture the next exposure is started as soon as a frame arrives, so the
+// camera integrates frame N+1 while frame N is processed. This is limited to looping:
+// calibration and guiding steps must measure a frame taken after the previous move
+// completed, so they wait for the frame to be processed as before.
+bool MyFrame::CanPipelineExposure() const
+{
+    return m_pipelinedCapture && m_continueCapturing && !m_exposurePending && !m_singleExposure.enabled &&
+        pCamera->HasNonGuiCapture() && !pGuider->IsCalibratingOrGuiding() && !pGuider->IsPaused();
+}
+
+void CaptureTiming::Reset()
+{
+    frameReady = prevFrameReady = 0;
+    frames = intervals = corrections = 0;
+    intervalSum = latencySum = 0.0;
+    latencyMax = 0;
+}
+
+void CaptureTiming::FrameReady(wxLongLong_t t)
+{
+    enum
+    {
+        LOG_INTERVAL = 100, // frames
+    };
+
+    if (prevFrameReady)
+    {
+        intervalSum += (double) (t - prevFrameReady);
+        ++intervals;
+    }
+    prevFrameReady = frameReady = t;
+
+    if (++frames % LOG_INTERVAL == 0)
+        Log("looping");
+}
+
+void CaptureTiming::CorrectionDispatched(wxLongLong_t t)
+{
+    if (!frameReady)
+        return; // already counted for this frame
+
+    wxLongLong_t latency = t - frameReady;
+    latencySum += (double) latency;
+    latencyMax = wxMax(latencyMax, latency);
+    ++corrections;
+    frameReady = 0;
+}
+
+void CaptureTiming::Log(const wxString& when) const
+{
+    double cadence = intervals ? intervalSum / intervals : 0.0;
+    double latency = corrections ? latencySum / corrections : 0.0;
+
+    Debug.Write(wxString::Format("CaptureTiming (%s): frames=%u cadence=%.0f ms (%.2f fps) corrections=%u "
+                                 "latency avg=%.0f ms max=%ld ms\n",
+                                 when, frames, cadence, cadence > 0.0 ? 1000.0 / cadence : 0.0, corrections, latency,
+                                 (long) latencyMax));
+
+    FramePoolStats pool = FramePoolGetStats();
+    Debug.Write(wxString::Format("FramePool: hits=%llu misses=%llu resident=%.1f MB idle=%.1f MB\n", pool.hits, pool.misses,
+                                 pool.bytesResident / 1048576.0, pool.bytesIdle / 1048576.0));
+}
+
 void MyFrame::SchedulePrimaryMove(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions)
 {
     Debug.Write(wxString::Format("SchedulePrimaryMove(%p, x=%.2f, y=%.2f, opts=%u)\n", mount, ofs.cameraOfs.X, ofs.cameraOfs.Y,
@@ -1729,7 +1795,10 @@ void MyFrame::SchedulePrimaryMove(Mount *mount, const GuiderOffset& ofs, unsigne
 
     // Manual moves do not affect the request count for IsBusy()
     if ((moveOptions & MOVEOPT_MANUAL) == 0)
+    {
         mount->IncrementRequestCount();
+        m_captureTiming.CorrectionDispatched(::wxGetUTCTimeMillis().GetValue());
+    }
 
     assert(m_pPrimaryWorkerThread);
     m_pPrimaryWorkerThread->EnqueueWorkerThreadMoveRequest(mount, ofs, moveOptions);
@@ -1753,7 +1822,10 @@ void MyFrame::ScheduleSecondaryMove(Mount *mount, const GuiderOffset& ofs, unsig
     else
     {
         if ((moveOptions & MOVEOPT_MANUAL) == 0)
+        {
             mount->IncrementRequestCount();
+            m_captureTiming.CorrectionDispatched(::wxGetUTCTimeMillis().GetValue());
+        }
 
         assert(m_pSecondaryWorkerThread);
         m_pSecondaryWorkerThread->EnqueueWorkerThreadMoveRequest(mount, ofs, moveOptions);
@@ -1847,6 +1919,7 @@ void MyFrame::StartCapturing()
 
         CaptureActive = true;
         m_frameCounter = 0;
+        m_captureTiming.Reset();
 
         CheckDarkFrameGeometry();
         UpdateButtonsStatus();
@@ -1883,6 +1956,8 @@ bool MyFrame::StopCapturing()
     {
         StatusMsgNoTimeout(_("Waiting for devices..."));
         m_continueCapturing = false;
+        // no guide correction on the worker thread for the frame in progress
+        pGuider->MeasurementStage().Withdraw();
 
         if (m_exposurePending)
         {
@@ -2282,6 +2357,16 @@ void MyFrame::SetAutoLoadCalibration(bool val)
     }
 }
 
+void MyFrame::SetPipelinedCapture(bool val)
+{
+    if (m_pipelinedCapture != val)
+    {
+        m_pipelinedCapture = val;
+        pConfig->Profile.SetBoolean("/frame/pipelinedCapture", m_pipelinedCapture);
+        Debug.Write(wxString::Format("Pipelined capture set to %d\n", m_pipelinedCapture));
+    }
+}
+
 inline static GuideParity guide_parity(int p)
 {
     switch (p)
@@ -2330,30 +2415,62 @@ void MyFrame::LoadCalibration()
     }
 }
 
-static bool save_multi_darks(const ExposureImgMap& darks, const wxString& fname, const wxString& note)
+// If the current HDU is an empty primary HDU, as written ahead of tile-compressed
+// images, move to the next HDU
+static void skip_empty_primary(fitsfile *fptr, int *status)
+{
+    int hdunr = 0;
+    int naxis = 0;
+    fits_get_hdu_num(fptr, &hdunr);
+    fits_get_img_dim(fptr, &naxis, status);
+    if (!*status && hdunr == 1 && naxis == 0)
+        fits_movrel_hdu(fptr, +1, nullptr, status);
+}
+
+// The dark library is written with lossless Rice tile compression, one tile per
+// row, so that a dark (or just the rows covering a subframe) can be read without
+// decompressing the rest of the library. The file is written next to the
+// existing library and then renamed over it, since the camera pages its darks in
+// from the existing file.
+static bool save_multi_darks(GuideCamera *camera, const wxString& fname, const wxString& note)
 {
     bool bError = false;
+    wxString tmpname = fname + ".tmp";
+    std::map<int, int> hdus;
+    wxSize size;
 
     try
     {
         fitsfile *fptr; // FITS file pointer
         int status = 0; // CFITSIO status value MUST be initialized to zero!
 
-        PHD_fits_create_file(&fptr, fname, true, &status);
+        PHD_fits_create_file(&fptr, tmpname, true, &status);
         if (status)
             throw ERROR_INFO("fits_create_file failed");
 
-        for (ExposureImgMap::const_iterator it = darks.begin(); it != darks.end(); ++it)
+        fits_set_compression_type(fptr, RICE_1, &status);
+
+        for (ExposureDarkMap::const_iterator it = camera->Darks.begin(); it != camera->Darks.end(); ++it)
         {
-            const usImage *const img = it->second;
+            usImage img;
+            if (camera->CopyDark(it->first, &img))
+            {
+                Debug.Write(wxString::Format("cannot read dark frame exposure = %d\n", it->first));
+                status = READ_ERROR;
+                break;
+            }
+
             long fsize[] = {
-                (long) img->Size.GetWidth(),
-                (long) img->Size.GetHeight(),
+                (long) img.Size.GetWidth(),
+                (long) img.Size.GetHeight(),
             };
+            long tile[] = { fsize[0], 1 };
+            if (!status)
+                fits_set_tile_dim(fptr, 2, tile, &status);
             if (!status)
                 fits_create_img(fptr, USHORT_IMG, 2, fsize, &status);
 
-            float exposure = (float) img->ImgExpDur / 1000.0f;
+            float exposure = (float) img.ImgExpDur / 1000.0f;
             char *keyname = const_cast<char *>("EXPOSURE");
             char *comment = const_cast<char *>("Exposure time in seconds");
             if (!status)
@@ -2369,10 +2486,15 @@ static bool save_multi_darks(const ExposureImgMap& darks, const wxString& fname,
             if (!status)
             {
                 long fpixel[3] = { 1, 1, 1 };
-                fits_write_pix(fptr, TUSHORT, fpixel, img->NPixels, img->ImageData, &status);
+                fits_write_pix(fptr, TUSHORT, fpixel, img.NPixels, img.ImageData, &status);
             }
 
-            Debug.Write(wxString::Format("saving dark frame exposure = %d\n", img->ImgExpDur));
+            int hdunr = 0;
+            fits_get_hdu_num(fptr, &hdunr);
+            hdus[img.ImgExpDur] = hdunr;
+            size = img.Size;
+
+            Debug.Write(wxString::Format("saving dark frame exposure = %d\n", img.ImgExpDur));
         }
 
         PHD_fits_close_file(fptr);
@@ -2384,15 +2506,27 @@ static bool save_multi_darks(const ExposureImgMap& darks, const wxString& fname,
         bError = true;
     }
 
-    return bError;
+    if (bError || !wxRenameFile(tmpname, fname, true))
+    {
+        wxRemoveFile(tmpname);
+        return true;
+    }
+
+    // the darks are now all in the new file; page them from there
+    camera->SetDarkLibrary(fname, size, hdus);
+
+    return false;
 }
 
+// Index the darks in the dark library file. Only the headers are read here; the
+// camera reads a dark's pixels when the dark is selected.
 static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
 {
     bool bError = false;
     fitsfile *fptr = 0;
     int status = 0; // CFITSIO status value MUST be initialized to zero!
     long last_frame_size[] = { -1L, -1L };
+    std::map<int, int> hdus;
 
     try
     {
@@ -2406,6 +2540,8 @@ static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
             int nhdus = 0;
             fits_get_num_hdus(fptr, &nhdus, &status);
 
+            skip_empty_primary(fptr, &status);
+
             while (true)
             {
                 int hdutype;
@@ -2438,21 +2574,6 @@ static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
                 last_frame_size[0] = fsize[0];
                 last_frame_size[1] = fsize[1];
 
-                std::unique_ptr<usImage> img(new usImage());
-
-                if (img->Init((int) fsize[0], (int) fsize[1]))
-                {
-                    pFrame->Alert(wxString::Format(_("Memory allocation error reading FITS file %s"), fname));
-                    throw ERROR_INFO("Memory Allocation failure");
-                }
-
-                long fpixel[] = { 1, 1, 1 };
-                if (fits_read_pix(fptr, TUSHORT, fpixel, fsize[0] * fsize[1], nullptr, img->ImageData, nullptr, &status))
-                {
-                    pFrame->Alert(wxString::Format(_("Error reading data from %s"), fname));
-                    throw ERROR_INFO("Error reading");
-                }
-
                 char keyname[] = "EXPOSURE";
                 float exposure;
                 if (fits_read_key(fptr, TFLOAT, keyname, &exposure, nullptr, &status))
@@ -2461,23 +2582,29 @@ static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
                     Debug.Write(wxString::Format("missing EXPOSURE value, assume %.3f\n", exposure));
                     status = 0;
                 }
-                img->ImgExpDur = ROUNDF(exposure * 1000.0);
-
-                img->CalcStats();
+                int expdur = ROUNDF(exposure * 1000.0);
 
-                Debug.Write(wxString::Format("loaded dark frame exposure = %d, med = %u\n", img->ImgExpDur, img->MedianADU));
+                int hdunr = 0;
+                fits_get_hdu_num(fptr, &hdunr);
+                hdus[expdur] = hdunr;
 
-                camera->AddDark(img.release());
+                Debug.Write(wxString::Format("indexed dark frame exposure = %d, hdu = %d\n", expdur, hdunr));
 
                 // if this is the last hdu, we are done
-                int hdunr = 0;
-                fits_get_hdu_num(fptr, &hdunr);
                 if (status || hdunr >= nhdus)
                     break;
 
                 // move to the next hdu
                 fits_movrel_hdu(fptr, +1, nullptr, &status);
             }
+
+            if (status)
+            {
+                pFrame->Alert(wxString::Format(_("Error reading data from %s"), fname));
+                throw ERROR_INFO("Error reading");
+            }
+
+            camera->SetDarkLibrary(fname, wxSize((int) last_frame_size[0], (int) last_frame_size[1]), hdus);
         }
         else
         {
@@ -2536,6 +2663,7 @@ bool MyFrame::DarkLibExists(int profileId, bool showAlert)
             if (PHD_fits_open_diskfile(&fptr, fileName, READONLY, &status) == 0)
             {
                 long fsize[2];
+                skip_empty_primary(fptr, &status);
                 fits_get_img_size(fptr, 2, fsize, &status);
                 if (status == 0 && fsize[0] == sensorSize.x && fsize[1] == sensorSize.y)
                     bOk = true;
@@ -2651,7 +2779,7 @@ void MyFrame::SaveDarkLibrary(const wxString& note)
 
     Debug.Write("saving dark library\n");
 
-    if (save_multi_darks(pCamera->Darks, filename, note))
+    if (save_multi_darks(pCamera, filename, note))
     {
         Alert(wxString::Format(_("Error saving darks FITS file %s"), filename));
     }
@@ -2872,6 +3000,7 @@ void MyFrameConfigDialogPane::LayoutControls(BrainCtrlIdMap& CtrlMap)
     this->Add(pTopGrid, sizer_flags);
     this->Add(GetSizerCtrl(CtrlMap, AD_szSoftwareUpdate), sizer_flags);
     this->Add(GetSizerCtrl(CtrlMap, AD_szLogFileInfo), sizer_flags);
+    this->Add(GetSizerCtrl(CtrlMap, AD_szGuideLogOptions), sizer_flags);
     this->Add(GetSingleCtrl(CtrlMap, AD_cbEnableImageLogging), sizer_flags);
     this->Add(GetSizerCtrl(CtrlMap, AD_szImageLoggingOptions), sizer_flags);
     this->Add(GetSizerCtrl(CtrlMap, AD_szDither), sizer_flags);
@@ -3030,6 +3159,11 @@ MyFrameConfigDialogCtrlSet::MyFrameConfigDialogCtrlSet(MyFrame *pFrame, Advanced
                    _("How long should PHD wait between guide frames? Default = 0ms, useful when using very short exposures "
                      "(e.g., using a video camera) but wanting to send guide commands less frequently"));
 
+    m_pPipelinedCapture = new wxCheckBox(GetParentWindow(AD_cbPipelinedCapture), wxID_ANY, _("Pipelined capture"));
+    AddCtrl(CtrlMap, AD_cbPipelinedCapture, m_pPipelinedCapture,
+            _("While looping, start the next exposure while the current frame is being processed. Increases the frame rate "
+              "with short exposures. Calibration and guiding always wait for the current frame to be processed."));
+
     parent = GetParentWindow(AD_szFocalLength);
     // Put a validator on this field to be sure that only digits are entered - avoids problem where
     // user face-plant on keyboard results in a focal length of zero
@@ -3071,6 +3205,24 @@ MyFrameConfigDialogCtrlSet::MyFrameConfigDialogCtrlSet(MyFrame *pFrame, Advanced
     pInputGroupBox->Add(pButtonSizer, wxSizerFlags(0).Align(wxRIGHT).Border(wxTop, 20));
     AddGroup(CtrlMap, AD_szLogFileInfo, pInputGroupBox);
 
+    // Guide log options
+    {
+        parent = GetParentWindow(AD_szGuideLogOptions);
+        wxBoxSizer *sz = new wxBoxSizer(wxHORIZONTAL);
+        width = StringWidth(_T("000"));
+        m_pGuideLogFlushInterval = pFrame->MakeSpinCtrl(parent, wxID_ANY, _T(" "), wxDefaultPosition, wxSize(width, -1),
+                                                        wxSP_ARROW_KEYS, 0, 60, 5, _T("GuideLogFlush"));
+        sz->Add(MakeLabeledControl(AD_szGuideLogOptions, _("Write guide log to disk every (s)"), m_pGuideLogFlushInterval,
+                                   _("Guide steps are written to disk at most this many seconds after they happen. Calibration "
+                                     "and guiding start and stop are always written immediately. 0 = write every step")),
+                wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL).Border(wxALL, 8));
+        m_pBinaryGuideLog = new wxCheckBox(parent, wxID_ANY, _("Binary guide log"));
+        m_pBinaryGuideLog->SetToolTip(_("Also write the guide steps to a compact binary file (.bin) next to the guide log, "
+                                        "for fast loading into analysis tools"));
+        sz->Add(m_pBinaryGuideLog, wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL).Border(wxALL, 8));
+        AddGroup(CtrlMap, AD_szGuideLogOptions, sz);
+    }
+
     const int PAD = 6;
 
     // Image logging controls
@@ -3229,6 +3381,7 @@ void MyFrameConfigDialogCtrlSet::LoadValues()
     m_ditherRaOnly->SetValue(m_pFrame->GetDitherRaOnly());
     m_ditherScaleFactor->SetValue(m_pFrame->GetDitherScaleFactor());
     m_pTimeLapse->SetValue(m_pFrame->GetTimeLapse());
+    m_pPipelinedCapture->SetValue(m_pFrame->GetPipelinedCapture());
     VarDelayCfg delayCfg = m_pFrame->GetVariableDelayConfig();
     m_varExposureDelayEnabled->SetValue(delayCfg.enabled);
     m_varExpDelayShort->SetValue((int) delayCfg.shortDelay / 1000.);
@@ -3246,6 +3399,8 @@ void MyFrameConfigDialogCtrlSet::LoadValues()
     m_pLanguage->Enable(!pFrame->CaptureActive);
 
     m_pLogDir->SetValue(GuideLog.GetLogDir());
+    m_pGuideLogFlushInterval->SetValue(GuideLog.GetFlushInterval());
+    m_pBinaryGuideLog->SetValue(GuideLog.GetBinaryLog());
     m_pLogDir->Enable(!pFrame->CaptureActive);
     m_pSelectDir->Enable(!pFrame->CaptureActive);
     m_pAutoLoadCalibration->SetValue(m_pFrame->GetAutoLoadCalibration());
@@ -3323,6 +3478,7 @@ void MyFrameConfigDialogCtrlSet::UnloadValues()
         m_pFrame->SetDitherRaOnly(m_ditherRaOnly->GetValue());
         m_pFrame->SetDitherScaleFactor(m_ditherScaleFactor->GetValue());
         m_pFrame->SetTimeLapse(m_pTimeLapse->GetValue());
+        m_pFrame->SetPipelinedCapture(m_pPipelinedCapture->GetValue());
         pFrame->SetVariableDelayConfig(m_varExposureDelayEnabled->GetValue(), m_varExpDelayShort->GetValue() * 1000,
                                        m_varExpDelayLong->GetValue() * 1000);
         int oldFL = m_pFrame->GetFocalLength();
@@ -3353,6 +3509,9 @@ void MyFrameConfigDialogCtrlSet::UnloadValues()
             Debug.ChangeDirLog(newdir);
         }
 
+        GuideLog.SetFlushInterval(m_pGuideLogFlushInterval->GetValue());
+        GuideLog.SetBinaryLog(m_pBinaryGuideLog->GetValue());
+
         m_pFrame->SetAutoLoadCalibration(m_pAutoLoadCalibration->GetValue());
 
         std::vector<int> dur(m_pFrame->GetExposureDurations());
@@ -116,6 +116,27 @@ struct SingleExposure
     wxRect subframe;
 };
 
+// Capture cadence (interval between frames arriving from the camera) and
+// frame-to-correction latency (time from a frame arriving until the guide
+// correction computed from it is dispatched), summarized in the debug log
+struct CaptureTiming
+{
+    wxLongLong_t frameReady; // arrival time of the frame being processed, 0 once its correction is out
+    wxLongLong_t prevFrameReady;
+    unsigned int frames;
+    unsigned int intervals;
+    unsigned int corrections;
+    double intervalSum;
+    double latencySum;
+    wxLongLong_t latencyMax;
+
+    CaptureTiming() { Reset(); }
+    void Reset();
+    void FrameReady(wxLongLong_t t);
+    void CorrectionDispatched(wxLongLong_t t);
+    void Log(const wxString& when) const;
+};
+
 class MyFrameConfigDialogCtrlSet : public ConfigDialogCtrlSet
 {
     MyFrame *m_pFrame;
@@ -134,6 +155,8 @@ class MyFrameConfigDialogCtrlSet : public ConfigDialogCtrlSet
     int m_oldLanguageChoice;
     wxTextCtrl *m_pLogDir;
     wxButton *m_pSelectDir;
+    wxSpinCtrl *m_pGuideLogFlushInterval;
+    wxCheckBox *m_pBinaryGuideLog;
     wxCheckBox *m_EnableImageLogging;
     wxStaticBoxSizer *m_LoggingOptions;
     wxCheckBox *m_LogNextNFrames;
@@ -145,6 +168,7 @@ class MyFrameConfigDialogCtrlSet : public ConfigDialogCtrlSet
     wxSpinCtrlDouble *m_LogAbsErrorThresh;
     wxSpinCtrl *m_LogNextNFramesCount;
     wxCheckBox *m_pAutoLoadCalibration;
+    wxCheckBox *m_pPipelinedCapture;
     wxComboBox *m_autoExpDurationMin;
     wxComboBox *m_autoExpDurationMax;
     wxSpinCtrlDouble *m_autoExpSNR;
@@ -197,6 +221,8 @@ private:
     bool m_beepForLostStar;
     double m_sampling;
     bool m_autoLoadCalibration;
+    bool m_pipelinedCapture; // start the next exposure before the current frame is processed
+    CaptureTiming m_captureTiming;
 
     wxAuiManager m_mgr;
     PHDStatusBar *m_statusbar;
@@ -341,7 +367,7 @@ public:
     void OnImportCamCal(wxCommandEvent& evt);
 
     void OnExposeComplete(wxThreadEvent& evt);
-    void OnExposeComplete(usImage *image, bool err);
+    void OnExposeComplete(usImage *image, bool err, const StarMeasurementPtr& measurement = StarMeasurementPtr());
     void OnMoveComplete(wxThreadEvent& evt);
 
     void LoadProfileSettings();
@@ -374,6 +400,8 @@ public:
     int GetFocalLength() const;
     bool GetAutoLoadCalibration() const;
     void SetAutoLoadCalibration(bool val);
+    bool GetPipelinedCapture() const;
+    void SetPipelinedCapture(bool val);
     void LoadCalibration();
     static wxString GetDefaultFileDir();
     static wxString GetDarksDir();
@@ -513,6 +541,7 @@ private:
     void SetComboBoxWidth(wxComboBox *pComboBox, unsigned int extra);
     void FinishStop();
     void DoTryReconnect();
+    bool CanPipelineExposure() const;
 
     // and of course, an event table
     wxDECLARE_EVENT_TABLE();
@@ -763,6 +792,11 @@ inline bool MyFrame::GetAutoLoadCalibration() const
     return m_autoLoadCalibration;
 }
 
+inline bool MyFrame::GetPipelinedCapture() const
+{
+    return m_pipelinedCapture;
+}
+
 inline bool MyFrame::GetServerMode() const
 {
     return m_serverMode;
@@ -400,6 +400,7 @@ void MyFrame::OnButtonLoop(wxCommandEvent& WXUNUSED(event))
 void MyFrame::FinishStop(void)
 {
     assert(!CaptureActive);
+    m_captureTiming.Log("stopped");
     m_singleExposure.enabled = false;
     EvtServer.NotifyLoopingStopped();
     // when looping resumes, start with at least one full frame. This enables applications
@@ -441,10 +442,11 @@ static void WarnRawImageMode(void)
  * - calls the routine to update the guider state (which may do nothing)
  * - calls any other appropriate state update routine depending upon the current state
  * - updates button state based on appropriate state variables
- * - schedules another exposure if CaptureActive is stil true
+ * - schedules another exposure if CaptureActive is stil true (with pipelined capture
+ *   while looping, this happens before the frame is processed)
  *
  */
-void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
+void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err, const StarMeasurementPtr& measurement)
 {
     try
     {
@@ -452,6 +454,14 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
 
         m_exposurePending = false;
 
+        if (measurement && measurement->move.mount)
+        {
+            // the worker thread made the guide correction for this frame; its move
+            // complete event follows this one
+            measurement->move.mount->IncrementRequestCount();
+            m_captureTiming.CorrectionDispatched(measurement->move.time);
+        }
+
         if (pGuider->GetPauseType() == PAUSE_FULL)
         {
             delete pNewFrame;
@@ -489,6 +499,12 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
 
         pNewFrame->FrameNum = ++m_frameCounter;
 
+        if (CanPipelineExposure())
+        {
+            Debug.Write("OnExposeComplete: starting next exposure before processing the frame\n");
+            ScheduleExposure();
+        }
+
         if (m_rawImageMode && !m_rawImageModeWarningDone)
         {
             WarnRawImageMode();
@@ -501,7 +517,7 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
             CheckDarkFrameGeometry();
         }
 
-        pGuider->UpdateGuideState(pNewFrame, !m_continueCapturing);
+        pGuider->UpdateGuideState(pNewFrame, !m_continueCapturing, measurement);
         pNewFrame = NULL; // the guider owns it now
 
         PhdController::UpdateControllerState();
@@ -511,11 +527,14 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
 
         CaptureActive = m_continueCapturing;
 
+        // with pipelined capture the next exposure may already be in progress; if capturing
+        // was stopped meanwhile, FinishStop runs when that exposure completes
         if (CaptureActive)
         {
-            ScheduleExposure();
+            if (!m_exposurePending)
+                ScheduleExposure();
         }
-        else
+        else if (!m_exposurePending)
         {
             FinishStop();
         }
@@ -527,11 +546,14 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
     }
 }
 
-void MyFrame::OnExposeComplete(wxThreadEvent& event)
+void MyFrame::OnExposeComplete(wxThreadEvent& event_)
 {
+    ExposeCompleteEvent& event = static_cast<ExposeCompleteEvent&>(event_);
     usImage *image = event.GetPayload<usImage *>();
     bool err = event.GetInt() != 0;
-    OnExposeComplete(image, err);
+    if (!err)
+        m_captureTiming.FrameReady(event.readyTime);
+    OnExposeComplete(image, err, event.measurement);
 }
 
 void MyFrame::OnMoveComplete(wxThreadEvent& event_)
@@ -0,0 +1,158 @@
+/*
+ *  parallel.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "parallel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+class WorkerPool
+{
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_lock; // protects the fields below
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    unsigned int m_generation;
+    unsigned int m_running; // workers still in the current job
+    bool m_shutdown;
+
+    // the current job
+    const std::function<void(int)> *m_task;
+    int m_count;
+    std::atomic<int> m_next;
+
+    // serializes ParallelFor callers
+    std::mutex m_busy;
+
+    void RunTasks()
+    {
+        int i;
+        while ((i = m_next.fetch_add(1)) < m_count)
+            (*m_task)(i);
+    }
+
+    void Worker()
+    {
+        unsigned int seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lck(m_lock);
+                m_start.wait(lck, [&] { return m_shutdown || m_generation != seen; });
+                if (m_shutdown)
+                    return;
+                seen = m_generation;
+            }
+
+            RunTasks();
+
+            std::lock_guard<std::mutex> lck(m_lock);
+            if (--m_running == 0)
+                m_done.notify_one();
+        }
+    }
+
+public:
+    WorkerPool() : m_generation(0), m_running(0), m_shutdown(false), m_task(nullptr), m_count(0), m_next(0)
+    {
+        unsigned int n = std::thread::hardware_concurrency();
+        for (unsigned int i = 1; i < n; i++)
+            m_threads.push_back(std::thread(&WorkerPool::Worker, this));
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lck(m_lock);
+            m_shutdown = true;
+        }
+        m_start.notify_all();
+        for (auto& t : m_threads)
+            t.join();
+    }
+
+    unsigned int ThreadCount() const { return m_threads.size() + 1; }
+
+    void Run(int count, const std::function<void(int)>& task)
+    {
+        std::unique_lock<std::mutex> busy(m_busy, std::try_to_lock);
+
+        if (count <= 1 || m_threads.empty() || !busy.owns_lock())
+        {
+            for (int i = 0; i < count; i++)
+                task(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lck(m_lock);
+            m_task = &task;
+            m_count = count;
+            m_next = 0;
+            m_running = m_threads.size();
+            ++m_generation;
+        }
+        m_start.notify_all();
+
+        RunTasks();
+
+        std::unique_lock<std::mutex> lck(m_lock);
+        m_done.wait(lck, [&] { return m_running == 0; });
+        m_task = nullptr;
+    }
+};
+
+WorkerPool& Pool()
+{
+    static WorkerPool s_pool;
+    return s_pool;
+}
+
+} // namespace
+
+unsigned int ParallelThreadCount()
+{
+    return Pool().ThreadCount();
+}
+
+void ParallelFor(int count, const std::function<void(int)>& task)
+{
+    Pool().Run(count, task);
+}
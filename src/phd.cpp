@@ -35,6 +35,7 @@
 #include "phd.h"
 
 #include "phdupdate.h"
+#include "cpu_features.h"
 
 #include <curl/curl.h>
 #include <memory>
@@ -419,6 +420,7 @@ static void OpenLogs(bool rollover)
 #if defined(CV_VERSION)
     Debug.Write(wxString::Format("   opencv %s\n", CV_VERSION));
 #endif
+    Debug.Write(wxString::Format("   SIMD %s\n", SimdLevelName(CpuSimdLevel())));
 
     if (rollover)
     {
@@ -491,6 +493,8 @@ bool PhdApp::OnInit()
     // capture wx error messages until the debug log has been opened
     EarlyLogger logger;
 
+    DebugLog::InstallCrashHandler();
+
     if (argc > 1 && argv[1] == _T("restart"))
         HandleRestart(); // exits
 
@@ -36,7 +36,12 @@
  */
 
 #include "phd.h"
+#include "frame_pool.h"
+#include "star_find.h"
+#include "parallel.h"
+
 #include <algorithm>
+#include <chrono>
 
 Star::Star()
 {
@@ -69,396 +74,53 @@ void Star::SetError(FindResult error)
     m_lastFindResult = error;
 }
 
-// helper struct for HFR calculation
-struct R2M
+static void StarFindLog(void *, const char *msg)
 {
-    double r2;
-    wxPoint p;
-    double m;
-    R2M() { }
-    R2M(int x, int y, double m_) : p(x, y), m(m_) { }
-    bool operator<(const R2M& rhs) const { return r2 < rhs.r2; }
-};
-
-static double hfr(std::vector<R2M>& vec, double cx, double cy, double mass)
-{
-    if (vec.size() == 1) // hot pixel?
-        return 0.25;
-
-    // compute Half Flux Radius (HFR)
-    for (auto it = vec.begin(); it != vec.end(); ++it)
-    {
-        double dx = (double) it->p.x - cx;
-        double dy = (double) it->p.y - cy;
-        it->r2 = dx * dx + dy * dy;
-    }
-    std::sort(vec.begin(), vec.end()); // sort by ascending radius^2
-
-    // find radius of half-mass
-    double r20, r21, m0, m1;
-    r20 = r21 = m0 = m1 = 0.0;
-    double halfm = 0.5 * mass;
-    for (auto it = vec.begin(); it != vec.end(); ++it)
-    {
-        const R2M& rm = *it;
-        r20 = r21;
-        m0 = m1;
-        r21 = rm.r2;
-        m1 += rm.m;
-        if (m1 > halfm)
-            break;
-    }
-
-    // interpolate
-    double hfr;
-    if (m1 > m0)
-    {
-        double r0 = sqrt(r20), r1 = sqrt(r21);
-        double s = (r1 - r0) / (m1 - m0);
-        hfr = r0 + s * (halfm - m0);
-    }
-    else
-        hfr = 0.25;
-
-    return hfr;
+    Debug.Write(wxString(msg));
 }
 
+// the core result codes are the Star::FindResult values
+static_assert(STAR_FIND_OK == (int) Star::STAR_OK && STAR_FIND_SATURATED == (int) Star::STAR_SATURATED &&
+                  STAR_FIND_LOWSNR == (int) Star::STAR_LOWSNR && STAR_FIND_LOWMASS == (int) Star::STAR_LOWMASS &&
+                  STAR_FIND_LOWHFD == (int) Star::STAR_LOWHFD && STAR_FIND_HIHFD == (int) Star::STAR_HIHFD &&
+                  STAR_FIND_TOO_NEAR_EDGE == (int) Star::STAR_TOO_NEAR_EDGE &&
+                  STAR_FIND_MASSCHANGE == (int) Star::STAR_MASSCHANGE && STAR_FIND_ERROR == (int) Star::STAR_ERROR,
+              "StarFindCode must match Star::FindResult");
+
 bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, FindMode mode, double minHFD, double maxHFD,
                 unsigned short maxADU, StarFindLogType loggingControl)
 {
-    FindResult Result = STAR_OK;
-    double newX = base_x;
-    double newY = base_y;
-
-    try
-    {
-        if (loggingControl == FIND_LOGGING_VERBOSE)
-            Debug.Write(wxString::Format("Star::Find(%d, %d, %d, %d, (%d,%d,%d,%d), %.1f, %0.1f, %hu) frame %u\n", searchRegion,
-                                         base_x, base_y, mode, pImg->Subframe.x, pImg->Subframe.y, pImg->Subframe.width,
-                                         pImg->Subframe.height, minHFD, maxHFD, maxADU, pImg->FrameNum));
-
-        int minx, miny, maxx, maxy;
-
-        if (pImg->Subframe.IsEmpty())
-        {
-            minx = miny = 0;
-            maxx = pImg->Size.GetWidth() - 1;
-            maxy = pImg->Size.GetHeight() - 1;
-        }
-        else
-        {
-            minx = pImg->Subframe.GetLeft();
-            maxx = pImg->Subframe.GetRight();
-            miny = pImg->Subframe.GetTop();
-            maxy = pImg->Subframe.GetBottom();
-        }
-
-        // search region bounds
-        int start_x = wxMax(base_x - searchRegion, minx);
-        int end_x = wxMin(base_x + searchRegion, maxx);
-        int start_y = wxMax(base_y - searchRegion, miny);
-        int end_y = wxMin(base_y + searchRegion, maxy);
-
-        if (end_x <= start_x || end_y <= start_y)
-        {
-            throw ERROR_INFO("coordinates are invalid");
-        }
-
-        const unsigned short *imgdata = pImg->ImageData;
-        int rowsize = pImg->Size.GetWidth();
-
-        int peak_x = 0, peak_y = 0;
-        unsigned int peak_val = 0;
-        unsigned short max3[3] = { 0, 0, 0 };
-
-        if (mode == FIND_PEAK)
-        {
-            for (int y = start_y; y <= end_y; y++)
-            {
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    unsigned short val = imgdata[y * rowsize + x];
-
-                    if (val > peak_val)
-                    {
-                        peak_val = val;
-                        peak_x = x;
-                        peak_y = y;
-                    }
-                }
-            }
-
-            PeakVal = peak_val;
-        }
-        else
-        {
-            // find the peak value within the search region using a smoothing function
-            // also check for saturation
-
-            for (int y = start_y + 1; y <= end_y - 1; y++)
-            {
-                for (int x = start_x + 1; x <= end_x - 1; x++)
-                {
-                    unsigned short p = imgdata[y * rowsize + x];
-                    unsigned int val = 4 * (unsigned int) p + imgdata[(y - 1) * rowsize + (x - 1)] +
-                        imgdata[(y - 1) * rowsize + (x + 1)] + imgdata[(y + 1) * rowsize + (x - 1)] +
-                        imgdata[(y + 1) * rowsize + (x + 1)] + 2 * imgdata[(y - 1) * rowsize + (x + 0)] +
-                        2 * imgdata[(y + 0) * rowsize + (x - 1)] + 2 * imgdata[(y + 0) * rowsize + (x + 1)] +
-                        2 * imgdata[(y + 1) * rowsize + (x + 0)];
-
-                    if (val > peak_val)
-                    {
-                        peak_val = val;
-                        peak_x = x;
-                        peak_y = y;
-                    }
-
-                    if (p > max3[0])
-                        std::swap(p, max3[0]);
-                    if (p > max3[1])
-                        std::swap(p, max3[1]);
-                    if (p > max3[2])
-                        std::swap(p, max3[2]);
-                }
-            }
-
-            PeakVal = max3[0]; // raw peak val
-            peak_val /= 16; // smoothed peak value
-        }
-
-        // measure noise in the annulus with inner radius A and outer radius B
-        int const A = 7; // inner radius
-        int const B = 12; // outer radius
-        int const A2 = A * A;
-        int const B2 = B * B;
-
-        // center window around peak value
-        start_x = wxMax(peak_x - B, minx);
-        end_x = wxMin(peak_x + B, maxx);
-        start_y = wxMax(peak_y - B, miny);
-        end_y = wxMin(peak_y + B, maxy);
-
-        // find the mean and stdev of the background
-
-        unsigned int nbg;
-        double mean_bg = 0., prev_mean_bg;
-        double sigma2_bg = 0.;
-        double sigma_bg = 0.;
-
-        for (int iter = 0; iter < 9; iter++)
-        {
-            double sum = 0.0;
-            double a = 0.0;
-            double q = 0.0;
-            nbg = 0;
-
-            const unsigned short *row = imgdata + rowsize * start_y;
-            for (int y = start_y; y <= end_y; y++, row += rowsize)
-            {
-                int dy = y - peak_y;
-                int dy2 = dy * dy;
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    int dx = x - peak_x;
-                    int r2 = dx * dx + dy2;
-
-                    // exclude points not in annulus
-                    if (r2 <= A2 || r2 > B2)
-                        continue;
-
-                    double const val = (double) row[x];
-
-                    if (iter > 0 && (val < mean_bg - 2.0 * sigma_bg || val > mean_bg + 2.0 * sigma_bg))
-                        continue;
-
-                    sum += val;
-                    ++nbg;
-                    double const k = (double) nbg;
-                    double const a0 = a;
-                    a += (val - a) / k;
-                    q += (val - a0) * (val - a);
-                }
-            }
-
-            if (nbg < 10) // only possible after the first iteration
-            {
-                Debug.Write(wxString::Format("Star::Find: too few background points! nbg=%u mean=%.1f sigma=%.1f\n", nbg,
-                                             mean_bg, sigma_bg));
-                break;
-            }
-
-            prev_mean_bg = mean_bg;
-            mean_bg = sum / (double) nbg;
-            sigma2_bg = q / (double) (nbg - 1);
-            sigma_bg = sqrt(sigma2_bg);
-
-            if (iter > 0 && fabs(mean_bg - prev_mean_bg) < 0.5)
-                break;
-        }
-
-        unsigned short thresh;
-
-        double cx = 0.0;
-        double cy = 0.0;
-        double mass = 0.0;
-        unsigned int n;
-
-        std::vector<R2M> hfrvec;
-
-        if (mode == FIND_PEAK)
-        {
-            mass = peak_val;
-            n = 1;
-            thresh = 0;
-        }
-        else
-        {
-            thresh = (unsigned short) (mean_bg + 3.0 * sigma_bg + 0.5);
-
-            // find pixels over threshold within aperture; compute mass and centroid
-
-            start_x = wxMax(peak_x - A, minx);
-            end_x = wxMin(peak_x + A, maxx);
-            start_y = wxMax(peak_y - A, miny);
-            end_y = wxMin(peak_y + A, maxy);
-
-            n = 0;
-
-            const unsigned short *row = imgdata + rowsize * start_y;
-            for (int y = start_y; y <= end_y; y++, row += rowsize)
-            {
-                int dy = y - peak_y;
-                int dy2 = dy * dy;
-                if (dy2 > A2)
-                    continue;
-
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    int dx = x - peak_x;
-
-                    // exclude points outside aperture
-                    if (dx * dx + dy2 > A2)
-                        continue;
-
-                    // exclude points below threshold
-                    unsigned short val = row[x];
-                    if (val < thresh)
-                        continue;
-
-                    double const d = (double) val - mean_bg;
-
-                    cx += dx * d;
-                    cy += dy * d;
-                    mass += d;
-                    ++n;
-
-                    hfrvec.push_back(R2M(x, y, d));
-                }
-            }
-        }
-
-        Mass = mass;
-
-        // SNR estimate from: Measuring the Signal-to-Noise Ratio S/N of the CCD Image of a Star or Nebula, J.H.Simonetti, 2004
-        // January 8
-        //     http://www.phys.vt.edu/~jhs/phys3154/snr20040108.pdf
-        double const gain = .5; // electrons per ADU, nominal
-        SNR = n > 0 ? mass / sqrt(mass / gain + sigma2_bg * (double) n * (1.0 + 1.0 / (double) nbg)) : 0.0;
-
-        double const LOW_SNR = 3.0;
-
-        // a few scattered pixels over threshold can give a false positive
-        // avoid this by requiring the smoothed peak value to be above the threshold
-        if (peak_val <= thresh && SNR >= LOW_SNR)
-        {
-            Debug.Write(wxString::Format("Star::Find false star n=%u nbg=%u bg=%.1f sigma=%.1f thresh=%u peak=%u\n", n, nbg,
-                                         mean_bg, sigma_bg, thresh, peak_val));
-            SNR = LOW_SNR - 0.1;
-        }
-
-        if (mass < 10.0)
-        {
-            HFD = 0.;
-            Result = STAR_LOWMASS;
-            goto done;
-        }
-
-        if (SNR < LOW_SNR)
-        {
-            HFD = 0.;
-            Result = STAR_LOWSNR;
-            goto done;
-        }
-
-        newX = peak_x + cx / mass;
-        newY = peak_y + cy / mass;
-
-        HFD = 2.0 * hfr(hfrvec, newX, newY, mass);
-        // Check for constraints on HFD value
-        if (mode != FIND_PEAK)
-        {
-            if (HFD < minHFD)
-            {
-                Result = STAR_LOWHFD;
-                goto done;
-            }
-            if (HFD > maxHFD)
-            {
-                Result = STAR_HIHFD;
-                goto done;
-            }
-        }
-
-        // check for saturation
-
-        unsigned int mx = (unsigned int) max3[0];
-
-        // remove pedestal
-        if (mx >= pImg->Pedestal)
-            mx -= pImg->Pedestal;
-        else
-            mx = 0; // unlikely
+    if (loggingControl == FIND_LOGGING_VERBOSE)
+        Debug.Write(wxString::Format("Star::Find(%d, %d, %d, %d, (%d,%d,%d,%d), %.1f, %0.1f, %hu) frame %u\n", searchRegion,
+                                     base_x, base_y, mode, pImg->Subframe.x, pImg->Subframe.y, pImg->Subframe.width,
+                                     pImg->Subframe.height, minHFD, maxHFD, maxADU, pImg->FrameNum));
 
-        if (maxADU > 0)
-        {
-            // maxADU is known
-            if (mx >= maxADU)
-                Result = STAR_SATURATED;
-            goto done;
-        }
+    StarFindParams params;
+    params.searchRegion = searchRegion;
+    params.baseX = base_x;
+    params.baseY = base_y;
+    params.peakMode = mode == FIND_PEAK;
+    params.minHFD = minHFD;
+    params.maxHFD = maxHFD;
+    params.maxADU = maxADU;
+    params.pedestal = pImg->Pedestal;
+    params.bitsPerPixel = pImg->BitsPerPixel;
 
-        // maxADU not known, use the "flat-top" heuristic
-        //
-        // even at saturation, the max values may vary a bit due to noise
-        // Call it saturated if the the top three values are within 32 parts per 65535 of max for 16-bit cameras,
-        // or within 1 part per 191 for 8-bit cameras
-        unsigned int d = (unsigned int) (max3[0] - max3[2]);
+    CoreLog const log = { StarFindLog, nullptr };
 
-        if (pImg->BitsPerPixel < 12)
-        {
-            if (d * 191U < 1U * mx)
-                Result = STAR_SATURATED;
-        }
-        else
-        {
-            if (d * 65535U < 32U * mx)
-                Result = STAR_SATURATED;
-        }
-    }
-    catch (const wxString& Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
+    StarFindResult res;
+    FindStar(&res, pImg->View(), params, log);
 
-        if (Result == STAR_OK)
-        {
-            Result = STAR_ERROR;
-        }
-    }
+    FindResult Result = static_cast<FindResult>(res.code);
 
-done:
     // update state
-    SetXY(newX, newY);
+    SetXY(res.x, res.y);
     m_lastFindResult = Result;
+    if (Result != STAR_ERROR)
+        PeakVal = res.peakVal;
+    Mass = res.mass;
+    SNR = res.snr;
+    HFD = res.hfd;
 
     bool wasFound = WasFound(Result);
 
@@ -471,7 +133,7 @@ done:
 
     if (loggingControl == FIND_LOGGING_VERBOSE)
         Debug.Write(wxString::Format("Star::Find returns %d (%d), X=%.2f, Y=%.2f, Mass=%.f, SNR=%.1f, Peak=%hu HFD=%.1f\n",
-                                     wasFound, Result, newX, newY, Mass, SNR, PeakVal, HFD));
+                                     wasFound, Result, res.x, res.y, Mass, SNR, PeakVal, HFD));
 
     return wasFound;
 }
@@ -496,13 +158,13 @@ struct FloatImg
         for (unsigned int i = 0; i < NPixels; i++)
             px[i] = (float) img.ImageData[i];
     }
-    ~FloatImg() { delete[] px; }
+    ~FloatImg() { FramePoolFree(px); }
     void Init(const wxSize& sz)
     {
-        delete[] px;
+        FramePoolFree(px);
         Size = sz;
         NPixels = Size.GetWidth() * Size.GetHeight();
-        px = new float[NPixels];
+        px = FramePoolAlloc<float>(NPixels);
     }
     void Swap(FloatImg& other)
     {
@@ -512,35 +174,76 @@ struct FloatImg
     }
 };
 
-static void GetStats(double *mean, double *stdev, const FloatImg& img, const wxRect& win)
+// sample count, sum and sum of squared deviations from the mean
+struct RunningStats
 {
-    // Determine the mean and standard deviation
-    double sum = 0.0;
-    double a = 0.0;
-    double q = 0.0;
-    double k = 1.0;
-    double km1 = 0.0;
+    double n;
+    double sum;
+    double q;
 
-    const int width = img.Size.GetWidth();
-    const float *p0 = &img.px[win.GetTop() * width + win.GetLeft()];
-    for (int y = 0; y < win.GetHeight(); y++)
+    RunningStats() : n(0.0), sum(0.0), q(0.0) { }
+
+    // combine with the stats of a disjoint set of samples (Chan et al.)
+    void Merge(const RunningStats& other)
     {
-        const float *end = p0 + win.GetWidth();
-        for (const float *p = p0; p < end; p++)
+        if (other.n == 0.0)
+            return;
+        if (n == 0.0)
         {
-            double const x = (double) *p;
-            sum += x;
-            double const a0 = a;
-            a += (x - a) / k;
-            q += (x - a0) * (x - a);
-            km1 = k;
-            k += 1.0;
+            *this = other;
+            return;
         }
-        p0 += width;
+        double const nn = n + other.n;
+        double const delta = other.sum / other.n - sum / n;
+        q += other.q + delta * delta * n * other.n / nn;
+        sum += other.sum;
+        n = nn;
     }
+};
 
-    *mean = sum / km1;
-    *stdev = sqrt(q / km1);
+static void GetStats(double *mean, double *stdev, const FloatImg& img, const wxRect& win)
+{
+    // Determine the mean and standard deviation. The window is split into
+    // bands of rows that are processed on the worker threads; each band
+    // takes two passes over its (cache-resident) rows, first for the mean
+    // then for the squared deviations, and the bands are then merged.
+    int const BAND_ROWS = 64;
+    int const nbands = (win.GetHeight() + BAND_ROWS - 1) / BAND_ROWS;
+    std::vector<RunningStats> bands(nbands);
+
+    const int width = img.Size.GetWidth();
+
+    ParallelFor(nbands, [&](int band) {
+        RunningStats& st = bands[band];
+        int const y0 = band * BAND_ROWS;
+        int const y1 = wxMin(y0 + BAND_ROWS, win.GetHeight());
+        const float *const first = &img.px[(win.GetTop() + y0) * width + win.GetLeft()];
+
+        const float *p0 = first;
+        for (int y = y0; y < y1; y++, p0 += width)
+            for (const float *p = p0; p < p0 + win.GetWidth(); p++)
+                st.sum += *p;
+
+        st.n = (double) (y1 - y0) * win.GetWidth();
+        double const a = st.sum / st.n;
+
+        p0 = first;
+        for (int y = y0; y < y1; y++, p0 += width)
+        {
+            for (const float *p = p0; p < p0 + win.GetWidth(); p++)
+            {
+                double const d = *p - a;
+                st.q += d * d;
+            }
+        }
+    });
+
+    RunningStats st;
+    for (const RunningStats& b : bands)
+        st.Merge(b);
+
+    *mean = st.sum / st.n;
+    *stdev = sqrt(st.q / st.n);
 }
 
 // un-comment to save the intermediate autofind image
@@ -571,111 +274,209 @@ static void SaveImage(const FloatImg& img, const char *name)
 #endif // SAVE_AUTOFIND_IMG
 }
 
-static void psf_conv(FloatImg& dst, const FloatImg& src)
+/* PSF Grid is:
+D3 D3 D3 D3 D3 D3 D3 D3 D3
+D3 D3 D3 D2 D1 D2 D3 D3 D3
+D3 D3 C3 C2 C1 C2 C3 D3 D3
+D3 D2 C2 B2 B1 B2 C2 D2 D3
+D3 D1 C1 B1 A  B1 C1 D1 D3
+D3 D2 C2 B2 B1 B2 C2 D2 D3
+D3 D3 C3 C2 C1 C2 C3 D3 D3
+D3 D3 D3 D2 D1 D2 D3 D3 D3
+D3 D3 D3 D3 D3 D3 D3 D3 D3
+
+1@A
+4@B1, B2, C1, C3, D1
+8@C2, D2
+44 * D3
+
+The filter response is the sum over the rings of PSF[ring] * (ring sum - ring size * mean), where mean is the mean of the
+9x9 window. That is a linear filter whose weights are PSF[ring] - K / 81, with K = sum of PSF[ring] * ring size. Since
+D3 covers everything outside the inner 37 pixels, the response is (PSF[D3] - K / 81) times the 9x9 box sum plus
+(PSF[ring] - PSF[D3]) times each of the inner pixels. The box sum is separable, and the inner pixels are symmetric
+about the center row so the rows can be folded in pairs before the horizontal pass.
+*/
+
+enum
 {
-    dst.Init(src.Size);
+    CONV_RADIUS = 4
+};
 
-    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
-    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
+//                         A      B1     B2    C1     C2    C3     D1     D2     D3
+static const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
 
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
+// Convolve one row. rows[k] points to row y - 4 + k of the source, dst to row y of the output. tmp is scratch space for
+// 5 * width floats.
+static void psf_conv_row(float *dst, const float *const rows[2 * CONV_RADIUS + 1], int width, float *tmp)
+{
+    static const double K =
+        PSF[0] + 4.0 * (PSF[1] + PSF[2] + PSF[3] + PSF[5] + PSF[6]) + 8.0 * (PSF[4] + PSF[7]) + 44.0 * PSF[8];
+    static const double wbox = PSF[8] - K / 81.0;
+    static const double a = PSF[0] - PSF[8];
+    static const double b1 = PSF[1] - PSF[8];
+    static const double b2 = PSF[2] - PSF[8];
+    static const double c1 = PSF[3] - PSF[8];
+    static const double c2 = PSF[4] - PSF[8];
+    static const double c3 = PSF[5] - PSF[8];
+    static const double d1 = PSF[6] - PSF[8];
+    static const double d2 = PSF[7] - PSF[8];
+
+    if (width <= 2 * CONV_RADIUS)
+    {
+        memset(dst, 0, width * sizeof(float));
+        return;
+    }
 
-    memset(dst.px, 0, src.NPixels * sizeof(float));
+    // vertical pass: fold the rows symmetric about the center row, and the 9-row column sums
+    float *v0 = tmp;
+    float *v1 = v0 + width;
+    float *v2 = v1 + width;
+    float *v3 = v2 + width;
+    float *s9 = v3 + width;
 
-    /* PSF Grid is:
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D1 C1 B1 A  B1 C1 D1 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
+    for (int x = 0; x < width; x++)
+    {
+        v0[x] = rows[4][x];
+        v1[x] = rows[3][x] + rows[5][x];
+        v2[x] = rows[2][x] + rows[6][x];
+        v3[x] = rows[1][x] + rows[7][x];
+        s9[x] = v0[x] + v1[x] + v2[x] + v3[x] + (rows[0][x] + rows[8][x]);
+    }
 
-    1@A
-    4@B1, B2, C1, C3, D1
-    8@C2, D2
-    44 * D3
-    */
+    // horizontal pass
+    for (int x = 0; x < CONV_RADIUS; x++)
+        dst[x] = dst[width - 1 - x] = 0.f;
 
-    int psf_size = 4;
+    double box = 0.0;
+    for (int x = 0; x < 2 * CONV_RADIUS; x++)
+        box += s9[x];
 
-    for (int y = psf_size; y < height - psf_size; y++)
+    for (int x = CONV_RADIUS; x < width - CONV_RADIUS; x++)
     {
-        for (int x = psf_size; x < width - psf_size; x++)
-        {
-            float A, B1, B2, C1, C2, C3, D1, D2, D3;
-
-#define PX(dx, dy) *(src.px + width * (y + (dy)) + x + (dx))
-            A = PX(+0, +0);
-            B1 = PX(+0, -1) + PX(+0, +1) + PX(+1, +0) + PX(-1, +0);
-            B2 = PX(-1, -1) + PX(+1, -1) + PX(-1, +1) + PX(+1, +1);
-            C1 = PX(+0, -2) + PX(-2, +0) + PX(+2, +0) + PX(+0, +2);
-            C2 = PX(-1, -2) + PX(+1, -2) + PX(-2, -1) + PX(+2, -1) + PX(-2, +1) + PX(+2, +1) + PX(-1, +2) + PX(+1, +2);
-            C3 = PX(-2, -2) + PX(+2, -2) + PX(-2, +2) + PX(+2, +2);
-            D1 = PX(+0, -3) + PX(-3, +0) + PX(+3, +0) + PX(+0, +3);
-            D2 = PX(-1, -3) + PX(+1, -3) + PX(-3, -1) + PX(+3, -1) + PX(-3, +1) + PX(+3, +1) + PX(-1, +3) + PX(+1, +3);
-            D3 = PX(-4, -2) + PX(-3, -2) + PX(+3, -2) + PX(+4, -2) + PX(-4, -1) + PX(+4, -1) + PX(-4, +0) + PX(+4, +0) +
-                PX(-4, +1) + PX(+4, +1) + PX(-4, +2) + PX(-3, +2) + PX(+3, +2) + PX(+4, +2);
-#undef PX
-            int i;
-            const float *uptr;
-
-            uptr = src.px + width * (y - 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y - 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            double mean = (A + B1 + B2 + C1 + C2 + C3 + D1 + D2 + D3) / 81.0;
-            double PSF_fit = PSF[0] * (A - mean) + PSF[1] * (B1 - 4.0 * mean) + PSF[2] * (B2 - 4.0 * mean) +
-                PSF[3] * (C1 - 4.0 * mean) + PSF[4] * (C2 - 8.0 * mean) + PSF[5] * (C3 - 4.0 * mean) +
-                PSF[6] * (D1 - 4.0 * mean) + PSF[7] * (D2 - 8.0 * mean) + PSF[8] * (D3 - 44.0 * mean);
-
-            dst.px[width * y + x] = (float) PSF_fit;
-        }
+        box += s9[x + CONV_RADIUS];
+
+        double inner = a * v0[x] + b1 * (v0[x - 1] + v0[x + 1] + v1[x]) + b2 * (v1[x - 1] + v1[x + 1]) +
+            c1 * (v0[x - 2] + v0[x + 2] + v2[x]) + c2 * (v1[x - 2] + v1[x + 2] + v2[x - 1] + v2[x + 1]) +
+            c3 * (v2[x - 2] + v2[x + 2]) + d1 * (v0[x - 3] + v0[x + 3] + v3[x]) +
+            d2 * (v1[x - 3] + v1[x + 3] + v3[x - 1] + v3[x + 1]);
+
+        dst[x] = (float) (inner + wbox * box);
+
+        box -= s9[x - CONV_RADIUS];
     }
 }
 
-static void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
+// CPU time spent in each stage of AutoFindConv, summed over the worker threads
+struct AutoFindTimes
 {
-    int width = src.Size.GetWidth();
-    int dw = src.Size.GetWidth() / downsample;
-    int dh = src.Size.GetHeight() / downsample;
+    double median;
+    double downsample;
+    double conv;
+};
 
-    dst.Init(wxSize(dw, dh));
+static double ElapsedMs(std::chrono::steady_clock::time_point& t)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - t).count();
+    t = now;
+    return ms;
+}
 
+// Pre-process a frame for star detection: 3x3 median filter within rect (pixels outside rect are zeroed), conversion to
+// floating point, downsampling, and the PSF convolution. The stages are fused: the output is divided into bands of rows
+// that are processed on the worker threads, and each band computes the median and downsampled rows it needs, including
+// the few rows of overlap with its neighbors, in small per-band buffers. No full-size intermediate image is created.
+static void AutoFindConv(FloatImg& conv, const usImage& image, const wxRect& rect, int downsample, AutoFindTimes *times)
+{
+    int const width = image.Size.GetWidth();
+    int const dw = width / downsample;
+    int const dh = image.Size.GetHeight() / downsample;
     float const d2 = downsample * downsample;
 
-    for (int yy = 0; yy < dh; yy++)
-    {
-        for (int xx = 0; xx < dw; xx++)
+    conv.Init(wxSize(dw, dh));
+
+    int const threads = ParallelThreadCount();
+    int const band_rows = wxMax(32, wxMin(128, dh / (4 * threads)));
+    int const nbands = (dh + band_rows - 1) / band_rows;
+
+    std::vector<AutoFindTimes> band_times(nbands);
+
+    ParallelFor(nbands, [&](int band) {
+        AutoFindTimes& bt = band_times[band];
+        bt.median = bt.downsample = bt.conv = 0.0;
+        std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+
+        int const y0 = band * band_rows;
+        int const y1 = wxMin(y0 + band_rows, dh);
+
+        // rows within CONV_RADIUS of the edge have no filter response
+        int const cy0 = wxMax(y0, (int) CONV_RADIUS);
+        int const cy1 = wxMin(y1, dh - CONV_RADIUS);
+
+        for (int y = y0; y < y1; y++)
+            if (y < cy0 || y >= cy1)
+                memset(&conv.px[y * dw], 0, dw * sizeof(float));
+
+        if (cy0 >= cy1)
+            return;
+
+        // downsampled rows cy0 - CONV_RADIUS .. cy1 + CONV_RADIUS - 1
+        int const r0 = cy0 - CONV_RADIUS;
+        int const nrows = cy1 - cy0 + 2 * CONV_RADIUS;
+        FramePoolBuffer<float> ds(nrows * dw);
+        std::vector<unsigned short> med(width, 0);
+
+        for (int r = 0; r < nrows; r++)
         {
-            float sum = 0.0;
+            float *dsrow = &ds[r * dw];
+            memset(dsrow, 0, dw * sizeof(float));
+
             for (int j = 0; j < downsample; j++)
-                for (int i = 0; i < downsample; i++)
-                    sum += src.px[(yy * downsample + j) * width + xx * downsample + i];
-            float val = sum / d2;
-            dst.px[yy * dw + xx] = val;
+            {
+                int const y = (r0 + r) * downsample + j;
+                if (y >= rect.GetTop() && y <= rect.GetBottom())
+                    Median3Row(&med[rect.GetLeft()], image.ImageData, image.Size, rect, y - rect.GetTop());
+                else
+                    memset(&med[0], 0, width * sizeof(unsigned short));
+
+                bt.median += ElapsedMs(t);
+
+                // same summation order as a per-pixel loop over the downsample x downsample block
+                const unsigned short *m = &med[0];
+                for (int x = 0; x < dw; x++)
+                    for (int i = 0; i < downsample; i++)
+                        dsrow[x] += (float) *m++;
+
+                bt.downsample += ElapsedMs(t);
+            }
+
+            if (downsample > 1)
+            {
+                for (int x = 0; x < dw; x++)
+                    dsrow[x] /= d2;
+            }
+
+            bt.downsample += ElapsedMs(t);
         }
+
+        std::vector<float> tmp(5 * dw);
+        for (int y = cy0; y < cy1; y++)
+        {
+            const float *rows[2 * CONV_RADIUS + 1];
+            for (int k = 0; k <= 2 * CONV_RADIUS; k++)
+                rows[k] = &ds[(y - CONV_RADIUS - r0 + k) * dw];
+            psf_conv_row(&conv.px[y * dw], rows, dw, &tmp[0]);
+        }
+
+        bt.conv += ElapsedMs(t);
+    });
+
+    times->median = times->downsample = times->conv = 0.0;
+    for (const AutoFindTimes& bt : band_times)
+    {
+        times->median += bt.median;
+        times->downsample += bt.downsample;
+        times->conv += bt.conv;
     }
 }
 
@@ -690,23 +491,213 @@ struct Peak
     bool operator<(const Peak& rhs) const { return val < rhs.val; }
 };
 
-static void RemoveItems(std::set<Peak>& stars, const std::set<int>& to_erase)
+// van Herk/Gil-Werman running maximum over a window of k elements:
+// dst[i] = max(src[i .. i + k - 1]) for i = 0 .. n - k, using 3 comparisons
+// per element regardless of k. Each element is a vector of `lanes` floats
+// (lanes = 1 for a row, lanes = row width to filter down the columns). g and
+// h are scratch space for n * lanes floats.
+static void RunningMax(float *dst, const float *src, int n, int lanes, int k, float *g, float *h)
 {
-    int n = 0;
-    for (std::set<Peak>::iterator it = stars.begin(); it != stars.end(); n++)
+    if (lanes == 1)
     {
-        if (to_erase.find(n) != to_erase.end())
+        for (int b = 0; b < n; b += k)
         {
-            std::set<Peak>::iterator next = it;
-            ++next;
-            stars.erase(it);
-            it = next;
+            int const e = std::min(b + k, n);
+
+            // g: max from the start of the block, h: max to the end of the block
+            g[b] = src[b];
+            for (int i = b + 1; i < e; i++)
+                g[i] = std::max(g[i - 1], src[i]);
+            h[e - 1] = src[e - 1];
+            for (int i = e - 2; i >= b; i--)
+                h[i] = std::max(h[i + 1], src[i]);
         }
-        else
-            ++it;
+
+        for (int i = 0; i <= n - k; i++)
+            dst[i] = std::max(h[i], g[i + k - 1]);
+
+        return;
+    }
+
+    for (int b = 0; b < n; b += k)
+    {
+        int const e = std::min(b + k, n);
+
+        memcpy(&g[b * lanes], &src[b * lanes], lanes * sizeof(float));
+        for (int i = b + 1; i < e; i++)
+        {
+            float *gi = &g[i * lanes];
+            const float *gp = gi - lanes;
+            const float *si = &src[i * lanes];
+            for (int l = 0; l < lanes; l++)
+                gi[l] = std::max(gp[l], si[l]);
+        }
+
+        memcpy(&h[(e - 1) * lanes], &src[(e - 1) * lanes], lanes * sizeof(float));
+        for (int i = e - 2; i >= b; i--)
+        {
+            float *hi = &h[i * lanes];
+            const float *hn = hi + lanes;
+            const float *si = &src[i * lanes];
+            for (int l = 0; l < lanes; l++)
+                hi[l] = std::max(hn[l], si[l]);
+        }
+    }
+
+    for (int i = 0; i <= n - k; i++)
+    {
+        float *di = &dst[i * lanes];
+        const float *hi = &h[i * lanes];
+        const float *gi = &g[(i + k - 1) * lanes];
+        for (int l = 0; l < lanes; l++)
+            di[l] = std::max(hi[l], gi[l]);
     }
 }
 
+// order candidates by descending intensity, ties in raster order
+static bool BrighterPeak(const Peak& a, const Peak& b)
+{
+    if (a.val != b.val)
+        return a.val > b.val;
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+// Find the local maxima of the convolved image within convRect, at least
+// srch pixels from its edges, whose intensity relative to the local
+// background (in units of the global stdev) is at least threshold. A pixel
+// is a local maximum if no pixel within srch is greater; this is evaluated
+// with a separable running-max filter. The local background is the mean of
+// the 15x15 window (clipped to convRect), taken from a summed-area table.
+// The work is split into bands of rows run on the worker threads; each band
+// keeps its brightest maxPeaks candidates in a bounded min-heap. Returns the
+// brightest maxPeaks candidates overall in image coordinates, brightest
+// first. Like the std::set<Peak> the caller stores them in, candidates of
+// equal intensity are treated as duplicates and only the first in raster
+// order is kept.
+static void FindPeaks(std::vector<Peak>& peaks, const FloatImg& conv, const wxRect& convRect, int srch, double global_stdev,
+                      double threshold, int downsample, unsigned int maxPeaks)
+{
+    const int local = 7; // local background window radius
+
+    int const dw = conv.Size.GetWidth();
+    int const xs = convRect.GetLeft() + srch;
+    int const xe = convRect.GetRight() - srch;
+    int const ys = convRect.GetTop() + srch;
+    int const ye = convRect.GetBottom() - srch;
+
+    peaks.clear();
+    if (xs > xe || ys > ye)
+        return;
+
+    int const nx = xe - xs + 1;
+    int const k = 2 * srch + 1;
+    int const BAND_ROWS = 64;
+    int const nbands = (ye - ys + BAND_ROWS) / BAND_ROWS;
+
+    std::vector<std::vector<Peak>> bandPeaks(nbands);
+
+    ParallelFor(nbands, [&](int band) {
+        int const y0 = ys + band * BAND_ROWS;
+        int const y1 = wxMin(y0 + BAND_ROWS, ye + 1);
+        int const hrows = y1 - y0 + 2 * srch;
+
+        // horizontal then vertical running max: vmax[y][x] is the max of
+        // the k x k window centered on (xs + x, y0 + y)
+        std::vector<float> hmax(hrows * nx);
+        std::vector<float> vmax((y1 - y0) * nx);
+        std::vector<float> g(hrows * nx);
+        std::vector<float> h(hrows * nx);
+
+        for (int r = 0; r < hrows; r++)
+            RunningMax(&hmax[r * nx], &conv.px[(y0 - srch + r) * dw + xs - srch], nx + 2 * srch, 1, k, &g[0], &h[0]);
+        RunningMax(&vmax[0], &hmax[0], hrows, nx, k, &g[0], &h[0]);
+
+        // summed-area table covering the local windows of this band;
+        // sat[(y - sy0) * sw + (x - sx0)] is the sum over [sx0, x) x [sy0, y)
+        int const sx0 = convRect.GetLeft();
+        int const sy0 = wxMax(y0 - local, convRect.GetTop());
+        int const sy1 = wxMin(y1 - 1 + local, convRect.GetBottom());
+        int const sw = convRect.GetWidth() + 1;
+        std::vector<double> sat((sy1 - sy0 + 2) * sw, 0.0);
+        for (int y = sy0; y <= sy1; y++)
+        {
+            const float *row = &conv.px[y * dw + sx0];
+            double *prev = &sat[(y - sy0) * sw];
+            double *cur = prev + sw;
+            double rowsum = 0.0;
+            for (int x = 1; x < sw; x++)
+            {
+                rowsum += row[x - 1];
+                cur[x] = prev[x] + rowsum;
+            }
+        }
+
+        std::vector<Peak>& heap = bandPeaks[band];
+
+        for (int y = y0; y < y1; y++)
+        {
+            const float *row = &conv.px[y * dw];
+            const float *mrow = &vmax[(y - y0) * nx - xs];
+
+            for (int x = xs; x <= xe; x++)
+            {
+                // local maxima are rare; test both conditions without branching on the first
+                float val = row[x];
+                if (!((val > 0.f) & (val >= mrow[x])))
+                    continue;
+
+                // compare local maximum to mean value of surrounding pixels
+                int const lx0 = wxMax(x - local, convRect.GetLeft()) - sx0;
+                int const lx1 = wxMin(x + local, convRect.GetRight()) - sx0 + 1;
+                int const ly0 = wxMax(y - local, convRect.GetTop()) - sy0;
+                int const ly1 = wxMin(y + local, convRect.GetBottom()) - sy0 + 1;
+                double const sum = sat[ly1 * sw + lx1] - sat[ly0 * sw + lx1] - sat[ly1 * sw + lx0] + sat[ly0 * sw + lx0];
+                double const local_mean = sum / (double) ((lx1 - lx0) * (ly1 - ly0));
+
+                // this is our measure of star intensity
+                double h = (val - local_mean) / global_stdev;
+
+                if (h < threshold)
+                    continue;
+
+                // coordinates on the original image
+                int imgx = x * downsample + downsample / 2;
+                int imgy = y * downsample + downsample / 2;
+
+                Peak pk(imgx, imgy, h);
+
+                // as in a std::set<Peak>, a peak with the same intensity as one already kept is a duplicate
+                if ((heap.size() < maxPeaks || BrighterPeak(pk, heap.front())) &&
+                    std::find_if(heap.begin(), heap.end(), [&pk](const Peak& p) { return p.val == pk.val; }) != heap.end())
+                {
+                    continue;
+                }
+
+                if (heap.size() < maxPeaks)
+                {
+                    heap.push_back(pk);
+                    std::push_heap(heap.begin(), heap.end(), BrighterPeak);
+                }
+                else if (BrighterPeak(pk, heap.front()))
+                {
+                    std::pop_heap(heap.begin(), heap.end(), BrighterPeak);
+                    heap.back() = pk;
+                    std::push_heap(heap.begin(), heap.end(), BrighterPeak);
+                }
+            }
+        }
+    });
+
+    for (const std::vector<Peak>& bp : bandPeaks)
+        peaks.insert(peaks.end(), bp.begin(), bp.end());
+
+    std::sort(peaks.begin(), peaks.end(), BrighterPeak);
+    peaks.erase(std::unique(peaks.begin(), peaks.end(), [](const Peak& a, const Peak& b) { return a.val == b.val; }),
+                peaks.end());
+    if (peaks.size() > maxPeaks)
+        peaks.resize(maxPeaks);
+}
+
 static bool CloseToReference(const GuideStar& referencePoint, const GuideStar& other)
 {
     // test whether star is close to the reference star for purposes of detecting duplicates and improving spacial sampling
@@ -730,29 +721,24 @@ bool GuideStar::AutoFind(const usImage& image, int extraEdgeAllowance, int searc
                                  "searchRegion = %d roi = %dx%d@%d,%d\n",
                                  extraEdgeAllowance, searchRegion, roi.width, roi.height, roi.x, roi.y));
 
-    // run a 3x3 median first to eliminate hot pixels
-    usImage smoothed;
-    smoothed.CopyFrom(image);
+    wxStopWatch swatch;
+
+    // the 3x3 median to eliminate hot pixels is applied within rect; with
+    // an ROI the pixels outside the ROI are blanked
+    wxRect rect(image.Size);
     if (!roi.IsEmpty())
     {
-        // set the subrame to the roi so that the Median3
-        // operation blanks pixels outside the ROI.
-        smoothed.Subframe = roi;
-        smoothed.Subframe.Intersect(wxRect(smoothed.Size));
+        rect = roi;
+        rect.Intersect(wxRect(image.Size));
 
-        Debug.Write(wxString::Format("AutoFind: using ROI %dx%d@%d,%d\n", smoothed.Subframe.width, smoothed.Subframe.height,
-                                     smoothed.Subframe.x, smoothed.Subframe.y));
+        Debug.Write(wxString::Format("AutoFind: using ROI %dx%d@%d,%d\n", rect.width, rect.height, rect.x, rect.y));
 
-        if (smoothed.Subframe.width < searchRegion || smoothed.Subframe.height < searchRegion)
+        if (rect.width < searchRegion || rect.height < searchRegion)
         {
-            Debug.Write(wxString::Format("AutoFind: bad ROI %dx%d\n", smoothed.Subframe.width, smoothed.Subframe.height));
+            Debug.Write(wxString::Format("AutoFind: bad ROI %dx%d\n", rect.width, rect.height));
             return false;
         }
     }
-    Median3(smoothed);
-
-    // convert to floating point
-    FloatImg conv(smoothed);
 
     // downsample the source image
     int downsample = pFrame->pGuider->GetAutoSelDownsample();
@@ -769,24 +755,17 @@ bool GuideStar::AutoFind(const usImage& image, int extraEdgeAllowance, int searc
         Debug.Write(wxString::Format("AutoFind: auto downsample for scale %.2f => %dx\n", scale, downsample));
     }
     if (downsample > 1)
-    {
         Debug.Write(wxString::Format("AutoFind: downsample %dx\n", downsample));
-        FloatImg tmp;
-        Downsample(tmp, conv, downsample);
-        conv.Swap(tmp);
-    }
 
-    // run the PSF convolution
-    {
-        FloatImg tmp;
-        psf_conv(tmp, conv);
-        conv.Swap(tmp);
-    }
+    // median, downsample and PSF convolution
+    FloatImg conv;
+    AutoFindTimes times;
+    AutoFindConv(conv, image, rect, downsample, &times);
+
+    Debug.Write(wxString::Format("AutoFind: convolution %ld ms (threads: %u, cpu ms: median %.1f downsample %.1f conv %.1f)\n",
+                                 swatch.Time(), ParallelThreadCount(), times.median, times.downsample, times.conv));
+    swatch.Start();
 
-    enum
-    {
-        CONV_RADIUS = 4
-    };
     int dw = conv.Size.GetWidth(); // width of the downsampled image
     int dh = conv.Size.GetHeight(); // height of the downsampled image
     wxRect convRect(CONV_RADIUS, CONV_RADIUS, dw - 2 * CONV_RADIUS, dh - 2 * CONV_RADIUS); // region containing valid data
@@ -809,99 +788,54 @@ bool GuideStar::AutoFind(const usImage& image, int extraEdgeAllowance, int searc
 
     // find each local maximum
     int srch = 4;
-    for (int y = convRect.GetTop() + srch; y <= convRect.GetBottom() - srch; y++)
-    {
-        for (int x = convRect.GetLeft() + srch; x <= convRect.GetRight() - srch; x++)
-        {
-            float val = conv.px[dw * y + x];
-            bool ismax = false;
-            if (val > 0.0)
-            {
-                ismax = true;
-                for (int j = -srch; j <= srch; j++)
-                {
-                    for (int i = -srch; i <= srch; i++)
-                    {
-                        if (i == 0 && j == 0)
-                            continue;
-                        if (conv.px[dw * (y + j) + (x + i)] > val)
-                        {
-                            ismax = false;
-                            break;
-                        }
-                    }
-                }
-            }
-            if (!ismax)
-                continue;
-
-            // compare local maximum to mean value of surrounding pixels
-            const int local = 7;
-            double local_mean, local_stdev;
-            wxRect localRect(x - local, y - local, 2 * local + 1, 2 * local + 1);
-            localRect.Intersect(convRect);
-            GetStats(&local_mean, &local_stdev, conv, localRect);
+    std::vector<Peak> peaks;
+    FindPeaks(peaks, conv, convRect, srch, global_stdev, threshold, downsample, TOP_N);
 
-            // this is our measure of star intensity
-            double h = (val - local_mean) / global_stdev;
-
-            if (h < threshold)
-            {
-                //  Debug.Write(wxString::Format("AG: local max REJECT [%d, %d] PSF %.1f SNR %.1f\n", imgx, imgy, val, SNR));
-                continue;
-            }
-
-            // coordinates on the original image
-            int imgx = x * downsample + downsample / 2;
-            int imgy = y * downsample + downsample / 2;
-
-            stars.insert(Peak(imgx, imgy, h));
-            if (stars.size() > TOP_N)
-                stars.erase(stars.begin());
-        }
-    }
+    stars.insert(peaks.begin(), peaks.end());
 
     for (std::set<Peak>::const_reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
         Debug.Write(wxString::Format("AutoFind: local max [%d, %d] %.1f\n", it->x, it->y, it->val));
 
-    // merge stars that are very close into a single star
+    // merge stars that are very close into a single star: a star is
+    // dropped if there is a brighter star within the merge radius
     {
         const int minlimitsq = 5 * 5;
-    repeat:
+        std::vector<Peak> merged;
         for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
         {
             std::set<Peak>::const_iterator b = a;
-            ++b;
-            for (; b != stars.end(); ++b)
+            for (++b; b != stars.end(); ++b)
             {
                 int dx = a->x - b->x;
                 int dy = a->y - b->y;
-                int d2 = dx * dx + dy * dy;
-                if (d2 < minlimitsq)
-                {
-                    // very close, treat as single star
-                    Debug.Write(wxString::Format("AutoFind: merge [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x,
-                                                 b->y, b->val));
-                    // erase the dimmer one
-                    stars.erase(a);
-                    goto repeat;
-                }
+                if (dx * dx + dy * dy < minlimitsq)
+                    break;
             }
+            if (b != stars.end())
+            {
+                // very close, treat as single star
+                Debug.Write(wxString::Format("AutoFind: merge [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x, b->y,
+                                             b->val));
+            }
+            else
+                merged.push_back(*a);
         }
+        stars = std::set<Peak>(merged.begin(), merged.end());
     }
 
     // exclude stars that would fit within a single searchRegion box
     {
-        // build a list of stars to be excluded
-        std::set<int> to_erase;
+        // mark the stars to be excluded
         const int extra = 5; // extra safety margin
         const int fullw = searchRegion + extra;
-        for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
+        std::vector<Peak> sorted(stars.begin(), stars.end());
+        std::vector<bool> erase(sorted.size(), false);
+        for (size_t i = 0; i < sorted.size(); i++)
         {
-            std::set<Peak>::const_iterator b = a;
-            ++b;
-            for (; b != stars.end(); ++b)
+            const Peak *a = &sorted[i];
+            for (size_t j = i + 1; j < sorted.size(); j++)
             {
+                const Peak *b = &sorted[j];
                 int dx = abs(a->x - b->x);
                 int dy = abs(a->y - b->y);
                 if (dx <= fullw && dy <= fullw)
@@ -917,13 +851,14 @@ bool GuideStar::AutoFind(const usImage& image, int extraEdgeAllowance, int searc
                     {
                         Debug.Write(wxString::Format("AutoFind: too close [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val,
                                                      b->x, b->y, b->val));
-                        to_erase.insert(std::distance(stars.begin(), a));
-                        to_erase.insert(std::distance(stars.begin(), b));
+                        erase[i] = erase[j] = true;
                     }
                 }
             }
         }
-        RemoveItems(stars, to_erase);
+        for (size_t i = 0; i < sorted.size(); i++)
+            if (erase[i])
+                stars.erase(sorted[i]);
     }
 
     // exclude stars too close to the edge
@@ -945,6 +880,9 @@ bool GuideStar::AutoFind(const usImage& image, int extraEdgeAllowance, int searc
         }
     }
 
+    Debug.Write(
+        wxString::Format("AutoFind: candidate selection %ld ms, %u candidates\n", swatch.Time(), (unsigned int) stars.size()));
+
     // At first I tried running Star::Find on the survivors to find the best
     // star. This had the unfortunate effect of locating hot pixels which
     // the psf convolution so nicely avoids. So, don't do that!  -ag
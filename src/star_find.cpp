@@ -0,0 +1,406 @@
+/*
+ *  star_find.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "star_find.h"
+#include "star_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+// helper struct for HFR calculation
+struct R2M
+{
+    double r2;
+    int x;
+    int y;
+    double m;
+    R2M() { }
+    R2M(int x_, int y_, double m_) : x(x_), y(y_), m(m_) { }
+    bool operator<(const R2M& rhs) const { return r2 < rhs.r2; }
+};
+
+// Find the element where the cumulative mass, taken in order of ascending
+// radius, first exceeds halfm. Rather than sorting the whole list, partition
+// it with nth_element and descend into the half that holds the crossing, so
+// only the elements near the half-flux radius end up ordered. Requires all
+// masses to be positive so that the cumulative mass is monotonic. On return
+// vec[0..k) holds the elements inside the crossing element and *m0 is their
+// total mass; returns k, or n if the total mass does not exceed halfm.
+static unsigned int hfr_select(R2M *vec, unsigned int n, double halfm, double *m0)
+{
+    unsigned int lo = 0, hi = n;
+    double base = 0.0;
+
+    while (lo < hi)
+    {
+        unsigned int mid = lo + (hi - lo) / 2;
+        std::nth_element(vec + lo, vec + mid, vec + hi);
+
+        double s = base;
+        for (unsigned int i = lo; i < mid; i++)
+            s += vec[i].m;
+
+        if (s > halfm)
+            hi = mid;
+        else if (s + vec[mid].m > halfm)
+        {
+            *m0 = s;
+            return mid;
+        }
+        else
+        {
+            base = s + vec[mid].m;
+            lo = mid + 1;
+        }
+    }
+
+    *m0 = base;
+    return n;
+}
+
+static double hfr(R2M *vec, unsigned int n, double cx, double cy, double mass)
+{
+    if (n == 1) // hot pixel?
+        return 0.25;
+
+    // compute Half Flux Radius (HFR)
+    bool positive = true;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        double dx = (double) vec[i].x - cx;
+        double dy = (double) vec[i].y - cy;
+        vec[i].r2 = dx * dx + dy * dy;
+        if (vec[i].m <= 0.0)
+            positive = false;
+    }
+
+    // find radius of half-mass
+    double r20, r21, m0, m1;
+    r20 = r21 = m0 = m1 = 0.0;
+    double halfm = 0.5 * mass;
+
+    unsigned int k;
+    if (positive && n > 0 && (k = hfr_select(vec, n, halfm, &m0)) < n)
+    {
+        // vec[k] is the crossing element, everything before it is closer in
+        r21 = vec[k].r2;
+        m1 = m0 + vec[k].m;
+        for (unsigned int i = 0; i < k; i++)
+            r20 = std::max(r20, vec[i].r2);
+    }
+    else
+    {
+        // pixels with non-positive mass (values just above a threshold that
+        // rounded below the background) make the cumulative mass
+        // non-monotonic, or the half mass is never reached; walk the full
+        // sorted list
+        std::sort(vec, vec + n); // sort by ascending radius^2
+
+        for (unsigned int i = 0; i < n; i++)
+        {
+            const R2M& rm = vec[i];
+            r20 = r21;
+            m0 = m1;
+            r21 = rm.r2;
+            m1 += rm.m;
+            if (m1 > halfm)
+                break;
+        }
+    }
+
+    // interpolate
+    double hfr;
+    if (m1 > m0)
+    {
+        double r0 = sqrt(r20), r1 = sqrt(r21);
+        double s = (r1 - r0) / (m1 - m0);
+        hfr = r0 + s * (halfm - m0);
+    }
+    else
+        hfr = 0.25;
+
+    return hfr;
+}
+
+void FindStar(StarFindResult *res, const ConstFrameView& img, const StarFindParams& params, const CoreLog& log)
+{
+    res->code = STAR_FIND_OK;
+    res->x = params.baseX;
+    res->y = params.baseY;
+    res->mass = 0.0;
+    res->snr = 0.0;
+    res->hfd = 0.0;
+    res->peakVal = 0;
+
+    FrameRect const valid = img.ValidRect();
+    int minx = valid.x;
+    int maxx = valid.Right();
+    int miny = valid.y;
+    int maxy = valid.Bottom();
+
+    // search region bounds
+    int start_x = std::max(params.baseX - params.searchRegion, minx);
+    int end_x = std::min(params.baseX + params.searchRegion, maxx);
+    int start_y = std::max(params.baseY - params.searchRegion, miny);
+    int end_y = std::min(params.baseY + params.searchRegion, maxy);
+
+    if (end_x <= start_x || end_y <= start_y)
+    {
+        log.Write("Star::Find: coordinates are invalid\n");
+        res->code = STAR_FIND_ERROR;
+        return;
+    }
+
+    // the kernels work in the coordinates of the image data, which for a
+    // compact image start at the subframe origin
+    int const ox = img.dataRect.x;
+    int const oy = img.dataRect.y;
+    minx -= ox;
+    maxx -= ox;
+    miny -= oy;
+    maxy -= oy;
+    start_x -= ox;
+    end_x -= ox;
+    start_y -= oy;
+    end_y -= oy;
+
+    const unsigned short *imgdata = img.data;
+    int rowsize = img.RowStride();
+    SimdLevel const simd = CpuSimdLevel();
+
+    StarPeak peak;
+
+    if (params.peakMode)
+    {
+        FindRawPeak(&peak, imgdata, rowsize, start_x, start_y, end_x, end_y, simd);
+        res->peakVal = peak.val;
+    }
+    else
+    {
+        // find the peak value within the search region using a smoothing function
+        // also check for saturation
+        FindSmoothedPeak(&peak, imgdata, rowsize, start_x, start_y, end_x, end_y, simd);
+        res->peakVal = peak.max3[0]; // raw peak val
+        peak.val /= 16; // smoothed peak value
+    }
+
+    int const peak_x = peak.x;
+    int const peak_y = peak.y;
+    unsigned int const peak_val = peak.val;
+    const unsigned short *const max3 = peak.max3;
+
+    // measure noise in the annulus with inner radius A and outer radius B
+    int const A = 7; // inner radius
+    int const B = 12; // outer radius
+
+    // find the mean and stdev of the background
+
+    unsigned short bgpx[(2 * B + 1) * (2 * B + 1)];
+    unsigned int const nann = GatherAnnulus(bgpx, imgdata, rowsize, peak_x, peak_y, A, B, minx, miny, maxx, maxy);
+
+    unsigned int nbg;
+    double mean_bg = 0., prev_mean_bg;
+    double sigma2_bg = 0.;
+    double sigma_bg = 0.;
+    unsigned short lo = 0, hi = 65535;
+
+    for (int iter = 0; iter < 9; iter++)
+    {
+        if (iter > 0)
+        {
+            // exclude values outside mean +/- 2 sigma; the pixels are integers so
+            // this is the same as clipping to [ceil(mean - 2 sigma), floor(mean + 2 sigma)]
+            double const lo_bg = mean_bg - 2.0 * sigma_bg;
+            double const hi_bg = mean_bg + 2.0 * sigma_bg;
+            lo = lo_bg <= 0.0 ? 0 : (unsigned short) ceil(lo_bg);
+            hi = hi_bg >= 65535.0 ? 65535 : (unsigned short) floor(hi_bg);
+        }
+
+        ClippedSums bg;
+        SumClipped(&bg, bgpx, nann, lo, hi, simd);
+        nbg = bg.n;
+
+        if (nbg < 10) // only possible after the first iteration
+        {
+            log.Write("Star::Find: too few background points! nbg=%u mean=%.1f sigma=%.1f\n", nbg, mean_bg, sigma_bg);
+            break;
+        }
+
+        prev_mean_bg = mean_bg;
+        mean_bg = (double) bg.sum / (double) nbg;
+        // exact in integer arithmetic: n * sum(x^2) - sum(x)^2 cannot overflow for the annulus sizes used here
+        sigma2_bg = (double) (nbg * bg.sum2 - bg.sum * bg.sum) / ((double) nbg * (double) (nbg - 1));
+        sigma_bg = sqrt(sigma2_bg);
+
+        if (iter > 0 && fabs(mean_bg - prev_mean_bg) < 0.5)
+            break;
+    }
+
+    unsigned short thresh;
+
+    double cx = 0.0;
+    double cy = 0.0;
+    double mass = 0.0;
+    unsigned int n;
+
+    // pixels over threshold within the aperture, for the HFR calculation
+    R2M hfrvec[(2 * A + 1) * (2 * A + 1)];
+    unsigned int nhfr = 0;
+
+    if (params.peakMode)
+    {
+        mass = peak_val;
+        n = 1;
+        thresh = 0;
+    }
+    else
+    {
+        thresh = (unsigned short) (mean_bg + 3.0 * sigma_bg + 0.5);
+
+        // find pixels over threshold within aperture; compute mass and centroid
+
+        ApertureSums ap;
+        unsigned int rowmask[2 * A + 1];
+        SumAperture(&ap, rowmask, imgdata, rowsize, peak_x, peak_y, A, minx, miny, maxx, maxy, thresh, simd);
+
+        // the kernel sums raw pixel values; subtract the background here
+        n = ap.n;
+        mass = (double) ap.sum - mean_bg * (double) n;
+        cx = (double) ap.sumdx - mean_bg * (double) ap.dx;
+        cy = (double) ap.sumdy - mean_bg * (double) ap.dy;
+
+        for (int j = 0; j <= 2 * A; j++)
+        {
+            if (!rowmask[j])
+                continue;
+            int const y = peak_y - A + j;
+            const unsigned short *row = imgdata + rowsize * y;
+            int x = peak_x - A;
+            for (unsigned int bits = rowmask[j]; bits; bits >>= 1, x++)
+            {
+                if (bits & 1)
+                    hfrvec[nhfr++] = R2M(x, y, (double) row[x] - mean_bg);
+            }
+        }
+    }
+
+    res->mass = mass;
+
+    // SNR estimate from: Measuring the Signal-to-Noise Ratio S/N of the CCD Image of a Star or Nebula, J.H.Simonetti, 2004
+    // January 8
+    //     http://www.phys.vt.edu/~jhs/phys3154/snr20040108.pdf
+    double const gain = .5; // electrons per ADU, nominal
+    res->snr = n > 0 ? mass / sqrt(mass / gain + sigma2_bg * (double) n * (1.0 + 1.0 / (double) nbg)) : 0.0;
+
+    double const LOW_SNR = 3.0;
+
+    // a few scattered pixels over threshold can give a false positive
+    // avoid this by requiring the smoothed peak value to be above the threshold
+    if (peak_val <= thresh && res->snr >= LOW_SNR)
+    {
+        log.Write("Star::Find false star n=%u nbg=%u bg=%.1f sigma=%.1f thresh=%u peak=%u\n", n, nbg, mean_bg, sigma_bg,
+                  thresh, peak_val);
+        res->snr = LOW_SNR - 0.1;
+    }
+
+    if (mass < 10.0)
+    {
+        res->code = STAR_FIND_LOWMASS;
+        return;
+    }
+
+    if (res->snr < LOW_SNR)
+    {
+        res->code = STAR_FIND_LOWSNR;
+        return;
+    }
+
+    double const newX = peak_x + cx / mass;
+    double const newY = peak_y + cy / mass;
+
+    res->hfd = 2.0 * hfr(hfrvec, nhfr, newX, newY, mass);
+
+    res->x = newX + ox;
+    res->y = newY + oy;
+
+    // Check for constraints on HFD value
+    if (!params.peakMode)
+    {
+        if (res->hfd < params.minHFD)
+        {
+            res->code = STAR_FIND_LOWHFD;
+            return;
+        }
+        if (res->hfd > params.maxHFD)
+        {
+            res->code = STAR_FIND_HIHFD;
+            return;
+        }
+    }
+
+    // check for saturation
+
+    unsigned int mx = (unsigned int) max3[0];
+
+    // remove pedestal
+    if (mx >= params.pedestal)
+        mx -= params.pedestal;
+    else
+        mx = 0; // unlikely
+
+    if (params.maxADU > 0)
+    {
+        // maxADU is known
+        if (mx >= params.maxADU)
+            res->code = STAR_FIND_SATURATED;
+        return;
+    }
+
+    // maxADU not known, use the "flat-top" heuristic
+    //
+    // even at saturation, the max values may vary a bit due to noise
+    // Call it saturated if the the top three values are within 32 parts per 65535 of max for 16-bit cameras,
+    // or within 1 part per 191 for 8-bit cameras
+    unsigned int d = (unsigned int) (max3[0] - max3[2]);
+
+    if (params.bitsPerPixel < 12)
+    {
+        if (d * 191U < 1U * mx)
+            res->code = STAR_FIND_SATURATED;
+    }
+    else
+    {
+        if (d * 65535U < 32U * mx)
+            res->code = STAR_FIND_SATURATED;
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ *  star_find.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_FIND_INCLUDED
+#define STAR_FIND_INCLUDED
+
+#include "frame_view.h"
+
+// The measurement behind Star::Find, without wxWidgets. The result codes
+// have the values of the corresponding Star::FindResult.
+enum StarFindCode
+{
+    STAR_FIND_OK = 0,
+    STAR_FIND_SATURATED,
+    STAR_FIND_LOWSNR,
+    STAR_FIND_LOWMASS,
+    STAR_FIND_LOWHFD,
+    STAR_FIND_HIHFD,
+    STAR_FIND_TOO_NEAR_EDGE,
+    STAR_FIND_MASSCHANGE,
+    STAR_FIND_ERROR,
+};
+
+struct StarFindParams
+{
+    int searchRegion;
+    int baseX; // center of the search region, image coordinates
+    int baseY;
+    bool peakMode; // Star::FIND_PEAK: the brightest pixel, no centroid
+    double minHFD;
+    double maxHFD;
+    unsigned short maxADU; // saturation level, or 0 if unknown
+    unsigned short pedestal; // of the frame
+    int bitsPerPixel; // of the frame
+};
+
+struct StarFindResult
+{
+    StarFindCode code;
+    double x; // image coordinates; baseX, baseY if no star was measured
+    double y;
+    double mass;
+    double snr;
+    double hfd;
+    unsigned short peakVal;
+};
+
+// Measure the star nearest the peak of the search region of the valid rect of
+// img. Works the same for compact and full-size images: the kernels run in
+// data coordinates and the position is returned in image coordinates.
+extern void FindStar(StarFindResult *res, const ConstFrameView& img, const StarFindParams& params, const CoreLog& log);
+
+#endif
@@ -0,0 +1,977 @@
+/*
+ *  star_kernels.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "star_kernels.h"
+
+#if defined(PHD_HAVE_SSE2)
+# include <emmintrin.h>
+#endif
+#if defined(PHD_HAVE_AVX2)
+# include <immintrin.h>
+#endif
+#if defined(PHD_HAVE_NEON)
+# include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <string.h>
+
+// ----------------------------------------------------------------------------
+// peak search
+// ----------------------------------------------------------------------------
+
+inline static unsigned int SmoothedPixel(const unsigned short *a, const unsigned short *b, const unsigned short *c, int x)
+{
+    return 4 * (unsigned int) b[x] + a[x - 1] + a[x + 1] + c[x - 1] + c[x + 1] +
+        2 * ((unsigned int) a[x] + b[x - 1] + b[x + 1] + c[x]);
+}
+
+inline static void InsertMax3(unsigned short max3[3], unsigned short p)
+{
+    if (p > max3[0])
+        std::swap(p, max3[0]);
+    if (p > max3[1])
+        std::swap(p, max3[1]);
+    if (p > max3[2])
+        std::swap(p, max3[2]);
+}
+
+static void SmoothedPeakScalar(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1)
+{
+    for (int y = y0 + 1; y <= y1 - 1; y++)
+    {
+        const unsigned short *b = img + y * rowsize;
+        const unsigned short *a = b - rowsize;
+        const unsigned short *c = b + rowsize;
+
+        for (int x = x0 + 1; x <= x1 - 1; x++)
+        {
+            unsigned int val = SmoothedPixel(a, b, c, x);
+            if (val > peak->val)
+            {
+                peak->val = val;
+                peak->x = x;
+                peak->y = y;
+            }
+            InsertMax3(peak->max3, b[x]);
+        }
+    }
+}
+
+// the vectorized row functions return the maximum smoothed value of row b over
+// [xs,xe] and the maximum raw value in *rawmax
+typedef unsigned int (*SmoothedRowFn)(const unsigned short *a, const unsigned short *b, const unsigned short *c, int xs, int xe,
+                                      unsigned short *rawmax);
+
+static void SmoothedPeakRows(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1,
+                             SmoothedRowFn rowfn)
+{
+    int const xs = x0 + 1;
+    int const xe = x1 - 1;
+    if (xs > xe)
+        return;
+
+    for (int y = y0 + 1; y <= y1 - 1; y++)
+    {
+        const unsigned short *b = img + y * rowsize;
+        const unsigned short *a = b - rowsize;
+        const unsigned short *c = b + rowsize;
+
+        unsigned short rawmax;
+        unsigned int rowmax = rowfn(a, b, c, xs, xe, &rawmax);
+
+        // revisit the (rare) rows that change the result so that ties and the
+        // top-3 values come out exactly as in the scalar scan
+        if (rowmax > peak->val)
+        {
+            for (int x = xs; x <= xe; x++)
+            {
+                if (SmoothedPixel(a, b, c, x) == rowmax)
+                {
+                    peak->val = rowmax;
+                    peak->x = x;
+                    peak->y = y;
+                    break;
+                }
+            }
+        }
+
+        if (rawmax > peak->max3[2])
+        {
+            for (int x = xs; x <= xe; x++)
+                InsertMax3(peak->max3, b[x]);
+        }
+    }
+}
+
+static void RawPeakScalar(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1)
+{
+    for (int y = y0; y <= y1; y++)
+    {
+        const unsigned short *row = img + y * rowsize;
+        for (int x = x0; x <= x1; x++)
+        {
+            if (row[x] > peak->val)
+            {
+                peak->val = row[x];
+                peak->x = x;
+                peak->y = y;
+            }
+        }
+    }
+}
+
+typedef unsigned short (*RawRowFn)(const unsigned short *row, int xs, int xe);
+
+static void RawPeakRows(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1, RawRowFn rowfn)
+{
+    for (int y = y0; y <= y1; y++)
+    {
+        const unsigned short *row = img + y * rowsize;
+        unsigned short rowmax = rowfn(row, x0, x1);
+        if (rowmax > peak->val)
+        {
+            int x = x0;
+            while (row[x] != rowmax)
+                ++x;
+            peak->val = rowmax;
+            peak->x = x;
+            peak->y = y;
+        }
+    }
+}
+
+#if defined(PHD_HAVE_SSE2)
+
+inline static __m128i VSum4_SSE2(const unsigned short *a, const unsigned short *b, const unsigned short *c, int x)
+{
+    __m128i const z = _mm_setzero_si128();
+    __m128i va = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (a + x)), z);
+    __m128i vb = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (b + x)), z);
+    __m128i vc = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (c + x)), z);
+    return _mm_add_epi32(_mm_add_epi32(va, vc), _mm_slli_epi32(vb, 1));
+}
+
+// SSE2 has no unsigned 32-bit max; the smoothed values are < 2^21 so the signed compare is safe
+inline static __m128i Max32_SSE2(__m128i a, __m128i b)
+{
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+inline static unsigned int HMax32_SSE2(__m128i v)
+{
+    v = Max32_SSE2(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = Max32_SSE2(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned int) _mm_cvtsi128_si32(v);
+}
+
+// unsigned 16-bit max via the signed max of the values biased by 0x8000
+inline static unsigned short HMaxBiased16_SSE2(__m128i v)
+{
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_epi16(v, _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned short) (_mm_cvtsi128_si32(v) ^ 0x8000);
+}
+
+static unsigned int SmoothedRow_SSE2(const unsigned short *a, const unsigned short *b, const unsigned short *c, int xs, int xe,
+                                     unsigned short *rawmax)
+{
+    __m128i const bias = _mm_set1_epi16((short) 0x8000);
+    __m128i vmax = _mm_setzero_si128();
+    __m128i rmax = bias;
+
+    int x = xs;
+    for (; x + 3 <= xe; x += 4)
+    {
+        __m128i h = _mm_add_epi32(_mm_add_epi32(VSum4_SSE2(a, b, c, x - 1), VSum4_SSE2(a, b, c, x + 1)),
+                                  _mm_slli_epi32(VSum4_SSE2(a, b, c, x), 1));
+        vmax = Max32_SSE2(vmax, h);
+        rmax = _mm_max_epi16(rmax, _mm_xor_si128(_mm_loadl_epi64((const __m128i *) (b + x)), bias));
+    }
+
+    unsigned int smax = HMax32_SSE2(vmax);
+    unsigned short r = HMaxBiased16_SSE2(rmax);
+    for (; x <= xe; x++)
+    {
+        smax = std::max(smax, SmoothedPixel(a, b, c, x));
+        r = std::max(r, b[x]);
+    }
+
+    *rawmax = r;
+    return smax;
+}
+
+static unsigned short RawRow_SSE2(const unsigned short *row, int xs, int xe)
+{
+    __m128i const bias = _mm_set1_epi16((short) 0x8000);
+    __m128i rmax = bias;
+
+    int x = xs;
+    for (; x + 7 <= xe; x += 8)
+        rmax = _mm_max_epi16(rmax, _mm_xor_si128(_mm_loadu_si128((const __m128i *) (row + x)), bias));
+
+    unsigned short r = HMaxBiased16_SSE2(rmax);
+    for (; x <= xe; x++)
+        r = std::max(r, row[x]);
+    return r;
+}
+
+#endif // PHD_HAVE_SSE2
+
+#if defined(PHD_HAVE_AVX2)
+
+PHD_TARGET_AVX2 inline static __m256i VSum8_AVX2(const unsigned short *a, const unsigned short *b, const unsigned short *c,
+                                                 int x)
+{
+    __m256i va = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (a + x)));
+    __m256i vb = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (b + x)));
+    __m256i vc = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (c + x)));
+    return _mm256_add_epi32(_mm256_add_epi32(va, vc), _mm256_slli_epi32(vb, 1));
+}
+
+PHD_TARGET_AVX2 static unsigned int SmoothedRow_AVX2(const unsigned short *a, const unsigned short *b, const unsigned short *c,
+                                                     int xs, int xe, unsigned short *rawmax)
+{
+    __m256i vmax = _mm256_setzero_si256();
+    __m128i rmax = _mm_setzero_si128();
+
+    int x = xs;
+    for (; x + 7 <= xe; x += 8)
+    {
+        __m256i h = _mm256_add_epi32(_mm256_add_epi32(VSum8_AVX2(a, b, c, x - 1), VSum8_AVX2(a, b, c, x + 1)),
+                                     _mm256_slli_epi32(VSum8_AVX2(a, b, c, x), 1));
+        vmax = _mm256_max_epu32(vmax, h);
+        rmax = _mm_max_epu16(rmax, _mm_loadu_si128((const __m128i *) (b + x)));
+    }
+
+    __m128i m = _mm_max_epu32(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+    m = _mm_max_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_max_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+    unsigned int smax = (unsigned int) _mm_cvtsi128_si32(m);
+
+    // minpos on the complement gives the horizontal max of unsigned 16-bit values
+    __m128i const ones = _mm_set1_epi16(-1);
+    unsigned short r = (unsigned short) ~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(rmax, ones)));
+
+    for (; x <= xe; x++)
+    {
+        smax = std::max(smax, SmoothedPixel(a, b, c, x));
+        r = std::max(r, b[x]);
+    }
+
+    *rawmax = r;
+    return smax;
+}
+
+PHD_TARGET_AVX2 static unsigned short RawRow_AVX2(const unsigned short *row, int xs, int xe)
+{
+    __m256i rmax = _mm256_setzero_si256();
+
+    int x = xs;
+    for (; x + 15 <= xe; x += 16)
+        rmax = _mm256_max_epu16(rmax, _mm256_loadu_si256((const __m256i *) (row + x)));
+
+    __m128i m = _mm_max_epu16(_mm256_castsi256_si128(rmax), _mm256_extracti128_si256(rmax, 1));
+    __m128i const ones = _mm_set1_epi16(-1);
+    unsigned short r = (unsigned short) ~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(m, ones)));
+
+    for (; x <= xe; x++)
+        r = std::max(r, row[x]);
+    return r;
+}
+
+#endif // PHD_HAVE_AVX2
+
+#if defined(PHD_HAVE_NEON)
+
+inline static uint32x4_t VSumLo_NEON(uint16x8_t a, uint16x8_t b, uint16x8_t c)
+{
+    return vaddq_u32(vaddl_u16(vget_low_u16(a), vget_low_u16(c)), vshll_n_u16(vget_low_u16(b), 1));
+}
+
+inline static uint32x4_t VSumHi_NEON(uint16x8_t a, uint16x8_t b, uint16x8_t c)
+{
+    return vaddq_u32(vaddl_u16(vget_high_u16(a), vget_high_u16(c)), vshll_n_u16(vget_high_u16(b), 1));
+}
+
+static unsigned int SmoothedRow_NEON(const unsigned short *a, const unsigned short *b, const unsigned short *c, int xs, int xe,
+                                     unsigned short *rawmax)
+{
+    uint32x4_t vmax = vdupq_n_u32(0);
+    uint16x8_t rmax = vdupq_n_u16(0);
+
+    int x = xs;
+    for (; x + 7 <= xe; x += 8)
+    {
+        uint16x8_t al = vld1q_u16(a + x - 1), bl = vld1q_u16(b + x - 1), cl = vld1q_u16(c + x - 1);
+        uint16x8_t am = vld1q_u16(a + x), bm = vld1q_u16(b + x), cm = vld1q_u16(c + x);
+        uint16x8_t ar = vld1q_u16(a + x + 1), br = vld1q_u16(b + x + 1), cr = vld1q_u16(c + x + 1);
+
+        uint32x4_t lo = vaddq_u32(vaddq_u32(VSumLo_NEON(al, bl, cl), VSumLo_NEON(ar, br, cr)),
+                                  vshlq_n_u32(VSumLo_NEON(am, bm, cm), 1));
+        uint32x4_t hi = vaddq_u32(vaddq_u32(VSumHi_NEON(al, bl, cl), VSumHi_NEON(ar, br, cr)),
+                                  vshlq_n_u32(VSumHi_NEON(am, bm, cm), 1));
+        vmax = vmaxq_u32(vmax, vmaxq_u32(lo, hi));
+        rmax = vmaxq_u16(rmax, bm);
+    }
+
+    unsigned int smax = vmaxvq_u32(vmax);
+    unsigned short r = vmaxvq_u16(rmax);
+    for (; x <= xe; x++)
+    {
+        smax = std::max(smax, SmoothedPixel(a, b, c, x));
+        r = std::max(r, b[x]);
+    }
+
+    *rawmax = r;
+    return smax;
+}
+
+static unsigned short RawRow_NEON(const unsigned short *row, int xs, int xe)
+{
+    uint16x8_t rmax = vdupq_n_u16(0);
+
+    int x = xs;
+    for (; x + 7 <= xe; x += 8)
+        rmax = vmaxq_u16(rmax, vld1q_u16(row + x));
+
+    unsigned short r = vmaxvq_u16(rmax);
+    for (; x <= xe; x++)
+        r = std::max(r, row[x]);
+    return r;
+}
+
+#endif // PHD_HAVE_NEON
+
+void FindSmoothedPeak(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1, SimdLevel simd)
+{
+    peak->x = peak->y = 0;
+    peak->val = 0;
+    peak->max3[0] = peak->max3[1] = peak->max3[2] = 0;
+
+    switch (simd)
+    {
+#if defined(PHD_HAVE_AVX2)
+    case SIMD_AVX2:
+        SmoothedPeakRows(peak, img, rowsize, x0, y0, x1, y1, SmoothedRow_AVX2);
+        break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+    case SIMD_SSE2:
+        SmoothedPeakRows(peak, img, rowsize, x0, y0, x1, y1, SmoothedRow_SSE2);
+        break;
+#endif
+#if defined(PHD_HAVE_NEON)
+    case SIMD_NEON:
+        SmoothedPeakRows(peak, img, rowsize, x0, y0, x1, y1, SmoothedRow_NEON);
+        break;
+#endif
+    default:
+        SmoothedPeakScalar(peak, img, rowsize, x0, y0, x1, y1);
+        break;
+    }
+}
+
+void FindRawPeak(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1, SimdLevel simd)
+{
+    peak->x = peak->y = 0;
+    peak->val = 0;
+    peak->max3[0] = peak->max3[1] = peak->max3[2] = 0;
+
+    switch (simd)
+    {
+#if defined(PHD_HAVE_AVX2)
+    case SIMD_AVX2:
+        RawPeakRows(peak, img, rowsize, x0, y0, x1, y1, RawRow_AVX2);
+        break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+    case SIMD_SSE2:
+        RawPeakRows(peak, img, rowsize, x0, y0, x1, y1, RawRow_SSE2);
+        break;
+#endif
+#if defined(PHD_HAVE_NEON)
+    case SIMD_NEON:
+        RawPeakRows(peak, img, rowsize, x0, y0, x1, y1, RawRow_NEON);
+        break;
+#endif
+    default:
+        RawPeakScalar(peak, img, rowsize, x0, y0, x1, y1);
+        break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// background annulus
+// ----------------------------------------------------------------------------
+
+unsigned int GatherAnnulus(unsigned short *dst, const unsigned short *img, int rowsize, int cx, int cy, int rin, int rout,
+                           int minx, int miny, int maxx, int maxy)
+{
+    int const rin2 = rin * rin;
+    int const rout2 = rout * rout;
+
+    int const y0 = std::max(cy - rout, miny);
+    int const y1 = std::min(cy + rout, maxy);
+
+    unsigned short *d = dst;
+
+    for (int y = y0; y <= y1; y++)
+    {
+        int const dy2 = (y - cy) * (y - cy);
+
+        // half-widths of the outer disk (dx^2 <= rout2 - dy2) and the inner disk (dx^2 <= rin2 - dy2)
+        int wout = 0;
+        while ((wout + 1) * (wout + 1) + dy2 <= rout2)
+            ++wout;
+        int win = -1;
+        if (dy2 <= rin2)
+        {
+            win = 0;
+            while ((win + 1) * (win + 1) + dy2 <= rin2)
+                ++win;
+        }
+
+        const unsigned short *row = img + y * rowsize;
+
+        if (win < 0)
+        {
+            // row does not cross the inner disk
+            int xa = std::max(cx - wout, minx);
+            int xb = std::min(cx + wout, maxx);
+            for (int x = xa; x <= xb; x++)
+                *d++ = row[x];
+            continue;
+        }
+
+        // left run [cx - wout, cx - win - 1] and right run [cx + win + 1, cx + wout]
+        int xa = std::max(cx - wout, minx);
+        int xb = std::min(cx - win - 1, maxx);
+        for (int x = xa; x <= xb; x++)
+            *d++ = row[x];
+
+        xa = std::max(cx + win + 1, minx);
+        xb = std::min(cx + wout, maxx);
+        for (int x = xa; x <= xb; x++)
+            *d++ = row[x];
+    }
+
+    return (unsigned int) (d - dst);
+}
+
+static void SumClippedScalar(ClippedSums *sums, const unsigned short *vals, unsigned int count, unsigned short lo,
+                             unsigned short hi)
+{
+    unsigned int n = 0;
+    unsigned long long sum = 0, sum2 = 0;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int v = vals[i];
+        if (v < lo || v > hi)
+            continue;
+        ++n;
+        sum += v;
+        sum2 += (unsigned long long) (v * v);
+    }
+
+    sums->n = n;
+    sums->sum = sum;
+    sums->sum2 = sum2;
+}
+
+// the 32-bit lane accumulators are flushed every BLOCK values to stay clear of overflow
+enum
+{
+    CLIP_BLOCK = 32768
+};
+
+#if defined(PHD_HAVE_SSE2)
+
+static void SumClipped_SSE2(ClippedSums *sums, const unsigned short *vals, unsigned int count, unsigned short lo,
+                            unsigned short hi)
+{
+    __m128i const z = _mm_setzero_si128();
+    __m128i const neg1 = _mm_set1_epi16(-1);
+    __m128i const vlo = _mm_set1_epi16((short) lo);
+    __m128i const vhi = _mm_set1_epi16((short) hi);
+
+    unsigned long long n = 0, sum = 0;
+    __m128i sum2 = z;
+
+    unsigned int i = 0;
+    while (i + 8 <= count)
+    {
+        unsigned int end = std::min(count, i + CLIP_BLOCK);
+        __m128i cnt32 = z;
+        __m128i sum32 = z;
+
+        for (; i + 8 <= end; i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) (vals + i));
+            // lo <= v <= hi  <=>  sat(lo - v) == 0 && sat(v - hi) == 0
+            __m128i keep = _mm_cmpeq_epi16(_mm_or_si128(_mm_subs_epu16(vlo, v), _mm_subs_epu16(v, vhi)), z);
+            v = _mm_and_si128(v, keep);
+
+            cnt32 = _mm_add_epi32(cnt32, _mm_madd_epi16(keep, neg1));
+
+            __m128i v0 = _mm_unpacklo_epi16(v, z);
+            __m128i v1 = _mm_unpackhi_epi16(v, z);
+            sum32 = _mm_add_epi32(sum32, _mm_add_epi32(v0, v1));
+
+            sum2 = _mm_add_epi64(sum2, _mm_mul_epu32(v0, v0));
+            sum2 = _mm_add_epi64(sum2, _mm_mul_epu32(_mm_srli_epi64(v0, 32), _mm_srli_epi64(v0, 32)));
+            sum2 = _mm_add_epi64(sum2, _mm_mul_epu32(v1, v1));
+            sum2 = _mm_add_epi64(sum2, _mm_mul_epu32(_mm_srli_epi64(v1, 32), _mm_srli_epi64(v1, 32)));
+        }
+
+        unsigned int c[4], s[4];
+        _mm_storeu_si128((__m128i *) c, cnt32);
+        _mm_storeu_si128((__m128i *) s, sum32);
+        for (int k = 0; k < 4; k++)
+        {
+            n += c[k];
+            sum += s[k];
+        }
+    }
+
+    unsigned long long q[2];
+    _mm_storeu_si128((__m128i *) q, sum2);
+
+    ClippedSums tail;
+    SumClippedScalar(&tail, vals + i, count - i, lo, hi);
+
+    sums->n = (unsigned int) n + tail.n;
+    sums->sum = sum + tail.sum;
+    sums->sum2 = q[0] + q[1] + tail.sum2;
+}
+
+#endif // PHD_HAVE_SSE2
+
+#if defined(PHD_HAVE_AVX2)
+
+PHD_TARGET_AVX2 static void SumClipped_AVX2(ClippedSums *sums, const unsigned short *vals, unsigned int count,
+                                            unsigned short lo, unsigned short hi)
+{
+    __m256i const z = _mm256_setzero_si256();
+    __m256i const neg1 = _mm256_set1_epi16(-1);
+    __m256i const vlo = _mm256_set1_epi16((short) lo);
+    __m256i const vhi = _mm256_set1_epi16((short) hi);
+
+    unsigned long long n = 0, sum = 0;
+    __m256i sum2 = z;
+
+    unsigned int i = 0;
+    while (i + 16 <= count)
+    {
+        unsigned int end = std::min(count, i + CLIP_BLOCK);
+        __m256i cnt32 = z;
+        __m256i sum32 = z;
+
+        for (; i + 16 <= end; i += 16)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (vals + i));
+            __m256i keep =
+                _mm256_cmpeq_epi16(_mm256_or_si256(_mm256_subs_epu16(vlo, v), _mm256_subs_epu16(v, vhi)), z);
+            v = _mm256_and_si256(v, keep);
+
+            cnt32 = _mm256_add_epi32(cnt32, _mm256_madd_epi16(keep, neg1));
+
+            __m256i v0 = _mm256_unpacklo_epi16(v, z);
+            __m256i v1 = _mm256_unpackhi_epi16(v, z);
+            sum32 = _mm256_add_epi32(sum32, _mm256_add_epi32(v0, v1));
+
+            sum2 = _mm256_add_epi64(sum2, _mm256_mul_epu32(v0, v0));
+            sum2 = _mm256_add_epi64(sum2, _mm256_mul_epu32(_mm256_srli_epi64(v0, 32), _mm256_srli_epi64(v0, 32)));
+            sum2 = _mm256_add_epi64(sum2, _mm256_mul_epu32(v1, v1));
+            sum2 = _mm256_add_epi64(sum2, _mm256_mul_epu32(_mm256_srli_epi64(v1, 32), _mm256_srli_epi64(v1, 32)));
+        }
+
+        unsigned int c[8], s[8];
+        _mm256_storeu_si256((__m256i *) c, cnt32);
+        _mm256_storeu_si256((__m256i *) s, sum32);
+        for (int k = 0; k < 8; k++)
+        {
+            n += c[k];
+            sum += s[k];
+        }
+    }
+
+    unsigned long long q[4];
+    _mm256_storeu_si256((__m256i *) q, sum2);
+
+    ClippedSums tail;
+    SumClippedScalar(&tail, vals + i, count - i, lo, hi);
+
+    sums->n = (unsigned int) n + tail.n;
+    sums->sum = sum + tail.sum;
+    sums->sum2 = q[0] + q[1] + q[2] + q[3] + tail.sum2;
+}
+
+#endif // PHD_HAVE_AVX2
+
+#if defined(PHD_HAVE_NEON)
+
+static void SumClipped_NEON(ClippedSums *sums, const unsigned short *vals, unsigned int count, unsigned short lo,
+                            unsigned short hi)
+{
+    uint16x8_t const vlo = vdupq_n_u16(lo);
+    uint16x8_t const vhi = vdupq_n_u16(hi);
+
+    unsigned long long n = 0, sum = 0;
+    uint64x2_t sum2 = vdupq_n_u64(0);
+
+    unsigned int i = 0;
+    while (i + 8 <= count)
+    {
+        unsigned int end = std::min(count, i + CLIP_BLOCK);
+        uint32x4_t cnt32 = vdupq_n_u32(0);
+        uint32x4_t sum32 = vdupq_n_u32(0);
+
+        for (; i + 8 <= end; i += 8)
+        {
+            uint16x8_t v = vld1q_u16(vals + i);
+            uint16x8_t keep = vandq_u16(vcgeq_u16(v, vlo), vcleq_u16(v, vhi));
+            v = vandq_u16(v, keep);
+
+            cnt32 = vpadalq_u16(cnt32, vshrq_n_u16(keep, 15));
+            sum32 = vpadalq_u16(sum32, v);
+            sum2 = vpadalq_u32(sum2, vmull_u16(vget_low_u16(v), vget_low_u16(v)));
+            sum2 = vpadalq_u32(sum2, vmull_u16(vget_high_u16(v), vget_high_u16(v)));
+        }
+
+        n += vaddvq_u32(cnt32);
+        sum += vaddlvq_u32(sum32);
+    }
+
+    ClippedSums tail;
+    SumClippedScalar(&tail, vals + i, count - i, lo, hi);
+
+    sums->n = (unsigned int) n + tail.n;
+    sums->sum = sum + tail.sum;
+    sums->sum2 = vaddvq_u64(sum2) + tail.sum2;
+}
+
+#endif // PHD_HAVE_NEON
+
+void SumClipped(ClippedSums *sums, const unsigned short *vals, unsigned int count, unsigned short lo, unsigned short hi,
+                SimdLevel simd)
+{
+    switch (simd)
+    {
+#if defined(PHD_HAVE_AVX2)
+    case SIMD_AVX2:
+        SumClipped_AVX2(sums, vals, count, lo, hi);
+        break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+    case SIMD_SSE2:
+        SumClipped_SSE2(sums, vals, count, lo, hi);
+        break;
+#endif
+#if defined(PHD_HAVE_NEON)
+    case SIMD_NEON:
+        SumClipped_NEON(sums, vals, count, lo, hi);
+        break;
+#endif
+    default:
+        SumClippedScalar(sums, vals, count, lo, hi);
+        break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// aperture moments
+// ----------------------------------------------------------------------------
+
+struct ApertureRow
+{
+    unsigned int n;
+    int sum;
+    int sumdx;
+    int dx;
+    unsigned int mask; // bit i set if pixel i of the run was selected
+};
+
+// px[0 .. count-1] is a run of pixels with horizontal offsets dx0, dx0 + 1, ...
+typedef void (*ApertureRowFn)(ApertureRow *r, const unsigned short *px, int count, int dx0, unsigned short thresh);
+
+static void ApertureRowScalar(ApertureRow *r, const unsigned short *px, int count, int dx0, unsigned short thresh)
+{
+    r->n = 0;
+    r->sum = r->sumdx = r->dx = 0;
+    r->mask = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        unsigned short val = px[i];
+        if (val < thresh)
+            continue;
+        int dx = dx0 + i;
+        ++r->n;
+        r->sum += val;
+        r->sumdx += dx * (int) val;
+        r->dx += dx;
+        r->mask |= 1U << i;
+    }
+}
+
+enum
+{
+    APERTURE_RUN = 2 * APERTURE_MAX_RADIUS + 2 // padded to a multiple of 16 lanes
+};
+
+#if defined(PHD_HAVE_SSE2)
+
+// The sums use _mm_madd_epi16 on values biased into the signed 16-bit range:
+// with v' = v - 32768, sum(v) = sum(v') + 32768 n and sum(dx v) = sum(dx v') + 32768 sum(dx)
+static void ApertureRow_SSE2(ApertureRow *r, const unsigned short *px, int count, int dx0, unsigned short thresh)
+{
+    unsigned short buf[APERTURE_RUN] = { 0 };
+    memcpy(buf, px, count * sizeof(unsigned short));
+
+    __m128i const z = _mm_setzero_si128();
+    __m128i const one = _mm_set1_epi16(1);
+    __m128i const neg1 = _mm_set1_epi16(-1);
+    __m128i const bias = _mm_set1_epi16((short) 0x8000);
+    __m128i const vthresh = _mm_set1_epi16((short) thresh);
+    __m128i const vcount = _mm_set1_epi16((short) count);
+    __m128i const vdx0 = _mm_set1_epi16((short) dx0);
+    __m128i iota = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+    __m128i const eight = _mm_set1_epi16(8);
+
+    __m128i n = z, sum = z, sumdx = z, sdx = z;
+    unsigned int mask = 0;
+
+    for (int i = 0; i < count; i += 8, iota = _mm_add_epi16(iota, eight))
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+        __m128i sel = _mm_and_si128(_mm_cmpgt_epi16(vcount, iota), _mm_cmpeq_epi16(_mm_subs_epu16(vthresh, v), z));
+        __m128i vb = _mm_and_si128(_mm_xor_si128(v, bias), sel);
+        __m128i dx = _mm_and_si128(_mm_add_epi16(iota, vdx0), sel);
+
+        n = _mm_add_epi32(n, _mm_madd_epi16(sel, neg1));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(vb, one));
+        sumdx = _mm_add_epi32(sumdx, _mm_madd_epi16(vb, dx));
+        sdx = _mm_add_epi32(sdx, _mm_madd_epi16(dx, one));
+
+        mask |= (unsigned int) _mm_movemask_epi8(_mm_packs_epi16(sel, z)) << i;
+    }
+
+    int t[4][4];
+    _mm_storeu_si128((__m128i *) t[0], n);
+    _mm_storeu_si128((__m128i *) t[1], sum);
+    _mm_storeu_si128((__m128i *) t[2], sumdx);
+    _mm_storeu_si128((__m128i *) t[3], sdx);
+
+    r->n = t[0][0] + t[0][1] + t[0][2] + t[0][3];
+    r->dx = t[3][0] + t[3][1] + t[3][2] + t[3][3];
+    r->sum = t[1][0] + t[1][1] + t[1][2] + t[1][3] + 32768 * (int) r->n;
+    r->sumdx = t[2][0] + t[2][1] + t[2][2] + t[2][3] + 32768 * r->dx;
+    r->mask = mask;
+}
+
+#endif // PHD_HAVE_SSE2
+
+#if defined(PHD_HAVE_AVX2)
+
+PHD_TARGET_AVX2 static void ApertureRow_AVX2(ApertureRow *r, const unsigned short *px, int count, int dx0,
+                                             unsigned short thresh)
+{
+    unsigned short buf[APERTURE_RUN] = { 0 };
+    memcpy(buf, px, count * sizeof(unsigned short));
+
+    __m256i const z = _mm256_setzero_si256();
+    __m256i const one = _mm256_set1_epi16(1);
+    __m256i const neg1 = _mm256_set1_epi16(-1);
+    __m256i const bias = _mm256_set1_epi16((short) 0x8000);
+    __m256i const vthresh = _mm256_set1_epi16((short) thresh);
+    __m256i const vcount = _mm256_set1_epi16((short) count);
+    __m256i const vdx0 = _mm256_set1_epi16((short) dx0);
+    __m256i iota = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m256i const sixteen = _mm256_set1_epi16(16);
+
+    __m256i n = z, sum = z, sumdx = z, sdx = z;
+    unsigned int mask = 0;
+
+    for (int i = 0; i < count; i += 16, iota = _mm256_add_epi16(iota, sixteen))
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (buf + i));
+        __m256i sel =
+            _mm256_and_si256(_mm256_cmpgt_epi16(vcount, iota), _mm256_cmpeq_epi16(_mm256_subs_epu16(vthresh, v), z));
+        __m256i vb = _mm256_and_si256(_mm256_xor_si256(v, bias), sel);
+        __m256i dx = _mm256_and_si256(_mm256_add_epi16(iota, vdx0), sel);
+
+        n = _mm256_add_epi32(n, _mm256_madd_epi16(sel, neg1));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(vb, one));
+        sumdx = _mm256_add_epi32(sumdx, _mm256_madd_epi16(vb, dx));
+        sdx = _mm256_add_epi32(sdx, _mm256_madd_epi16(dx, one));
+
+        // packs works within 128-bit lanes; gather the two 8-byte halves before the movemask
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(sel, z), _MM_SHUFFLE(3, 1, 2, 0));
+        mask |= ((unsigned int) _mm256_movemask_epi8(packed) & 0xffffU) << i;
+    }
+
+    int t[4][8];
+    _mm256_storeu_si256((__m256i *) t[0], n);
+    _mm256_storeu_si256((__m256i *) t[1], sum);
+    _mm256_storeu_si256((__m256i *) t[2], sumdx);
+    _mm256_storeu_si256((__m256i *) t[3], sdx);
+
+    int s[4] = { 0, 0, 0, 0 };
+    for (int k = 0; k < 4; k++)
+        for (int j = 0; j < 8; j++)
+            s[k] += t[k][j];
+
+    r->n = s[0];
+    r->dx = s[3];
+    r->sum = s[1] + 32768 * s[0];
+    r->sumdx = s[2] + 32768 * s[3];
+    r->mask = mask;
+}
+
+#endif // PHD_HAVE_AVX2
+
+#if defined(PHD_HAVE_NEON)
+
+static void ApertureRow_NEON(ApertureRow *r, const unsigned short *px, int count, int dx0, unsigned short thresh)
+{
+    unsigned short buf[APERTURE_RUN] = { 0 };
+    memcpy(buf, px, count * sizeof(unsigned short));
+
+    static const uint16_t s_iota[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    static const uint16_t s_bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+
+    uint16x8_t const vthresh = vdupq_n_u16(thresh);
+    uint16x8_t const vcount = vdupq_n_u16((uint16_t) count);
+    uint16x8_t const bits = vld1q_u16(s_bits);
+    int16x8_t const vdx0 = vdupq_n_s16((int16_t) dx0);
+    uint16x8_t iota = vld1q_u16(s_iota);
+
+    uint32x4_t n = vdupq_n_u32(0);
+    uint32x4_t sum = vdupq_n_u32(0);
+    int32x4_t sumdx = vdupq_n_s32(0);
+    int32x4_t sdx = vdupq_n_s32(0);
+    unsigned int mask = 0;
+
+    for (int i = 0; i < count; i += 8, iota = vaddq_u16(iota, vdupq_n_u16(8)))
+    {
+        uint16x8_t v = vld1q_u16(buf + i);
+        uint16x8_t sel = vandq_u16(vcltq_u16(iota, vcount), vcgeq_u16(v, vthresh));
+        v = vandq_u16(v, sel);
+        int16x8_t dx = vandq_s16(vaddq_s16(vreinterpretq_s16_u16(iota), vdx0), vreinterpretq_s16_u16(sel));
+
+        n = vpadalq_u16(n, vshrq_n_u16(sel, 15));
+        sum = vpadalq_u16(sum, v);
+
+        int32x4_t vlo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+        int32x4_t vhi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
+        sumdx = vmlaq_s32(sumdx, vmovl_s16(vget_low_s16(dx)), vlo);
+        sumdx = vmlaq_s32(sumdx, vmovl_s16(vget_high_s16(dx)), vhi);
+        sdx = vpadalq_s16(sdx, dx);
+
+        mask |= (unsigned int) vaddvq_u16(vandq_u16(sel, bits)) << i;
+    }
+
+    r->n = vaddvq_u32(n);
+    r->sum = (int) vaddvq_u32(sum);
+    r->sumdx = vaddvq_s32(sumdx);
+    r->dx = vaddvq_s32(sdx);
+    r->mask = mask;
+}
+
+#endif // PHD_HAVE_NEON
+
+void SumAperture(ApertureSums *sums, unsigned int *rowmask, const unsigned short *img, int rowsize, int cx, int cy, int radius,
+                 int minx, int miny, int maxx, int maxy, unsigned short thresh, SimdLevel simd)
+{
+    ApertureRowFn rowfn;
+    switch (simd)
+    {
+#if defined(PHD_HAVE_AVX2)
+    case SIMD_AVX2:
+        rowfn = ApertureRow_AVX2;
+        break;
+#endif
+#if defined(PHD_HAVE_SSE2)
+    case SIMD_SSE2:
+        rowfn = ApertureRow_SSE2;
+        break;
+#endif
+#if defined(PHD_HAVE_NEON)
+    case SIMD_NEON:
+        rowfn = ApertureRow_NEON;
+        break;
+#endif
+    default:
+        rowfn = ApertureRowScalar;
+        break;
+    }
+
+    memset(sums, 0, sizeof(*sums));
+
+    int const r2 = radius * radius;
+
+    for (int j = 0; j <= 2 * radius; j++)
+    {
+        rowmask[j] = 0;
+
+        int const dy = j - radius;
+        int const y = cy + dy;
+        if (y < miny || y > maxy)
+            continue;
+
+        int w = 0;
+        while ((w + 1) * (w + 1) + dy * dy <= r2)
+            ++w;
+
+        int const xa = std::max(cx - w, minx);
+        int const xb = std::min(cx + w, maxx);
+        if (xa > xb)
+            continue;
+
+        ApertureRow r;
+        rowfn(&r, img + y * rowsize + xa, xb - xa + 1, xa - cx, thresh);
+
+        rowmask[j] = r.mask << (xa - (cx - radius));
+
+        sums->n += r.n;
+        sums->sum += r.sum;
+        sums->sumdx += r.sumdx;
+        sums->sumdy += (long long) dy * r.sum;
+        sums->dx += r.dx;
+        sums->dy += (long long) dy * r.n;
+    }
+}
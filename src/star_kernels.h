@@ -0,0 +1,104 @@
+/*
+ *  star_kernels.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_KERNELS_INCLUDED
+#define STAR_KERNELS_INCLUDED
+
+#include "cpu_features.h"
+
+// Pixel kernels used by Star::Find. Each kernel has a scalar implementation
+// and SSE2/AVX2/NEON implementations selected by the SimdLevel argument;
+// callers normally pass CpuSimdLevel(). Coordinates are absolute image
+// coordinates and rectangles are inclusive.
+
+struct StarPeak
+{
+    int x;
+    int y;
+    unsigned int val;
+    unsigned short max3[3]; // three largest raw pixel values, descending
+};
+
+// Find the maximum of the [1 2 1]x[1 2 1] smoothed image (not normalized,
+// i.e. 16x the mean) over the interior of the rectangle [x0,x1]x[y0,y1].
+// max3 is collected over the same interior pixels. Ties resolve to the first
+// pixel in raster order.
+extern void FindSmoothedPeak(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1,
+                             SimdLevel simd);
+
+// Find the maximum raw pixel value over the rectangle [x0,x1]x[y0,y1]. max3 is
+// not computed.
+extern void FindRawPeak(StarPeak *peak, const unsigned short *img, int rowsize, int x0, int y0, int x1, int y1,
+                        SimdLevel simd);
+
+// Copy the pixels with rin^2 < dx^2 + dy^2 <= rout^2 around (cx,cy) and
+// inside [minx,maxx]x[miny,maxy] to dst; returns the number of pixels
+// copied, at most (2 * rout + 1)^2.
+extern unsigned int GatherAnnulus(unsigned short *dst, const unsigned short *img, int rowsize, int cx, int cy, int rin, int rout,
+                                  int minx, int miny, int maxx, int maxy);
+
+struct ClippedSums
+{
+    unsigned int n;
+    unsigned long long sum;
+    unsigned long long sum2;
+};
+
+// Count, sum and sum of squares of the values v with lo <= v <= hi
+extern void SumClipped(ClippedSums *sums, const unsigned short *vals, unsigned int count, unsigned short lo, unsigned short hi,
+                       SimdLevel simd);
+
+enum
+{
+    APERTURE_MAX_RADIUS = 15
+};
+
+struct ApertureSums
+{
+    unsigned int n; // pixels at or above the threshold
+    long long sum; // sum of pixel values
+    long long sumdx; // sum of dx * value
+    long long sumdy; // sum of dy * value
+    long long dx; // sum of dx
+    long long dy; // sum of dy
+};
+
+// Accumulate the moments of the pixels with value >= thresh inside the disk
+// dx^2 + dy^2 <= radius^2 around (cx,cy), clipped to [minx,maxx]x[miny,maxy].
+// rowmask[j] (j = 0 .. 2 * radius) receives bit (dx + radius) for each
+// selected pixel of row cy - radius + j. radius must not exceed
+// APERTURE_MAX_RADIUS.
+extern void SumAperture(ApertureSums *sums, unsigned int *rowmask, const unsigned short *img, int rowsize, int cx, int cy,
+                        int radius, int minx, int miny, int maxx, int maxy, unsigned short thresh, SimdLevel simd);
+
+#endif
@@ -0,0 +1,643 @@
+/*
+ *  star_measurement.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <algorithm>
+#include <chrono>
+
+MassChecker::MassChecker() : m_highMass(0.), m_lowMass(9e99), m_exposure(0), m_isAutoExposure(false)
+{
+    SetTimeWindow(DefaultTimeWindowMs);
+}
+
+void MassChecker::SetTimeWindow(unsigned int milliseconds)
+{
+    // an abrupt change in mass will affect the median after approx m_timeWindow/2
+    m_timeWindow = milliseconds * 2;
+}
+
+void MassChecker::SetExposure(int exposure, bool isAutoExp)
+{
+    if (isAutoExp != m_isAutoExposure)
+    {
+        m_isAutoExposure = isAutoExp;
+        m_exposure = exposure;
+        Reset();
+    }
+    else if (exposure != m_exposure)
+    {
+        m_exposure = exposure;
+        if (!m_isAutoExposure)
+        {
+            Reset();
+        }
+    }
+}
+
+void MassChecker::AppendData(double mass)
+{
+    wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+    wxLongLong_t oldest = now - m_timeWindow;
+
+    while (m_data.size() > 0 && m_data.front().time < oldest)
+        m_data.pop_front();
+
+    Entry entry;
+    entry.time = now;
+    entry.mass = AdjustedMass(mass);
+    m_data.push_back(entry);
+}
+
+bool MassChecker::CheckMass(double mass, double threshold, double limits[4])
+{
+    if (m_data.size() < 5)
+        return false;
+
+    m_tmp.clear();
+    for (std::deque<Entry>::const_iterator it = m_data.begin(); it != m_data.end(); ++it)
+        m_tmp.push_back(it->mass);
+
+    size_t mid = m_tmp.size() / 2;
+    std::nth_element(m_tmp.begin(), m_tmp.begin() + mid, m_tmp.end());
+    double med = m_tmp[mid];
+
+    if (med > m_highMass)
+        m_highMass = med;
+    if (med < m_lowMass)
+        m_lowMass = med;
+
+    // let the low water mark drift to follow the median so that it moves back up after a
+    // period of intermittent clouds has brought it down
+    m_lowMass += .05 * (med - m_lowMass);
+
+    limits[0] = m_lowMass * (1. - threshold);
+    limits[1] = med;
+    limits[2] = m_highMass * (1. + threshold);
+    // when mass is depressed by sky conditions, we still want to trigger a rejection when
+    // there is a large spike in mass, even if it is still below the high water mark-based
+    // threhold
+    limits[3] = med * (1. + 2.0 * threshold);
+
+    double adjmass = AdjustedMass(mass);
+    bool reject = adjmass < limits[0] || adjmass > limits[2] || adjmass > limits[3];
+
+    if (reject && m_isAutoExposure)
+    {
+        // convert back to mass-like numbers for logging by caller
+        for (int i = 0; i < 4; i++)
+            limits[i] *= (double) m_exposure;
+    }
+
+    return reject;
+}
+
+void MassChecker::Reset()
+{
+    m_data.clear();
+    m_highMass = 0.;
+    m_lowMass = 9e99;
+}
+
+bool MassChecker::operator==(const MassChecker& rhs) const
+{
+    // m_tmp is scratch space for CheckMass
+    if (m_highMass != rhs.m_highMass || m_lowMass != rhs.m_lowMass || m_timeWindow != rhs.m_timeWindow ||
+        m_exposure != rhs.m_exposure || m_isAutoExposure != rhs.m_isAutoExposure || m_data.size() != rhs.m_data.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < m_data.size(); i++)
+    {
+        if (m_data[i].time != rhs.m_data[i].time || m_data[i].mass != rhs.m_data[i].mass)
+            return false;
+    }
+
+    return true;
+}
+
+void DistanceChecker::Activate()
+{
+    if (m_state == ST_GUIDING)
+    {
+        Debug.Write("DistanceChecker: activated\n");
+        m_state = ST_WAITING;
+        m_expires = ::wxGetUTCTimeMillis().GetValue() + WAIT_INTERVAL_MS;
+        m_forceTolerance = 2.0;
+    }
+}
+
+bool DistanceChecker::_CheckDistance(double distance, double tolerance, const StarSearchPlan& plan)
+{
+    enum
+    {
+        MIN_FRAMES_FOR_STATS = 10
+    };
+    if (!plan.guiding || plan.paused || plan.settling || plan.avgDistanceCount < MIN_FRAMES_FOR_STATS)
+    {
+        return true;
+    }
+    double threshold = tolerance * plan.avgDistance;
+    if (distance > threshold)
+    {
+        Debug.Write(wxString::Format("DistanceChecker: reject for large offset (%.2f > %.2f) avgDist = %.2f count = %u\n",
+                                     distance, threshold, plan.avgDistance, plan.avgDistanceCount));
+        return false;
+    }
+    return true;
+}
+
+bool DistanceChecker::CheckDistance(double distance, double tolerance, const StarSearchPlan& plan)
+{
+    if (m_forceTolerance != 0.)
+        tolerance = m_forceTolerance;
+
+    bool small_offset = _CheckDistance(distance, tolerance, plan);
+
+    switch (m_state)
+    {
+    default:
+    case ST_GUIDING:
+        if (small_offset)
+            return true;
+
+        Debug.Write("DistanceChecker: activated\n");
+        m_state = ST_WAITING;
+        m_expires = ::wxGetUTCTimeMillis().GetValue() + WAIT_INTERVAL_MS;
+        return false;
+
+    case ST_WAITING:
+    {
+        if (small_offset)
+        {
+            Debug.Write("DistanceChecker: deactivated\n");
+            m_state = ST_GUIDING;
+            m_forceTolerance = 0.;
+            return true;
+        }
+        // large distance
+        wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+        if (now < m_expires)
+        {
+            // reject frame
+            return false;
+        }
+        // timed-out
+        Debug.Write("DistanceChecker: begin recovering\n");
+        m_state = ST_RECOVERING;
+        // fall through
+    }
+
+    case ST_RECOVERING:
+        if (small_offset)
+        {
+            Debug.Write("DistanceChecker: deactivated\n");
+            m_state = ST_GUIDING;
+        }
+        return true;
+    }
+}
+
+bool DistanceChecker::operator==(const DistanceChecker& rhs) const
+{
+    return m_state == rhs.m_state && m_expires == rhs.m_expires && m_forceTolerance == rhs.m_forceTolerance;
+}
+
+// Star::Find starts from a copy of the star and leaves some fields untouched
+// on failure, so the whole star has to match, not just its position
+static bool SameStar(const Star& a, const Star& b)
+{
+    return a.X == b.X && a.Y == b.Y && a.IsValid() == b.IsValid() && a.Mass == b.Mass && a.SNR == b.SNR && a.HFD == b.HFD &&
+        a.PeakVal == b.PeakVal && a.GetError() == b.GetError();
+}
+
+static bool SamePoint(const PHD_Point& a, const PHD_Point& b)
+{
+    return a.IsValid() == b.IsValid() && (!a.IsValid() || (a.X == b.X && a.Y == b.Y));
+}
+
+static bool SameStats(DescriptiveStats a, DescriptiveStats b)
+{
+    // the getters are not const, compare copies
+    return a.GetCount() == b.GetCount() &&
+        (a.GetCount() == 0 || (a.GetMean() == b.GetMean() && a.GetVariance() == b.GetVariance()));
+}
+
+bool StarTrackingState::operator==(const StarTrackingState& rhs) const
+{
+    if (!SameStar(primary, rhs.primary) || guideStars.size() != rhs.guideStars.size() ||
+        !SameStats(primaryDistStats, rhs.primaryDistStats) || !(massChecker == rhs.massChecker) ||
+        !(distanceChecker == rhs.distanceChecker) || multiStarMode != rhs.multiStarMode || stabilizing != rhs.stabilizing ||
+        lockPositionMoved != rhs.lockPositionMoved || starsUsed != rhs.starsUsed)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < guideStars.size(); i++)
+    {
+        const GuideStar& a = guideStars[i];
+        const GuideStar& b = rhs.guideStars[i];
+        if (!SameStar(a, b) || !SamePoint(a.referencePoint, b.referencePoint) || a.missCount != b.missCount ||
+            a.zeroCount != b.zeroCount || !SamePoint(a.offsetFromPrimary, b.offsetFromPrimary) || a.wasLost != b.wasLost)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool StarSearchPlan::operator==(const StarSearchPlan& rhs) const
+{
+    return searchRegion == rhs.searchRegion && findMode == rhs.findMode && minHFD == rhs.minHFD && maxHFD == rhs.maxHFD &&
+        saturation == rhs.saturation && maxStars == rhs.maxStars && stabilitySigmaX == rhs.stabilitySigmaX &&
+        massChangeThresholdEnabled == rhs.massChangeThresholdEnabled && massChangeThreshold == rhs.massChangeThreshold &&
+        exposure == rhs.exposure && autoExposure == rhs.autoExposure && jumpTolerance == rhs.jumpTolerance &&
+        avgDistance == rhs.avgDistance && avgDistanceCount == rhs.avgDistanceCount &&
+        SamePoint(lockPosition, rhs.lockPosition) && raOnly == rhs.raOnly && guiding == rhs.guiding && paused == rhs.paused &&
+        settling == rhs.settling && guidingEnabled == rhs.guidingEnabled && state == rhs.state;
+}
+
+bool IsValidSecondaryStarPosition(const PHD_Point& pt, const wxSize& frameSize)
+{
+    // tightly coupled to Star::Find but with somewhat relaxed constraints. Find handles cases where search region is
+    // only partly within image
+    return pt.X >= 5 && pt.X + 5 < frameSize.GetX() && pt.Y >= 5 && pt.Y + 5 < frameSize.GetY();
+}
+
+// Private method to build compact logging string for how secondary stars were used
+static void AppendStarUse(wxString& secondaryInfo, int starNum, double dX, double dY, double weight, const wxString& flag)
+{
+    secondaryInfo += wxString::Format("[#%d %0.2f,%0.2f,%0.2f,%s] ", starNum, dX, dY, weight, flag);
+}
+
+// Use secondary stars to refine the offset value if appropriate.  Return of true means the offset has been adjusted.
+static bool RefineOffset(const usImage *pImage, const StarSearchPlan& plan, StarMeasurement *m)
+{
+    StarTrackingState& st = m->state;
+    std::vector<GuideStar>& guideStars = st.guideStars;
+    double primaryDistance;
+    double secondaryDistance;
+    double primarySigma = 0;
+    bool averaged = false;
+    int validStars = 0;
+    PHD_Point origOffset = m->offset;
+    st.starsUsed = 1;
+    bool erasures = false;
+    bool refined = false;
+
+    // Primary star is in position 0 of the list
+    try
+    {
+        if (plan.guiding && guideStars.size() > 1 && plan.guidingEnabled && !plan.settling)
+        {
+            double sumWeights = 1;
+            double sumX = origOffset.X;
+            double sumY = origOffset.Y;
+            primaryDistance = hypot(sumX, sumY);
+
+            st.primaryDistStats.AddValue(primaryDistance);
+
+#define Iter_Inx(p) (p - guideStars.begin())
+
+            if (st.primaryDistStats.GetCount() > 5)
+            {
+                primarySigma = st.primaryDistStats.GetSigma();
+                if (!st.stabilizing && primaryDistance > plan.stabilitySigmaX * primarySigma)
+                {
+                    st.stabilizing = true;
+                    Debug.Write("MultiStar: large primary error, entering stabilization period\n");
+                }
+                else if (st.stabilizing)
+                {
+                    if (primaryDistance <= 2 * primarySigma)
+                    {
+                        st.stabilizing = false;
+                        Debug.Write("MultiStar: exiting stabilization period\n");
+                        if (st.lockPositionMoved)
+                        {
+                            st.lockPositionMoved = false;
+                            Debug.Write("MultiStar: updating star positions after lock position change\n");
+                            for (auto pGS = guideStars.begin() + 1; pGS != guideStars.end();)
+                            {
+                                PHD_Point expectedLoc = st.primary + pGS->offsetFromPrimary;
+                                bool found;
+                                if (IsValidSecondaryStarPosition(expectedLoc, pImage->Size))
+                                    found = pGS->Find(pImage, plan.searchRegion, expectedLoc.X, expectedLoc.Y, plan.findMode,
+                                                      plan.minHFD, plan.maxHFD, plan.saturation, Star::FIND_LOGGING_VERBOSE);
+                                else
+                                    found = pGS->Find(pImage, plan.searchRegion, pGS->X, pGS->Y, plan.findMode, plan.minHFD,
+                                                      plan.maxHFD, plan.saturation, Star::FIND_LOGGING_VERBOSE);
+                                if (found)
+                                {
+                                    pGS->referencePoint.X = pGS->X;
+                                    pGS->referencePoint.Y = pGS->Y;
+                                    pGS->wasLost = false;
+                                    ++pGS;
+                                }
+                                else
+                                {
+                                    // Don't need to update reference point, lost star will continue to use the
+                                    // offsetFromPrimary location for possible recovery
+                                    pGS->wasLost = true;
+                                    ++pGS;
+                                }
+                            }
+                            return false; // All the secondary stars reference points reflect current positions
+                        }
+                    }
+                }
+            }
+            else
+                st.stabilizing = true; // get some data for primary star movement
+
+            if (!st.stabilizing && guideStars.size() > 1 && (sumX != 0 || sumY != 0))
+            {
+                wxString secondaryInfo = "MultiStar: ";
+                for (auto pGS = guideStars.begin() + 1; pGS != guideStars.end();)
+                {
+                    if (st.starsUsed >= plan.maxStars || guideStars.size() == 1)
+                        break;
+                    bool found;
+                    if (pGS->wasLost)
+                    {
+                        // Look for it based on its original offset from the primary star
+                        PHD_Point expectedLoc = st.primary + pGS->offsetFromPrimary;
+                        found = pGS->Find(pImage, plan.searchRegion, expectedLoc.X, expectedLoc.Y, plan.findMode, plan.minHFD,
+                                          plan.maxHFD, plan.saturation, Star::FIND_LOGGING_MINIMAL);
+                    }
+                    else
+                        // Look for it where we last found it
+                        found = pGS->Find(pImage, plan.searchRegion, pGS->X, pGS->Y, plan.findMode, plan.minHFD, plan.maxHFD,
+                                          plan.saturation, Star::FIND_LOGGING_MINIMAL);
+                    if (found)
+                    {
+                        double dX = pGS->X - pGS->referencePoint.X;
+                        double dY = pGS->Y - pGS->referencePoint.Y;
+
+                        pGS->wasLost = false;
+                        st.starsUsed++;
+
+                        if (dX != 0. || dY != 0.)
+                        {
+                            // Handle zero-counting - suspect results of exactly zero movement
+                            if (dX == 0. || dY == 0.)
+                                ++pGS->zeroCount;
+                            else if (pGS->zeroCount > 0)
+                                --pGS->zeroCount;
+
+                            if (pGS->zeroCount == 5)
+                            {
+                                AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "DZ");
+                                pGS = guideStars.erase(pGS);
+                                erasures = true;
+                                continue;
+                            }
+
+                            // Handle suspicious excursions - counted as "misses"
+                            secondaryDistance = hypot(dX, dY);
+                            if (secondaryDistance > 2.5 * primarySigma)
+                            {
+                                if (++pGS->missCount > 10)
+                                {
+                                    // Reset the reference point to wherever it is now
+                                    pGS->referencePoint.X = pGS->X;
+                                    pGS->referencePoint.Y = pGS->Y;
+                                    pGS->missCount = 0;
+                                    AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0, "R");
+                                }
+                                else
+                                    AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0,
+                                                  "M" + std::to_string(pGS->missCount));
+                                ++pGS;
+                                continue;
+                            }
+                            else if (pGS->missCount > 0)
+                            {
+                                --pGS->missCount;
+                            }
+
+                            // At this point we have usable data from the secondary star
+                            double wt = (pGS->SNR / st.primary.SNR);
+                            sumX += wt * dX;
+                            sumY += wt * dY;
+                            sumWeights += wt;
+                            averaged = true;
+                            validStars++;
+
+                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, wt, "U");
+                        }
+                        else // exactly zero on both axes, probably a hot pixel, drop it
+                        {
+                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "DZ");
+                            pGS = guideStars.erase(pGS);
+                            erasures = true;
+                        }
+                    }
+                    else
+                    {
+                        // star not found in its search region
+                        AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "L");
+                        pGS->wasLost = true;
+                    }
+                    if (!erasures)
+                        ++pGS;
+                    else
+                        erasures = false;
+                } // End of looping through secondary stars
+                Debug.Write(secondaryInfo + "\n");
+
+                if (averaged)
+                {
+                    sumX = sumX / sumWeights;
+                    sumY = sumY / sumWeights;
+                    if (hypot(sumX, sumY) < primaryDistance) // Apply average only if its smaller than single-star delta
+                    {
+                        m->offset.SetXY(sumX, sumY);
+                        refined = true;
+                    }
+                    Debug.Write(wxString::Format("%s, %d included, MultiStar: {%0.2f, %0.2f}, one-star: {%0.2f, %0.2f}\n",
+                                                 (refined ? "refined" : "single-star"), validStars, sumX, sumY, origOffset.X,
+                                                 origOffset.Y));
+                }
+            }
+        }
+    }
+    catch (const wxString& msg)
+    {
+        Debug.Write(wxString::Format("MultiStar fault: exception at %d, %s, reverting to single-star mode\n", __LINE__, msg));
+        st.multiStarMode = false;
+    }
+
+    return refined;
+#undef Iter_Inx
+}
+
+// Find the primary star and check that it is usable: the mass change and star jump checks
+static StarMeasurement::Result FindPrimaryStar(const usImage *pImage, const StarSearchPlan& plan, StarMeasurement *m)
+{
+    StarTrackingState& st = m->state;
+    Star& newStar = m->star;
+
+    newStar = st.primary;
+    if (!newStar.Find(pImage, plan.searchRegion, plan.findMode, plan.minHFD, plan.maxHFD, plan.saturation,
+                      Star::FIND_LOGGING_VERBOSE))
+    {
+        st.primary.SetError(newStar.GetError());
+        st.distanceChecker.Activate();
+        return StarMeasurement::STAR_LOST;
+    }
+
+    // check to see if it seems like the star we just found was the
+    // same as the original star by comparing the mass
+    if (plan.massChangeThresholdEnabled)
+    {
+        st.massChecker.SetExposure(plan.exposure, plan.autoExposure);
+        if (st.massChecker.CheckMass(newStar.Mass, plan.massChangeThreshold, m->massLimits))
+        {
+            st.primary.SetError(Star::STAR_MASSCHANGE);
+
+            Debug.Write(
+                wxString::Format("UpdateCurrentPosition: star mass new=%.1f exp=%.1f thresh=%.0f%% limits=(%.1f, %.1f, %.1f)\n",
+                                 newStar.Mass, m->massLimits[1], plan.massChangeThreshold * 100., m->massLimits[0],
+                                 m->massLimits[2], m->massLimits[3]));
+
+            st.massChecker.AppendData(newStar.Mass);
+            st.distanceChecker.Activate();
+            return StarMeasurement::STAR_MASS_CHANGED;
+        }
+    }
+
+    const PHD_Point& lockPos = plan.lockPosition;
+    if (lockPos.IsValid())
+    {
+        if (plan.raOnly)
+            m->distance = fabs(newStar.X - lockPos.X);
+        else
+            m->distance = newStar.Distance(lockPos);
+    }
+
+    if (!st.distanceChecker.CheckDistance(m->distance, plan.jumpTolerance, plan))
+    {
+        st.primary.SetError(Star::STAR_ERROR);
+        return StarMeasurement::STAR_JUMPED;
+    }
+
+    return StarMeasurement::STAR_FOUND;
+}
+
+StarMeasurement *MeasureFrame(const usImage *pImage, const StarSearchPlan& plan)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    StarMeasurement *m = new StarMeasurement();
+    m->plan = plan;
+    m->state = plan.state;
+    std::fill(m->massLimits, m->massLimits + 4, 0.);
+    m->distance = 0.;
+    m->refined = false;
+    m->move.mount = nullptr;
+    m->move.options = 0;
+    m->move.time = 0;
+
+    m->result = FindPrimaryStar(pImage, plan, m);
+
+    if (m->result == StarMeasurement::STAR_FOUND)
+    {
+        // update the star position, mass, etc.
+        StarTrackingState& st = m->state;
+        st.primary = m->star;
+        st.massChecker.AppendData(m->star.Mass);
+
+        if (plan.lockPosition.IsValid())
+        {
+            m->offset = st.primary - plan.lockPosition;
+            if (st.multiStarMode && st.guideStars.size() > 1)
+                m->refined = RefineOffset(pImage, plan, m);
+            else
+                st.starsUsed = 1;
+        }
+    }
+
+    m->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return m;
+}
+
+void StarMeasurementStage::Publish(const StarSearchPlan& plan, Mount *guideMount)
+{
+    std::shared_ptr<const StarSearchPlan> p = std::make_shared<StarSearchPlan>(plan);
+    wxCriticalSectionLocker lck(m_lock);
+    m_plan.swap(p);
+    m_guideMount = guideMount;
+}
+
+void StarMeasurementStage::Withdraw()
+{
+    std::shared_ptr<const StarSearchPlan> p;
+    wxCriticalSectionLocker lck(m_lock);
+    m_plan.swap(p);
+    m_guideMount = nullptr;
+}
+
+StarMeasurement *StarMeasurementStage::Measure(const usImage *pImage) const
+{
+    std::shared_ptr<const StarSearchPlan> plan;
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        plan = m_plan;
+    }
+
+    if (!plan || !pImage->ImageData)
+        return nullptr;
+
+    StarMeasurement *m = MeasureFrame(pImage, *plan);
+
+    {
+        // the guider may have stopped or paused guiding while the frame was measured
+        wxCriticalSectionLocker lck(m_lock);
+        if (m_guideMount && m_plan == plan)
+        {
+            m->move.mount = m_guideMount;
+            m->move.options = m->PrimaryFound() ? MOVEOPTS_GUIDE_STEP : MOVEOPTS_DEDUCED_MOVE;
+            m->move.time = ::wxGetUTCTimeMillis().GetValue();
+        }
+    }
+
+    Debug.Write(wxString::Format("StarMeasurement: primary %s (%d) at (%.2f, %.2f), %u stars used, %.1f ms%s\n",
+                                 m->PrimaryFound() ? "found" : "dropped", m->result, m->star.X, m->star.Y, m->state.starsUsed,
+                                 m->elapsedMs, m->move.mount ? ", guide step on the worker thread" : ""));
+
+    return m;
+}
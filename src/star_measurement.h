@@ -0,0 +1,247 @@
+/*
+ *  star_measurement.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_MEASUREMENT_H_INCLUDED
+#define STAR_MEASUREMENT_H_INCLUDED
+
+#include "guiding_stats.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+class Mount;
+struct StarSearchPlan;
+
+// Star measurement stage
+//
+// Finding the guide stars and deciding how a frame is used for guiding -- the
+// primary star search, the mass change and star jump checks, the offset from
+// the lock position and its multi-star refinement -- is done by MeasureFrame,
+// which works only on a StarSearchPlan: a copy of the guider's settings and of
+// the star tracking state, taken after the previous frame. The result is an
+// immutable StarMeasurement record holding the stars found, the offset, the
+// drop reason if the frame is not usable and the tracking state after the
+// frame.
+//
+// After processing each frame the guider publishes its plan, and the worker
+// thread measures the next frame against it as soon as the exposure
+// completes. While guiding normally (not paused, recentering after a dither,
+// shifting the lock position or measuring backlash) the worker thread also
+// makes the guide correction the record calls for -- the guide step, or a
+// dead-reckoning move if the frame was dropped -- without waiting for the GUI
+// thread, so a busy GUI thread (a modal dialog, a slow repaint) no longer
+// delays the correction.
+//
+// The guider then takes the record as the result of the frame if the plan it
+// was measured against still matches the guider's state: it adopts the
+// tracking state and uses the record for display, logging and notifications.
+// Otherwise (a star was selected, the lock position moved, a setting changed)
+// the guider measures the frame itself with MeasureFrame, so a stale record
+// never changes the tracking result; a correction the worker thread already
+// made for the frame is not repeated.
+
+// Detects a change in the mass of the primary star, as when another star
+// moves into the search region
+class MassChecker
+{
+    enum
+    {
+        DefaultTimeWindowMs = 22500
+    };
+
+    struct Entry
+    {
+        wxLongLong_t time;
+        double mass;
+    };
+
+    std::deque<Entry> m_data;
+    double m_highMass; // high-water mark
+    double m_lowMass; // low-water mark
+    unsigned long m_timeWindow;
+    std::vector<double> m_tmp;
+    int m_exposure;
+    bool m_isAutoExposure;
+
+public:
+    MassChecker();
+
+    void SetTimeWindow(unsigned int milliseconds);
+    void SetExposure(int exposure, bool isAutoExp);
+    double AdjustedMass(double mass) const { return m_isAutoExposure ? mass / (double) m_exposure : mass; }
+    void AppendData(double mass);
+    bool CheckMass(double mass, double threshold, double limits[4]);
+    void Reset();
+
+    bool operator==(const MassChecker& rhs) const;
+};
+
+// Rejects frames where the star jumped much further than the recent guide error
+struct DistanceChecker
+{
+    enum State
+    {
+        ST_GUIDING,
+        ST_WAITING,
+        ST_RECOVERING,
+    };
+    State m_state;
+    wxLongLong_t m_expires;
+    double m_forceTolerance;
+
+    enum
+    {
+        WAIT_INTERVAL_MS = 5000
+    };
+
+    DistanceChecker() : m_state(ST_GUIDING), m_expires(0), m_forceTolerance(0.) { }
+
+    void Activate();
+    static bool _CheckDistance(double distance, double tolerance, const StarSearchPlan& plan);
+    bool CheckDistance(double distance, double tolerance, const StarSearchPlan& plan);
+
+    bool operator==(const DistanceChecker& rhs) const;
+};
+
+// The part of the guider's state that measuring a frame reads and updates
+struct StarTrackingState
+{
+    Star primary; // the primary star as last found
+    std::vector<GuideStar> guideStars; // the primary star, then the secondary stars
+    DescriptiveStats primaryDistStats;
+    MassChecker massChecker;
+    DistanceChecker distanceChecker;
+    bool multiStarMode;
+    bool stabilizing;
+    bool lockPositionMoved;
+    unsigned int starsUsed;
+
+    bool operator==(const StarTrackingState& rhs) const;
+};
+
+struct StarSearchPlan
+{
+    // star search
+    int searchRegion;
+    Star::FindMode findMode;
+    double minHFD;
+    double maxHFD;
+    unsigned short saturation;
+    unsigned int maxStars; // secondary stars are searched until this many stars are in use
+    double stabilitySigmaX;
+
+    // frame checks
+    bool massChangeThresholdEnabled;
+    double massChangeThreshold;
+    int exposure;
+    bool autoExposure;
+    double jumpTolerance;
+    double avgDistance; // smoothed guide error, RA only if raOnly
+    unsigned int avgDistanceCount;
+
+    // guider and mount state
+    PHD_Point lockPosition;
+    bool raOnly;
+    bool guiding;
+    bool paused;
+    bool settling;
+    bool guidingEnabled;
+
+    StarTrackingState state;
+
+    bool operator==(const StarSearchPlan& rhs) const;
+    bool operator!=(const StarSearchPlan& rhs) const { return !(*this == rhs); }
+};
+
+struct StarMeasurement
+{
+    enum Result
+    {
+        STAR_FOUND,
+        STAR_LOST, // the primary star was not found, star.GetError() tells why
+        STAR_MASS_CHANGED,
+        STAR_JUMPED, // rejected by the distance check
+    };
+
+    struct Move
+    {
+        Mount *mount; // the mount the worker thread moved for this frame, null if it made no move
+        unsigned int options; // MOVEOPTS_GUIDE_STEP with offset, or MOVEOPTS_DEDUCED_MOVE
+        wxLongLong_t time; // when the move was dispatched (wxGetUTCTimeMillis)
+    };
+
+    StarSearchPlan plan;
+    StarTrackingState state; // the tracking state after the frame
+    Result result;
+    Star star; // the primary star as found in the frame: position, mass, SNR, HFD and find result
+    double massLimits[4]; // the mass limits when the mass changed
+    double distance; // distance of the primary star from the lock position
+    PHD_Point offset; // camera offset from the lock position, refined by the secondary stars if refined is set
+    bool refined;
+    Move move;
+    double elapsedMs; // time spent measuring
+
+    bool PrimaryFound() const { return result == STAR_FOUND; }
+};
+
+typedef std::shared_ptr<const StarMeasurement> StarMeasurementPtr;
+
+// Measure the stars in a frame against a plan. Returns a new record owned by the caller.
+extern StarMeasurement *MeasureFrame(const usImage *pImage, const StarSearchPlan& plan);
+
+// Secondary star positions that Star::Find can search around
+extern bool IsValidSecondaryStarPosition(const PHD_Point& pt, const wxSize& frameSize);
+
+class StarMeasurementStage
+{
+    mutable wxCriticalSection m_lock; // protects m_plan and m_guideMount
+    std::shared_ptr<const StarSearchPlan> m_plan;
+    Mount *m_guideMount;
+
+public:
+    StarMeasurementStage() : m_guideMount(nullptr) { }
+
+    // GUI thread: set or clear the plan for the frames that follow. guideMount is
+    // the mount the worker thread makes the guide correction with, or null if the
+    // GUI thread makes it
+    void Publish(const StarSearchPlan& plan, Mount *guideMount);
+    void Withdraw();
+
+    // worker thread: measure a finished frame against the current plan and decide
+    // the guide correction. Returns a new record owned by the caller, or null if
+    // there is no plan.
+    StarMeasurement *Measure(const usImage *pImage) const;
+};
+
+#endif
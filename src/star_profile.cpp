@@ -111,14 +111,14 @@ void ProfileWindow::UpdateData(const usImage *img, float xpos, float ypos)
 
     int x, y;
     unsigned short *uptr = this->data;
-    const int xrowsize = img->Size.GetWidth();
+    const wxRect valid = img->ValidRect(); // pixels outside it are shown as 0
     for (x = 0; x < FULLW; x++)
         horiz_profile[x] = vert_profile[x] = midrow_profile[x] = 0;
     for (y = 0; y < FULLW; y++)
     {
         for (x = 0; x < FULLW; x++, uptr++)
         {
-            *uptr = *(img->ImageData + xstart + x + (ystart + y) * xrowsize);
+            *uptr = valid.Contains(xstart + x, ystart + y) ? img->Pixel(xstart + x, ystart + y) : 0;
             horiz_profile[x] += (int) *uptr;
             vert_profile[y] += (int) *uptr;
         }
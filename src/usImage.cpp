@@ -33,97 +33,60 @@
  */
 
 #include "phd.h"
+#include "frame_ops.h"
+#include "frame_pool.h"
 #include "image_math.h"
+#include "parallel.h"
 
 #include <algorithm>
+#include <mutex>
+#include <vector>
 
-class HistogramBuilder
+usImage::~usImage()
 {
-public:
-    int *histo;
-    unsigned short MinADU, MaxADU;
-    int pixCount;
-
-    HistogramBuilder()
-    {
-        histo = new int[65536];
-        MinADU = 0;
-        MaxADU = 0;
-        pixCount = 0;
-    }
-
-    ~HistogramBuilder() { delete[] histo; }
-
-    unsigned short median() const
-    {
-        int pixelLeft = pixCount / 2;
+    FramePoolFree(ImageData);
+}
 
-        for (int i = MinADU; i < MaxADU; ++i)
-        {
-            if (histo[i] > pixelLeft)
-            {
-                return i;
-            }
-            pixelLeft -= histo[i];
-        }
-        return MaxADU;
-    }
+bool usImage::Init(const wxSize& size)
+{
+    // Allocates space for image and sets params up
+    // returns true on error
 
-    void scan(const unsigned short *t, int len)
-    {
-        if (pixCount == 0)
-        {
-            unsigned short v = t[0];
-            // Initialization
-            MinADU = t[0];
-            MaxADU = t[0];
-            histo[t[0]] = 0;
-        }
+    Subframe = wxRect(0, 0, 0, 0);
+    return Alloc(size, wxRect(size));
+}
 
-        for (int i = 0; i < len; ++i)
-        {
-            unsigned short v = t[i];
-            if (v < MinADU)
-            {
-                for (int k = v; k < MinADU; ++k)
-                {
-                    histo[k] = 0;
-                }
-                MinADU = v;
-            }
-            if (v > MaxADU)
-            {
-                for (int k = MaxADU + 1; k <= v; ++k)
-                {
-                    histo[k] = 0;
-                }
-                MaxADU = v;
-            }
-            histo[v]++;
-        }
+bool usImage::InitCompact(const wxSize& size, const wxRect& subframe)
+{
+    // Only the subframe is allocated, so the cost of a frame follows the
+    // size of the subframe rather than the sensor. Pixel() takes image
+    // coordinates either way.
 
-        pixCount += len;
-    }
-};
+    Subframe = subframe;
+    return Alloc(size, subframe);
+}
 
-bool usImage::Init(const wxSize& size)
+bool usImage::InitLike(const usImage& other)
 {
-    // Allocates space for image and sets params up
-    // returns true on error
+    return other.IsCompact() ? InitCompact(other.Size, other.DataRect) : Init(other.Size);
+}
 
+bool usImage::Alloc(const wxSize& size, const wxRect& dataRect)
+{
     unsigned int prev = NPixels;
-    NPixels = size.GetWidth() * size.GetHeight();
+    NPixels = dataRect.GetWidth() * dataRect.GetHeight();
     Size = size;
-    Subframe = wxRect(0, 0, 0, 0);
+    DataRect = dataRect;
     MinADU = MaxADU = MedianADU = 0;
+    StatsValid = false;
 
     if (NPixels != prev)
     {
-        delete[] ImageData;
+        FramePoolFree(ImageData);
 
         if (NPixels)
         {
-            ImageData = new unsigned short[NPixels];
+            ImageData = FramePoolAlloc<unsigned short>(NPixels);
             if (!ImageData)
             {
                 NPixels = 0;
@@ -139,96 +102,49 @@ bool usImage::Init(const wxSize& size)
 
 void usImage::SwapImageData(usImage& other)
 {
-    unsigned short *t = ImageData;
-    ImageData = other.ImageData;
-    other.ImageData = t;
+    std::swap(ImageData, other.ImageData);
+    std::swap(NPixels, other.NPixels);
+    std::swap(DataRect, other.DataRect);
+    StatsValid = other.StatsValid = false;
 }
 
-void usImage::CalcStats()
+bool usImage::Expand()
 {
-    if (!ImageData || !NPixels)
-        return;
-
-    MinADU = 65535;
-    MaxADU = 0;
-    FiltMin = 65535;
-    FiltMax = 0;
-
-    if (Subframe.IsEmpty())
-    {
-        // full frame, no subframe
-
-        HistogramBuilder hb;
-        hb.scan(ImageData, NPixels);
-        MinADU = hb.MinADU;
-        MaxADU = hb.MaxADU;
-        MedianADU = hb.median();
+    // Replace the data of a compact image by a full-size buffer that is zero
+    // outside the subframe, for the few operations that work on whole frames
 
-        unsigned short *tmpdata = new unsigned short[NPixels];
+    if (!IsCompact())
+        return false;
 
-        Median3(tmpdata, ImageData, Size, wxRect(Size));
-
-        const unsigned short *src = tmpdata;
-        for (unsigned int i = 0; i < NPixels; i++)
-        {
-            unsigned short d = *src++;
-            if (d < FiltMin)
-                FiltMin = d;
-            if (d > FiltMax)
-                FiltMax = d;
-        }
-
-        delete[] tmpdata;
-    }
-    else
-    {
-        // Subframe
-
-        unsigned int pixcnt = Subframe.width * Subframe.height;
-        unsigned short *tmpdata = new unsigned short[pixcnt];
-
-        unsigned short *dst;
-
-        dst = tmpdata;
-        for (int y = 0; y < Subframe.height; y++)
-        {
-            const unsigned short *src = ImageData + Subframe.x + (Subframe.y + y) * Size.GetWidth();
-            for (int x = 0; x < Subframe.width; x++)
-            {
-                unsigned short d = *src;
-                *dst++ = *src++;
-            }
-        }
+    usImage full;
+    if (full.Init(Size))
+        return true;
 
-        HistogramBuilder hb;
-        hb.scan(tmpdata, pixcnt);
-        MinADU = hb.MinADU;
-        MaxADU = hb.MaxADU;
-        MedianADU = hb.median();
+    for (int y = 0; y < Size.GetHeight(); y++)
+        FullFrameRow(&full.Pixel(0, y), View(), y);
 
-        dst = new unsigned short[pixcnt];
+    SwapImageData(full);
+    return false;
+}
 
-        Median3(dst, tmpdata, Subframe.GetSize(), wxRect(Subframe.GetSize()));
+void usImage::CalcStats()
+{
+    if (!ImageData || !NPixels)
+        return;
 
-        const unsigned short *src = dst;
-        for (unsigned int i = 0; i < pixcnt; i++)
-        {
-            unsigned short d = *src++;
-            if (d < FiltMin)
-                FiltMin = d;
-            if (d > FiltMax)
-                FiltMax = d;
-        }
+    FrameStats stats;
+    CalcFrameStats(&stats, View());
 
-        delete[] dst;
-        delete[] tmpdata;
-    }
+    MinADU = stats.minADU;
+    MaxADU = stats.maxADU;
+    MedianADU = stats.medianADU;
+    FiltMin = stats.filtMin;
+    FiltMax = stats.filtMax;
+    StatsValid = true;
 }
 
-static unsigned char *buildGammaLookupTable(int blevel, int wlevel, double power)
+static void buildGammaLookupTable(unsigned char *result, int blevel, int wlevel, double power)
 {
-    unsigned char *result = new unsigned char[0x10000];
-
     if (blevel < 0)
         blevel = 0;
     if (wlevel < 0)
@@ -236,7 +152,7 @@ static unsigned char *buildGammaLookupTable(int blevel, int wlevel, double power
     if (blevel > 0xffff)
         blevel = 0xffff;
     if (wlevel > 0xffff)
-        blevel = 0xffff;
+        wlevel = 0xffff;
 
     for (int i = 0; i <= blevel; ++i)
         result[i] = 0;
@@ -250,36 +166,184 @@ static unsigned char *buildGammaLookupTable(int blevel, int wlevel, double power
 
     for (int i = wlevel; i < 0x10000; ++i)
         result[i] = 255;
+}
+
+// The display stretch only changes when the user moves the gamma slider or
+// the black/white levels of the image change, so keep the last lookup table
+// around instead of rebuilding it for every frame
+struct GammaLookupTable
+{
+    std::mutex lock;
+    bool valid;
+    int blevel;
+    int wlevel;
+    double power;
+    unsigned char table[0x10000];
+
+    GammaLookupTable() : valid(false), blevel(0), wlevel(0), power(0.0) { }
+
+    const unsigned char *Get(int b, int w, double p)
+    {
+        if (!valid || b != blevel || w != wlevel || p != power)
+        {
+            buildGammaLookupTable(table, b, w, p);
+            blevel = b;
+            wlevel = w;
+            power = p;
+            valid = true;
+        }
+        return table;
+    }
+};
+
+static GammaLookupTable& GetGammaLookupTable()
+{
+    static GammaLookupTable s_lut;
+    return s_lut;
+}
+
+// Row buffers for the downsampled display, one set per band of rows. They
+// only grow, so displaying frames of one size does not allocate. Used with
+// the gamma lookup table lock held.
+struct DownsampleScratch
+{
+    std::vector<unsigned int> colsum;
+    std::vector<unsigned short> avg;
+};
+
+static DownsampleScratch& GetDownsampleScratch()
+{
+    static DownsampleScratch s_scratch;
+    return s_scratch;
+}
+
+// map a row of pixels through the lookup table and expand it to gray RGB,
+// four pixels (three 32-bit words) at a time
+static void LutToRGB(unsigned char *dst, const unsigned short *src, const unsigned char *lut, int count)
+{
+    int x = 0;
 
-    return result;
+#if wxBYTE_ORDER == wxLITTLE_ENDIAN
+    for (; x + 4 <= count; x += 4, dst += 12)
+    {
+        wxUint32 const d0 = lut[src[x]], d1 = lut[src[x + 1]], d2 = lut[src[x + 2]], d3 = lut[src[x + 3]];
+        wxUint32 const w0 = d0 * 0x010101 | d1 << 24;
+        wxUint32 const w1 = d1 * 0x0101 | d2 * 0x01010000;
+        wxUint32 const w2 = d2 | d3 * 0x01010100;
+        memcpy(dst, &w0, 4);
+        memcpy(dst + 4, &w1, 4);
+        memcpy(dst + 8, &w2, 4);
+    }
+#endif
+
+    for (; x < count; x++)
+    {
+        unsigned char const d = lut[src[x]];
+        *dst++ = d;
+        *dst++ = d;
+        *dst++ = d;
+    }
 }
 
-bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
+bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power, int downsample)
 {
     wxImage *img = *rawimg;
 
-    if (!img || !img->Ok() || (img->GetWidth() != Size.GetWidth()) ||
-        (img->GetHeight() != Size.GetHeight())) // can't reuse bitmap
+    if (downsample < 1)
+        downsample = 1;
+
+    int const W = Size.GetWidth();
+    int const outW = W / downsample;
+    int const outH = Size.GetHeight() / downsample;
+
+    if (!img || !img->Ok() || (img->GetWidth() != outW) || (img->GetHeight() != outH)) // can't reuse bitmap
     {
         delete img;
-        img = new wxImage(Size.GetWidth(), Size.GetHeight(), false);
+        img = new wxImage(outW, outH, false);
     }
 
-    unsigned char *ImgPtr = img->GetData();
-    unsigned short *RawPtr = ImageData;
+    unsigned char *const imgData = img->GetData();
+
+    GammaLookupTable& gammaLut = GetGammaLookupTable();
+    std::lock_guard<std::mutex> lock(gammaLut.lock);
+    const unsigned char *const lutTable = gammaLut.Get(blevel, wlevel, power);
 
-    unsigned char *lutTable = buildGammaLookupTable(blevel, wlevel, power);
+    // convert bands of rows on the worker threads
+    int const BAND_ROWS = 64;
+    int const nbands = (outH + BAND_ROWS - 1) / BAND_ROWS;
 
-    for (unsigned int i = 0; i < NPixels; i++, RawPtr++)
+    unsigned int *colsums = nullptr;
+    unsigned short *avgs = nullptr;
+    if (downsample > 1)
     {
-        unsigned short v = *RawPtr;
-        unsigned char d = lutTable[v];
-        *ImgPtr++ = d;
-        *ImgPtr++ = d;
-        *ImgPtr++ = d;
+        DownsampleScratch& scratch = GetDownsampleScratch();
+        if (scratch.colsum.size() < (size_t) nbands * W)
+            scratch.colsum.resize((size_t) nbands * W);
+        if (scratch.avg.size() < (size_t) nbands * outW)
+            scratch.avg.resize((size_t) nbands * outW);
+        colsums = scratch.colsum.data();
+        avgs = scratch.avg.data();
     }
 
-    delete[] lutTable;
+    // only DataRect has pixels; the rest of a compact image is shown black
+    const unsigned short *const imageData = ImageData;
+    int const dx0 = DataRect.GetLeft();
+    int const dy0 = DataRect.GetTop();
+    int const dw = DataRect.GetWidth();
+    int const dh = DataRect.GetHeight();
+
+    // capture by value: the byte stores below could otherwise alias the
+    // captured variables and force them to be reloaded for every pixel
+    ParallelFor(nbands, [=](int band) {
+        int const y0 = band * BAND_ROWS;
+        int const y1 = std::min(y0 + BAND_ROWS, outH);
+
+        if (downsample == 1)
+        {
+            for (int y = y0; y < y1; y++)
+            {
+                unsigned char *const dst = imgData + (size_t) y * outW * 3;
+                if (y < dy0 || y >= dy0 + dh)
+                {
+                    memset(dst, 0, outW * 3);
+                    continue;
+                }
+                memset(dst, 0, dx0 * 3);
+                LutToRGB(dst + dx0 * 3, imageData + (size_t) (y - dy0) * dw, lutTable, dw);
+                memset(dst + (dx0 + dw) * 3, 0, (outW - dx0 - dw) * 3);
+            }
+            return;
+        }
+
+        // average each downsample x downsample block
+        unsigned int *const colsum = colsums + (size_t) band * W;
+        unsigned short *const avg = avgs + (size_t) band * outW;
+        unsigned int const n = downsample * downsample;
+
+        for (int y = y0; y < y1; y++)
+        {
+            std::fill(colsum, colsum + W, 0);
+            for (int j = 0; j < downsample; j++)
+            {
+                int const sy = y * downsample + j - dy0;
+                if (sy < 0 || sy >= dh)
+                    continue;
+                const unsigned short *const src = imageData + (size_t) sy * dw;
+                for (int x = 0; x < dw; x++)
+                    colsum[dx0 + x] += src[x];
+            }
+
+            for (int x = 0; x < outW; x++)
+            {
+                unsigned int sum = 0;
+                for (int i = 0; i < downsample; i++)
+                    sum += colsum[x * downsample + i];
+                avg[x] = sum / n;
+            }
+
+            LutToRGB(imgData + (size_t) y * outW * 3, avg, lutTable, outW);
+        }
+    });
 
     *rawimg = img;
     return false;
@@ -401,7 +465,19 @@ bool usImage::Save(const wxString& fname, const wxString& hdrNote) const
         }
 
         long fpixel[3] = { 1, 1, 1 };
-        fits_write_pix(fptr, TUSHORT, fpixel, NPixels, ImageData, &status);
+        if (IsCompact())
+        {
+            // the file always has the full frame, zero outside the subframe
+            std::vector<unsigned short> row(Size.GetWidth());
+            for (int y = 0; y < Size.GetHeight() && !status; y++)
+            {
+                FullFrameRow(row.data(), View(), y);
+                fpixel[1] = y + 1;
+                fits_write_pix(fptr, TUSHORT, fpixel, row.size(), row.data(), &status);
+            }
+        }
+        else
+            fits_write_pix(fptr, TUSHORT, fpixel, NPixels, ImageData, &status);
 
         PHD_fits_close_file(fptr);
 
@@ -522,7 +598,7 @@ bool usImage::Load(const wxString& fname)
 
 bool usImage::CopyFrom(const usImage& src)
 {
-    if (Init(src.Size))
+    if (InitLike(src))
         return true;
     memcpy(ImageData, src.ImageData, NPixels * sizeof(unsigned short));
     return false;
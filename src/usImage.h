@@ -35,18 +35,22 @@
 #ifndef USIMAGECLASS
 #define USIMAGECLASS
 
+#include "frame_view.h"
+
 class usImage
 {
 public:
     unsigned short *ImageData; // Pointer to raw data
     wxSize Size; // Dimensions of image
     wxRect Subframe; // were the valid data is
-    unsigned int NPixels;
+    wxRect DataRect; // the part of the image held in ImageData: all of it, or just the subframe for a compact image
+    unsigned int NPixels; // pixels in ImageData
     unsigned short MinADU;
     unsigned short MaxADU;
     unsigned short MedianADU;
     unsigned short FiltMin;
     unsigned short FiltMax;
+    bool StatsValid; // MinADU .. FiltMax are up to date
     wxDateTime ImgStartTime;
     int ImgExpDur; // milli-seconds
     int ImgStackCnt;
@@ -55,26 +59,49 @@ public:
     unsigned int FrameNum;
 
     usImage()
-        : ImageData(nullptr), NPixels(0), MinADU(0), MaxADU(0), MedianADU(0), FiltMin(0), FiltMax(0), ImgExpDur(0),
-          ImgStackCnt(1), BitsPerPixel(0), Pedestal(0), FrameNum(0)
+        : ImageData(nullptr), NPixels(0), MinADU(0), MaxADU(0), MedianADU(0), FiltMin(0), FiltMax(0), StatsValid(false),
+          ImgExpDur(0), ImgStackCnt(1), BitsPerPixel(0), Pedestal(0), FrameNum(0)
     {
     }
-    ~usImage() { delete[] ImageData; }
+    ~usImage();
 
     bool Init(const wxSize& size);
     bool Init(int width, int height) { return Init(wxSize(width, height)); }
+    // allocate just the subframe of an image of the given size
+    bool InitCompact(const wxSize& size, const wxRect& subframe);
+    bool InitLike(const usImage& other);
+    bool IsCompact() const { return DataRect.GetSize() != Size; }
+    bool Expand();
+    wxRect ValidRect() const { return Subframe.IsEmpty() ? wxRect(Size) : Subframe; }
+    wxRect ToData(const wxRect& rect) const { return wxRect(rect.GetPosition() - DataRect.GetPosition(), rect.GetSize()); }
+    int RowStride() const { return DataRect.GetWidth(); }
     void SwapImageData(usImage& other);
     void CalcStats();
+    void EnsureStats()
+    {
+        if (!StatsValid)
+            CalcStats();
+    }
     void InitImgStartTime();
     bool CopyFrom(const usImage& src);
-    bool CopyToImage(wxImage **img, int blevel, int wlevel, double power);
+    bool CopyToImage(wxImage **img, int blevel, int wlevel, double power, int downsample = 1);
     bool CopyFromImage(const wxImage& img);
     bool Load(const wxString& fname);
     bool Save(const wxString& fname, const wxString& hdrComment = wxEmptyString) const;
     bool Rotate(double theta, bool mirror = false);
-    unsigned short& Pixel(int x, int y) { return ImageData[y * Size.x + x]; }
-    const unsigned short& Pixel(int x, int y) const { return ImageData[y * Size.x + x]; }
+    // x and y are image coordinates, which must be within DataRect
+    unsigned short& Pixel(int x, int y) { return ImageData[(y - DataRect.y) * DataRect.width + x - DataRect.x]; }
+    const unsigned short& Pixel(int x, int y) const
+    {
+        return ImageData[(y - DataRect.y) * DataRect.width + x - DataRect.x];
+    }
     void Clear(void);
+    // the image as seen by the phd2core frame routines
+    FrameView View();
+    ConstFrameView View() const;
+
+private:
+    bool Alloc(const wxSize& size, const wxRect& dataRect);
 };
 
 inline void usImage::Clear(void)
@@ -82,4 +109,22 @@ inline void usImage::Clear(void)
     memset(ImageData, 0, NPixels * sizeof(unsigned short));
 }
 
+inline FrameRect ToFrameRect(const wxRect& r)
+{
+    FrameRect fr = { r.x, r.y, r.width, r.height };
+    return fr;
+}
+
+inline FrameView usImage::View()
+{
+    FrameView v = { ImageData, Size.GetWidth(), Size.GetHeight(), ToFrameRect(DataRect), ToFrameRect(Subframe) };
+    return v;
+}
+
+inline ConstFrameView usImage::View() const
+{
+    ConstFrameView v = { ImageData, Size.GetWidth(), Size.GetHeight(), ToFrameRect(DataRect), ToFrameRect(Subframe) };
+    return v;
+}
+
 #endif
@@ -98,6 +98,7 @@ void WorkerThread::EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposur
     message.args.expose.options = exposureOptions;
     message.args.expose.subframe = subframe;
     message.args.expose.pSemaphore = 0;
+    message.args.expose.measurement = nullptr;
 
     EnqueueMessage(message);
 }
@@ -155,7 +156,8 @@ static void CameraROITest(usImage *img)
     {
         for (int x = -4; x <= 4; x++)
             for (int y = -4; y <= 4; y++)
-                img->ImageData[X + x + (Y + y) * img->Size.x] = base - (x * x + y * y) * scale;
+                if (img->DataRect.Contains(X + x, Y + y))
+                    img->Pixel(X + x, Y + y) = base - (x * x + y * y) * scale;
     }
     dx += ddx;
     if (dx < 0 || dx >= 48)
@@ -217,6 +219,8 @@ bool WorkerThread::HandleExpose(EXPOSE_REQUEST *req)
 
         Debug.Write("Exposure complete\n");
 
+        req->readyTime = ::wxGetUTCTimeMillis().GetValue();
+
         if (!bError)
         {
             CameraROITest(req->pImage);
@@ -233,7 +237,12 @@ bool WorkerThread::HandleExpose(EXPOSE_REQUEST *req)
                 break;
             }
 
-            req->pImage->CalcStats();
+            // image statistics are only needed for display; the guider
+            // computes them when the frame is painted (see usImage::EnsureStats)
+
+            // find the guide stars and decide the guide correction here rather
+            // than on the GUI thread
+            req->measurement = m_pFrame->pGuider->MeasurementStage().Measure(req->pImage);
         }
     }
     catch (const wxString& Msg)
@@ -245,12 +254,32 @@ bool WorkerThread::HandleExpose(EXPOSE_REQUEST *req)
     return bError;
 }
 
-void WorkerThread::SendWorkerThreadExposeComplete(usImage *pImage, bool bError)
+ExposeCompleteEvent::ExposeCompleteEvent(const EXPOSE_REQUEST& expose, bool error)
+    : wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE), readyTime(expose.readyTime),
+      measurement(expose.measurement)
+{
+    SetPayload<usImage *>(expose.pImage);
+    SetInt(error);
+}
+
+void WorkerThread::SendWorkerThreadExposeComplete(const EXPOSE_REQUEST& expose, bool bError)
+{
+    wxQueueEvent(m_pFrame, new ExposeCompleteEvent(expose, bError));
+}
+
+// The move request for the guide correction the worker thread makes for a measured frame
+static void GuideStepMoveRequest(const StarMeasurement& measurement, MOVE_REQUEST *move)
 {
-    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE);
-    event->SetPayload<usImage *>(pImage);
-    event->SetInt(bError);
-    wxQueueEvent(m_pFrame, event);
+    move->mount = measurement.move.mount;
+    move->duration = 0;
+    move->direction = NONE;
+    move->axisMove = false;
+    move->moveOptions = measurement.move.options;
+    move->moveResult = Mount::MOVE_OK;
+    move->ofs = GuiderOffset();
+    if (measurement.move.options == MOVEOPTS_GUIDE_STEP)
+        move->ofs.cameraOfs = measurement.offset;
+    move->semaphore = nullptr;
 }
 
 /*************      Move       **************************/
@@ -429,10 +458,32 @@ wxThread::ExitCode WorkerThread::Entry()
                 Debug.Write("worker thread skipping SendWorkerThreadExposeComplete\n");
                 delete message.args.expose.pImage; // should be null though
                 message.args.expose.pImage = 0;
+                delete message.args.expose.measurement;
+                message.args.expose.measurement = nullptr;
                 m_skipSendExposeComplete = false;
             }
             else
-                SendWorkerThreadExposeComplete(message.args.expose.pImage, bError);
+            {
+                // the event takes ownership of the measurement, so take the move request first
+                const StarMeasurement *measurement = message.args.expose.measurement;
+                bool guideStep = !bError && measurement && measurement->move.mount;
+                MOVE_REQUEST move;
+                if (guideStep)
+                    GuideStepMoveRequest(*measurement, &move);
+
+                // the frame goes first so that the GUI thread accounts for the move
+                // before it sees the move complete
+                SendWorkerThreadExposeComplete(message.args.expose, bError);
+
+                if (guideStep)
+                {
+                    Debug.Write(wxString::Format("worker thread guide step %s ofs (%.2f, %.2f) opts 0x%x\n",
+                                                 move.mount->GetMountClassName(), move.ofs.cameraOfs.X, move.ofs.cameraOfs.Y,
+                                                 move.moveOptions));
+                    HandleMove(&move);
+                    SendWorkerThreadMoveComplete(move);
+                }
+            }
             break;
 
         case REQUEST_MOVE:
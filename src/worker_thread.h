@@ -64,6 +64,8 @@ struct EXPOSE_REQUEST
     wxRect subframe;
     bool error;
     wxSemaphore *pSemaphore;
+    wxLongLong_t readyTime; // when the camera delivered the frame (wxGetUTCTimeMillis)
+    StarMeasurement *measurement; // stars and guide correction measured on the worker thread, passed on with the frame
 };
 
 struct MOVE_REQUEST
@@ -78,6 +80,14 @@ struct MOVE_REQUEST
     wxSemaphore *semaphore;
 };
 
+struct ExposeCompleteEvent : public wxThreadEvent
+{
+    wxLongLong_t readyTime;
+    StarMeasurementPtr measurement;
+
+    ExposeCompleteEvent(const EXPOSE_REQUEST& expose, bool error);
+};
+
 struct MoveCompleteEvent : public wxThreadEvent
 {
     unsigned int moveOptions;
@@ -185,7 +195,7 @@ public:
 
 protected:
     bool HandleExpose(EXPOSE_REQUEST *args);
-    void SendWorkerThreadExposeComplete(usImage *pImage, bool bError);
+    void SendWorkerThreadExposeComplete(const EXPOSE_REQUEST& expose, bool bError);
     // in the frame class: void MyFrame::OnWorkerThreadExposeComplete(wxThreadEvent& event);
 
     /*************      Guide       **************************/
@@ -0,0 +1,440 @@
+/*
+ *  compact_frame_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Compact images hold only their subframe. Star::Find, CalcStats, Subtract
+// and RemoveDefects must give the same results for a compact image as for a
+// full-size image with the same subframe, and Expand and Save must rebuild
+// the zero-padded full frame.
+
+#include "frame_ops.h"
+#include "star_find.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+struct Star
+{
+    double x;
+    double y;
+    double amplitude;
+    double sigma;
+};
+
+// noisy background with Gaussian stars and a few hot pixels
+std::vector<unsigned short> MakeField(int width, int height, double background, const std::vector<Star>& stars,
+                                      unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> gauss(0.0, 20.0);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+
+    std::vector<unsigned short> px((size_t) width * height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            double v = background + gauss(rng);
+            for (const Star& s : stars)
+            {
+                double const dx = x - s.x, dy = y - s.y;
+                v += s.amplitude * std::exp(-(dx * dx + dy * dy) / (2.0 * s.sigma * s.sigma));
+            }
+            if (uni(rng) < 2e-3)
+                v += 20000.0;
+            px[(size_t) y * width + x] = (unsigned short) std::min(65535.0, std::max(0.0, v));
+        }
+    }
+    return px;
+}
+
+// An image of the field with a subframe, either full size or compact
+struct TestImage
+{
+    std::vector<unsigned short> buf;
+    int width;
+    int height;
+    FrameRect dataRect;
+    FrameRect subframe;
+
+    FrameView View()
+    {
+        FrameView v = { buf.data(), width, height, dataRect, subframe };
+        return v;
+    }
+    ConstFrameView View() const
+    {
+        ConstFrameView v = { buf.data(), width, height, dataRect, subframe };
+        return v;
+    }
+    unsigned short At(int x, int y) const { return View().Pixel(x, y); }
+};
+
+TestImage FullImage(const std::vector<unsigned short>& field, int width, int height, const FrameRect& sub)
+{
+    TestImage img = { field, width, height, { 0, 0, width, height }, sub };
+    return img;
+}
+
+TestImage CompactImage(const std::vector<unsigned short>& field, int width, int height, const FrameRect& sub)
+{
+    TestImage img = { std::vector<unsigned short>((size_t) sub.width * sub.height), width, height, sub, sub };
+    for (int y = 0; y < sub.height; y++)
+        std::copy_n(&field[(size_t) (sub.y + y) * width + sub.x], sub.width, &img.buf[(size_t) y * sub.width]);
+    return img;
+}
+
+// the subframe as an image of its own
+TestImage CroppedImage(const std::vector<unsigned short>& field, int width, const FrameRect& sub)
+{
+    TestImage img = CompactImage(field, width, sub.y + sub.height, sub);
+    img.width = sub.width;
+    img.height = sub.height;
+    img.dataRect = FrameRect{ 0, 0, sub.width, sub.height };
+    img.subframe = FrameRect{ 0, 0, 0, 0 };
+    return img;
+}
+
+int const W = 160;
+int const H = 120;
+
+// interior, at the origin, at the bottom right corner, and too narrow for
+// the median filter
+const FrameRect SUBFRAMES[] = {
+    { 50, 30, 64, 48 },
+    { 0, 0, 64, 48 },
+    { W - 70, H - 50, 70, 50 },
+    { 20, 10, 1, 40 },
+};
+
+} // namespace
+
+TEST(CompactFrameTest, star_find)
+{
+    // one star well inside the first subframe and one close to its edge, so
+    // the background annulus and the aperture are clipped by the subframe
+    std::vector<Star> const stars = { { 80.3, 52.6, 8000.0, 1.6 }, { 53.8, 74.2, 3000.0, 1.2 } };
+    std::vector<unsigned short> const field = MakeField(W, H, 1000.0, stars, 1);
+
+    for (const FrameRect& sub : SUBFRAMES)
+    {
+        if (sub.width < 16)
+            continue;
+
+        TestImage const full = FullImage(field, W, H, sub);
+        TestImage const compact = CompactImage(field, W, H, sub);
+
+        CoreLog const log = { nullptr, nullptr };
+
+        for (bool peakMode : { false, true })
+        {
+            // search from the stars and from points along the subframe edges
+            std::vector<std::pair<int, int>> bases;
+            for (const Star& s : stars)
+                bases.push_back(std::make_pair((int) s.x, (int) s.y));
+            bases.push_back(std::make_pair(sub.x + 2, sub.y + 2));
+            bases.push_back(std::make_pair(sub.Right() - 1, sub.y + sub.height / 2));
+            bases.push_back(std::make_pair(sub.x + sub.width / 2, sub.Bottom()));
+
+            for (const auto& base : bases)
+            {
+                StarFindParams params = {};
+                params.searchRegion = 15;
+                params.baseX = base.first;
+                params.baseY = base.second;
+                params.peakMode = peakMode;
+                params.minHFD = 1.5;
+                params.maxHFD = 50.0;
+                params.bitsPerPixel = 16;
+
+                StarFindResult a, b;
+                FindStar(&a, full.View(), params, log);
+                FindStar(&b, compact.View(), params, log);
+
+                SCOPED_TRACE(::testing::Message() << "subframe " << sub.x << "," << sub.y << " base " << base.first << ","
+                                                  << base.second << " peak " << peakMode);
+                EXPECT_EQ(a.code, b.code);
+                EXPECT_NEAR(a.x, b.x, 1e-9);
+                EXPECT_NEAR(a.y, b.y, 1e-9);
+                EXPECT_EQ(a.mass, b.mass);
+                EXPECT_EQ(a.snr, b.snr);
+                EXPECT_NEAR(a.hfd, b.hfd, 1e-9);
+                EXPECT_EQ(a.peakVal, b.peakVal);
+            }
+        }
+    }
+
+    // the star inside the first subframe is found at the same place in the
+    // compact image, in image coordinates
+    TestImage const compact = CompactImage(field, W, H, SUBFRAMES[0]);
+    StarFindParams params = {};
+    params.searchRegion = 15;
+    params.baseX = 78;
+    params.baseY = 54;
+    params.minHFD = 1.5;
+    params.maxHFD = 50.0;
+    params.bitsPerPixel = 16;
+    StarFindResult res;
+    FindStar(&res, compact.View(), params, CoreLog{ nullptr, nullptr });
+    EXPECT_EQ(STAR_FIND_OK, res.code);
+    EXPECT_NEAR(stars[0].x, res.x, 0.1);
+    EXPECT_NEAR(stars[0].y, res.y, 0.1);
+}
+
+TEST(CompactFrameTest, calc_stats)
+{
+    std::vector<unsigned short> const field = MakeField(W, H, 1000.0, { { 80.3, 52.6, 8000.0, 1.6 } }, 2);
+
+    for (const FrameRect& sub : SUBFRAMES)
+    {
+        FrameStats a, b, c;
+        CalcFrameStats(&a, FullImage(field, W, H, sub).View());
+        CalcFrameStats(&b, CompactImage(field, W, H, sub).View());
+        CalcFrameStats(&c, CroppedImage(field, W, sub).View());
+
+        SCOPED_TRACE(::testing::Message() << "subframe " << sub.x << "," << sub.y << " " << sub.width << "x" << sub.height);
+        EXPECT_EQ(a.minADU, b.minADU);
+        EXPECT_EQ(a.maxADU, b.maxADU);
+        EXPECT_EQ(a.medianADU, b.medianADU);
+        EXPECT_EQ(a.filtMin, b.filtMin);
+        EXPECT_EQ(a.filtMax, b.filtMax);
+
+        // only the subframe counts
+        EXPECT_EQ(c.minADU, b.minADU);
+        EXPECT_EQ(c.maxADU, b.maxADU);
+        EXPECT_EQ(c.medianADU, b.medianADU);
+        EXPECT_EQ(c.filtMin, b.filtMin);
+        EXPECT_EQ(c.filtMax, b.filtMax);
+    }
+
+    // a subframe large enough to be split into several bands
+    int const BW = 1100, BH = 700;
+    std::vector<unsigned short> const big = MakeField(BW, BH, 1000.0, {}, 3);
+    FrameRect const sub = { 20, 10, 1024, 600 };
+    FrameStats a, b;
+    CalcFrameStats(&a, FullImage(big, BW, BH, sub).View());
+    CalcFrameStats(&b, CompactImage(big, BW, BH, sub).View());
+    EXPECT_EQ(a.minADU, b.minADU);
+    EXPECT_EQ(a.maxADU, b.maxADU);
+    EXPECT_EQ(a.medianADU, b.medianADU);
+    EXPECT_EQ(a.filtMin, b.filtMin);
+    EXPECT_EQ(a.filtMax, b.filtMax);
+}
+
+TEST(CompactFrameTest, subtract)
+{
+    std::vector<unsigned short> const field = MakeField(W, H, 1000.0, { { 80.3, 52.6, 8000.0, 1.6 } }, 4);
+    // a dark brighter than the light, so there is a pedestal
+    std::vector<unsigned short> const darkField = MakeField(W, H, 1100.0, {}, 5);
+
+    FrameStats darkStats;
+    CalcFrameStats(&darkStats, FullImage(darkField, W, H, FrameRect{ 0, 0, 0, 0 }).View());
+
+    for (const FrameRect& sub : SUBFRAMES)
+    {
+        TestImage full = FullImage(field, W, H, sub);
+        TestImage compact = CompactImage(field, W, H, sub);
+        TestImage compactWithCompactDark = CompactImage(field, W, H, sub);
+        TestImage const dark = FullImage(darkField, W, H, FrameRect{ 0, 0, 0, 0 });
+        TestImage const compactDark = CompactImage(darkField, W, H, sub);
+
+        FrameStats lightStats;
+        CalcFrameStats(&lightStats, compact.View());
+
+        unsigned short pa = 0, pb = 0, pc = 0;
+        SubtractDarkFrame(full.View(), lightStats.medianADU, dark.View(), darkStats.medianADU, &pa);
+        SubtractDarkFrame(compact.View(), lightStats.medianADU, dark.View(), darkStats.medianADU, &pb);
+        SubtractDarkFrame(compactWithCompactDark.View(), lightStats.medianADU, compactDark.View(), darkStats.medianADU,
+                          &pc);
+
+        SCOPED_TRACE(::testing::Message() << "subframe " << sub.x << "," << sub.y << " " << sub.width << "x" << sub.height);
+        EXPECT_GT(pa, 0);
+        EXPECT_EQ(pa, pb);
+        EXPECT_EQ(pa, pc);
+
+        for (int y = 0; y < H; y++)
+        {
+            for (int x = 0; x < W; x++)
+            {
+                bool const inside = x >= sub.x && x <= sub.Right() && y >= sub.y && y <= sub.Bottom();
+                if (!inside)
+                {
+                    // outside the subframe the full image is untouched
+                    ASSERT_EQ(field[(size_t) y * W + x], full.At(x, y)) << x << "," << y;
+                    continue;
+                }
+                ASSERT_EQ(full.At(x, y), compact.At(x, y)) << x << "," << y;
+                ASSERT_EQ(full.At(x, y), compactWithCompactDark.At(x, y)) << x << "," << y;
+            }
+        }
+    }
+}
+
+TEST(CompactFrameTest, remove_defects)
+{
+    std::vector<unsigned short> const field = MakeField(W, H, 1000.0, {}, 6);
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> ux(0, W - 1), uy(0, H - 1);
+
+    for (const FrameRect& sub : SUBFRAMES)
+    {
+        if (sub.width < 2)
+            continue;
+
+        // defects inside the subframe, away from its edges
+        std::vector<DefectPoint> inner;
+        for (int i = 0; i < 200; i++)
+        {
+            DefectPoint const p = { ux(rng), uy(rng) };
+            if (p.x > sub.x && p.x < sub.Right() && p.y > sub.y && p.y < sub.Bottom())
+                inner.push_back(p);
+        }
+        // and the same with defects on its edges and corners, and outside it
+        std::vector<DefectPoint> all = inner;
+        for (int i = 0; i < 200; i++)
+            all.push_back(DefectPoint{ ux(rng), uy(rng) });
+        for (int x = sub.x; x <= sub.Right(); x += 5)
+        {
+            all.push_back(DefectPoint{ x, sub.y });
+            all.push_back(DefectPoint{ x, sub.Bottom() });
+        }
+        for (int y = sub.y; y <= sub.Bottom(); y += 5)
+        {
+            all.push_back(DefectPoint{ sub.x, y });
+            all.push_back(DefectPoint{ sub.Right(), y });
+        }
+        all.push_back(DefectPoint{ sub.Right(), sub.Bottom() });
+
+        SCOPED_TRACE(::testing::Message() << "subframe " << sub.x << "," << sub.y << " " << sub.width << "x" << sub.height);
+
+        // without defects on the subframe edges the neighbors are the same
+        // pixels either way
+        {
+            DefectIndex index;
+            BuildDefectIndex(&index, W, H, inner.data(), inner.size());
+            ASSERT_FALSE(index.entries.empty());
+
+            TestImage full = FullImage(field, W, H, sub);
+            TestImage compact = CompactImage(field, W, H, sub);
+            RemoveFrameDefects(full.View(), index);
+            RemoveFrameDefects(compact.View(), index);
+
+            for (int y = sub.y; y <= sub.Bottom(); y++)
+                for (int x = sub.x; x <= sub.Right(); x++)
+                    ASSERT_EQ(full.At(x, y), compact.At(x, y)) << x << "," << y;
+        }
+
+        // with defects on the edges the compact image has no neighbors
+        // outside the subframe, so it must treat the subframe as the frame:
+        // the same result as the subframe cropped to an image of its own
+        {
+            DefectIndex index;
+            BuildDefectIndex(&index, W, H, all.data(), all.size());
+
+            std::vector<DefectPoint> cropped;
+            for (const DefectPoint& p : all)
+                cropped.push_back(DefectPoint{ p.x - sub.x, p.y - sub.y });
+            DefectIndex cropIndex;
+            BuildDefectIndex(&cropIndex, sub.width, sub.height, cropped.data(), cropped.size());
+
+            TestImage full = FullImage(field, W, H, sub);
+            TestImage compact = CompactImage(field, W, H, sub);
+            TestImage crop = CroppedImage(field, W, sub);
+            RemoveFrameDefects(full.View(), index);
+            RemoveFrameDefects(compact.View(), index);
+            RemoveFrameDefects(crop.View(), cropIndex);
+
+            int changed = 0;
+            for (int y = 0; y < H; y++)
+            {
+                for (int x = 0; x < W; x++)
+                {
+                    bool const inside = x >= sub.x && x <= sub.Right() && y >= sub.y && y <= sub.Bottom();
+                    if (!inside)
+                    {
+                        // defects outside the subframe are left alone
+                        ASSERT_EQ(field[(size_t) y * W + x], full.At(x, y)) << x << "," << y;
+                        continue;
+                    }
+                    ASSERT_EQ(crop.At(x - sub.x, y - sub.y), compact.At(x, y)) << x << "," << y;
+                    if (compact.At(x, y) != field[(size_t) y * W + x])
+                        ++changed;
+                }
+            }
+            EXPECT_GT(changed, 0);
+        }
+    }
+}
+
+TEST(CompactFrameTest, full_frame_rows)
+{
+    std::vector<unsigned short> const field = MakeField(W, H, 1000.0, {}, 8);
+
+    for (const FrameRect& sub : SUBFRAMES)
+    {
+        TestImage const compact = CompactImage(field, W, H, sub);
+        TestImage const full = FullImage(field, W, H, FrameRect{ 0, 0, 0, 0 });
+
+        // the rows Expand and Save build: the field inside the subframe and
+        // zero everywhere else, and nothing written past the row
+        std::vector<unsigned short> row(W + 1);
+        for (int y = 0; y < H; y++)
+        {
+            row[W] = 0x5555;
+            FullFrameRow(row.data(), compact.View(), y);
+            ASSERT_EQ(0x5555, row[W]);
+            for (int x = 0; x < W; x++)
+            {
+                bool const inside = x >= sub.x && x <= sub.Right() && y >= sub.y && y <= sub.Bottom();
+                ASSERT_EQ(inside ? field[(size_t) y * W + x] : 0, row[x]) << x << "," << y;
+            }
+
+            // a full-size image comes back unchanged
+            FullFrameRow(row.data(), full.View(), y);
+            ASSERT_TRUE(std::equal(row.begin(), row.begin() + W, field.begin() + (size_t) y * W)) << y;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
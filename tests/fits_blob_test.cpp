@@ -0,0 +1,189 @@
+/*
+ *  fits_blob_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Checks the direct FITS decoder used for INDI BLOBs against hand-built FITS
+// files, and that it declines the files it leaves to CFITSIO.
+
+#include "fits_blob.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct FitsBuilder
+{
+    std::vector<std::string> cards;
+
+    FitsBuilder& Card(const char *keyword, const std::string& value)
+    {
+        char buf[81];
+        snprintf(buf, sizeof(buf), "%-8s= %20s", keyword, value.c_str());
+        cards.push_back(buf);
+        return *this;
+    }
+
+    // image with the given header cards, pixel values i + 3 * y (mod 2^bitpix)
+    std::vector<unsigned char> Build(int bitpix, int width, int height, bool pad = true) const
+    {
+        std::string hdr;
+        for (const std::string& c : cards)
+        {
+            std::string card = c;
+            card.resize(80, ' ');
+            hdr += card;
+        }
+        std::string end = "END";
+        end.resize(80, ' ');
+        hdr += end;
+        hdr.resize((hdr.size() + 2879) / 2880 * 2880, ' ');
+
+        std::vector<unsigned char> f(hdr.begin(), hdr.end());
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                unsigned int v = x + 3 * y;
+                if (bitpix == 16)
+                {
+                    unsigned short s = (unsigned short) (v * 97) ^ 0x8000; // signed with BZERO
+                    f.push_back(s >> 8);
+                    f.push_back(s & 0xff);
+                }
+                else
+                    f.push_back((unsigned char) v);
+            }
+        }
+        if (pad)
+            f.resize((f.size() + 2879) / 2880 * 2880, 0);
+        return f;
+    }
+};
+
+FitsBuilder Basic(int bitpix, int width, int height)
+{
+    FitsBuilder b;
+    b.Card("SIMPLE", "T")
+        .Card("BITPIX", std::to_string(bitpix))
+        .Card("NAXIS", "2")
+        .Card("NAXIS1", std::to_string(width))
+        .Card("NAXIS2", std::to_string(height));
+    return b;
+}
+
+} // namespace
+
+TEST(FitsBlobTest, decodes_16bit)
+{
+    int const W = 37, H = 11;
+    std::vector<unsigned char> f = Basic(16, W, H).Card("BZERO", "32768").Card("BSCALE", "1").Build(16, W, H);
+
+    FitsBlobImage img;
+    ASSERT_TRUE(ParseFitsBlob(&img, f.data(), f.size()));
+    EXPECT_EQ(16, img.bitpix);
+    EXPECT_EQ(W, img.width);
+    EXPECT_EQ(H, img.height);
+
+    for (SimdLevel simd : { SIMD_NONE, CpuSimdLevel() })
+    {
+        std::vector<unsigned short> px(W * H);
+        DecodeFitsBlob(px.data(), W, img, W, H, simd);
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++)
+                ASSERT_EQ((unsigned short) ((x + 3 * y) * 97), px[y * W + x]) << x << "," << y;
+    }
+}
+
+TEST(FitsBlobTest, decodes_8bit_into_wider_rows)
+{
+    int const W = 40, H = 5, STRIDE = 64;
+    std::vector<unsigned char> f = Basic(8, W, H).Card("EXTEND", "T").Build(8, W, H, false);
+
+    FitsBlobImage img;
+    ASSERT_TRUE(ParseFitsBlob(&img, f.data(), f.size()));
+
+    std::vector<unsigned short> px(STRIDE * H, 0xffff);
+    DecodeFitsBlob(px.data(), STRIDE, img, W, H, CpuSimdLevel());
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+            ASSERT_EQ((unsigned char) (x + 3 * y), px[y * STRIDE + x]);
+        for (int x = W; x < STRIDE; x++)
+            ASSERT_EQ(0xffff, px[y * STRIDE + x]); // untouched
+    }
+}
+
+TEST(FitsBlobTest, declines_what_cfitsio_handles)
+{
+    FitsBlobImage img;
+
+    // signed 16-bit data and scaled data
+    std::vector<unsigned char> f = Basic(16, 8, 8).Build(16, 8, 8);
+    EXPECT_FALSE(ParseFitsBlob(&img, f.data(), f.size()));
+    f = Basic(16, 8, 8).Card("BZERO", "32768").Card("BSCALE", "2").Build(16, 8, 8);
+    EXPECT_FALSE(ParseFitsBlob(&img, f.data(), f.size()));
+
+    // floating point
+    f = Basic(-32, 8, 8).Build(8, 8, 8);
+    EXPECT_FALSE(ParseFitsBlob(&img, f.data(), f.size()));
+
+    // color
+    FitsBuilder rgb;
+    rgb.Card("SIMPLE", "T").Card("BITPIX", "8").Card("NAXIS", "3").Card("NAXIS1", "8").Card("NAXIS2", "8").Card("NAXIS3", "3");
+    f = rgb.Build(8, 8, 24);
+    EXPECT_FALSE(ParseFitsBlob(&img, f.data(), f.size()));
+
+    // truncated data
+    f = Basic(8, 100, 100).Build(8, 100, 100, false);
+    EXPECT_TRUE(ParseFitsBlob(&img, f.data(), f.size()));
+    EXPECT_FALSE(ParseFitsBlob(&img, f.data(), f.size() - 1));
+
+    // an extension after the primary HDU
+    f = Basic(8, 8, 8).Build(8, 8, 8);
+    f.resize(f.size() + 2880, ' ');
+    EXPECT_FALSE(ParseFitsBlob(&img, f.data(), f.size()));
+
+    // not FITS
+    std::vector<unsigned char> junk(2880, 'x');
+    EXPECT_FALSE(ParseFitsBlob(&img, junk.data(), junk.size()));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
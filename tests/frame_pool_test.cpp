@@ -0,0 +1,193 @@
+/*
+ *  frame_pool_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// The pool is process-wide, so each test looks at the change in the counters
+// rather than their absolute values.
+
+#include "frame_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct Delta
+{
+    FramePoolStats before;
+    Delta() : before(FramePoolGetStats()) { }
+    unsigned long long Hits() const { return FramePoolGetStats().hits - before.hits; }
+    unsigned long long Misses() const { return FramePoolGetStats().misses - before.misses; }
+};
+
+} // namespace
+
+TEST(FramePoolTest, reuses_released_buffer)
+{
+    FramePoolTrim();
+    Delta d;
+
+    unsigned short *a = FramePoolAlloc<unsigned short>(1280 * 960);
+    ASSERT_NE(a, nullptr);
+    memset(a, 0xab, 1280 * 960 * sizeof(unsigned short));
+    FramePoolFree(a);
+
+    unsigned short *b = FramePoolAlloc<unsigned short>(1280 * 960);
+    EXPECT_EQ(a, b);
+    FramePoolFree(b);
+
+    EXPECT_EQ(d.Misses(), 1u);
+    EXPECT_EQ(d.Hits(), 1u);
+}
+
+TEST(FramePoolTest, sizes_in_a_bucket_share_buffers)
+{
+    FramePoolTrim();
+    Delta d;
+
+    // 1,000,000 and 1,020,000 bytes both round up to 1,048,576
+    void *a = FramePoolAlloc(1000000);
+    FramePoolFree(a);
+    void *b = FramePoolAlloc(1020000);
+    FramePoolFree(b);
+    EXPECT_EQ(a, b);
+
+    // a size in another bucket does not take it
+    void *c = FramePoolAlloc(2000000);
+    EXPECT_NE(a, c);
+    FramePoolFree(c);
+
+    EXPECT_EQ(d.Misses(), 2u);
+    EXPECT_EQ(d.Hits(), 1u);
+}
+
+TEST(FramePoolTest, alternating_frame_and_subframe)
+{
+    FramePoolTrim();
+    Delta d;
+
+    // looping while the guider switches between a full frame and a subframe
+    for (int i = 0; i < 100; i++)
+    {
+        size_t n = (i % 3) ? 4096 * 2 : 1920 * 1080;
+        unsigned short *img = FramePoolAlloc<unsigned short>(n);
+        unsigned short *tmp = FramePoolAlloc<unsigned short>(n);
+        img[n - 1] = tmp[n - 1] = 0;
+        FramePoolFree(tmp);
+        FramePoolFree(img);
+    }
+
+    // the subframe is below FRAME_POOL_MIN_BYTES and bypasses the pool; the
+    // full frame misses only until two buffers are idle
+    EXPECT_EQ(d.Misses(), 2u);
+    EXPECT_GT(d.Hits(), 60u);
+}
+
+TEST(FramePoolTest, resident_and_idle_bytes)
+{
+    FramePoolTrim();
+    FramePoolStats s0 = FramePoolGetStats();
+    EXPECT_EQ(s0.bytesIdle, 0u);
+
+    void *a = FramePoolAlloc(3 * 1024 * 1024);
+    FramePoolStats s1 = FramePoolGetStats();
+    EXPECT_EQ(s1.bytesResident - s0.bytesResident, 3u * 1024 * 1024);
+    EXPECT_EQ(s1.bytesIdle, 0u);
+
+    FramePoolFree(a);
+    FramePoolStats s2 = FramePoolGetStats();
+    EXPECT_EQ(s2.bytesResident, s1.bytesResident);
+    EXPECT_EQ(s2.bytesIdle, 3u * 1024 * 1024);
+
+    FramePoolTrim();
+    FramePoolStats s3 = FramePoolGetStats();
+    EXPECT_EQ(s3.bytesResident, s0.bytesResident);
+    EXPECT_EQ(s3.bytesIdle, 0u);
+}
+
+TEST(FramePoolTest, small_requests_bypass_the_pool)
+{
+    Delta d;
+    void *p = FramePoolAlloc(100);
+    ASSERT_NE(p, nullptr);
+    FramePoolFree(p);
+    FramePoolFree(nullptr);
+    EXPECT_EQ(d.Hits() + d.Misses(), 0u);
+}
+
+TEST(FramePoolTest, alignment)
+{
+    void *p = FramePoolAlloc(200000);
+    EXPECT_EQ((uintptr_t) p % 16, 0u);
+    FramePoolFree(p);
+    p = FramePoolAlloc(10);
+    EXPECT_EQ((uintptr_t) p % 16, 0u);
+    FramePoolFree(p);
+}
+
+TEST(FramePoolTest, concurrent_use)
+{
+    FramePoolTrim();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+    {
+        threads.push_back(std::thread([t] {
+            for (int i = 0; i < 200; i++)
+            {
+                size_t n = 100000 + 50000 * ((t + i) % 4);
+                unsigned char *p = static_cast<unsigned char *>(FramePoolAlloc(n));
+                memset(p, t, n);
+                for (size_t j = 0; j < n; j += 4096)
+                    ASSERT_EQ(p[j], t);
+                FramePoolFree(p);
+            }
+        }));
+    }
+    for (auto& th : threads)
+        th.join();
+
+    FramePoolStats s = FramePoolGetStats();
+    EXPECT_EQ(s.bytesResident, s.bytesIdle);
+    FramePoolTrim();
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
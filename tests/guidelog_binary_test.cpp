@@ -0,0 +1,279 @@
+/*
+ *  guidelog_binary_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "guidelog_binary.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+GuideLogRecord MountStep()
+{
+    GuideLogRecord rec;
+    rec.Clear();
+    rec.kind = GLR_MOUNT;
+    rec.frame = 12;
+    rec.time = 34.5678;
+    rec.dx = 0.1234;
+    rec.dy = -0.5;
+    rec.raRaw = 0.25;
+    rec.decRaw = -1.125;
+    rec.raGuide = 0.2;
+    rec.decGuide = -1.0;
+    rec.raDuration = 150;
+    rec.raDir = 'W';
+    rec.decDuration = 0;
+    rec.starMass = 12345.6;
+    rec.snr = 42.13;
+    rec.errorCode = 0;
+    return rec;
+}
+
+std::string ReadAll(FILE *fp)
+{
+    std::string s;
+    rewind(fp);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        s.append(buf, n);
+    return s;
+}
+
+std::string Format(const GuideLogRecord& rec, const char *status = nullptr)
+{
+    std::string s;
+    GuideLogFormatRow(&s, rec, status);
+    return s;
+}
+
+} // namespace
+
+TEST(GuideLogBinaryTest, text_rows)
+{
+    GuideLogRecord rec = MountStep();
+    EXPECT_EQ(Format(rec), "12,34.568,\"Mount\",0.123,-0.500,0.250,-1.125,0.200,-1.000,150,W,0,,,,12346,42.13,0\n");
+
+    rec.kind = GLR_AO;
+    rec.xStep = -3;
+    rec.yStep = 2;
+    EXPECT_EQ(Format(rec), "12,34.568,\"AO\",0.123,-0.500,0.250,-1.125,0.200,-1.000,,,,,-3,2,12346,42.13,0\n");
+
+    GuideLogRecord drop;
+    drop.Clear();
+    drop.kind = GLR_DROP;
+    drop.frame = 13;
+    drop.time = 35.0;
+    drop.starMass = 10.0;
+    drop.snr = 2.5;
+    drop.errorCode = 1;
+    drop.SetStatus("Star lost - low SNR");
+    EXPECT_EQ(Format(drop), "13,35.000,\"DROP\",,,,,,,,,,,,,10,2.50,1,\"Star lost - low SNR\"\n");
+    EXPECT_EQ(Format(drop, "full status"), "13,35.000,\"DROP\",,,,,,,,,,,,,10,2.50,1,\"full status\"\n");
+}
+
+TEST(GuideLogBinaryTest, status_truncates_on_character_boundary)
+{
+    GuideLogRecord rec;
+    rec.Clear();
+
+    std::string s(26, 'a');
+    s += "\xc3\xa9"; // two-byte character straddling the limit
+    rec.SetStatus(s.c_str());
+    EXPECT_EQ(std::string(rec.status), std::string(26, 'a'));
+
+    rec.SetStatus("short");
+    EXPECT_STREQ(rec.status, "short");
+}
+
+TEST(GuideLogBinaryTest, round_trip)
+{
+    FILE *fp = tmpfile();
+    ASSERT_NE(fp, nullptr);
+
+    ASSERT_TRUE(GuideLogBinaryWriteHeader(fp));
+    std::vector<GuideLogRecord> recs;
+    for (int i = 0; i < 100; i++)
+    {
+        GuideLogRecord rec = MountStep();
+        rec.frame = i;
+        rec.time = i * 0.5;
+        rec.dx = i * 0.01;
+        recs.push_back(rec);
+        ASSERT_TRUE(GuideLogBinaryWriteRecord(fp, rec));
+    }
+
+    rewind(fp);
+    GuideLogBinaryReader reader;
+    std::string error;
+    ASSERT_TRUE(reader.Open(fp, &error)) << error;
+
+    GuideLogRecord rec;
+    size_t n = 0;
+    while (reader.Next(&rec))
+    {
+        ASSERT_LT(n, recs.size());
+        EXPECT_EQ(memcmp(&rec, &recs[n], sizeof(rec)), 0) << "record " << n;
+        ++n;
+    }
+    EXPECT_EQ(n, recs.size());
+
+    fclose(fp);
+}
+
+TEST(GuideLogBinaryTest, converts_to_text)
+{
+    FILE *bin = tmpfile();
+    FILE *txt = tmpfile();
+    ASSERT_NE(bin, nullptr);
+    ASSERT_NE(txt, nullptr);
+
+    ASSERT_TRUE(GuideLogBinaryWriteHeader(bin));
+
+    // a step logged before any guiding begin record gets a heading of its own
+    GuideLogRecord step = MountStep();
+    GuideLogBinaryWriteRecord(bin, step);
+
+    GuideLogRecord rec;
+    rec.Clear();
+    rec.kind = GLR_GUIDING_BEGIN;
+    rec.time = 1700000000.0;
+    GuideLogBinaryWriteRecord(bin, rec);
+    GuideLogBinaryWriteRecord(bin, step);
+    rec.kind = GLR_GUIDING_END;
+    rec.time = 1700000100.0;
+    GuideLogBinaryWriteRecord(bin, rec);
+
+    rewind(bin);
+    std::string error;
+    ASSERT_TRUE(GuideLogBinaryToText(bin, txt, &error)) << error;
+
+    std::string text = ReadAll(txt);
+    const std::string heading = "Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,"
+                                "RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode\n";
+    const std::string row = Format(step);
+
+    ASSERT_EQ(text.compare(0, heading.size() + row.size(), heading + row), 0) << text;
+
+    size_t begin = text.find("\nGuiding Begins at ");
+    ASSERT_NE(begin, std::string::npos);
+    size_t eol = text.find('\n', begin + 1);
+    ASSERT_NE(eol, std::string::npos);
+    EXPECT_EQ(eol - begin, strlen("\nGuiding Begins at 2023-11-14 22:13:20"));
+    EXPECT_EQ(text.compare(eol + 1, heading.size() + row.size(), heading + row), 0) << text;
+
+    size_t end = text.find("Guiding Ends at ", eol);
+    ASSERT_NE(end, std::string::npos);
+    EXPECT_EQ(text.back(), '\n');
+
+    fclose(bin);
+    fclose(txt);
+}
+
+TEST(GuideLogBinaryTest, reads_columns_by_name)
+{
+    // append an unknown column to the table and widen the records, as a
+    // later writer might
+    FILE *fp = tmpfile();
+    ASSERT_NE(fp, nullptr);
+    ASSERT_TRUE(GuideLogBinaryWriteHeader(fp));
+    std::string hdr = ReadAll(fp);
+    fclose(fp);
+
+    uint32_t recordSize, columnCount;
+    memcpy(&recordSize, &hdr[16], 4);
+    memcpy(&columnCount, &hdr[20], 4);
+    ASSERT_EQ(recordSize, sizeof(GuideLogRecord));
+    ASSERT_EQ(hdr.size(), 24 + columnCount * sizeof(GuideLogColumn));
+
+    GuideLogColumn extra;
+    memset(&extra, 0, sizeof(extra));
+    strcpy(extra.name, "Extra");
+    extra.offset = sizeof(GuideLogRecord);
+    extra.type = GLC_F64;
+    extra.size = 8;
+    hdr.append(reinterpret_cast<const char *>(&extra), sizeof(extra));
+    recordSize += 8;
+    ++columnCount;
+    memcpy(&hdr[16], &recordSize, 4);
+    memcpy(&hdr[20], &columnCount, 4);
+
+    GuideLogRecord step = MountStep();
+    std::string data = hdr;
+    data.append(reinterpret_cast<const char *>(&step), sizeof(step));
+    data.append(8, '\x7f');
+
+    fp = tmpfile();
+    ASSERT_NE(fp, nullptr);
+    fwrite(data.data(), 1, data.size(), fp);
+    rewind(fp);
+
+    GuideLogBinaryReader reader;
+    std::string error;
+    ASSERT_TRUE(reader.Open(fp, &error)) << error;
+    EXPECT_EQ(reader.Columns().size(), columnCount);
+
+    GuideLogRecord rec;
+    ASSERT_TRUE(reader.Next(&rec));
+    EXPECT_EQ(memcmp(&rec, &step, sizeof(rec)), 0);
+    EXPECT_FALSE(reader.Next(&rec));
+
+    fclose(fp);
+}
+
+TEST(GuideLogBinaryTest, rejects_other_files)
+{
+    FILE *fp = tmpfile();
+    ASSERT_NE(fp, nullptr);
+    fputs("PHD2 version 2.6.13, Log version 2.5\n", fp);
+    rewind(fp);
+
+    FILE *out = tmpfile();
+    std::string error;
+    EXPECT_FALSE(GuideLogBinaryToText(fp, out, &error));
+    EXPECT_EQ(error, "not a binary guide log");
+
+    fclose(fp);
+    fclose(out);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
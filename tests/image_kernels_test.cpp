@@ -0,0 +1,194 @@
+/*
+ *  image_kernels_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Compares the vectorized pixel conversion kernels with the scalar
+// implementation.
+
+#include "image_kernels.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+
+std::vector<SimdLevel> VectorLevels()
+{
+    std::vector<SimdLevel> levels;
+#if defined(PHD_HAVE_SSE2)
+    levels.push_back(SIMD_SSE2);
+#endif
+#if defined(PHD_HAVE_AVX2)
+    if (CpuSimdLevel() == SIMD_AVX2)
+        levels.push_back(SIMD_AVX2);
+#endif
+#if defined(PHD_HAVE_NEON)
+    levels.push_back(SIMD_NEON);
+#endif
+    return levels;
+}
+
+std::vector<unsigned char> RandomBytes(size_t n, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<unsigned char> v(n);
+    for (unsigned char& b : v)
+        b = (unsigned char) rng();
+    return v;
+}
+
+// odd lengths exercise the scalar tails
+const unsigned int COUNTS[] = { 0, 1, 7, 8, 15, 16, 17, 31, 33, 1001 };
+
+} // namespace
+
+TEST(ImageKernelsTest, ConvertBigEndian16)
+{
+    std::vector<unsigned char> src = RandomBytes(2 * 1001, 1);
+
+    for (unsigned short flip : { 0, 0x8000 })
+    {
+        for (unsigned int n : COUNTS)
+        {
+            std::vector<unsigned short> ref(n + 1, 0x5555);
+            ConvertBigEndian16(ref.data(), src.data(), n, flip, SIMD_NONE);
+            for (unsigned int i = 0; i < n; i++)
+                ASSERT_EQ((unsigned short) (((src[2 * i] << 8) | src[2 * i + 1]) ^ flip), ref[i]);
+            ASSERT_EQ(0x5555, ref[n]);
+
+            for (SimdLevel simd : VectorLevels())
+            {
+                std::vector<unsigned short> out(n + 1, 0x5555);
+                ConvertBigEndian16(out.data(), src.data(), n, flip, simd);
+                EXPECT_EQ(ref, out) << SimdLevelName(simd) << " n=" << n;
+            }
+        }
+    }
+}
+
+TEST(ImageKernelsTest, WidenBytes)
+{
+    std::vector<unsigned char> src = RandomBytes(1001, 2);
+
+    for (unsigned int n : COUNTS)
+    {
+        std::vector<unsigned short> ref(n + 1, 0x5555);
+        WidenBytes(ref.data(), src.data(), n, SIMD_NONE);
+        for (unsigned int i = 0; i < n; i++)
+            ASSERT_EQ(src[i], ref[i]);
+        ASSERT_EQ(0x5555, ref[n]);
+
+        for (SimdLevel simd : VectorLevels())
+        {
+            std::vector<unsigned short> out(n + 1, 0x5555);
+            WidenBytes(out.data(), src.data(), n, simd);
+            EXPECT_EQ(ref, out) << SimdLevelName(simd) << " n=" << n;
+        }
+    }
+}
+
+TEST(ImageKernelsTest, AccumulateBytes_wraps)
+{
+    std::vector<unsigned char> src = RandomBytes(1001, 3);
+    std::mt19937 rng(4);
+    std::vector<unsigned short> acc0(1002);
+    for (unsigned short& v : acc0)
+        v = (unsigned short) (65400 + rng() % 136); // some sums overflow
+
+    for (unsigned int n : COUNTS)
+    {
+        std::vector<unsigned short> ref(acc0.begin(), acc0.begin() + n + 1);
+        AccumulateBytes(ref.data(), src.data(), n, SIMD_NONE);
+        for (unsigned int i = 0; i < n; i++)
+            ASSERT_EQ((unsigned short) (acc0[i] + src[i]), ref[i]);
+        ASSERT_EQ(acc0[n], ref[n]);
+
+        for (SimdLevel simd : VectorLevels())
+        {
+            std::vector<unsigned short> out(acc0.begin(), acc0.begin() + n + 1);
+            AccumulateBytes(out.data(), src.data(), n, simd);
+            EXPECT_EQ(ref, out) << SimdLevelName(simd) << " n=" << n;
+        }
+    }
+}
+
+TEST(ImageKernelsTest, SubtractDarkRect_clamps)
+{
+    int const W = 9, H = 4;
+    std::vector<unsigned short> light(W * H, 100), dark(W * H, 40);
+    dark[W + 2] = 500; // hot pixel in the dark only
+    light[2 * W + 3] = 65530;
+    dark[2 * W + 3] = 0; // 65530 + pedestal overflows
+
+    SubtractDarkRect(&light[W + 1], W, &dark[W + 1], W, 5, 2, 10);
+
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+        {
+            unsigned short expect = 100;
+            if (x >= 1 && x < 6 && y >= 1 && y < 3)
+                expect = 70;
+            if (x == 2 && y == 1)
+                expect = 0;
+            if (x == 3 && y == 2)
+                expect = 65535;
+            EXPECT_EQ(expect, light[y * W + x]) << x << "," << y;
+        }
+    }
+}
+
+TEST(ImageKernelsTest, SubtractDarkRect_compact_light)
+{
+    // a 3x2 subframe at (4,1) held in its own buffer, and a full 9x4 dark
+    int const W = 9, H = 4, SW = 3, SH = 2;
+    std::vector<unsigned short> light(SW * SH), dark(W * H);
+    for (int i = 0; i < SW * SH; i++)
+        light[i] = 1000 + i;
+    for (int i = 0; i < W * H; i++)
+        dark[i] = i;
+
+    SubtractDarkRect(light.data(), SW, &dark[W + 4], W, SW, SH, 5);
+
+    for (int y = 0; y < SH; y++)
+        for (int x = 0; x < SW; x++)
+            EXPECT_EQ(1000 + y * SW + x + 5 - ((y + 1) * W + x + 4), light[y * SW + x]) << x << "," << y;
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
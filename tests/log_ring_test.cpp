@@ -0,0 +1,204 @@
+/*
+ *  log_ring_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "log_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+std::vector<std::string> DrainAll(LogRing& ring)
+{
+    std::vector<std::string> out;
+    ring.Drain([&](const LogRing::Record& r) { out.push_back(std::string(r.text, r.len)); });
+    return out;
+}
+
+} // namespace
+
+TEST(LogRingTest, records_in_order)
+{
+    LogRing ring(64);
+
+    ASSERT_TRUE(ring.Put(1, 7, "first\n", 6));
+    ASSERT_TRUE(ring.Put(2, 8, "", 0));
+    std::string longer(1000, 'x');
+    ASSERT_TRUE(ring.Put(3, 9, longer.data(), longer.size()));
+
+    std::vector<LogRing::Record> recs;
+    std::vector<std::string> texts;
+    unsigned int n = ring.Drain([&](const LogRing::Record& r) {
+        recs.push_back(r);
+        texts.push_back(std::string(r.text, r.len));
+    });
+
+    ASSERT_EQ(n, 3u);
+    EXPECT_EQ(texts[0], "first\n");
+    EXPECT_EQ(recs[0].time, 1);
+    EXPECT_EQ(recs[0].thread, 7u);
+    EXPECT_EQ(texts[1], "");
+    EXPECT_EQ(texts[2], longer);
+    EXPECT_EQ(recs[2].time, 3);
+    EXPECT_EQ(ring.Consumed(), ring.Produced());
+    EXPECT_EQ(ring.Drain([](const LogRing::Record&) { }), 0u);
+}
+
+static void CollectRecord(void *ctx, const LogRing::Record& r)
+{
+    static_cast<std::vector<std::string> *>(ctx)->push_back(std::string(r.text, r.len));
+}
+
+TEST(LogRingTest, drain_with_function_pointer)
+{
+    LogRing ring(64);
+
+    std::string longest(ring.MaxText(), 'y');
+    ASSERT_TRUE(ring.Put(1, 1, "a\n", 2));
+    ASSERT_TRUE(ring.Put(2, 1, longest.data(), longest.size()));
+    ASSERT_TRUE(ring.Put(3, 1, "b\n", 2));
+
+    std::vector<std::string> out;
+    ASSERT_EQ(ring.Drain(CollectRecord, &out), 3u);
+    ASSERT_EQ(out.size(), 3u);
+    EXPECT_EQ(out[0], "a\n");
+    EXPECT_EQ(out[1], longest);
+    EXPECT_EQ(out[2], "b\n");
+    EXPECT_EQ(ring.Drain(CollectRecord, &out), 0u);
+}
+
+TEST(LogRingTest, wraps_around)
+{
+    LogRing ring(16);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        std::string s(i % 300, (char) ('a' + i % 26));
+        ASSERT_TRUE(ring.Put(i, 0, s.data(), s.size()));
+        std::vector<std::string> out = DrainAll(ring);
+        ASSERT_EQ(out.size(), 1u);
+        ASSERT_EQ(out[0], s);
+    }
+    EXPECT_EQ(ring.Overflows(), 0u);
+}
+
+TEST(LogRingTest, overflow_drops_and_counts)
+{
+    LogRing ring(16);
+
+    int accepted = 0;
+    for (int i = 0; i < 100; i++)
+        if (ring.Put(i, 0, "0123456789", 10))
+            ++accepted;
+
+    EXPECT_EQ(accepted, 16); // one slot per record
+    EXPECT_EQ(ring.Overflows(), 84u);
+
+    std::vector<std::string> out = DrainAll(ring);
+    EXPECT_EQ(out.size(), 16u);
+
+    // space is available again
+    EXPECT_TRUE(ring.Put(0, 0, "again", 5));
+}
+
+TEST(LogRingTest, long_records_are_truncated)
+{
+    LogRing ring(64);
+
+    std::string big(100000, 'z');
+    ASSERT_TRUE(ring.Put(0, 0, big.data(), big.size()));
+    EXPECT_EQ(ring.Truncations(), 1u);
+
+    std::vector<std::string> out = DrainAll(ring);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].size(), ring.MaxText());
+    EXPECT_EQ(out[0], big.substr(0, ring.MaxText()));
+}
+
+TEST(LogRingTest, concurrent_producers)
+{
+    LogRing ring(1024);
+
+    const int PRODUCERS = 6;
+    const int PER_PRODUCER = 20000;
+
+    std::atomic<int> done(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < PRODUCERS; t++)
+    {
+        threads.push_back(std::thread([&, t] {
+            for (int i = 0; i < PER_PRODUCER; i++)
+            {
+                // vary the length so records span one to several slots
+                std::string s = std::to_string(i) + ":" + std::string(i % 400, (char) ('A' + t));
+                while (!ring.Put(i, t, s.data(), s.size()))
+                    std::this_thread::yield();
+            }
+            ++done;
+        }));
+    }
+
+    std::vector<int> next(PRODUCERS, 0);
+    bool ok = true;
+    auto check = [&](const LogRing::Record& r) {
+        int t = (int) r.thread;
+        int i = (int) r.time;
+        std::string expect = std::to_string(i) + ":" + std::string(i % 400, (char) ('A' + t));
+        if (i != next[t] || std::string(r.text, r.len) != expect)
+            ok = false;
+        next[t] = i + 1;
+    };
+
+    while (done < PRODUCERS)
+        ring.Drain(check);
+    ring.Drain(check);
+
+    for (auto& th : threads)
+        th.join();
+
+    EXPECT_TRUE(ok);
+    for (int t = 0; t < PRODUCERS; t++)
+        EXPECT_EQ(next[t], PER_PRODUCER);
+    EXPECT_EQ(ring.Consumed(), ring.Produced());
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,233 @@
+/*
+ *  median_filter_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Compares the sliding-histogram MedianFilter with the previous
+// implementation, which rebuilt the histogram at the start of every row and
+// scanned it for each output pixel.
+//
+// The 6000x4000 benchmark is disabled by default; run it with
+//   MedianFilterTest --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+
+#include "median_kernels.h"
+#include "parallel.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+unsigned short HistoMedian(const unsigned short histo1[256], const unsigned short histo2[65536], int n)
+{
+    n /= 2;
+    unsigned int i;
+    for (i = 0; i < 256; i++)
+    {
+        if (histo1[i] > n)
+            break;
+        n -= histo1[i];
+    }
+    for (i <<= 8; i < 65536; i++)
+    {
+        if (histo2[i] > n)
+            break;
+        n -= histo2[i];
+    }
+    return i;
+}
+
+void ReferenceMedianFilter(unsigned short *d, const unsigned short *src, int width, int height, int halfWidth)
+{
+    std::vector<unsigned short> histo1(256);
+    std::vector<unsigned short> histo2(65536);
+
+    for (int y = 0; y < height; y++)
+    {
+        int top = std::max(0, y - halfWidth);
+        int bot = std::min(y + halfWidth, height - 1);
+        int left = 0;
+        int right = std::min(halfWidth, width - 1);
+
+        std::fill(histo1.begin(), histo1.end(), 0);
+        std::fill(histo2.begin(), histo2.end(), 0);
+
+        for (int j = top; j <= bot; j++)
+        {
+            const unsigned short *p = &src[j * width + left];
+            for (int i = left; i <= right; i++, p++)
+            {
+                ++histo1[*p >> 8];
+                ++histo2[*p];
+            }
+        }
+        unsigned int n = (right - left + 1) * (bot - top + 1);
+
+        *d++ = HistoMedian(&histo1[0], &histo2[0], n);
+
+        for (int i = 1; i < width; i++)
+        {
+            left = std::max(0, i - halfWidth);
+            right = std::min(i + halfWidth, width - 1);
+
+            if (left > 0)
+            {
+                const unsigned short *p = &src[top * width + left - 1];
+                for (int j = top; j <= bot; j++, p += width)
+                {
+                    --histo1[*p >> 8];
+                    --histo2[*p];
+                }
+                n -= (bot - top + 1);
+            }
+
+            if (i + halfWidth <= width - 1)
+            {
+                const unsigned short *p = &src[top * width + right];
+                for (int j = top; j <= bot; j++, p += width)
+                {
+                    ++histo1[*p >> 8];
+                    ++histo2[*p];
+                }
+                n += (bot - top + 1);
+            }
+
+            *d++ = HistoMedian(&histo1[0], &histo2[0], n);
+        }
+    }
+}
+
+// a dark frame: offset plus read noise, with a sprinkling of hot pixels
+std::vector<unsigned short> MakeDark(int width, int height, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(1000.0, 30.0);
+    std::uniform_int_distribution<int> hot(0, 999);
+    std::uniform_int_distribution<int> hotval(2000, 65535);
+
+    std::vector<unsigned short> img(width * height);
+    for (auto& v : img)
+        v = hot(rng) == 0 ? (unsigned short) hotval(rng) : (unsigned short) std::max(0.0, noise(rng));
+    return img;
+}
+
+void CheckFilter(const std::vector<unsigned short>& img, int width, int height, int halfWidth)
+{
+    std::vector<unsigned short> expected(img.size());
+    std::vector<unsigned short> actual(img.size());
+
+    ReferenceMedianFilter(&expected[0], &img[0], width, height, halfWidth);
+    MedianFilter(&actual[0], &img[0], width, height, halfWidth);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            ASSERT_EQ(expected[y * width + x], actual[y * width + x])
+                << "x=" << x << " y=" << y << " size=" << width << "x" << height << " halfWidth=" << halfWidth;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TEST(MedianFilterTest, dark)
+{
+    std::vector<unsigned short> img = MakeDark(301, 203, 1);
+    CheckFilter(img, 301, 203, 15);
+}
+
+TEST(MedianFilterTest, sizes)
+{
+    // images smaller than the window and stripes of odd heights
+    std::mt19937 rng(2);
+    for (int i = 0; i < 40; i++)
+    {
+        int width = 1 + rng() % 90;
+        int height = 1 + rng() % 150;
+        int halfWidth = 1 + rng() % 16;
+        std::vector<unsigned short> img = MakeDark(width, height, rng());
+        CheckFilter(img, width, height, halfWidth);
+    }
+}
+
+TEST(MedianFilterTest, fullRange)
+{
+    // uniform values over the whole range make the median move across
+    // coarse histogram bins
+    std::mt19937 rng(3);
+    int width = 157, height = 141;
+    std::vector<unsigned short> img(width * height);
+    for (auto& v : img)
+        v = (unsigned short) (rng() & 0xffff);
+    CheckFilter(img, width, height, 7);
+
+    // a step edge
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            img[y * width + x] = x < width / 2 ? 10 : 60000;
+    CheckFilter(img, width, height, 15);
+}
+
+TEST(MedianFilterTest, DISABLED_Benchmark6000x4000)
+{
+    int const width = 6000, height = 4000, halfWidth = 15;
+    std::vector<unsigned short> img = MakeDark(width, height, 4);
+    std::vector<unsigned short> expected(img.size());
+    std::vector<unsigned short> actual(img.size());
+
+    auto start = std::chrono::steady_clock::now();
+    ReferenceMedianFilter(&expected[0], &img[0], width, height, halfWidth);
+    double refMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    MedianFilter(&actual[0], &img[0], width, height, halfWidth);
+    double newMs = ElapsedMs(start);
+
+    printf("MedianFilter %dx%d window %d: previous %.0f ms, sliding histogram %.0f ms (%u threads)\n", width, height,
+           2 * halfWidth + 1, refMs, newMs, ParallelThreadCount());
+
+    EXPECT_TRUE(expected == actual);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
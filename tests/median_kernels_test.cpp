@@ -0,0 +1,150 @@
+/*
+ *  median_kernels_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Compares the 3x3 median kernels with a direct evaluation of the median of
+// the nine neighbors on random frames.
+
+#include "median_kernels.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+std::vector<SimdLevel> AllLevels()
+{
+    std::vector<SimdLevel> levels;
+    levels.push_back(SIMD_NONE);
+#if defined(PHD_HAVE_SSE2)
+    levels.push_back(SIMD_SSE2);
+#endif
+#if defined(PHD_HAVE_AVX2)
+    if (CpuSimdLevel() == SIMD_AVX2)
+        levels.push_back(SIMD_AVX2);
+#endif
+#if defined(PHD_HAVE_NEON)
+    levels.push_back(SIMD_NEON);
+#endif
+    return levels;
+}
+
+unsigned short ReferenceMedian(const std::vector<unsigned short>& img, int width, int x, int y)
+{
+    unsigned short v[9];
+    int n = 0;
+    for (int j = -1; j <= 1; j++)
+        for (int i = -1; i <= 1; i++)
+            v[n++] = img[(y + j) * width + x + i];
+    std::nth_element(v, v + 4, v + 9);
+    return v[4];
+}
+
+void CheckFrame(const std::vector<unsigned short>& img, int width, int height)
+{
+    const unsigned short GUARD = 0xbeef;
+
+    for (SimdLevel level : AllLevels())
+    {
+        std::vector<unsigned short> row(width);
+        for (int y = 1; y < height - 1; y++)
+        {
+            std::fill(row.begin(), row.end(), GUARD);
+            Median3Interior(&row[0], &img[(y - 1) * width], &img[y * width], &img[(y + 1) * width], width, level);
+
+            // the border pixels are left alone
+            ASSERT_EQ(row[0], GUARD) << SimdLevelName(level);
+            ASSERT_EQ(row[width - 1], GUARD) << SimdLevelName(level);
+
+            for (int x = 1; x < width - 1; x++)
+                ASSERT_EQ(row[x], ReferenceMedian(img, width, x, y))
+                    << SimdLevelName(level) << " width " << width << " at " << x << "," << y;
+        }
+    }
+}
+
+} // namespace
+
+TEST(Median3Test, random_full_range)
+{
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> px(0, 65535);
+
+    // widths around the vector sizes and the chunk size
+    const int widths[] = { 3, 4, 9, 10, 11, 17, 18, 19, 33, 100, 257, 258, 259, 513, 640 };
+    for (int width : widths)
+    {
+        int height = 5;
+        std::vector<unsigned short> img(width * height);
+        for (auto& v : img)
+            v = (unsigned short) px(rng);
+        CheckFrame(img, width, height);
+    }
+}
+
+TEST(Median3Test, random_with_ties)
+{
+    std::mt19937 rng(2);
+    std::uniform_int_distribution<int> px(0, 3);
+
+    for (int width = 3; width < 80; width++)
+    {
+        int height = 4;
+        std::vector<unsigned short> img(width * height);
+        for (auto& v : img)
+            v = (unsigned short) px(rng);
+        CheckFrame(img, width, height);
+    }
+}
+
+TEST(Median3Test, extremes)
+{
+    // values at both ends of the range exercise the SSE2 bias
+    std::mt19937 rng(3);
+    const unsigned short vals[] = { 0, 1, 0x7fff, 0x8000, 0x8001, 0xfffe, 0xffff };
+
+    int width = 300, height = 6;
+    std::vector<unsigned short> img(width * height);
+    for (auto& v : img)
+        v = vals[rng() % (sizeof(vals) / sizeof(vals[0]))];
+    CheckFrame(img, width, height);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
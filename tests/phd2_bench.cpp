@@ -0,0 +1,387 @@
+/*
+ *  phd2_bench.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Latency and throughput of the phd2core image processing and star detection
+// routines on synthetic star fields: the whole-frame operations and star
+// measurement behind usImage::CalcStats, Subtract, RemoveDefects and
+// Star::Find, and the SIMD kernels they are built from.
+//
+// Usage: phd2_bench [--frame=WxH] [--stars=N] [--noise=SIGMA] [--seed=N] [benchmark options]
+//
+//   --frame   frame size in pixels (default 1280x960)
+//   --stars   star density, stars per megapixel (default 50)
+//   --noise   standard deviation of the background noise in ADU (default 20)
+//   --seed    random seed for the synthetic frames (default 1)
+//
+// All other options are passed to Google Benchmark, e.g.
+// --benchmark_filter=Median3 or --benchmark_format=json.
+//
+// Star searches are timed per star (items/s is stars per second); whole frame
+// operations report bytes/s of 16-bit input. Kernels with SIMD implementations
+// are run at every level the build and the CPU support; the Star::Find and
+// whole-frame entry points use the level the CPU supports.
+
+#include "cpu_features.h"
+#include "frame_ops.h"
+#include "median_kernels.h"
+#include "parallel.h"
+#include "star_find.h"
+#include "star_kernels.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct BenchOptions
+{
+    int width = 1280;
+    int height = 960;
+    double starDensity = 50.0;
+    double noise = 20.0;
+    unsigned int seed = 1;
+};
+
+enum
+{
+    SEARCH_REGION = 15, // default guider search region
+    ANNULUS_OUTER = 12, // background annulus outer radius used by Star::Find
+    EDGE = SEARCH_REGION + ANNULUS_OUTER + 2, // keep the stars' searches inside the frame
+};
+
+double const HOT_PIXEL = 30000.0; // added to the hot pixels of the light and dark
+
+struct SyntheticField
+{
+    int width;
+    int height;
+    std::vector<unsigned short> light;
+    std::vector<unsigned short> dark;
+    std::vector<int> starX; // rounded star positions, the search starting points
+    std::vector<int> starY;
+    std::vector<DefectPoint> hotPixels;
+    DefectIndex defects; // the hot pixels
+
+    // Gaussian stars of random brightness and width on a noisy pedestal, with
+    // a sprinkling of hot pixels. The dark has the same pedestal and hot pixels.
+    explicit SyntheticField(const BenchOptions& opt) : width(opt.width), height(opt.height)
+    {
+        size_t const npix = (size_t) width * height;
+        std::mt19937 rng(opt.seed);
+        std::normal_distribution<double> gauss(0.0, opt.noise);
+        std::uniform_real_distribution<double> uni(0.0, 1.0);
+
+        double const pedestal = 1000.0;
+        std::vector<double> px(npix, pedestal);
+
+        int const nstars = std::max(1, (int) std::lround(opt.starDensity * (double) npix / 1e6));
+        for (int i = 0; i < nstars; i++)
+        {
+            double const sx = EDGE + uni(rng) * (width - 2 * EDGE);
+            double const sy = EDGE + uni(rng) * (height - 2 * EDGE);
+            double const amplitude = 200.0 + 20000.0 * uni(rng) * uni(rng);
+            double const sigma = 1.0 + 1.5 * uni(rng);
+            int const r = (int) std::ceil(5.0 * sigma);
+            for (int y = std::max(0, (int) sy - r); y <= std::min(height - 1, (int) sy + r); y++)
+            {
+                for (int x = std::max(0, (int) sx - r); x <= std::min(width - 1, (int) sx + r); x++)
+                {
+                    double const dx = x - sx;
+                    double const dy = y - sy;
+                    px[(size_t) y * width + x] += amplitude * std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+                }
+            }
+            starX.push_back((int) std::lround(sx));
+            starY.push_back((int) std::lround(sy));
+        }
+
+        light.resize(npix);
+        dark.resize(npix);
+        for (size_t i = 0; i < npix; i++)
+        {
+            bool const hot = uni(rng) < 1e-4;
+            double const d = pedestal + gauss(rng) * 0.5 + (hot ? HOT_PIXEL : 0.0);
+            double const v = px[i] + gauss(rng) + (hot ? HOT_PIXEL : 0.0);
+            dark[i] = (unsigned short) std::min(65535.0, std::max(0.0, d));
+            light[i] = (unsigned short) std::min(65535.0, std::max(0.0, v));
+            if (hot)
+                hotPixels.push_back(DefectPoint{ (int) (i % width), (int) (i / width) });
+        }
+
+        BuildDefectIndex(&defects, width, height, hotPixels.data(), hotPixels.size());
+        defects.defectCount = hotPixels.size();
+    }
+
+    size_t Bytes() const { return light.size() * sizeof(unsigned short); }
+};
+
+// A full-frame image with no subframe, as a usImage would present it
+template<typename T>
+FrameViewT<T> FullFrame(T *data, int width, int height)
+{
+    FrameViewT<T> v = { data, width, height, { 0, 0, width, height }, { 0, 0, 0, 0 } };
+    return v;
+}
+
+std::vector<SimdLevel> SupportedLevels()
+{
+    std::vector<SimdLevel> levels;
+    levels.push_back(SIMD_NONE);
+#if defined(PHD_HAVE_SSE2)
+    levels.push_back(SIMD_SSE2);
+#endif
+#if defined(PHD_HAVE_AVX2)
+    if (CpuSimdLevel() == SIMD_AVX2)
+        levels.push_back(SIMD_AVX2);
+#endif
+#if defined(PHD_HAVE_NEON)
+    levels.push_back(SIMD_NEON);
+#endif
+    return levels;
+}
+
+void RegisterBenchmarks(const SyntheticField& field)
+{
+    std::vector<SimdLevel> const levels = SupportedLevels();
+    const SyntheticField *f = &field;
+
+    for (SimdLevel simd : levels)
+    {
+        std::string const sfx = std::string("/") + SimdLevelName(simd);
+
+        // guide star search around each star's last position
+        benchmark::RegisterBenchmark(("FindSmoothedPeak" + sfx).c_str(), [f, simd](benchmark::State& state) {
+            size_t i = 0;
+            for (auto _ : state)
+            {
+                int const x = f->starX[i], y = f->starY[i];
+                StarPeak peak;
+                FindSmoothedPeak(&peak, f->light.data(), f->width, x - SEARCH_REGION, y - SEARCH_REGION, x + SEARCH_REGION,
+                                 y + SEARCH_REGION, simd);
+                benchmark::DoNotOptimize(peak);
+                if (++i == f->starX.size())
+                    i = 0;
+            }
+            state.SetItemsProcessed(state.iterations());
+        });
+
+        benchmark::RegisterBenchmark(("FindRawPeak" + sfx).c_str(), [f, simd](benchmark::State& state) {
+            size_t i = 0;
+            for (auto _ : state)
+            {
+                int const x = f->starX[i], y = f->starY[i];
+                StarPeak peak;
+                FindRawPeak(&peak, f->light.data(), f->width, x - SEARCH_REGION, y - SEARCH_REGION, x + SEARCH_REGION,
+                            y + SEARCH_REGION, simd);
+                benchmark::DoNotOptimize(peak);
+                if (++i == f->starX.size())
+                    i = 0;
+            }
+            state.SetItemsProcessed(state.iterations());
+        });
+
+        // whole-frame smoothed peak scan, the first pass of star auto-selection
+        benchmark::RegisterBenchmark(("FullFramePeak" + sfx).c_str(), [f, simd](benchmark::State& state) {
+            for (auto _ : state)
+            {
+                StarPeak peak;
+                FindSmoothedPeak(&peak, f->light.data(), f->width, 0, 0, f->width - 1, f->height - 1, simd);
+                benchmark::DoNotOptimize(peak);
+            }
+            state.SetBytesProcessed(state.iterations() * f->Bytes());
+        });
+
+        // 3x3 median noise reduction (Median3) and the image statistics filter
+        benchmark::RegisterBenchmark(("Median3" + sfx).c_str(), [f, simd](benchmark::State& state) {
+            std::vector<unsigned short> dst(f->light.size());
+            for (auto _ : state)
+            {
+                for (int y = 1; y < f->height - 1; y++)
+                {
+                    const unsigned short *row = f->light.data() + (size_t) y * f->width;
+                    Median3Interior(dst.data() + (size_t) y * f->width, row - f->width, row, row + f->width, f->width, simd);
+                }
+                benchmark::ClobberMemory();
+            }
+            state.SetBytesProcessed(state.iterations() * f->Bytes());
+        });
+    }
+
+    // one complete Star::Find measurement, the per-star cost of guiding
+    benchmark::RegisterBenchmark("StarFind", [f](benchmark::State& state) {
+        ConstFrameView const img = FullFrame(f->light.data(), f->width, f->height);
+        StarFindParams params = {};
+        params.searchRegion = SEARCH_REGION;
+        params.minHFD = 1.5;
+        params.maxHFD = 50.0;
+        params.bitsPerPixel = 16;
+        CoreLog const log = { nullptr, nullptr };
+        size_t i = 0;
+        for (auto _ : state)
+        {
+            params.baseX = f->starX[i];
+            params.baseY = f->starY[i];
+            StarFindResult res;
+            FindStar(&res, img, params, log);
+            benchmark::DoNotOptimize(res);
+            if (++i == f->starX.size())
+                i = 0;
+        }
+        state.SetItemsProcessed(state.iterations());
+    });
+
+    // frame statistics, computed for every displayed frame
+    benchmark::RegisterBenchmark("CalcStats", [f](benchmark::State& state) {
+        ConstFrameView const img = FullFrame(f->light.data(), f->width, f->height);
+        for (auto _ : state)
+        {
+            FrameStats stats;
+            CalcFrameStats(&stats, img);
+            benchmark::DoNotOptimize(stats);
+        }
+        state.SetBytesProcessed(state.iterations() * f->Bytes());
+    });
+
+    // median filter used to build defect maps from the master dark
+    benchmark::RegisterBenchmark("MedianFilter", [f](benchmark::State& state) {
+        int const halfWidth = (int) state.range(0);
+        std::vector<unsigned short> dst(f->dark.size());
+        for (auto _ : state)
+        {
+            MedianFilter(dst.data(), f->dark.data(), f->width, f->height, halfWidth);
+            benchmark::ClobberMemory();
+        }
+        state.SetBytesProcessed(state.iterations() * f->Bytes());
+    })->Arg(1)->Arg(3)->Unit(benchmark::kMillisecond);
+
+    // dark subtraction of a full frame
+    benchmark::RegisterBenchmark("Subtract", [f](benchmark::State& state) {
+        std::vector<unsigned short> light(f->light);
+        FrameView const img = FullFrame(light.data(), f->width, f->height);
+        ConstFrameView const dark = FullFrame(f->dark.data(), f->width, f->height);
+        FrameStats lightStats, darkStats;
+        CalcFrameStats(&lightStats, img);
+        CalcFrameStats(&darkStats, dark);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            std::memcpy(light.data(), f->light.data(), f->Bytes());
+            state.ResumeTiming();
+            unsigned short pedestal = 0;
+            SubtractDarkFrame(img, lightStats.medianADU, dark, darkStats.medianADU, &pedestal);
+            benchmark::ClobberMemory();
+        }
+        state.SetBytesProcessed(state.iterations() * f->Bytes());
+    });
+
+    // bad pixel removal with a defect map of the dark's hot pixels
+    benchmark::RegisterBenchmark("RemoveDefects", [f](benchmark::State& state) {
+        std::vector<unsigned short> light(f->light);
+        FrameView const img = FullFrame(light.data(), f->width, f->height);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            std::memcpy(light.data(), f->light.data(), f->Bytes());
+            state.ResumeTiming();
+            RemoveFrameDefects(img, f->defects);
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * f->defects.entries.size());
+    });
+}
+
+bool ParseOption(const char *arg, BenchOptions *opt)
+{
+    if (std::strncmp(arg, "--frame=", 8) == 0)
+        return std::sscanf(arg + 8, "%dx%d", &opt->width, &opt->height) == 2 && opt->width > 2 * EDGE &&
+            opt->height > 2 * EDGE;
+    if (std::strncmp(arg, "--stars=", 8) == 0)
+        return (opt->starDensity = std::atof(arg + 8)) > 0.0;
+    if (std::strncmp(arg, "--noise=", 8) == 0)
+        return (opt->noise = std::atof(arg + 8)) >= 0.0;
+    if (std::strncmp(arg, "--seed=", 7) == 0)
+    {
+        opt->seed = (unsigned int) std::strtoul(arg + 7, nullptr, 10);
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // pick out our own options and leave the rest for Google Benchmark
+    BenchOptions opt;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        bool const ours = std::strncmp(argv[i], "--frame=", 8) == 0 || std::strncmp(argv[i], "--stars=", 8) == 0 ||
+            std::strncmp(argv[i], "--noise=", 8) == 0 || std::strncmp(argv[i], "--seed=", 7) == 0;
+        if (!ours)
+            argv[nargs++] = argv[i];
+        else if (!ParseOption(argv[i], &opt))
+        {
+            std::fprintf(stderr, "phd2_bench: invalid option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    argc = nargs;
+
+    SyntheticField field(opt);
+
+    benchmark::AddCustomContext("frame", std::to_string(opt.width) + "x" + std::to_string(opt.height));
+    benchmark::AddCustomContext("stars", std::to_string(field.starX.size()));
+    benchmark::AddCustomContext("defects", std::to_string(field.defects.entries.size()));
+    benchmark::AddCustomContext("noise", std::to_string(opt.noise));
+    benchmark::AddCustomContext("simd", SimdLevelName(CpuSimdLevel()));
+    benchmark::AddCustomContext("threads", std::to_string(ParallelThreadCount()));
+
+    RegisterBenchmarks(field);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ *  star_kernels_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Compares the vectorized Star::Find kernels with the scalar implementation
+// on synthetic star fields.
+
+#include "star_kernels.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+struct SyntheticFrame
+{
+    int width;
+    int height;
+    std::vector<unsigned short> pixels;
+
+    // Gaussian star of the given amplitude and sigma on a noisy pedestal,
+    // with a sprinkling of saturated hot pixels
+    SyntheticFrame(int w, int h, double starx, double stary, double amplitude, double sigma, double pedestal, double noise,
+                   unsigned int seed)
+        : width(w), height(h), pixels(w * h)
+    {
+        std::mt19937 rng(seed);
+        std::normal_distribution<double> gauss(0.0, noise);
+        std::uniform_int_distribution<int> hot(0, 999);
+
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                double dx = x - starx;
+                double dy = y - stary;
+                double v = pedestal + gauss(rng) + amplitude * exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+                if (hot(rng) == 0)
+                    v = 65535.0;
+                pixels[y * w + x] = (unsigned short) std::min(65535.0, std::max(0.0, v));
+            }
+        }
+    }
+};
+
+std::vector<SimdLevel> VectorLevels()
+{
+    std::vector<SimdLevel> levels;
+#if defined(PHD_HAVE_SSE2)
+    levels.push_back(SIMD_SSE2);
+#endif
+#if defined(PHD_HAVE_AVX2)
+    if (CpuSimdLevel() == SIMD_AVX2)
+        levels.push_back(SIMD_AVX2);
+#endif
+#if defined(PHD_HAVE_NEON)
+    levels.push_back(SIMD_NEON);
+#endif
+    return levels;
+}
+
+struct Region
+{
+    int x0, y0, x1, y1;
+};
+
+// search regions covering the star, the frame edges and a few odd widths
+// that exercise the vector tail handling
+std::vector<Region> SearchRegions(const SyntheticFrame& frame, int cx, int cy)
+{
+    std::vector<Region> regions;
+    for (int r = 2; r <= 45; r += 7)
+    {
+        Region rgn;
+        rgn.x0 = std::max(cx - r, 0);
+        rgn.y0 = std::max(cy - r, 0);
+        rgn.x1 = std::min(cx + r, frame.width - 1);
+        rgn.y1 = std::min(cy + r, frame.height - 1);
+        regions.push_back(rgn);
+    }
+    Region full = { 0, 0, frame.width - 1, frame.height - 1 };
+    regions.push_back(full);
+    return regions;
+}
+
+} // namespace
+
+class StarKernelsTest : public ::testing::TestWithParam<int>
+{
+protected:
+    SyntheticFrame MakeFrame() const
+    {
+        int seed = GetParam();
+        std::mt19937 rng(seed);
+        int w = 37 + rng() % 160;
+        int h = 29 + rng() % 120;
+        double starx = w * (rng() % 1000) / 1000.0;
+        double stary = h * (rng() % 1000) / 1000.0;
+        double amplitude = 500.0 + rng() % 60000;
+        double sigma = 0.7 + (rng() % 40) / 10.0;
+        double pedestal = (seed % 5 == 0) ? 0.0 : 100.0 + rng() % 3000;
+        double noise = 1.0 + rng() % 60;
+        return SyntheticFrame(w, h, starx, stary, amplitude, sigma, pedestal, noise, seed);
+    }
+};
+
+TEST_P(StarKernelsTest, smoothed_peak)
+{
+    SyntheticFrame frame = MakeFrame();
+    const unsigned short *img = &frame.pixels[0];
+
+    for (const Region& rgn : SearchRegions(frame, frame.width / 2, frame.height / 2))
+    {
+        StarPeak ref;
+        FindSmoothedPeak(&ref, img, frame.width, rgn.x0, rgn.y0, rgn.x1, rgn.y1, SIMD_NONE);
+
+        // the scalar kernel against a direct evaluation of the smoothing filter
+        unsigned int best = 0;
+        for (int y = rgn.y0 + 1; y < rgn.y1; y++)
+            for (int x = rgn.x0 + 1; x < rgn.x1; x++)
+            {
+                const unsigned short *p = img + y * frame.width + x;
+                int w = frame.width;
+                unsigned int v = 4 * p[0] + 2 * (p[-1] + p[1] + p[-w] + p[w]) + p[-w - 1] + p[-w + 1] + p[w - 1] + p[w + 1];
+                best = std::max(best, v);
+            }
+        EXPECT_EQ(ref.val, best);
+
+        for (SimdLevel level : VectorLevels())
+        {
+            StarPeak peak;
+            FindSmoothedPeak(&peak, img, frame.width, rgn.x0, rgn.y0, rgn.x1, rgn.y1, level);
+            EXPECT_EQ(peak.x, ref.x) << SimdLevelName(level);
+            EXPECT_EQ(peak.y, ref.y) << SimdLevelName(level);
+            EXPECT_EQ(peak.val, ref.val) << SimdLevelName(level);
+            for (int i = 0; i < 3; i++)
+                EXPECT_EQ(peak.max3[i], ref.max3[i]) << SimdLevelName(level);
+        }
+    }
+}
+
+TEST_P(StarKernelsTest, raw_peak)
+{
+    SyntheticFrame frame = MakeFrame();
+    const unsigned short *img = &frame.pixels[0];
+
+    for (const Region& rgn : SearchRegions(frame, frame.width / 3, frame.height / 3))
+    {
+        StarPeak ref;
+        FindRawPeak(&ref, img, frame.width, rgn.x0, rgn.y0, rgn.x1, rgn.y1, SIMD_NONE);
+
+        for (SimdLevel level : VectorLevels())
+        {
+            StarPeak peak;
+            FindRawPeak(&peak, img, frame.width, rgn.x0, rgn.y0, rgn.x1, rgn.y1, level);
+            EXPECT_EQ(peak.x, ref.x) << SimdLevelName(level);
+            EXPECT_EQ(peak.y, ref.y) << SimdLevelName(level);
+            EXPECT_EQ(peak.val, ref.val) << SimdLevelName(level);
+        }
+    }
+}
+
+TEST_P(StarKernelsTest, annulus_stats)
+{
+    SyntheticFrame frame = MakeFrame();
+    const unsigned short *img = &frame.pixels[0];
+    const int A = 7, B = 12;
+
+    for (int cy = 0; cy < frame.height; cy += 5)
+    {
+        for (int cx = 0; cx < frame.width; cx += 7)
+        {
+            unsigned short vals[(2 * B + 1) * (2 * B + 1)];
+            unsigned int count = GatherAnnulus(vals, img, frame.width, cx, cy, A, B, 0, 0, frame.width - 1, frame.height - 1);
+
+            // gathered pixels match a direct scan of the annulus
+            unsigned int n = 0;
+            unsigned long long sum = 0;
+            for (int y = std::max(cy - B, 0); y <= std::min(cy + B, frame.height - 1); y++)
+                for (int x = std::max(cx - B, 0); x <= std::min(cx + B, frame.width - 1); x++)
+                {
+                    int r2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                    if (r2 <= A * A || r2 > B * B)
+                        continue;
+                    ++n;
+                    sum += img[y * frame.width + x];
+                }
+            ASSERT_EQ(count, n);
+
+            unsigned short lo = 0, hi = 65535;
+            for (int iter = 0; iter < 3; iter++)
+            {
+                ClippedSums ref;
+                SumClipped(&ref, vals, count, lo, hi, SIMD_NONE);
+                if (iter == 0)
+                {
+                    EXPECT_EQ(ref.sum, sum);
+                }
+
+                for (SimdLevel level : VectorLevels())
+                {
+                    ClippedSums s;
+                    SumClipped(&s, vals, count, lo, hi, level);
+                    EXPECT_EQ(s.n, ref.n) << SimdLevelName(level);
+                    EXPECT_EQ(s.sum, ref.sum) << SimdLevelName(level);
+                    EXPECT_EQ(s.sum2, ref.sum2) << SimdLevelName(level);
+                }
+
+                if (ref.n < 2)
+                    break;
+                double mean = (double) ref.sum / ref.n;
+                double sigma = sqrt((double) (ref.n * ref.sum2 - ref.sum * ref.sum) / ((double) ref.n * (ref.n - 1)));
+                lo = (unsigned short) std::max(0.0, ceil(mean - 2.0 * sigma));
+                hi = (unsigned short) std::min(65535.0, floor(mean + 2.0 * sigma));
+            }
+        }
+    }
+}
+
+TEST_P(StarKernelsTest, aperture)
+{
+    SyntheticFrame frame = MakeFrame();
+    const unsigned short *img = &frame.pixels[0];
+    const int A = 7;
+
+    for (unsigned short thresh : { 0, 150, 1000, 20000 })
+    {
+        for (int cy = 0; cy < frame.height; cy += 3)
+        {
+            for (int cx = 0; cx < frame.width; cx += 4)
+            {
+                ApertureSums ref;
+                unsigned int refmask[2 * A + 1];
+                SumAperture(&ref, refmask, img, frame.width, cx, cy, A, 0, 0, frame.width - 1, frame.height - 1, thresh,
+                            SIMD_NONE);
+
+                for (SimdLevel level : VectorLevels())
+                {
+                    ApertureSums s;
+                    unsigned int mask[2 * A + 1];
+                    SumAperture(&s, mask, img, frame.width, cx, cy, A, 0, 0, frame.width - 1, frame.height - 1, thresh, level);
+                    EXPECT_EQ(s.n, ref.n) << SimdLevelName(level);
+                    EXPECT_EQ(s.sum, ref.sum) << SimdLevelName(level);
+                    EXPECT_EQ(s.sumdx, ref.sumdx) << SimdLevelName(level);
+                    EXPECT_EQ(s.sumdy, ref.sumdy) << SimdLevelName(level);
+                    EXPECT_EQ(s.dx, ref.dx) << SimdLevelName(level);
+                    EXPECT_EQ(s.dy, ref.dy) << SimdLevelName(level);
+                    for (int j = 0; j <= 2 * A; j++)
+                        EXPECT_EQ(mask[j], refmask[j]) << SimdLevelName(level) << " row " << j;
+                }
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(SyntheticStars, StarKernelsTest, ::testing::Range(1, 25));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}